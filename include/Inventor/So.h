@@ -35,6 +35,7 @@
 
 #include <Inventor/SoDB.h>
 #include <Inventor/SoInput.h>
+#include <Inventor/SoOffscreenRenderQueue.h>
 #include <Inventor/SoOffscreenRenderer.h>
 #include <Inventor/SoOutput.h>
 #include <Inventor/SoPath.h>
@@ -103,6 +103,10 @@ public:
   static SbBool isNotifying(void);
   static void endNotify(void);
 
+  static void startTransaction(void);
+  static SbBool isInTransaction(void);
+  static void endTransaction(void);
+
   typedef SbBool ProgressCallbackType(const SbName & itemid, float fraction,
                                       SbBool interruptible, void * userdata);
   static void addProgressCallback(ProgressCallbackType * func, void * userdata);
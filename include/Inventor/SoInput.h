@@ -120,6 +120,9 @@ public:
 
   SbBool isFileVRML1(void);
   SbBool isFileVRML2(void);
+
+  void setNumParseThreads(const int numthreads);
+  int getNumParseThreads(void) const;
   virtual void resetFilePointer(FILE * fptr);
 
   virtual void getLocationString(SbString & string) const;
@@ -0,0 +1,72 @@
+#ifndef COIN_SOOFFSCREENRENDERQUEUE_H
+#define COIN_SOOFFSCREENRENDERQUEUE_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#include <Inventor/SoOffscreenRenderer.h>
+#include <Inventor/SbVec2s.h>
+
+class SoCamera;
+class SoNode;
+class SoOffscreenRenderQueueP;
+
+class COIN_DLL_API SoOffscreenRenderQueue {
+public:
+  SoOffscreenRenderQueue(void);
+  ~SoOffscreenRenderQueue();
+
+  void setComponents(const SoOffscreenRenderer::Components components);
+  SoOffscreenRenderer::Components getComponents(void) const;
+  void setBackgroundColor(const SbColor & color);
+  const SbColor & getBackgroundColor(void) const;
+  void setNumThreads(const int numthreads);
+  int getNumThreads(void) const;
+
+  int addJob(SoNode * scene, SoCamera * camera, const SbVec2s & size);
+  int getNumPendingJobs(void) const;
+  void processJobs(void);
+
+  SbBool isJobDone(const int job) const;
+  const unsigned char * getJobBuffer(const int job) const;
+  SbVec2s getJobSize(const int job) const;
+  void removeJob(const int job);
+
+private:
+  SoOffscreenRenderQueue(const SoOffscreenRenderQueue & rhs); // N/A
+  SoOffscreenRenderQueue & operator = (const SoOffscreenRenderQueue & rhs); // N/A
+
+  friend class SoOffscreenRenderQueueP;
+  class SoOffscreenRenderQueueP * pimpl;
+};
+
+#endif // !COIN_SOOFFSCREENRENDERQUEUE_H
@@ -52,6 +52,10 @@ class SoPath;
 // SoExtSelectionP" statement in the class definition.
 class SoOffscreenRendererP;
 
+typedef void SoOffscreenRendererRowCB(void * userdata,
+                                      class SoOffscreenRenderer * renderer,
+                                      const unsigned char * rows,
+                                      int firstrow, int numrows);
 
 class COIN_DLL_API SoOffscreenRenderer {
 public:
@@ -100,6 +104,16 @@ public:
   void setPbufferEnable(SbBool enable);
   SbBool getPbufferEnable(void) const;
 
+  void setNumThreads(const int numthreads);
+  int getNumThreads(void) const;
+
+  static void setContextPoolSize(const int numcontexts);
+  static int getContextPoolSize(void);
+
+  void setRowCallback(SoOffscreenRendererRowCB * func, void * userdata = NULL);
+  SbBool renderToRGB(SoNode * scene, FILE * fp);
+  SbBool renderToRGB(SoNode * scene, const char * filename);
+
 private:
   friend class SoOffscreenRendererP;
   class SoOffscreenRendererP * pimpl;
@@ -66,6 +66,8 @@ public:
   SbBool setCompression(const SbName & compmethod,
                         const float level = 0.5f);
   static const SbName * getAvailableCompressionMethods(unsigned int & num);
+  void setNumCompressionThreads(const int numthreads);
+  int getNumCompressionThreads(void) const;
 
   virtual void setBuffer(void * bufPointer, size_t initSize,
                          SoOutputReallocCB * reallocFunc, int32_t offset = 0);
@@ -77,6 +79,10 @@ public:
   virtual void setHeaderString(const SbString & str);
   virtual void resetHeaderString(void);
   virtual void setFloatPrecision(const int precision);
+  void setRoundTripFloats(const SbBool flag);
+  SbBool getRoundTripFloats(void) const;
+  void setSceneCacheFormat(const SbBool flag);
+  SbBool isSceneCacheFormat(void) const;
 
   void setStage(Stage stage);
   Stage getStage(void) const;
@@ -88,6 +88,8 @@ public:
   static SbColor & getBoundingBoxColor(void);
   static void setReadAsSoFile(SbBool enable);
   static SbBool getReadAsSoFile(void);
+  static void setDelayFetchURL(const SbBool onoff);
+  static SbBool getDelayFetchURL(void);
 
   virtual void doAction(SoAction * action);
   virtual void callback(SoCallbackAction * action);
@@ -132,6 +132,9 @@ public:
   void setDelayedObjDepthWrite(SbBool write);
   SbBool getDelayedObjDepthWrite(void) const;
 
+  void setNumSortThreads(const int numthreads);
+  int getNumSortThreads(void) const;
+
   SbBool isRenderingTranspPaths(void) const;
   SbBool isRenderingTranspBackfaces(void) const;
 
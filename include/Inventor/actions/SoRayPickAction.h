@@ -66,6 +66,8 @@ public:
               float fardistance = -1.0);
   void setPickAll(const SbBool flag);
   SbBool isPickAll(void) const;
+  void setBVHCaching(const SbBool onoff);
+  SbBool isBVHCaching(void) const;
   const SoPickedPointList & getPickedPointList(void) const;
   SoPickedPoint * getPickedPoint(const int index = 0) const;
 
@@ -61,6 +61,12 @@ public:
   SbBool areVPNodesGenerated(void); 
   void matchIndexArrays(SbBool onoff);
   SbBool areIndexArraysMatched(void) const;
+  void optimizeVertexCache(SbBool onoff);
+  SbBool isVertexCacheOptimized(void) const;
+  void optimizeOverdraw(SbBool onoff);
+  SbBool isOverdrawOptimized(void) const;
+  void setVertexCacheSize(const int size);
+  int getVertexCacheSize(void) const;
   SoSimplifier * getSimplifier(void) const;
 
   virtual void apply(SoNode * root);
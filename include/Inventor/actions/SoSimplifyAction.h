@@ -53,6 +53,17 @@ public:
   virtual void apply(SoPath * path);
   virtual void apply(const SoPathList & pathlist, SbBool obeysrules = FALSE);
 
+  void setSimplificationLevels(const int numlevels, const float levels[]);
+  int getNumSimplificationLevels(void) const;
+  const float * getSimplificationLevels(void) const;
+
+  void setScreenAreas(const int numareas, const float areas[]);
+  int getNumScreenAreas(void) const;
+  const float * getScreenAreas(void) const;
+
+  void setMinTriangles(const int mintriangles);
+  int getMinTriangles(void) const;
+
 protected:
   virtual void beginTraversal(SoNode * node);
 
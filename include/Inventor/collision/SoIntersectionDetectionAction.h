@@ -85,6 +85,9 @@ public:
   void setShapeInternalsEnabled(SbBool enable);
   SbBool isShapeInternalsEnabled(void) const;
 
+  void setNumThreads(int numthreads);
+  int getNumThreads(void) const;
+
   void addVisitationCallback(SoType type, SoIntersectionVisitationCB * cb, void * closure);
   void removeVisitationCallback(SoType type, SoIntersectionVisitationCB * cb, void * closure);
 
@@ -65,6 +65,9 @@ public:
   void set1HSVValue(int idx, float h, float s, float v);
   void set1HSVValue(int idx, const float hsv[3]);
 
+private:
+  virtual SbBool readBinaryValues(SoInput * in, int num);
+
 }; // SoMFColor
 
 #endif // !COIN_SOMFCOLOR_H
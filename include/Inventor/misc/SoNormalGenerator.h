@@ -57,6 +57,11 @@ public:
             const SbVec3f &v2,
             const SbVec3f &v3);
 
+  void setIndexedFaces(const SbVec3f * coords,
+                       const int numcoords,
+                       const int32_t * coordindex,
+                       const int numindices);
+
   void generate(const float creaseAngle,
                 const int32_t * striplens = NULL,
                 const int numstrips = 0);
@@ -73,6 +78,9 @@ public:
   const SbVec3f & getNormal(const int32_t i) const;
   void setNormal(const int32_t index, const SbVec3f &normal);
 
+  static void setNumThreads(const int numthreads);
+  static int getNumThreads(void);
+
 private:
   SbBSPTree bsp;
   SbList <int> vertexList;
@@ -72,6 +72,9 @@ public:
   static void setSearchOK(SbBool dosearch);
   static SbBool getSearchOK();
 
+  static void setDelayedRead(SbBool delay);
+  static SbBool getDelayedRead(void);
+
 protected:
   virtual ~SoFile();
 
@@ -424,6 +424,8 @@ SoAction::initClasses(void)
   SoIntersectionDetectionAction::initClass();
 
   SoSimplifyAction::initClass();
+  SoShapeSimplifyAction::initClass();
+  SoGlobalSimplifyAction::initClass();
   SoReorganizeAction::initClass();
   SoToVRMLAction::initClass();
 #ifdef HAVE_VRML97
@@ -72,6 +72,9 @@
 
 #include <Inventor/C/glue/gl.h>
 #include <Inventor/C/tidbits.h>
+#ifdef HAVE_THREADS
+#include <Inventor/C/threads/wpool.h>
+#endif // HAVE_THREADS
 #include <Inventor/SbColor.h>
 #include <Inventor/SbPlane.h>
 #include <Inventor/SoFullPath.h>
@@ -122,6 +125,7 @@
 #include "SbBasicP.h"
 #include "actions/SoActionP.h"
 #include "actions/SoSubActionP.h"
+#include "base/SbRadixSort.h"
 #include "glue/glp.h"
 #include "glue/simage_wrapper.h"
 #include "rendering/SoGL.h"
@@ -539,7 +543,18 @@
 
 class SoGLRenderActionP {
 public:
-  SoGLRenderActionP(void) : action(NULL) { }
+  SoGLRenderActionP(void)
+    : action(NULL), sorttranspobjorder(NULL), sorttranspobjordersize(0) {
+#ifdef HAVE_THREADS
+    this->sortpool = NULL;
+#endif // HAVE_THREADS
+  }
+  ~SoGLRenderActionP() {
+    delete[] this->sorttranspobjorder;
+#ifdef HAVE_THREADS
+    if (this->sortpool) cc_wpool_destruct(this->sortpool);
+#endif // HAVE_THREADS
+  }
 
   SoGLRenderAction * action;
   SbViewportRegion viewport;
@@ -560,6 +575,17 @@ public:
   SoPathList transpobjpaths;
   SoPathList sorttranspobjpaths;
   SbList<float> sorttranspobjdistances;
+  SbRadixSort pathsorter;
+  // kept between frames, for repairing the previous order
+  SbList<uintptr_t> sorttranspobjkeys;
+  int32_t * sorttranspobjorder;
+  int sorttranspobjordersize;
+  int numsortthreads;
+#ifdef HAVE_THREADS
+  // shared by the primitive vertex caches for sorting triangles
+  cc_wpool * sortpool;
+  static cc_wpool * getSortPool(SoGLRenderAction * action, const int numworkers);
+#endif // HAVE_THREADS
   SoGLRenderAction::TransparentDelayedObjectRenderType transpdelayedrendertype;
   SbBool renderingtranspbackfaces;
 
@@ -617,7 +643,7 @@ public:
   void addSortTransPath(SoPath * path);
 
   void addTransPath(SoPath * path);
-  void doPathSort(void);
+  const int32_t * doPathSort(void);
 
   // For profiling mode auto-redraw functionality
   boost::scoped_ptr<SoAlarmSensor> redrawSensor;
@@ -738,6 +764,7 @@ SoGLRenderAction::SoGLRenderAction(const SbViewportRegion & viewportregion)
   PRIVATE(this)->sortedobjectstrategy = BBOX_CENTER;
   PRIVATE(this)->sortedobjectcb = NULL;
   PRIVATE(this)->sortedobjectclosure = NULL;
+  PRIVATE(this)->numsortthreads = 1;
 }
 
 /*!
@@ -1479,35 +1506,95 @@ SoGLRenderAction::invalidateState(void)
   PRIVATE(this)->needglinit = TRUE;
 }
 
-// Sort paths with transparent objects before rendering.
-void
-SoGLRenderActionP::doPathSort(void)
+// The number of insertion sort moves per path allowed when repairing
+// the previous order of the transparent paths. Above this, the paths
+// are sorted from scratch.
+static const int SOGLRENDER_MAX_REPAIR_MOVES = 8;
+
+// Identifies a transparent path between frames, from the nodes and
+// child indices of the path and the node id of the tail, so that a
+// change to the shape itself gives a new key. A false match only
+// costs some extra moves, as the order is always repaired against
+// the current distances.
+static uintptr_t
+soglrender_path_key(const SoPath * path)
+{
+  const SoFullPath * fullpath = reclassify_cast<const SoFullPath *>(path);
+  uintptr_t key = static_cast<uintptr_t>(fullpath->getTail()->getNodeId());
+  for (int i = 0; i < fullpath->getLength(); i++) {
+    key = key * 33 + reinterpret_cast<uintptr_t>(fullpath->getNode(i));
+    key = key * 33 + static_cast<uintptr_t>(fullpath->getIndex(i));
+  }
+  return key;
+}
+
+// Insertion sorts the path order from the previous frame on the
+// current distances, most distant first. Ties are broken on
+// traversal order, which gives the same order as a full sort.
+// Returns FALSE if the order has changed too much to be worth
+// repairing.
+static SbBool
+soglrender_repair_order(int32_t * order, const float * distances, const int num)
 {
-  // need to cast to SbPList to avoid ref/unref problems, since
-  // operator[] is overloaded with non-virtual inheritance.
-  SbPList * plist = &this->sorttranspobjpaths;
-  float * darray = const_cast<float *>(this->sorttranspobjdistances.getArrayPtr());
-
-  int i, j, distance, n = this->sorttranspobjdistances.getLength();
-  void * ptmp;
-  float dtmp;
-
-  // shell sort algorithm (O(nlog(n))
-  for (distance = 1; distance <= n/9; distance = 3*distance + 1) ;
-  for (; distance > 0; distance /= 3) {
-    for (i = distance; i < n; i++) {
-      dtmp = darray[i];
-      ptmp = plist->get(i);
-      j = i;
-      while (j >= distance && darray[j-distance] < dtmp) {
-        darray[j] = darray[j-distance];
-        plist->set(j, plist->get(j-distance));
-        j -= distance;
+  int moves = num * SOGLRENDER_MAX_REPAIR_MOVES;
+  for (int i = 1; i < num; i++) {
+    const int32_t idx = order[i];
+    const float dist = distances[idx];
+    int j = i;
+    while (j > 0 &&
+           ((distances[order[j-1]] < dist) ||
+            (distances[order[j-1]] == dist && order[j-1] > idx))) {
+      order[j] = order[j-1];
+      j--;
+      if (--moves < 0) {
+        order[j] = idx;
+        return FALSE;
       }
-      darray[j] = dtmp;
-      plist->set(j, ptmp);
     }
+    order[j] = idx;
   }
+  return TRUE;
+}
+
+// Sort paths with transparent objects before rendering. Returns the
+// indices of the paths, with the most distant path first. Paths at
+// the same distance are rendered in traversal order.
+//
+// When the same paths are rendered as in the previous frame, the
+// previous order is nearly sorted if the camera moved only a little,
+// and is repaired instead of sorting from scratch.
+const int32_t *
+SoGLRenderActionP::doPathSort(void)
+{
+  const int num = this->sorttranspobjpaths.getLength();
+  SbBool samepaths = (num == this->sorttranspobjkeys.getLength());
+  if (!samepaths) {
+    this->sorttranspobjkeys.truncate(0);
+    for (int i = 0; i < num; i++) this->sorttranspobjkeys.append(0);
+  }
+  for (int i = 0; i < num; i++) {
+    const uintptr_t key = soglrender_path_key(this->sorttranspobjpaths[i]);
+    if (key != this->sorttranspobjkeys[i]) {
+      this->sorttranspobjkeys[i] = key;
+      samepaths = FALSE;
+    }
+  }
+
+  const float * distances = this->sorttranspobjdistances.getArrayPtr();
+  if (samepaths &&
+      soglrender_repair_order(this->sorttranspobjorder, distances, num)) {
+    return this->sorttranspobjorder;
+  }
+  if (num > this->sorttranspobjordersize) {
+    delete[] this->sorttranspobjorder;
+    this->sorttranspobjorder = new int32_t[num];
+    this->sorttranspobjordersize = num;
+  }
+  if (num > 0) {
+    const int32_t * order = this->pathsorter.sort(distances, num, TRUE);
+    (void)memcpy(this->sorttranspobjorder, order, num * sizeof(int32_t));
+  }
+  return this->sorttranspobjorder;
 }
 
 /*!
@@ -1551,6 +1638,59 @@ SoGLRenderAction::removePreRenderCallback(SoGLPreRenderCB * func, void * userdat
   PRIVATE(this)->precblist.removeCallback(reinterpret_cast<SoCallbackListCB *>(func), userdata);
 }
 
+/*!
+  Sets the number of threads used to calculate the depths of the
+  triangles of large shapes when the transparency type is
+  SORTED_OBJECT_SORTED_TRIANGLE_ADD or
+  SORTED_OBJECT_SORTED_TRIANGLE_BLEND. Each thread gets at least 65536
+  vertices or triangles. The default is 1.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa getNumSortThreads()
+  \since Coin 4.0
+*/
+void
+SoGLRenderAction::setNumSortThreads(const int numthreads)
+{
+  assert(numthreads >= 1);
+  PRIVATE(this)->numsortthreads = numthreads;
+}
+
+/*!
+  Returns the number of threads used for sorting triangles.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa setNumSortThreads()
+  \since Coin 4.0
+*/
+int
+SoGLRenderAction::getNumSortThreads(void) const
+{
+  return PRIVATE(this)->numsortthreads;
+}
+
+#ifdef HAVE_THREADS
+cc_wpool *
+SoGLRenderActionP::getSortPool(SoGLRenderAction * action, const int numworkers)
+{
+  if (PRIVATE(action)->sortpool == NULL) {
+    PRIVATE(action)->sortpool = cc_wpool_construct(numworkers);
+  }
+  else if (cc_wpool_get_num_workers(PRIVATE(action)->sortpool) < numworkers) {
+    cc_wpool_set_num_workers(PRIVATE(action)->sortpool, numworkers);
+  }
+  return PRIVATE(action)->sortpool;
+}
+
+cc_wpool *
+sogl_sort_pool(SoGLRenderAction * action, const int numworkers)
+{
+  return SoGLRenderActionP::getSortPool(action, numworkers);
+}
+#endif // HAVE_THREADS
+
 /*!
 
   Sets the strategy used for sorting transparent objects.
@@ -1886,7 +2026,7 @@ SoGLRenderActionP::renderSingle(SoNode * node)
 
     // All paths in the sorttranspobjpaths should be sorted
     // back-to-front and rendered
-    this->doPathSort();
+    const int32_t * sortorder = this->doPathSort();
     int i;
     for (i = 0; i < this->sorttranspobjpaths.getLength(); i++) {
       for (int pass = 0; pass < numtransppasses; pass++) {
@@ -1902,7 +2042,7 @@ SoGLRenderActionP::renderSingle(SoNode * node)
             break;
           }
         }
-        this->action->apply(this->sorttranspobjpaths[i]);
+        this->action->apply(this->sorttranspobjpaths[sortorder[i]]);
       }
     }
 
@@ -2681,3 +2821,134 @@ SoGLRenderActionP::renderSortedLayersNV(const SoState * state)
 // *************************************************************************
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SbRotation.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/C/glue/gl.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/nodes/SoCallback.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoMaterial.h>
+#include <Inventor/nodes/SoPerspectiveCamera.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+// check that the order of the sorted transparent paths, repaired from
+// the previous frame, is the same as a fresh sort gives
+
+static SbList<int> * glrender_test_order = NULL;
+
+static void
+glrender_test_record(void * closure, SoAction * action)
+{
+  if (action->isOfType(SoGLRenderAction::getClassTypeId()) &&
+      static_cast<SoGLRenderAction *>(action)->isRenderingTranspPaths()) {
+    glrender_test_order->append(int(reinterpret_cast<intptr_t>(closure)));
+  }
+}
+
+static SoSeparator *
+glrender_test_object(const int id, const SbVec3f & pos)
+{
+  SoSeparator * sep = new SoSeparator;
+  SoTranslation * translation = new SoTranslation;
+  translation->translation = pos;
+  sep->addChild(translation);
+  SoCallback * callback = new SoCallback;
+  callback->setCallback(glrender_test_record, reinterpret_cast<void *>(intptr_t(id)));
+  sep->addChild(callback);
+  sep->addChild(new SoCube);
+  return sep;
+}
+
+static SbBool
+glrender_test_same_order(SoGLRenderAction * action, SoNode * root)
+{
+  SbList<int> kept, fresh;
+  glrender_test_order = &kept;
+  action->apply(root);
+  SoGLRenderAction freshaction(action->getViewportRegion());
+  freshaction.setTransparencyType(SoGLRenderAction::SORTED_OBJECT_BLEND);
+  glrender_test_order = &fresh;
+  freshaction.apply(root);
+  glrender_test_order = NULL;
+  return kept.getLength() > 0 && kept == fresh;
+}
+
+BOOST_AUTO_TEST_CASE(sortedPathOrder)
+{
+  void * ctx = cc_glglue_context_create_offscreen(64, 64);
+  if (!ctx || !cc_glglue_context_make_current(ctx)) {
+    if (ctx) cc_glglue_context_destruct(ctx);
+    BOOST_TEST_MESSAGE("no offscreen OpenGL context, sortedPathOrder skipped");
+    return;
+  }
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoPerspectiveCamera * camera = new SoPerspectiveCamera;
+  camera->position.setValue(0.0f, 0.0f, 30.0f);
+  root->addChild(camera);
+  SoMaterial * material = new SoMaterial;
+  material->transparency = 0.5f;
+  root->addChild(material);
+  // objects with nearly the same depths, and two at the same depth
+  const int numobjects = 24;
+  for (int i = 0; i < numobjects; i++) {
+    const SbVec3f pos(float(i - numobjects / 2) * 1.5f,
+                      0.0f, -float((i * 7) % 23) * 0.2f);
+    root->addChild(glrender_test_object(i, pos));
+  }
+
+  SoGLRenderAction action(SbViewportRegion(64, 64));
+  action.setTransparencyType(SoGLRenderAction::SORTED_OBJECT_BLEND);
+  BOOST_CHECK_MESSAGE(glrender_test_same_order(&action, root),
+                      "first frame differs");
+
+  // camera moves along the view direction, which keep the tie
+  for (int frame = 1; frame <= 3; frame++) {
+    camera->position.setValue(0.0f, 0.0f, 30.0f - 0.5f * float(frame));
+    BOOST_CHECK_MESSAGE(glrender_test_same_order(&action, root),
+                        "order differs after move " << frame);
+  }
+
+  // small camera turns, which swap a few paths per frame
+  for (int frame = 1; frame <= 20; frame++) {
+    camera->orientation =
+      SbRotation(SbVec3f(0.0f, 1.0f, 0.0f), 0.01f * float(frame));
+    BOOST_CHECK_MESSAGE(glrender_test_same_order(&action, root),
+                        "order differs after turn " << frame);
+  }
+
+  // a large turn, with too many swaps to repair
+  camera->orientation = SbRotation(SbVec3f(0.0f, 1.0f, 0.0f), -0.5f);
+  BOOST_CHECK_MESSAGE(glrender_test_same_order(&action, root),
+                      "order differs after large turn");
+
+  root->addChild(glrender_test_object(numobjects, SbVec3f(0.0f, 0.0f, -2.0f)));
+  BOOST_CHECK_MESSAGE(glrender_test_same_order(&action, root),
+                      "order differs after adding a path");
+
+  root->removeChild(5);
+  BOOST_CHECK_MESSAGE(glrender_test_same_order(&action, root),
+                      "order differs after removing a path");
+
+  // move an object and edit its shape
+  SoSeparator * edited = static_cast<SoSeparator *>(root->getChild(8));
+  static_cast<SoTranslation *>(edited->getChild(0))->translation.setValue(0.0f, 0.0f, -10.0f);
+  static_cast<SoCube *>(edited->getChild(2))->width = 4.0f;
+  BOOST_CHECK_MESSAGE(glrender_test_same_order(&action, root),
+                      "order differs after editing a shape");
+
+  camera->orientation = SbRotation(SbVec3f(0.0f, 1.0f, 0.0f), -0.49f);
+  BOOST_CHECK_MESSAGE(glrender_test_same_order(&action, root),
+                      "order differs after turn following the edit");
+
+  root->unref();
+  cc_glglue_context_reinstate_previous(ctx);
+  cc_glglue_context_destruct(ctx);
+}
+
+#endif // COIN_TEST_SUITE
@@ -81,6 +81,10 @@
 
 #include <Inventor/actions/SoGetBoundingBoxAction.h>
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
 #include <Inventor/elements/SoBBoxModelMatrixElement.h>
 #include <Inventor/elements/SoLocalBBoxMatrixElement.h>
 #include <Inventor/elements/SoViewingMatrixElement.h>
@@ -93,6 +97,19 @@
 #include <Inventor/errors/SoDebugError.h>
 #endif // COIN_DEBUG
 
+#ifdef COIN_THREADSAFE
+#include <Inventor/C/threads/wpool.h>
+#include <Inventor/SoPath.h>
+#include <Inventor/fields/SoSFNode.h>
+#include <Inventor/misc/SoChildList.h>
+#include <Inventor/nodes/SoFile.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/threads/SbMutex.h>
+#include <Inventor/VRMLnodes/SoVRMLInline.h>
+#include "misc/SbHash.h"
+#include "nodes/SoSceneCacheSeparator.h"
+#endif // COIN_THREADSAFE
+
 #include "actions/SoSubActionP.h"
 #include "SbBasicP.h"
 
@@ -220,8 +237,30 @@
 
 class SoGetBoundingBoxActionP {
 public:
+  SoGetBoundingBoxActionP(void)
+  {
+    this->numthreads = 1;
+#ifdef COIN_THREADSAFE
+    this->pool = NULL;
+#endif // COIN_THREADSAFE
+  }
+  ~SoGetBoundingBoxActionP()
+  {
+#ifdef COIN_THREADSAFE
+    if (this->pool) cc_wpool_destruct(this->pool);
+#endif // COIN_THREADSAFE
+  }
+
+  int numthreads;
+
+#ifdef COIN_THREADSAFE
+  cc_wpool * pool;
+  void prefillCaches(const SbViewportRegion & vp, SoNode * root);
+#endif // COIN_THREADSAFE
 };
 
+#define PRIVATE(obj) ((obj)->pimpl)
+
 SO_ACTION_SOURCE(SoGetBoundingBoxAction);
 
 
@@ -590,6 +629,60 @@ SoGetBoundingBoxAction::resetCenter(void)
   this->center.setValue(0.0f, 0.0f, 0.0f);
 }
 
+/*!
+  Sets the number of threads to use for calculating bounding boxes.
+
+  With more than one thread, the action will, before the normal
+  traversal, calculate the bounding boxes of independent SoSeparator
+  subgraphs in a pool of worker threads, each with its own
+  SoGetBoundingBoxAction instance. This fills in the bounding box
+  caches of these SoSeparator nodes, so the following traversal can
+  use the cached results. This will only speed things up for wide
+  scene graphs with invalid bounding box caches, like freshly loaded
+  scenes.
+
+  Subgraphs which are shared with other subgraphs, or which contain
+  field connections, are left for the normal traversal, as Coin
+  nodes can not safely be traversed from several threads at once in
+  these cases.
+
+  The resulting bounding box is the same as when only one thread is
+  used. Multiple threads are only used when the action is applied to
+  a node, not in camera space, and without a reset path.
+
+  This setting is ignored unless Coin was built with thread safe
+  traversals enabled (COIN_THREADSAFE).
+
+  Default is 1.
+
+  \sa getNumThreads()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoGetBoundingBoxAction::setNumThreads(const int numthreads)
+{
+  assert(numthreads >= 1);
+  PRIVATE(this)->numthreads = numthreads;
+}
+
+/*!
+  Returns the number of threads used for calculating bounding boxes.
+
+  \sa setNumThreads()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+int
+SoGetBoundingBoxAction::getNumThreads(void) const
+{
+  return PRIVATE(this)->numthreads;
+}
+
 // Documented in superclass. Overridden to reset center point and
 // bounding box before traversal starts.
 void
@@ -598,6 +691,286 @@ SoGetBoundingBoxAction::beginTraversal(SoNode * node)
   this->resetCenter();
   this->bbox.makeEmpty();
 
+#ifdef COIN_THREADSAFE
+  if (PRIVATE(this)->numthreads > 1 &&
+      this->getWhatAppliedTo() == SoAction::NODE &&
+      !this->isInCameraSpace() && !this->isResetPath()) {
+    PRIVATE(this)->prefillCaches(this->vpregion, node);
+  }
+#endif // COIN_THREADSAFE
+
   SoViewportRegionElement::set(this->getState(), this->vpregion);
   inherited::beginTraversal(node);
 }
+
+// *************************************************************************
+
+#ifdef COIN_THREADSAFE
+
+// Finds SoSeparator nodes below the tail of path, looking through
+// plain SoGroup nodes. A path is appended to candidates for each
+// separator found.
+static void
+sogetbbox_find_separators(SoPath * path, SbList<SoPath *> & candidates)
+{
+  const SoChildList * children = path->getTail()->getChildren();
+  if (children == NULL) return;
+  for (int i = 0; i < children->getLength(); i++) {
+    SoNode * child = (*children)[i];
+    if (child->isOfType(SoSeparator::getClassTypeId())) {
+      SoPath * childpath = path->copy();
+      childpath->ref();
+      childpath->append(i);
+      candidates.append(childpath);
+    }
+    else if (child->getTypeId() == SoGroup::getClassTypeId()) {
+      path->append(i);
+      sogetbbox_find_separators(path, candidates);
+      path->pop();
+    }
+  }
+}
+
+// Marks all nodes in the subgraph with the owner index, and marks
+// subgraphs which share nodes with other subgraphs, or which have
+// field connections, as unusable.
+static void
+sogetbbox_claim_nodes(SoNode * node, const int owner,
+                      SbHash<const SoBase *, int> & owners,
+                      SbList<SbBool> & usable)
+{
+  int prevowner;
+  if (owners.get(node, prevowner)) {
+    if (prevowner != owner) {
+      usable[prevowner] = FALSE;
+      usable[owner] = FALSE;
+    }
+    return;
+  }
+  owners.put(node, owner);
+
+  const SoFieldData * fielddata = node->getFieldData();
+  const int numfields = fielddata ? fielddata->getNumFields() : 0;
+  for (int i = 0; i < numfields; i++) {
+    SoField * field = fielddata->getField(node, i);
+    if (field->isConnected()) { usable[owner] = FALSE; }
+    if (field->isOfType(SoSFNode::getClassTypeId())) {
+      SoNode * value = static_cast<SoSFNode *>(field)->getValue();
+      if (value) { sogetbbox_claim_nodes(value, owner, owners, usable); }
+    }
+  }
+
+  // a scene cache separator which hasn't read its children uses the
+  // bounding box stored in the file, so it is a leaf here, and isn't
+  // made to read them by getChildren()
+  if (node->isOfType(SoSceneCacheSeparator::getClassTypeId()) &&
+      static_cast<SoSceneCacheSeparator *>(node)->isPending()) return;
+
+  const SoChildList * children = node->getChildren();
+  if (children) {
+    // SoFile and SoVRMLInline nodes without children may still have
+    // a file to read, which is only done on the main thread
+    if (children->getLength() == 0 &&
+        (node->isOfType(SoFile::getClassTypeId()) ||
+         node->isOfType(SoVRMLInline::getClassTypeId()))) {
+      usable[owner] = FALSE;
+    }
+    for (int i = 0; i < children->getLength(); i++) {
+      sogetbbox_claim_nodes((*children)[i], owner, owners, usable);
+    }
+  }
+}
+
+typedef struct {
+  const SbList<SoPath *> * paths;
+  int nextpath;
+  SbMutex mutex;
+} sogetbbox_prefill_data;
+
+typedef struct {
+  sogetbbox_prefill_data * data;
+  SoGetBoundingBoxAction * action;
+} sogetbbox_prefill_worker_data;
+
+static void
+sogetbbox_prefill_worker(void * closure)
+{
+  sogetbbox_prefill_worker_data * worker =
+    static_cast<sogetbbox_prefill_worker_data *>(closure);
+  sogetbbox_prefill_data * data = worker->data;
+  for (;;) {
+    data->mutex.lock();
+    const int idx = data->nextpath++;
+    data->mutex.unlock();
+    if (idx >= data->paths->getLength()) break;
+    worker->action->apply((*data->paths)[idx]);
+  }
+}
+
+// Applies bounding box actions to independent SoSeparator subgraphs
+// below root in the worker threads, to fill in their bounding box
+// caches. The actions are applied to the full paths from root, so
+// the state at each separator is the same as in the normal traversal.
+void
+SoGetBoundingBoxActionP::prefillCaches(const SbViewportRegion & vp, SoNode * root)
+{
+  if (root->getTypeId() != SoGroup::getClassTypeId() &&
+      root->getTypeId() != SoSeparator::getClassTypeId()) return;
+
+  int i;
+  SoPath * rootpath = new SoPath(root);
+  rootpath->ref();
+  SbList<SoPath *> candidates;
+  sogetbbox_find_separators(rootpath, candidates);
+  rootpath->unref();
+
+  // Split the separators further until there are enough subgraphs
+  // to keep all the threads busy. The bounding boxes of the
+  // separators split up will be calculated by the normal traversal,
+  // from the caches of their children.
+  const int wanted = this->numthreads * 4;
+  for (int level = 0; level < 8 && candidates.getLength() < wanted; level++) {
+    SbList<SoPath *> split;
+    SbBool didsplit = FALSE;
+    for (i = 0; i < candidates.getLength(); i++) {
+      SoPath * path = candidates[i];
+      const int oldlen = split.getLength();
+      if (path->getTail()->getTypeId() == SoSeparator::getClassTypeId()) {
+        sogetbbox_find_separators(path, split);
+      }
+      if (split.getLength() > oldlen) {
+        path->unref();
+        didsplit = TRUE;
+      }
+      else {
+        split.append(path);
+      }
+    }
+    candidates = split;
+    if (!didsplit) break;
+  }
+
+  SbList<SbBool> usable(candidates.getLength());
+  for (i = 0; i < candidates.getLength(); i++) { usable.append(TRUE); }
+  SbHash<const SoBase *, int> owners(1024);
+  for (i = 0; i < candidates.getLength(); i++) {
+    sogetbbox_claim_nodes(candidates[i]->getTail(), i, owners, usable);
+  }
+
+  SbList<SoPath *> paths;
+  for (i = 0; i < candidates.getLength(); i++) {
+    if (usable[i]) { paths.append(candidates[i]); }
+  }
+
+  if (paths.getLength() > 1) {
+    const int numworkers = SbMin(this->numthreads, paths.getLength());
+    if (this->pool == NULL) {
+      this->pool = cc_wpool_construct(numworkers);
+    }
+    else if (cc_wpool_get_num_workers(this->pool) < numworkers) {
+      cc_wpool_set_num_workers(this->pool, numworkers);
+    }
+
+    sogetbbox_prefill_data data;
+    data.paths = &paths;
+    data.nextpath = 0;
+
+    sogetbbox_prefill_worker_data * workers =
+      new sogetbbox_prefill_worker_data[numworkers];
+    for (i = 0; i < numworkers; i++) {
+      workers[i].data = &data;
+      workers[i].action = new SoGetBoundingBoxAction(vp);
+    }
+
+    cc_wpool_begin(this->pool, numworkers);
+    for (i = 0; i < numworkers; i++) {
+      cc_wpool_start_worker(this->pool, sogetbbox_prefill_worker, &workers[i]);
+    }
+    cc_wpool_end(this->pool);
+    cc_wpool_wait_all(this->pool);
+
+    for (i = 0; i < numworkers; i++) { delete workers[i].action; }
+    delete[] workers;
+  }
+
+  for (i = 0; i < candidates.getLength(); i++) { candidates[i]->unref(); }
+}
+
+#endif // COIN_THREADSAFE
+
+#undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+BOOST_AUTO_TEST_CASE(numthreads)
+{
+  SoGetBoundingBoxAction action(SbViewportRegion(100, 100));
+  BOOST_CHECK_MESSAGE(action.getNumThreads() == 1,
+                      "Expected one thread by default");
+  action.setNumThreads(4);
+  BOOST_CHECK_MESSAGE(action.getNumThreads() == 4,
+                      "Expected the number of threads to be set");
+}
+
+// The subgraphs are only traversed from several threads in thread
+// safe builds, so the test would compare two serial traversals in
+// other builds.
+#ifdef COIN_THREADSAFE
+
+static SoSeparator *
+sogetbbox_test_scene(void)
+{
+  SoSeparator * root = new SoSeparator;
+  SoCube * shared = new SoCube;
+  SoGroup * group = new SoGroup;
+  root->addChild(group);
+  for (int i = 0; i < 16; i++) {
+    SoTranslation * translation = new SoTranslation;
+    translation->translation.setValue(float(i), float(i % 3), 0.0f);
+    group->addChild(translation);
+    SoSeparator * sep = new SoSeparator;
+    SoTranslation * offset = new SoTranslation;
+    offset->translation.setValue(0.0f, 0.0f, float(i));
+    sep->addChild(offset);
+    sep->addChild(new SoSphere);
+    SoSeparator * inner = new SoSeparator;
+    inner->addChild(i % 4 ? static_cast<SoNode *>(new SoCube) : shared);
+    sep->addChild(inner);
+    group->addChild(sep);
+  }
+  return root;
+}
+
+BOOST_AUTO_TEST_CASE(multithreaded)
+{
+  SoSeparator * reference = sogetbbox_test_scene();
+  reference->ref();
+  SoSeparator * root = sogetbbox_test_scene();
+  root->ref();
+
+  SoGetBoundingBoxAction action(SbViewportRegion(100, 100));
+  action.apply(reference);
+  const SbBox3f expected = action.getBoundingBox();
+
+  action.setNumThreads(4);
+  // first pass fills the caches, second pass uses them
+  for (int pass = 0; pass < 2; pass++) {
+    action.apply(root);
+    const SbBox3f box = action.getBoundingBox();
+    BOOST_CHECK_MESSAGE(box.getMin().equals(expected.getMin(), 1e-5f) &&
+                        box.getMax().equals(expected.getMax(), 1e-5f),
+                        "Multiple threads gave a different bounding box");
+  }
+
+  root->unref();
+  reference->unref();
+}
+
+#endif // COIN_THREADSAFE
+
+#endif // COIN_TEST_SUITE
@@ -30,20 +30,119 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 \**************************************************************************/
 
-// FIXME: this class has not yet been implemented in Coin. this is a
-// placeholder / stub / skeleton code, not yet built (nor installed,
-// obviously).  --mortene.
-
 /*!
   \class SoGlobalSimplifyAction SoGlobalSimplifyAction.h Inventor/actions/SoGlobalSimplifyAction.h
   \brief The SoGlobalSimplifyAction class is for globally simplifying the
   geometry of a scene graph, globally.
+
+  All the triangles of the shapes in the scene graph are transformed
+  to world coordinates and merged into one mesh, which is simplified
+  as a whole. This can remove many more triangles than simplifying
+  each shape on its own, as with SoShapeSimplifyAction, since small
+  shapes can be collapsed into their neighbours.
+
+  The scene graph the action is applied to is not changed. The
+  simplified scene graph is returned from getSimplifiedSceneGraph(),
+  as an SoSeparator with an SoIndexedFaceSet, or an SoLevelOfDetail
+  node with one SoIndexedFaceSet for each simplification level. The
+  normals and the diffuse colors of the shapes are kept per vertex in
+  an SoVertexProperty node.
+
+  Shapes with different decimation settings (see SoSimplifyAction)
+  are merged and simplified separately, and put in the returned
+  SoSeparator one after the other.
+
+  Only triangles are kept, so lines, points and textures are not a
+  part of the simplified scene graph.
+
+  \sa SoShapeSimplifyAction
+  \since Coin 4.0
 */
 
-#include <Inventor/SbName.h>
 #include <Inventor/actions/SoGlobalSimplifyAction.h>
-#include <coindefs.h> // COIN_STUB()
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <cassert>
+
+#include <Inventor/SbMatrix.h>
+#include <Inventor/SbName.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/SoPrimitiveVertex.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/caches/SoPrimitiveVertexCache.h>
+#include <Inventor/elements/SoModelMatrixElement.h>
+#include <Inventor/elements/SoShapeStyleElement.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoShape.h>
+
+#include "coindefs.h" // COIN_UNUSED_ARG()
+#include "actions/SoSubActionP.h"
+#include "actions/SoSimplifyActionP.h"
+#include "base/SbQuadricSimplifier.h"
+
+class SoGlobalSimplifyActionP {
+public:
+  SoGlobalSimplifyActionP(void)
+    : master(NULL),
+      cbaction(SbViewportRegion(640, 480)),
+      pvcache(NULL),
+      result(NULL)
+  {
+    this->cbaction.addTriangleCallback(SoShape::getClassTypeId(), triangle_cb, this);
+    this->cbaction.addPreCallback(SoShape::getClassTypeId(), pre_shape_cb, this);
+    this->cbaction.addPostCallback(SoShape::getClassTypeId(), post_shape_cb, this);
+    this->format.normals = TRUE;
+    this->format.colors = TRUE;
+  }
+  ~SoGlobalSimplifyActionP()
+  {
+    this->clear();
+  }
+
+  // the merged triangles of the shapes with the same simplification
+  // levels
+  class Mesh {
+  public:
+    SbList<float> levels;
+    SbList<SbVec3f> coords;
+    SbList<float> attributes;
+    SbList<int32_t> indices;
+  };
+
+  SoGlobalSimplifyAction * master;
+  SoCallbackAction cbaction;
+  SoPrimitiveVertexCache * pvcache;
+  SoSeparator * result;
+  SbBool didinit;
+  SbBool flip;
+  SbMatrix matrix;
+  SbMatrix normalmatrix;
+  SbList<float> levels;
+  SbList<Mesh *> meshes;
+  SoSimplifyActionP::MeshFormat format;
+  SbQuadricSimplifier simplifier;
+
+  static SoCallbackAction::Response pre_shape_cb(void * userdata,
+                                                 SoCallbackAction * action,
+                                                 const SoNode * node);
+  static SoCallbackAction::Response post_shape_cb(void * userdata,
+                                                  SoCallbackAction * action,
+                                                  const SoNode * node);
+  static void triangle_cb(void * userdata, SoCallbackAction * action,
+                          const SoPrimitiveVertex * v1,
+                          const SoPrimitiveVertex * v2,
+                          const SoPrimitiveVertex * v3);
+
+  void initShape(SoCallbackAction * action);
+  void addShape(void);
+  void createResult(void);
+  void clear(void);
+};
+
+#define PRIVATE(obj) ((obj)->pimpl)
 
 SO_ACTION_SOURCE(SoGlobalSimplifyAction);
 
@@ -63,7 +162,8 @@ SoGlobalSimplifyAction::initClass(void)
 
 SoGlobalSimplifyAction::SoGlobalSimplifyAction(void)
 {
-  COIN_STUB();
+  PRIVATE(this)->master = this;
+  SO_ACTION_CONSTRUCTOR(SoGlobalSimplifyAction);
 }
 
 /*!
@@ -72,12 +172,247 @@ SoGlobalSimplifyAction::SoGlobalSimplifyAction(void)
 
 SoGlobalSimplifyAction::~SoGlobalSimplifyAction(void)
 {
-  COIN_STUB();
+}
+
+/*!
+  Returns the simplified scene graph made by the last apply(), or \c
+  NULL if the action hasn't been applied. The scene graph is owned by
+  the action, so ref it to keep it after the next apply() or after
+  the action is destructed.
+*/
+SoSeparator *
+SoGlobalSimplifyAction::getSimplifiedSceneGraph(void) const
+{
+  return PRIVATE(this)->result;
+}
+
+/*!
+  Simplifies the scene graph below \a root.
+*/
+void
+SoGlobalSimplifyAction::apply(SoNode * root)
+{
+  PRIVATE(this)->clear();
+  PRIVATE(this)->cbaction.apply(root);
+  PRIVATE(this)->createResult();
+}
+
+/*!
+  Simplifies the scene graph in \a path.
+*/
+void
+SoGlobalSimplifyAction::apply(SoPath * path)
+{
+  PRIVATE(this)->clear();
+  PRIVATE(this)->cbaction.apply(path);
+  PRIVATE(this)->createResult();
+}
+
+/*!
+  Simplifies the scene graph in the paths of \a pathlist, merged into
+  one simplified scene graph.
+*/
+void
+SoGlobalSimplifyAction::apply(const SoPathList & pathlist, SbBool obeysrules)
+{
+  PRIVATE(this)->clear();
+  PRIVATE(this)->cbaction.apply(pathlist, obeysrules);
+  PRIVATE(this)->createResult();
 }
 
 // Documented in superclass.
 void
 SoGlobalSimplifyAction::beginTraversal(SoNode * /* node */)
 {
-  COIN_STUB();
+  assert(0 && "should never get here");
+}
+
+SoCallbackAction::Response
+SoGlobalSimplifyActionP::pre_shape_cb(void * userdata, SoCallbackAction * COIN_UNUSED_ARG(action),
+                                      const SoNode * COIN_UNUSED_ARG(node))
+{
+  SoGlobalSimplifyActionP * thisp = static_cast<SoGlobalSimplifyActionP *>(userdata);
+  thisp->didinit = FALSE;
+  return SoCallbackAction::CONTINUE;
+}
+
+SoCallbackAction::Response
+SoGlobalSimplifyActionP::post_shape_cb(void * userdata, SoCallbackAction * COIN_UNUSED_ARG(action),
+                                       const SoNode * COIN_UNUSED_ARG(node))
+{
+  SoGlobalSimplifyActionP * thisp = static_cast<SoGlobalSimplifyActionP *>(userdata);
+  if (thisp->pvcache) {
+    thisp->addShape();
+    thisp->pvcache->unref();
+    thisp->pvcache = NULL;
+  }
+  return SoCallbackAction::CONTINUE;
+}
+
+void
+SoGlobalSimplifyActionP::triangle_cb(void * userdata, SoCallbackAction * action,
+                                     const SoPrimitiveVertex * v1,
+                                     const SoPrimitiveVertex * v2,
+                                     const SoPrimitiveVertex * v3)
+{
+  SoGlobalSimplifyActionP * thisp = static_cast<SoGlobalSimplifyActionP *>(userdata);
+  if (!thisp->didinit) thisp->initShape(action);
+  if (thisp->pvcache == NULL) return;
+
+  // mirroring transforms turn the triangles inside out
+  SoPrimitiveVertex v[3];
+  v[0] = *v1;
+  v[1] = thisp->flip ? *v3 : *v2;
+  v[2] = thisp->flip ? *v2 : *v3;
+  for (int i = 0; i < 3; i++) {
+    SbVec3f tmp;
+    thisp->matrix.multVecMatrix(v[i].getPoint(), tmp);
+    v[i].setPoint(tmp);
+    thisp->normalmatrix.multDirMatrix(v[i].getNormal(), tmp);
+    (void) tmp.normalize();
+    v[i].setNormal(tmp);
+  }
+  thisp->pvcache->addTriangle(&v[0], &v[1], &v[2]);
+}
+
+void
+SoGlobalSimplifyActionP::initShape(SoCallbackAction * action)
+{
+  this->didinit = TRUE;
+  SoState * state = action->getState();
+  if (SoShapeStyleElement::get(state)->getFlags() & SoShapeStyleElement::INVISIBLE) {
+    return;
+  }
+  this->matrix = SoModelMatrixElement::get(state);
+  this->normalmatrix = this->matrix.inverse().transpose();
+  this->flip = this->matrix.det3() < 0.0f;
+  SoSimplifyActionP::getLevels(this->master, state, this->levels);
+
+  assert(this->pvcache == NULL);
+  this->pvcache = new SoPrimitiveVertexCache(state);
+  this->pvcache->ref();
+}
+
+// adds the triangles of the current shape to the mesh with the same
+// simplification levels
+void
+SoGlobalSimplifyActionP::addShape(void)
+{
+  this->pvcache->fit();
+  const int numindices = this->pvcache->getNumTriangleIndices();
+  if (numindices == 0) return;
+
+  Mesh * mesh = NULL;
+  for (int i = 0; i < this->meshes.getLength() && !mesh; i++) {
+    if (this->meshes[i]->levels == this->levels) mesh = this->meshes[i];
+  }
+  if (mesh == NULL) {
+    mesh = new Mesh;
+    mesh->levels = this->levels;
+    this->meshes.append(mesh);
+  }
+
+  const int offset = mesh->coords.getLength();
+  const int numvertices = this->pvcache->getNumVertices();
+  const SbVec3f * coords = this->pvcache->getVertexArray();
+  const SbVec3f * normals = this->pvcache->getNormalArray();
+  const uint8_t * colors = this->pvcache->getColorArray();
+  for (int i = 0; i < numvertices; i++) {
+    mesh->coords.append(coords[i]);
+    for (int j = 0; j < 3; j++) mesh->attributes.append(normals[i][j]);
+    for (int j = 0; j < 4; j++) mesh->attributes.append(float(colors[i*4+j]));
+  }
+  const GLint * indices = this->pvcache->getTriangleIndices();
+  for (int i = 0; i < numindices; i++) {
+    mesh->indices.append(static_cast<int32_t>(indices[i]) + offset);
+  }
 }
+
+void
+SoGlobalSimplifyActionP::createResult(void)
+{
+  this->result = new SoSeparator;
+  this->result->ref();
+
+  SbList<float> fulllevel;
+  fulllevel.append(1.0f);
+  for (int i = 0; i < this->meshes.getLength(); i++) {
+    Mesh * mesh = this->meshes[i];
+    const int numtriangles = mesh->indices.getLength() / 3;
+    this->simplifier.setMesh(mesh->coords.getArrayPtr(), mesh->attributes.getArrayPtr(),
+                             mesh->coords.getLength(), this->format.getNumAttributes(),
+                             mesh->indices.getArrayPtr(), numtriangles);
+    const SbList<float> & levels =
+      numtriangles >= this->master->getMinTriangles() ? mesh->levels : fulllevel;
+    this->result->addChild(SoSimplifyActionP::createMesh(this->master, this->simplifier,
+                                                         levels, this->format));
+    this->simplifier.clear();
+    delete mesh;
+    this->meshes[i] = NULL;
+  }
+  this->meshes.truncate(0);
+}
+
+void
+SoGlobalSimplifyActionP::clear(void)
+{
+  if (this->result) {
+    this->result->unref();
+    this->result = NULL;
+  }
+  for (int i = 0; i < this->meshes.getLength(); i++) delete this->meshes[i];
+  this->meshes.truncate(0);
+}
+
+#undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoLevelOfDetail.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/nodes/SoTranslation.h>
+#include <Inventor/nodes/SoVertexProperty.h>
+
+BOOST_AUTO_TEST_CASE(merge)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  root->addChild(new SoSphere);
+  root->addChild(new SoTranslation);
+  static_cast<SoTranslation *>(root->getChild(1))->translation.setValue(4.0f, 0.0f, 0.0f);
+  root->addChild(new SoSphere);
+
+  SoGlobalSimplifyAction gsa;
+  const float levels[] = { 1.0f, 0.2f };
+  gsa.setSimplificationLevels(2, levels);
+  gsa.apply(root);
+
+  SoSeparator * result = gsa.getSimplifiedSceneGraph();
+  BOOST_REQUIRE(result != NULL);
+  BOOST_REQUIRE(result->getNumChildren() == 1);
+  BOOST_REQUIRE(result->getChild(0)->isOfType(SoLevelOfDetail::getClassTypeId()));
+  SoLevelOfDetail * lod = static_cast<SoLevelOfDetail *>(result->getChild(0));
+  BOOST_REQUIRE(lod->getNumChildren() == 2);
+
+  SoVertexProperty * vp[2];
+  for (int i = 0; i < 2; i++) {
+    BOOST_REQUIRE(lod->getChild(i)->isOfType(SoIndexedFaceSet::getClassTypeId()));
+    SoIndexedFaceSet * ifs = static_cast<SoIndexedFaceSet *>(lod->getChild(i));
+    vp[i] = static_cast<SoVertexProperty *>(ifs->vertexProperty.getValue());
+    BOOST_REQUIRE(vp[i] != NULL);
+  }
+  BOOST_CHECK_MESSAGE(vp[1]->vertex.getNum() < vp[0]->vertex.getNum(),
+                      "Lower level should have fewer vertices");
+
+  // both spheres should be in the merged shape, in world space
+  float maxx = 0.0f;
+  for (int i = 0; i < vp[0]->vertex.getNum(); i++) {
+    if (vp[0]->vertex[i][0] > maxx) maxx = vp[0]->vertex[i][0];
+  }
+  BOOST_CHECK_MESSAGE(maxx > 4.5f, "Translated sphere missing from result");
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
@@ -130,7 +130,9 @@
 #include <Inventor/actions/SoRayPickAction.h>
 
 #include <cfloat>
+#include <cstdlib>
 
+#include <Inventor/C/tidbits.h>
 #include <Inventor/SbLine.h>
 #include <Inventor/SoPickedPoint.h>
 #include <Inventor/elements/SoClipPlaneElement.h>
@@ -224,14 +226,32 @@ public:
     PPLIST_IS_SORTED =   0x0080, // did we sort pickedpointslist ?
     OSVOLUME_DIRTY =     0x0100, // did we calculate osvolume?
     PUSH_PICK_TO_FRONT = 0x0200, // should pick go in front?
-    CULL_BACKFACES =     0x0400  // should backface picks be ignored?
+    CULL_BACKFACES =     0x0400, // should backface picks be ignored?
+    BVH_CACHING =        0x0800  // should shapes build ray pick caches?
   };
 
+  static SbBool defaultBVHCaching(void);
+
   SoRayPickAction * owner;
 };
 
 #define PRIVATE(obj) ((obj)->pimpl)
 
+// The default for setBVHCaching() can be set with an environment
+// variable, so that picks done internally in other actions and in
+// the GUI toolkits (which construct their own SoRayPickAction
+// instances) can also use the caches.
+SbBool
+SoRayPickActionP::defaultBVHCaching(void)
+{
+  static int bvhcaching = -1;
+  if (bvhcaching == -1) {
+    const char * env = coin_getenv("COIN_RAYPICK_BVH_CACHING");
+    bvhcaching = (env && atoi(env) > 0) ? 1 : 0;
+  }
+  return bvhcaching ? TRUE : FALSE;
+}
+
 // *************************************************************************
 
 SO_ACTION_SOURCE(SoRayPickAction);
@@ -267,6 +287,9 @@ SoRayPickAction::SoRayPickAction(const SbViewportRegion & viewportregion)
   PRIVATE(this)->radiusinpixels = 5.0f;
   PRIVATE(this)->flags = 0;
   PRIVATE(this)->objectspacevalid = TRUE;
+  if (SoRayPickActionP::defaultBVHCaching()) {
+    PRIVATE(this)->setFlag(SoRayPickActionP::BVH_CACHING);
+  }
 
   SO_ACTION_CONSTRUCTOR(SoRayPickAction);
 }
@@ -427,6 +450,49 @@ SoRayPickAction::isPickAll(void) const
   return PRIVATE(this)->isFlagSet(SoRayPickActionP::PICK_ALL);
 }
 
+/*!
+  Sets whether shapes should cache their primitives for picking.
+
+  When enabled, shapes which use SoShape::generatePrimitives() for
+  picking will store the generated triangles, line segments and
+  points, together with their details, in a cache. The triangles are
+  organized in a bounding volume hierarchy, so that later picks only
+  need to test the triangles close to the pick ray. The cache is
+  invalidated when the shape, or any state the shape depends on,
+  changes, just like the bounding box cache of the shape.
+
+  This makes repeated picking on large, static shapes (e.g. for mouse
+  hover highlighting) several orders of magnitude faster, at the cost
+  of memory for the cached primitives. Since shapes are picked through
+  the same code path, the picked points are the same with and without
+  caching.
+
+  The default value is \c FALSE, unless the environment variable
+  COIN_RAYPICK_BVH_CACHING is set to a positive value.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoRayPickAction::setBVHCaching(const SbBool onoff)
+{
+  if (onoff) PRIVATE(this)->setFlag(SoRayPickActionP::BVH_CACHING);
+  else PRIVATE(this)->clearFlag(SoRayPickActionP::BVH_CACHING);
+}
+
+/*!
+  Returns whether shapes will cache their primitives for picking.
+
+  \sa setBVHCaching()
+  \since Coin 4.0
+*/
+SbBool
+SoRayPickAction::isBVHCaching(void) const
+{
+  return PRIVATE(this)->isFlagSet(SoRayPickActionP::BVH_CACHING);
+}
+
 /*!
   Returns a list of the picked points.
 */
@@ -1179,3 +1245,197 @@ SoRayPickActionP::setPickStyleFlags(SoState * state)
 }
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SoPickedPoint.h>
+#include <Inventor/details/SoFaceDetail.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoSubNode.h>
+
+// A face set which overrides createTriangleDetail() the way an
+// application might, reading the picked point and editing the detail
+// made by the superclass.
+class RayPickDetailFaceSet : public SoIndexedFaceSet {
+  typedef SoIndexedFaceSet inherited;
+  SO_NODE_HEADER(RayPickDetailFaceSet);
+public:
+  static void initClass(void) {
+    SO_NODE_INIT_CLASS(RayPickDetailFaceSet, SoIndexedFaceSet, "IndexedFaceSet");
+  }
+  RayPickDetailFaceSet(void) {
+    SO_NODE_CONSTRUCTOR(RayPickDetailFaceSet);
+    this->numnullpp = 0;
+  }
+  int numnullpp;
+
+protected:
+  virtual ~RayPickDetailFaceSet() { }
+  virtual SoDetail * createTriangleDetail(SoRayPickAction * action,
+                                          const SoPrimitiveVertex * v1,
+                                          const SoPrimitiveVertex * v2,
+                                          const SoPrimitiveVertex * v3,
+                                          SoPickedPoint * pp) {
+    if (pp == NULL) {
+      this->numnullpp++;
+      return NULL;
+    }
+    SoDetail * detail = inherited::createTriangleDetail(action, v1, v2, v3, pp);
+    if (detail && detail->isOfType(SoFaceDetail::getClassTypeId())) {
+      static_cast<SoFaceDetail *>(detail)->setPartIndex(pp->getPoint()[0] > 0.0f ? 7 : 8);
+    }
+    return detail;
+  }
+};
+
+SO_NODE_SOURCE(RayPickDetailFaceSet);
+
+BOOST_AUTO_TEST_CASE(bvhcaching)
+{
+  // two quads of two triangles each, one behind the other, so that
+  // the picks are done on the triangles in the cache
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  const float xyz[][3] = {
+    { -1.0f, -1.0f, 0.0f }, { 1.0f, -1.0f, 0.0f },
+    { 1.0f, 1.0f, 0.0f }, { -1.0f, 1.0f, 0.0f },
+    { -1.0f, -1.0f, -3.0f }, { 1.0f, -1.0f, -3.0f },
+    { 1.0f, 1.0f, -3.0f }, { -1.0f, 1.0f, -3.0f }
+  };
+  coords->point.setValues(0, 8, xyz);
+  root->addChild(coords);
+  SoIndexedFaceSet * faceset = new SoIndexedFaceSet;
+  const int32_t indices[] = {
+    0, 1, 2, -1, 0, 2, 3, -1, 4, 5, 6, -1, 4, 6, 7, -1
+  };
+  faceset->coordIndex.setValues(0, 16, indices);
+  root->addChild(faceset);
+
+  SoRayPickAction ra(SbViewportRegion(100, 100));
+  ra.setRay(SbVec3f(0.3f, 0.4f, 10.0f), SbVec3f(0.0f, 0.0f, -1.0f));
+  ra.setPickAll(TRUE);
+
+  ra.setBVHCaching(FALSE);
+  ra.apply(root);
+  SoPickedPointList reference(ra.getPickedPointList());
+  BOOST_CHECK_MESSAGE(reference.getLength() == 2,
+                      "Expected the ray to hit both quads");
+
+  ra.setBVHCaching(TRUE);
+  BOOST_CHECK_MESSAGE(ra.isBVHCaching(), "BVH caching should be enabled");
+  // first pass builds the cache, second pass picks on the cache
+  for (int pass = 0; pass < 2; pass++) {
+    ra.apply(root);
+    const SoPickedPointList & pplist = ra.getPickedPointList();
+    BOOST_CHECK_MESSAGE(pplist.getLength() == reference.getLength(),
+                        "BVH caching gave a different number of picked points");
+    for (int i = 0; i < pplist.getLength() && i < reference.getLength(); i++) {
+      BOOST_CHECK_MESSAGE(pplist[i]->getPoint().equals(reference[i]->getPoint(), 1e-5f),
+                          "BVH caching gave a different picked point");
+      BOOST_CHECK_MESSAGE(pplist[i]->getNormal().equals(reference[i]->getNormal(), 1e-5f),
+                          "BVH caching gave a different picked normal");
+    }
+  }
+
+  // the cache must be invalidated when the coordinates change, so
+  // moving the back quad away from the ray leaves one hit
+  for (int i = 4; i < 8; i++) {
+    coords->point.set1Value(i, xyz[i][0] + 10.0f, xyz[i][1], xyz[i][2]);
+  }
+  ra.apply(root);
+  BOOST_CHECK_MESSAGE(ra.getPickedPointList().getLength() == 1,
+                      "Expected the ray to hit only the front quad");
+  // and moving it into place again gives two hits
+  coords->point.setValues(0, 8, xyz);
+  ra.apply(root);
+  BOOST_CHECK_MESSAGE(ra.getPickedPointList().getLength() == 2,
+                      "Expected the ray to hit both quads again");
+
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(bvhcachingdetails)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  const float xyz[][3] = {
+    { -1.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+    { -1.0f, 1.0f, 0.0f }, { 1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 0.0f }
+  };
+  coords->point.setValues(0, 6, xyz);
+  root->addChild(coords);
+  SoIndexedFaceSet * faceset = new SoIndexedFaceSet;
+  const int32_t indices[] = { 0, 1, 2, 3, -1, 1, 4, 5, 2, -1 };
+  faceset->coordIndex.setValues(0, 10, indices);
+  root->addChild(faceset);
+
+  SoRayPickAction ra(SbViewportRegion(100, 100));
+  ra.setRay(SbVec3f(0.5f, 0.25f, 10.0f), SbVec3f(0.0f, 0.0f, -1.0f));
+  ra.setBVHCaching(TRUE);
+  for (int pass = 0; pass < 2; pass++) {
+    ra.apply(root);
+    const SoPickedPoint * pp = ra.getPickedPoint();
+    BOOST_REQUIRE_MESSAGE(pp != NULL, "Expected the ray to hit the face set");
+    const SoDetail * detail = pp->getDetail();
+    BOOST_REQUIRE_MESSAGE(detail && detail->isOfType(SoFaceDetail::getClassTypeId()),
+                          "Expected a face detail for the picked point");
+    const SoFaceDetail * face = static_cast<const SoFaceDetail *>(detail);
+    BOOST_CHECK_MESSAGE(face->getFaceIndex() == 1,
+                        "Wrong face index in the cached detail");
+    BOOST_CHECK_MESSAGE(face->getNumPoints() == 4,
+                        "Wrong number of points in the cached detail");
+    for (int i = 0; i < face->getNumPoints() && i < 4; i++) {
+      BOOST_CHECK_MESSAGE(face->getPoint(i)->getCoordinateIndex() == indices[5+i],
+                          "Wrong coordinate index in the cached detail");
+    }
+  }
+
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(bvhcachingoverriddendetails)
+{
+  if (RayPickDetailFaceSet::getClassTypeId() == SoType::badType()) {
+    RayPickDetailFaceSet::initClass();
+  }
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  const float xyz[][3] = {
+    { -1.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+    { -1.0f, 1.0f, 0.0f }, { 1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 0.0f }
+  };
+  coords->point.setValues(0, 6, xyz);
+  root->addChild(coords);
+  RayPickDetailFaceSet * faceset = new RayPickDetailFaceSet;
+  const int32_t indices[] = { 0, 1, 2, 3, -1, 1, 4, 5, 2, -1 };
+  faceset->coordIndex.setValues(0, 10, indices);
+  root->addChild(faceset);
+
+  SoRayPickAction ra(SbViewportRegion(100, 100));
+  ra.setRay(SbVec3f(0.5f, 0.25f, 10.0f), SbVec3f(0.0f, 0.0f, -1.0f));
+  ra.setBVHCaching(TRUE);
+  for (int pass = 0; pass < 2; pass++) {
+    ra.apply(root);
+    const SoPickedPoint * pp = ra.getPickedPoint();
+    BOOST_REQUIRE_MESSAGE(pp != NULL, "Expected the ray to hit the face set");
+    const SoDetail * detail = pp->getDetail();
+    BOOST_REQUIRE_MESSAGE(detail && detail->isOfType(SoFaceDetail::getClassTypeId()),
+                          "Expected the detail made by the overriding shape");
+    const SoFaceDetail * face = static_cast<const SoFaceDetail *>(detail);
+    BOOST_CHECK_MESSAGE(face->getFaceIndex() == 1,
+                        "Wrong face index in the overridden detail");
+    BOOST_CHECK_MESSAGE(face->getPartIndex() == 7,
+                        "The detail was not edited by the overriding shape");
+  }
+  BOOST_CHECK_MESSAGE(faceset->numnullpp == 0,
+                      "createTriangleDetail() was called without a picked point");
+
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
@@ -135,6 +135,20 @@
 
   Note. This is work-in-progress. pederb, 2005-04-05.
 
+  The triangles of each new shape are reordered for the
+  post-transform vertex cache of the graphics hardware, and the
+  vertices are renumbered in the order the triangles use them, so
+  that vertex data is read sequentially. The triangles can also be
+  sorted in clusters to reduce overdraw, see optimizeOverdraw(). Since
+  the reordered triangle lists use the vertex cache about as well as
+  triangle strips would, no strips are made by
+  generateTriangleStrips().
+
+  Use startReport() and finishReport() around one or more
+  applications of the action to get the average number of cache
+  misses per triangle (ACMR) and per vertex (ATVR) before and after
+  the reordering.
+
   The code below is an example of a program that applies an
   SoReorganizeAction on a scene graph, converting all shapes into
   shapes that can be rendered using vertex array or VBO rendering.
@@ -279,6 +293,8 @@
 #include <Inventor/elements/SoNormalElement.h>
 #include <Inventor/caches/SoPrimitiveVertexCache.h>
 #include <Inventor/SbColor4f.h>
+#include <Inventor/SbString.h>
+#include <Inventor/errors/SoDebugError.h>
 
 #ifdef HAVE_VRML97
 #include <Inventor/VRMLnodes/SoVRMLCoordinate.h>
@@ -291,9 +307,14 @@
 #include <Inventor/VRMLnodes/SoVRMLIndexedLineSet.h>
 #endif // HAVE_VRML97
 
-#include "coindefs.h" // COIN_STUB()
+#include "coindefs.h" // COIN_UNUSED_ARG()
 #include "SbBasicP.h"
 #include "actions/SoSubActionP.h"
+#include "base/SbVertexCacheOptimizer.h"
+
+// how many more cache misses per triangle a cluster sorted for
+// overdraw may have
+#define SOREORGANIZE_OVERDRAW_THRESHOLD 1.05f
 
 class SoReorganizeActionP {
  public:
@@ -304,6 +325,9 @@ class SoReorganizeActionP {
       gentristrips(FALSE),
       genvp(FALSE),
       matchidx(TRUE),
+      optimizevertexcache(TRUE),
+      optimizeoverdraw(FALSE),
+      vertexcachesize(16),
       cbaction(SbViewportRegion(640, 480)),
       pvcache(NULL)
   {
@@ -340,6 +364,9 @@ class SoReorganizeActionP {
   SbBool gentristrips;
   SbBool genvp;
   SbBool matchidx;
+  SbBool optimizevertexcache;
+  SbBool optimizeoverdraw;
+  int vertexcachesize;
   SbList <SbBool> needtexcoords;
   int lastneeded;
   int numtriangles;
@@ -357,6 +384,24 @@ class SoReorganizeActionP {
   SoSearchAction sa;
   SoPrimitiveVertexCache * pvcache;
 
+  // the triangles of the new shape, and the pvcache vertex for each
+  // new vertex if the vertices have been renumbered
+  SbList <int32_t> triangleindices;
+  SbList <int32_t> vertexorder;
+  int numvertices;
+
+  // statistics collected between startReport() and finishReport()
+  struct Report {
+    SbBool active;
+    SbString msg;
+    int numshapes;
+    int numtriangles;
+    int numvertices;
+    int missesbefore;
+    int missesafter;
+  };
+  static Report report;
+
   static SoCallbackAction::Response pre_shape_cb(void * userdata, SoCallbackAction * action, const SoNode * node);
   static SoCallbackAction::Response post_shape_cb(void * userdata, SoCallbackAction * action, const SoNode * node);
   static void triangle_cb(void * userdata, SoCallbackAction * action,
@@ -369,6 +414,10 @@ class SoReorganizeActionP {
                               const SoPrimitiveVertex * v2);
 
   SbBool initShape(SoCallbackAction * action);
+  void orderTriangles(void);
+  int getVertex(const int idx) const {
+    return this->vertexorder.getLength() ? this->vertexorder[idx] : idx;
+  }
   void replaceNode(SoFullPath * path);
   void replaceIfs(SoFullPath * path);
   void replaceVrmlIfs(SoFullPath * path);
@@ -381,6 +430,8 @@ class SoReorganizeActionP {
 
 #define PRIVATE(obj) obj->pimpl
 
+SoReorganizeActionP::Report SoReorganizeActionP::report = { FALSE, SbString(), 0, 0, 0, 0, 0 };
+
 SO_ACTION_SOURCE(SoReorganizeAction);
 
 /*!
@@ -479,6 +530,80 @@ SoReorganizeAction::areIndexArraysMatched(void) const
   return PRIVATE(this)->matchidx;
 }
 
+/*!
+  Sets whether the triangles of the new shapes should be reordered for
+  the post-transform vertex cache, with the vertices renumbered in the
+  order they are used. The default is \c TRUE.
+
+  \since Coin 4.0
+*/
+void
+SoReorganizeAction::optimizeVertexCache(SbBool onoff)
+{
+  PRIVATE(this)->optimizevertexcache = onoff;
+}
+
+/*!
+  Returns whether the triangles are reordered for the vertex cache.
+
+  \since Coin 4.0
+*/
+SbBool
+SoReorganizeAction::isVertexCacheOptimized(void) const
+{
+  return PRIVATE(this)->optimizevertexcache;
+}
+
+/*!
+  Sets whether clusters of the reordered triangles should be sorted to
+  reduce overdraw, drawing the parts of a shape which face out from
+  its center first. This costs a few more vertex cache misses. The
+  default is \c FALSE. Only used when the triangles are reordered for
+  the vertex cache.
+
+  \since Coin 4.0
+*/
+void
+SoReorganizeAction::optimizeOverdraw(SbBool onoff)
+{
+  PRIVATE(this)->optimizeoverdraw = onoff;
+}
+
+/*!
+  Returns whether the triangles are sorted to reduce overdraw.
+
+  \since Coin 4.0
+*/
+SbBool
+SoReorganizeAction::isOverdrawOptimized(void) const
+{
+  return PRIVATE(this)->optimizeoverdraw;
+}
+
+/*!
+  Sets the number of vertices in the FIFO vertex cache which is
+  simulated when sorting for overdraw and for the report from
+  finishReport(). The default is 16.
+
+  \since Coin 4.0
+*/
+void
+SoReorganizeAction::setVertexCacheSize(const int size)
+{
+  PRIVATE(this)->vertexcachesize = SbMax(size, 3);
+}
+
+/*!
+  Returns the simulated vertex cache size.
+
+  \since Coin 4.0
+*/
+int
+SoReorganizeAction::getVertexCacheSize(void) const
+{
+  return PRIVATE(this)->vertexcachesize;
+}
+
 SoSimplifier *
 SoReorganizeAction::getSimplifier(void) const
 {
@@ -538,16 +663,58 @@ SoReorganizeAction::apply(const SoPathList & pathlist, SbBool COIN_UNUSED_ARG(ob
   }
 }
 
+/*!
+  Starts collecting vertex cache statistics for the triangle shapes
+  made by all SoReorganizeAction instances, to be reported with \a
+  msg by finishReport().
+*/
 void
-SoReorganizeAction::startReport(const char * COIN_UNUSED_ARG(msg))
+SoReorganizeAction::startReport(const char * msg)
 {
-  COIN_STUB();
+  SoReorganizeActionP::Report & report = SoReorganizeActionP::report;
+  report.active = TRUE;
+  report.msg = msg ? msg : "";
+  report.numshapes = 0;
+  report.numtriangles = 0;
+  report.numvertices = 0;
+  report.missesbefore = 0;
+  report.missesafter = 0;
 }
 
+/*!
+  Posts the vertex cache statistics collected since startReport() with
+  SoDebugError::postInfo(), and stops collecting them.
+
+  The statistics are the average number of misses per triangle (ACMR)
+  and per vertex (ATVR) in a simulated FIFO vertex cache, for the
+  triangles as they were before and after the reorganization. For
+  the ACMR, 0.5 is the best possible for large regular meshes and 3.0
+  the worst. For the ATVR, 1.0 is the best possible.
+*/
 void
 SoReorganizeAction::finishReport(void)
 {
-  COIN_STUB();
+  SoReorganizeActionP::Report & report = SoReorganizeActionP::report;
+  if (!report.active) return;
+  report.active = FALSE;
+
+  if (report.numtriangles == 0) {
+    SoDebugError::postInfo("SoReorganizeAction::finishReport",
+                           "%s: no triangle shapes", report.msg.getString());
+    return;
+  }
+  const float numtriangles = float(report.numtriangles);
+  const float numvertices = float(report.numvertices);
+  SoDebugError::postInfo("SoReorganizeAction::finishReport",
+                         "%s: %d shapes, %d triangles, %d vertices, "
+                         "ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+                         report.msg.getString(),
+                         report.numshapes, report.numtriangles,
+                         report.numvertices,
+                         report.missesbefore / numtriangles,
+                         report.missesafter / numtriangles,
+                         report.missesbefore / numvertices,
+                         report.missesafter / numvertices);
 }
 
 // Documented in superclass.
@@ -722,7 +889,12 @@ SoReorganizeActionP::replaceNode(SoFullPath * path)
   if (this->pvcache == NULL) return;
   this->pvcache->fit(); // needed to do optimize-sort of data
 
+  this->triangleindices.truncate(0);
+  this->vertexorder.truncate(0);
+  this->numvertices = this->pvcache->getNumVertices();
+
   if (this->pvcache->getNumTriangleIndices()) {
+    this->orderTriangles();
     if (this->isvrml) {
       this->replaceVrmlIfs(path);
     }
@@ -742,6 +914,61 @@ SoReorganizeActionP::replaceNode(SoFullPath * path)
   this->pvcache = NULL;
 }
 
+// reorders the triangles for the vertex cache, and collects
+// statistics for the report
+void
+SoReorganizeActionP::orderTriangles(void)
+{
+  const int numindices = this->pvcache->getNumTriangleIndices();
+  const GLint * indices = this->pvcache->getTriangleIndices();
+  for (int i = 0; i < numindices; i++) {
+    this->triangleindices.append(static_cast<int32_t>(indices[i]));
+  }
+  int32_t * ptr = const_cast<int32_t *>(this->triangleindices.getArrayPtr());
+  const int numtriangles = numindices / 3;
+
+  int missesbefore = 0, usedvertices = 0;
+  if (report.active) {
+    SbVertexCacheOptimizer::getCacheStatistics(ptr, numindices,
+                                               this->numvertices,
+                                               this->vertexcachesize,
+                                               missesbefore, usedvertices);
+  }
+  if (this->optimizevertexcache) {
+    SbVertexCacheOptimizer::optimizeTriangles(ptr, numtriangles,
+                                              this->numvertices);
+    if (this->optimizeoverdraw) {
+      SbVertexCacheOptimizer::optimizeOverdraw(ptr, numtriangles,
+                                               this->pvcache->getVertexArray(),
+                                               this->numvertices,
+                                               this->vertexcachesize,
+                                               SOREORGANIZE_OVERDRAW_THRESHOLD);
+    }
+    // the vertices are renumbered in the order they are used, which
+    // also drops vertices used only by lines and points
+    int32_t * order = new int32_t[this->numvertices];
+    this->numvertices =
+      SbVertexCacheOptimizer::optimizeVertexFetch(ptr, numindices,
+                                                  this->numvertices, order);
+    for (int i = 0; i < this->numvertices; i++) {
+      this->vertexorder.append(order[i]);
+    }
+    delete[] order;
+  }
+  if (report.active) {
+    int missesafter, numused;
+    SbVertexCacheOptimizer::getCacheStatistics(ptr, numindices,
+                                               this->numvertices,
+                                               this->vertexcachesize,
+                                               missesafter, numused);
+    report.numshapes++;
+    report.numtriangles += numtriangles;
+    report.numvertices += usedvertices;
+    report.missesbefore += missesbefore;
+    report.missesafter += missesafter;
+  }
+}
+
 SoVertexProperty *
 SoReorganizeActionP::createVertexProperty(const SbBool forlines)
 {
@@ -755,7 +982,7 @@ SoReorganizeActionP::createVertexProperty(const SbBool forlines)
   }
   vp->normalBinding = nbind;
 
-  int numv = this->pvcache->getNumVertices();
+  int numv = this->numvertices;
 
   if (this->hastexture) {
     vp->texCoord.setNum(numv);
@@ -763,7 +990,7 @@ SoReorganizeActionP::createVertexProperty(const SbBool forlines)
     const SbVec4f * src = this->pvcache->getTexCoordArray();
 
     for (int i = 0; i < numv; i++) {
-      SbVec4f tmp = src[i];
+      SbVec4f tmp = src[this->getVertex(i)];
       if (tmp[3] != 0.0f) {
         tmp[0] /= tmp[3];
         tmp[1] /= tmp[3];
@@ -774,11 +1001,21 @@ SoReorganizeActionP::createVertexProperty(const SbBool forlines)
     vp->texCoord.finishEditing();
   }
 
-  vp->vertex.setValues(0, numv,
-                       this->pvcache->getVertexArray());
+  vp->vertex.setNum(numv);
+  SbVec3f * vdst = vp->vertex.startEditing();
+  const SbVec3f * vsrc = this->pvcache->getVertexArray();
+  for (int i = 0; i < numv; i++) {
+    vdst[i] = vsrc[this->getVertex(i)];
+  }
+  vp->vertex.finishEditing();
   if (nbind == SoVertexProperty::PER_VERTEX_INDEXED) {
-    vp->normal.setValues(0, numv,
-                         this->pvcache->getNormalArray());
+    vp->normal.setNum(numv);
+    SbVec3f * ndst = vp->normal.startEditing();
+    const SbVec3f * nsrc = this->pvcache->getNormalArray();
+    for (int i = 0; i < numv; i++) {
+      ndst[i] = nsrc[this->getVertex(i)];
+    }
+    vp->normal.finishEditing();
   }
 
   vp->materialBinding = SoVertexProperty::OVERALL;
@@ -786,12 +1023,12 @@ SoReorganizeActionP::createVertexProperty(const SbBool forlines)
 
   if (this->pvcache->colorPerVertex()) {
     vp->materialBinding = SoVertexProperty::PER_VERTEX_INDEXED;
-    uint8_t * src = const_cast<uint8_t *>(this->pvcache->getColorArray());
+    const uint8_t * colors = this->pvcache->getColorArray();
     vp->orderedRGBA.setNum(numv);
     uint32_t * dst = vp->orderedRGBA.startEditing();
     for (int i = 0; i < numv; i++) {
+      const uint8_t * src = colors + this->getVertex(i) * 4;
       dst[i] = (src[0]<<24)|(src[1]<<16)|(src[2]<<8)|src[3];
-      src += 4;
     }
     vp->orderedRGBA.finishEditing();
   }
@@ -815,8 +1052,8 @@ SoReorganizeActionP::replaceIfs(SoFullPath * path)
   ifs->materialIndex.setNum(0);
   ifs->textureCoordIndex.setNum(0);
 
-  int numtri = this->pvcache->getNumTriangleIndices() / 3;
-  const GLint * indices = this->pvcache->getTriangleIndices();
+  int numtri = this->triangleindices.getLength() / 3;
+  const int32_t * indices = this->triangleindices.getArrayPtr();
   ifs->coordIndex.setNum(numtri * 4);
   int32_t * ptr = ifs->coordIndex.startEditing();
 
@@ -857,7 +1094,7 @@ SoReorganizeActionP::replaceVrmlIfs(SoFullPath * path)
   ifs->solid = oldifs->solid;
   ifs->creaseAngle = oldifs->creaseAngle;
 
-  int numv = this->pvcache->getNumVertices();
+  int numv = this->numvertices;
 
   if (this->hastexture) {
     SoVRMLTextureCoordinate * tc = new SoVRMLTextureCoordinate;
@@ -866,7 +1103,7 @@ SoReorganizeActionP::replaceVrmlIfs(SoFullPath * path)
     const SbVec4f * src = this->pvcache->getTexCoordArray();
 
     for (int i = 0; i < numv; i++) {
-      SbVec4f tmp = src[i];
+      SbVec4f tmp = src[this->getVertex(i)];
       if (tmp[3] != 0.0f) {
         tmp[0] /= tmp[3];
         tmp[1] /= tmp[3];
@@ -879,26 +1116,36 @@ SoReorganizeActionP::replaceVrmlIfs(SoFullPath * path)
   }
 
   SoVRMLCoordinate * c = new SoVRMLCoordinate;
-  c->point.setValues(0, numv,
-                     this->pvcache->getVertexArray());
+  c->point.setNum(numv);
+  SbVec3f * vdst = c->point.startEditing();
+  const SbVec3f * vsrc = this->pvcache->getVertexArray();
+  for (int i = 0; i < numv; i++) {
+    vdst[i] = vsrc[this->getVertex(i)];
+  }
+  c->point.finishEditing();
   ifs->coord = c;
 
   if (this->lighting) {
     SoVRMLNormal * norm = new SoVRMLNormal;
-    norm->vector.setValues(0, numv,
-                           this->pvcache->getNormalArray());
+    norm->vector.setNum(numv);
+    SbVec3f * ndst = norm->vector.startEditing();
+    const SbVec3f * nsrc = this->pvcache->getNormalArray();
+    for (int i = 0; i < numv; i++) {
+      ndst[i] = nsrc[this->getVertex(i)];
+    }
+    norm->vector.finishEditing();
     ifs->normal = norm;
   }
   if (this->pvcache->colorPerVertex()) {
     SoVRMLColor * col = new SoVRMLColor;
     col->color.setNum(numv);
-    uint8_t * src = const_cast<uint8_t *>(this->pvcache->getColorArray());
+    const uint8_t * colors = this->pvcache->getColorArray();
     SbColor * dst = col->color.startEditing();
     for (int i = 0; i < numv; i++) {
+      const uint8_t * src = colors + this->getVertex(i) * 4;
       dst[i] = SbColor(src[0]/255.0f,
                        src[1]/255.0f,
                        src[2]/255.0f);
-      src += 4;
     }
     col->color.finishEditing();
     ifs->color = col;
@@ -908,8 +1155,8 @@ SoReorganizeActionP::replaceVrmlIfs(SoFullPath * path)
   ifs->colorIndex.setNum(0);
   ifs->texCoordIndex.setNum(0);
 
-  int numtri = this->pvcache->getNumTriangleIndices() / 3;
-  const GLint * indices = this->pvcache->getTriangleIndices();
+  int numtri = this->triangleindices.getLength() / 3;
+  const int32_t * indices = this->triangleindices.getArrayPtr();
   ifs->coordIndex.setNum(numtri * 4);
   int32_t * ptr = ifs->coordIndex.startEditing();
 
@@ -1036,3 +1283,128 @@ SoReorganizeActionP::replaceVrmlIls(SoFullPath * path)
 }
 
 #undef PRIVATE
+#undef SOREORGANIZE_OVERDRAW_THRESHOLD
+
+#ifdef COIN_TEST_SUITE
+
+#include <algorithm>
+#include <vector>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoShapeHints.h>
+#include <Inventor/nodes/SoVertexProperty.h>
+
+// returns the cache misses per triangle with a FIFO cache of 16 vertices
+static float
+get_acmr(const SoIndexedFaceSet * ifs, const int numvertices)
+{
+  std::vector<int> stamps(numvertices, -17);
+  int time = 0, misses = 0;
+  for (int i = 0; i < ifs->coordIndex.getNum(); i++) {
+    const int32_t idx = ifs->coordIndex[i];
+    if (idx < 0) continue;
+    if (time - stamps[idx] >= 16) {
+      stamps[idx] = ++time;
+      misses++;
+    }
+  }
+  return float(misses) / float(ifs->coordIndex.getNum() / 4);
+}
+
+// returns the corners of all triangles, sorted, to compare meshes
+static std::vector<float>
+get_triangles(const SoIndexedFaceSet * ifs)
+{
+  const SoVertexProperty * vp =
+    static_cast<const SoVertexProperty *>(ifs->vertexProperty.getValue());
+  std::vector<std::vector<float> > triangles;
+  for (int i = 0; i + 3 < ifs->coordIndex.getNum(); i += 4) {
+    std::vector<float> t;
+    for (int j = 0; j < 3; j++) {
+      const SbVec3f & v = vp->vertex[ifs->coordIndex[i + j]];
+      t.push_back(v[0]); t.push_back(v[1]); t.push_back(v[2]);
+    }
+    triangles.push_back(t);
+  }
+  std::sort(triangles.begin(), triangles.end());
+  std::vector<float> result;
+  for (size_t i = 0; i < triangles.size(); i++) {
+    result.insert(result.end(), triangles[i].begin(), triangles[i].end());
+  }
+  return result;
+}
+
+// a grid of quads on the z = 0 plane, rows of triangles interleaved
+// with triangles from other rows to defeat the simple index sorting
+static SoSeparator *
+make_grid(const int size)
+{
+  SoSeparator * root = new SoSeparator;
+  SoShapeHints * hints = new SoShapeHints;
+  hints->creaseAngle = 1.0f;
+  root->addChild(hints);
+  SoCoordinate3 * coords = new SoCoordinate3;
+  for (int y = 0; y <= size; y++) {
+    for (int x = 0; x <= size; x++) {
+      coords->point.set1Value(y * (size + 1) + x, SbVec3f(float(x), float(y), 0.0f));
+    }
+  }
+  root->addChild(coords);
+  SoIndexedFaceSet * ifs = new SoIndexedFaceSet;
+  int n = 0;
+  for (int x = 0; x < size; x++) {
+    for (int y = 0; y < size; y++) {
+      const int32_t corner = y * (size + 1) + x;
+      const int32_t quad[] = { corner, corner + 1, corner + size + 2, corner + size + 1, -1 };
+      ifs->coordIndex.setValues(n, 5, quad);
+      n += 5;
+    }
+  }
+  root->addChild(ifs);
+  return root;
+}
+
+BOOST_AUTO_TEST_CASE(vertexcache)
+{
+  SoSeparator * reference = make_grid(40);
+  reference->ref();
+  SoReorganizeAction unoptimized;
+  unoptimized.optimizeVertexCache(FALSE);
+  unoptimized.apply(reference);
+  const SoIndexedFaceSet * refifs =
+    static_cast<SoIndexedFaceSet *>(reference->getChild(2));
+  const int numvertices =
+    static_cast<SoVertexProperty *>(refifs->vertexProperty.getValue())->vertex.getNum();
+
+  for (int overdraw = 0; overdraw < 2; overdraw++) {
+    SoSeparator * root = make_grid(40);
+    root->ref();
+    SoReorganizeAction ra;
+    ra.optimizeOverdraw(overdraw);
+    ra.apply(root);
+    BOOST_REQUIRE(root->getChild(2)->isOfType(SoIndexedFaceSet::getClassTypeId()));
+    const SoIndexedFaceSet * ifs =
+      static_cast<SoIndexedFaceSet *>(root->getChild(2));
+    BOOST_CHECK_MESSAGE(get_triangles(ifs) == get_triangles(refifs),
+                        "Reordering should keep the triangles");
+    BOOST_CHECK_MESSAGE(get_acmr(ifs, numvertices) < 0.8f &&
+                        get_acmr(ifs, numvertices) < get_acmr(refifs, numvertices),
+                        "Reordering should give fewer cache misses");
+
+    // the vertices should be numbered in the order of first use
+    int32_t next = 0;
+    SbBool ordered = TRUE;
+    for (int i = 0; i < ifs->coordIndex.getNum(); i++) {
+      const int32_t idx = ifs->coordIndex[i];
+      if (idx == next) next++;
+      else if (idx > next) ordered = FALSE;
+    }
+    BOOST_CHECK_MESSAGE(ordered && next == numvertices,
+                        "Vertices should be renumbered in the order of use");
+    root->unref();
+  }
+  reference->unref();
+}
+
+#endif // COIN_TEST_SUITE
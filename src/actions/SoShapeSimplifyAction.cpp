@@ -30,20 +30,107 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 \**************************************************************************/
 
-// FIXME: this class has not yet been implemented in Coin. this is a
-// placeholder / stub / skeleton code, not yet built (nor installed,
-// obviously).  --mortene.
-
 /*!
   \class SoShapeSimplifyAction SoShapeSimplifyAction.h Inventor/actions/SoShapeSimplifyAction.h
   \brief The SoShapeSimplifyAction class replaces complex primitives
   with simplified polygon representations.
+
+  Each shape in the scene graph with at least getMinTriangles()
+  triangles is simplified on its own, in its local coordinate system,
+  and replaced in its parent group by an SoIndexedFaceSet with an
+  SoVertexProperty node, or by an SoLevelOfDetail node with one
+  SoIndexedFaceSet for each simplification level. The colors of the
+  shape are put in the SoVertexProperty node, together with the
+  texture coordinates when texturing is on, and the normals when
+  lighting is on. Shapes which generate their normals from the crease
+  angle, such as an SoIndexedFaceSet without normals, are replaced
+  by shapes which do the same.
+
+  Shapes below nodes other than groups, such as VRML geometry and
+  node kit parts, and shapes using more than one texture unit are
+  left as they are.
+
+  \code
+  SoShapeSimplifyAction simplify;
+  const float levels[] = { 1.0f, 0.25f, 0.05f };
+  simplify.setSimplificationLevels(3, levels);
+  simplify.apply(root);
+  \endcode
+
+  \sa SoGlobalSimplifyAction
+  \since Coin 4.0
 */
 
-#include <Inventor/SbName.h>
 #include <Inventor/actions/SoShapeSimplifyAction.h>
-#include <coindefs.h> // COIN_STUB()
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <cassert>
+
+#include <Inventor/SbName.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/SoPrimitiveVertex.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/actions/SoSearchAction.h>
+#include <Inventor/caches/SoPrimitiveVertexCache.h>
+#include <Inventor/elements/SoDecimationTypeElement.h>
+#include <Inventor/elements/SoLightModelElement.h>
+#include <Inventor/elements/SoMultiTextureCoordinateElement.h>
+#include <Inventor/elements/SoMultiTextureEnabledElement.h>
+#include <Inventor/elements/SoNormalElement.h>
+#include <Inventor/elements/SoShapeStyleElement.h>
+#include <Inventor/nodes/SoGroup.h>
+#include <Inventor/nodes/SoShape.h>
+#include <Inventor/nodes/SoVertexProperty.h>
+#include <Inventor/nodes/SoVertexShape.h>
+
+#ifdef HAVE_VRML97
+#include <Inventor/VRMLnodes/SoVRMLGeometry.h>
+#endif // HAVE_VRML97
+
+#include "SbBasicP.h"
+#include "coindefs.h" // COIN_UNUSED_ARG()
+#include "actions/SoSubActionP.h"
+#include "actions/SoSimplifyActionP.h"
+#include "base/SbQuadricSimplifier.h"
+
+class SoShapeSimplifyActionP {
+public:
+  SoShapeSimplifyActionP(void)
+    : master(NULL),
+      cbaction(SbViewportRegion(640, 480)),
+      pvcache(NULL)
+  {
+    this->cbaction.addTriangleCallback(SoShape::getClassTypeId(), triangle_cb, this);
+    this->cbaction.addPreCallback(SoShape::getClassTypeId(), pre_shape_cb, this);
+  }
+
+  SoShapeSimplifyAction * master;
+  SoCallbackAction cbaction;
+  SoSearchAction sa;
+  SoPrimitiveVertexCache * pvcache;
+  SbBool didinit;
+  SbBool skipshape;
+  SbBool generatednormals;
+  SoSimplifyActionP::MeshFormat format;
+  SbList<float> levels;
+  SbQuadricSimplifier simplifier;
+
+  static SoCallbackAction::Response pre_shape_cb(void * userdata,
+                                                 SoCallbackAction * action,
+                                                 const SoNode * node);
+  static void triangle_cb(void * userdata, SoCallbackAction * action,
+                          const SoPrimitiveVertex * v1,
+                          const SoPrimitiveVertex * v2,
+                          const SoPrimitiveVertex * v3);
+
+  SbBool initShape(SoCallbackAction * action);
+  void replaceNode(SoFullPath * path);
+};
+
+#define PRIVATE(obj) ((obj)->pimpl)
 
 SO_ACTION_SOURCE(SoShapeSimplifyAction);
 
@@ -63,7 +150,8 @@ SoShapeSimplifyAction::initClass(void)
 
 SoShapeSimplifyAction::SoShapeSimplifyAction(void)
 {
-  COIN_STUB();
+  PRIVATE(this)->master = this;
+  SO_ACTION_CONSTRUCTOR(SoShapeSimplifyAction);
 }
 
 /*!
@@ -72,12 +160,350 @@ SoShapeSimplifyAction::SoShapeSimplifyAction(void)
 
 SoShapeSimplifyAction::~SoShapeSimplifyAction(void)
 {
-  COIN_STUB();
+  if (PRIVATE(this)->pvcache) PRIVATE(this)->pvcache->unref();
+}
+
+/*!
+  Simplifies all shapes below \a root.
+*/
+void
+SoShapeSimplifyAction::apply(SoNode * root)
+{
+  PRIVATE(this)->sa.setType(SoShape::getClassTypeId());
+  PRIVATE(this)->sa.setSearchingAll(TRUE);
+  PRIVATE(this)->sa.setInterest(SoSearchAction::ALL);
+  PRIVATE(this)->sa.apply(root);
+  // copy the paths, since applying the action on a path can
+  // change the paths found
+  SoPathList pl(PRIVATE(this)->sa.getPaths());
+  PRIVATE(this)->sa.reset();
+  for (int i = 0; i < pl.getLength(); i++) {
+    this->apply(pl[i]);
+  }
+}
+
+/*!
+  Simplifies the shape at the tail of \a path.
+*/
+void
+SoShapeSimplifyAction::apply(SoPath * path)
+{
+  SoFullPath * fullpath = reclassify_cast<SoFullPath *>(path);
+  if (!fullpath->getTail()->isOfType(SoShape::getClassTypeId())) return;
+  PRIVATE(this)->cbaction.apply(path);
+  PRIVATE(this)->replaceNode(fullpath);
+}
+
+/*!
+  Simplifies the shapes at the tail of the paths in \a pathlist.
+*/
+void
+SoShapeSimplifyAction::apply(const SoPathList & pathlist, SbBool COIN_UNUSED_ARG(obeysrules))
+{
+  for (int i = 0; i < pathlist.getLength(); i++) {
+    this->apply(pathlist[i]);
+  }
 }
 
 // Documented in superclass.
 void
 SoShapeSimplifyAction::beginTraversal(SoNode * /* node */)
 {
-  COIN_STUB();
+  assert(0 && "should never get here");
+}
+
+SoCallbackAction::Response
+SoShapeSimplifyActionP::pre_shape_cb(void * userdata, SoCallbackAction * action,
+                                     const SoNode * node)
+{
+  SoShapeSimplifyActionP * thisp = static_cast<SoShapeSimplifyActionP *>(userdata);
+  thisp->didinit = FALSE;
+  thisp->skipshape = FALSE;
+#ifdef HAVE_VRML97
+  thisp->skipshape = node->isOfType(SoVRMLGeometry::getClassTypeId());
+#endif // HAVE_VRML97
+
+  // vertex shapes without normals get them generated from the crease
+  // angle. The simplified shape will be in the same place in the
+  // scene graph, and should generate its normals the same way.
+  thisp->generatednormals = FALSE;
+  if (node->isOfType(SoVertexShape::getClassTypeId())) {
+    const SoNode * vp =
+      coin_assert_cast<const SoVertexShape *>(node)->vertexProperty.getValue();
+    thisp->generatednormals =
+      SoNormalElement::getInstance(action->getState())->getNum() == 0 &&
+      !(vp && vp->isOfType(SoVertexProperty::getClassTypeId()) &&
+        coin_assert_cast<const SoVertexProperty *>(vp)->normal.getNum() > 0);
+  }
+  return thisp->skipshape ? SoCallbackAction::PRUNE : SoCallbackAction::CONTINUE;
+}
+
+void
+SoShapeSimplifyActionP::triangle_cb(void * userdata, SoCallbackAction * action,
+                                    const SoPrimitiveVertex * v1,
+                                    const SoPrimitiveVertex * v2,
+                                    const SoPrimitiveVertex * v3)
+{
+  SoShapeSimplifyActionP * thisp = static_cast<SoShapeSimplifyActionP *>(userdata);
+
+  if (!thisp->didinit) {
+    if (thisp->initShape(action)) {
+      assert(thisp->pvcache == NULL);
+      thisp->pvcache = new SoPrimitiveVertexCache(action->getState());
+      thisp->pvcache->ref();
+    }
+  }
+  if (thisp->pvcache) {
+    thisp->pvcache->addTriangle(v1, v2, v3);
+  }
+}
+
+// returns TRUE if the shape should be simplified
+SbBool
+SoShapeSimplifyActionP::initShape(SoCallbackAction * action)
+{
+  this->didinit = TRUE;
+  SoState * state = action->getState();
+
+  if (this->skipshape ||
+      SoDecimationTypeElement::get(state) == SoDecimationTypeElement::HIGHEST) {
+    return FALSE;
+  }
+  const unsigned int shapeflags = SoShapeStyleElement::get(state)->getFlags();
+  if (shapeflags &
+      (SoShapeStyleElement::BUMPMAP|
+       SoShapeStyleElement::BBOXCMPLX|
+       SoShapeStyleElement::INVISIBLE|
+       SoShapeStyleElement::BIGIMAGE)) {
+    return FALSE;
+  }
+
+  // SoVertexProperty has texture coordinates for one unit only
+  int lastenabled;
+  const SbBool * enabledunits =
+    SoMultiTextureEnabledElement::getEnabledUnits(state, lastenabled);
+  if (enabledunits) {
+    for (int i = 1; i <= lastenabled; i++) {
+      if (enabledunits[i]) return FALSE;
+    }
+  }
+  this->format.texcoords = FALSE;
+  if (SoMultiTextureEnabledElement::get(state, 0)) {
+    switch (SoMultiTextureCoordinateElement::getInstance(state)->getType(0)) {
+    case SoMultiTextureCoordinateElement::DEFAULT:
+    case SoMultiTextureCoordinateElement::EXPLICIT:
+    case SoMultiTextureCoordinateElement::FUNCTION:
+      this->format.texcoords = TRUE;
+      break;
+    case SoMultiTextureCoordinateElement::TEXGEN:
+      break;
+    default:
+      return FALSE;
+    }
+  }
+
+  this->format.normals = !this->generatednormals &&
+    SoLightModelElement::get(state) != SoLightModelElement::BASE_COLOR;
+
+  SoSimplifyActionP::getLevels(this->master, state, this->levels);
+  return TRUE;
+}
+
+void
+SoShapeSimplifyActionP::replaceNode(SoFullPath * path)
+{
+  if (this->pvcache == NULL) return;
+  this->pvcache->fit();
+
+  const int numtriangles = this->pvcache->getNumTriangleIndices() / 3;
+  SoNode * parent = path->getLength() > 1 ? path->getNodeFromTail(1) : NULL;
+  if (numtriangles > 0 &&
+      numtriangles >= this->master->getMinTriangles() &&
+      parent && parent->isOfType(SoGroup::getClassTypeId())) {
+    this->format.colors = this->pvcache->colorPerVertex();
+    const int numvertices = this->pvcache->getNumVertices();
+    const int numattributes = this->format.getNumAttributes();
+    float * attributes = new float[numvertices * numattributes];
+    const SbVec3f * normals = this->pvcache->getNormalArray();
+    const SbVec4f * texcoords = this->pvcache->getTexCoordArray();
+    const uint8_t * colors = this->pvcache->getColorArray();
+    float * dst = attributes;
+    for (int i = 0; i < numvertices; i++) {
+      if (this->format.normals) {
+        *dst++ = normals[i][0];
+        *dst++ = normals[i][1];
+        *dst++ = normals[i][2];
+      }
+      if (this->format.texcoords) {
+        SbVec4f tc = texcoords[i];
+        if (tc[3] != 0.0f) {
+          tc[0] /= tc[3];
+          tc[1] /= tc[3];
+        }
+        *dst++ = tc[0];
+        *dst++ = tc[1];
+      }
+      if (this->format.colors) {
+        for (int j = 0; j < 4; j++) *dst++ = float(colors[i*4+j]);
+      }
+    }
+    const GLint * glindices = this->pvcache->getTriangleIndices();
+    int32_t * indices = new int32_t[numtriangles * 3];
+    for (int i = 0; i < numtriangles * 3; i++) {
+      indices[i] = static_cast<int32_t>(glindices[i]);
+    }
+
+    this->simplifier.setMesh(this->pvcache->getVertexArray(), attributes,
+                             numvertices, numattributes,
+                             indices, numtriangles);
+    delete[] attributes;
+    delete[] indices;
+
+    SoNode * node = SoSimplifyActionP::createMesh(this->master, this->simplifier,
+                                                  this->levels, this->format);
+    this->simplifier.clear();
+    node->ref();
+    const int idx = path->getIndexFromTail(0);
+    path->pop();
+    coin_assert_cast<SoGroup *>(parent)->replaceChild(idx, node);
+    path->push(idx);
+    node->unrefNoDelete();
+  }
+  this->pvcache->unref();
+  this->pvcache = NULL;
 }
+
+#undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/nodes/SoCallback.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoLevelOfDetail.h>
+#include <Inventor/nodes/SoMaterial.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/elements/SoDecimationPercentageElement.h>
+#include <Inventor/elements/SoDecimationTypeElement.h>
+
+static void
+percentage_cb(void * userdata, SoAction * action)
+{
+  SoState * state = action->getState();
+  if (state->isElementEnabled(SoDecimationTypeElement::getClassStackIndex())) {
+    SoDecimationTypeElement::set(state, SoDecimationTypeElement::PERCENTAGE);
+    SoDecimationPercentageElement::set(state, *static_cast<float *>(userdata));
+  }
+}
+
+static void
+highest_cb(void *, SoAction * action)
+{
+  SoState * state = action->getState();
+  if (state->isElementEnabled(SoDecimationTypeElement::getClassStackIndex())) {
+    SoDecimationTypeElement::set(state, SoDecimationTypeElement::HIGHEST);
+  }
+}
+
+// returns the number of triangles in an indexed face set from the
+// simplify actions, or -1 if an index is out of range
+static int
+count_triangles(SoNode * node)
+{
+  if (!node->isOfType(SoIndexedFaceSet::getClassTypeId())) return -1;
+  SoIndexedFaceSet * ifs = static_cast<SoIndexedFaceSet *>(node);
+  SoVertexProperty * vp =
+    static_cast<SoVertexProperty *>(ifs->vertexProperty.getValue());
+  if (vp == NULL) return -1;
+  const int numcoords = vp->vertex.getNum();
+  const int numindices = ifs->coordIndex.getNum();
+  if (numindices % 4) return -1;
+  for (int i = 0; i < numindices; i++) {
+    const int32_t idx = ifs->coordIndex[i];
+    if ((i % 4 == 3) ? (idx != -1) : (idx < 0 || idx >= numcoords)) return -1;
+  }
+  return numindices / 4;
+}
+
+BOOST_AUTO_TEST_CASE(levels)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoSphere * sphere = new SoSphere;
+  root->addChild(sphere);
+
+  SoShapeSimplifyAction ssa;
+  const float levels[] = { 1.0f, 0.5f, 0.1f };
+  ssa.setSimplificationLevels(3, levels);
+  ssa.apply(root);
+
+  BOOST_REQUIRE(root->getNumChildren() == 1);
+  SoNode * result = root->getChild(0);
+  BOOST_REQUIRE(result->isOfType(SoLevelOfDetail::getClassTypeId()));
+  SoLevelOfDetail * lod = static_cast<SoLevelOfDetail *>(result);
+  BOOST_REQUIRE(lod->getNumChildren() == 3);
+  BOOST_CHECK_MESSAGE(lod->screenArea.getNum() == 2,
+                      "Expected one screen area between each level");
+
+  const int full = count_triangles(lod->getChild(0));
+  BOOST_REQUIRE(full > 0);
+  for (int i = 1; i < 3; i++) {
+    const int num = count_triangles(lod->getChild(i));
+    const int target = int(levels[i] * full);
+    BOOST_CHECK_MESSAGE(num > 0 && num <= target + 2 && num >= target / 2,
+                        "Level should be close to its share of the triangles");
+  }
+  BOOST_CHECK_MESSAGE(lod->screenArea[0] > lod->screenArea[1],
+                      "Screen areas should decrease with the level");
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(decimation)
+{
+  float percentage = 0.25f;
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCallback * cb = new SoCallback;
+  cb->setCallback(percentage_cb, &percentage);
+  root->addChild(cb);
+  root->addChild(new SoSphere);
+
+  SoShapeSimplifyAction ssa;
+  ssa.apply(root);
+  BOOST_REQUIRE(root->getNumChildren() == 2);
+  BOOST_CHECK_MESSAGE(count_triangles(root->getChild(1)) > 0,
+                      "Percentage decimation should give a single face set");
+
+  cb->setCallback(highest_cb);
+  root->replaceChild(1, new SoSphere);
+  ssa.apply(root);
+  BOOST_CHECK_MESSAGE(root->getChild(1)->isOfType(SoSphere::getClassTypeId()),
+                      "Highest decimation should leave the shape unchanged");
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(materialFromState)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoMaterial * material = new SoMaterial;
+  material->diffuseColor.setValue(1.0f, 0.0f, 0.0f);
+  root->addChild(material);
+  root->addChild(new SoSphere);
+
+  SoShapeSimplifyAction ssa;
+  const float levels[] = { 0.5f };
+  ssa.setSimplificationLevels(1, levels);
+  ssa.apply(root);
+
+  BOOST_REQUIRE(root->getNumChildren() == 2);
+  BOOST_REQUIRE(count_triangles(root->getChild(1)) > 0);
+  SoIndexedFaceSet * ifs = static_cast<SoIndexedFaceSet *>(root->getChild(1));
+  SoVertexProperty * vp =
+    static_cast<SoVertexProperty *>(ifs->vertexProperty.getValue());
+  BOOST_CHECK_MESSAGE(vp->orderedRGBA.getNum() == 0,
+                      "A shape without per vertex colors should keep using the material");
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
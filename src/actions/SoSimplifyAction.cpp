@@ -34,18 +34,52 @@
   \class SoSimplifyAction SoSimplifyAction.h Inventor/actions/SoSimplifyAction.h
   \brief The SoSimplifyAction class is the base class for the simplify
   action classes.
+
+  The simplify actions reduce the number of triangles of the shapes
+  in a scene graph by quadric error edge collapses, as described by
+  Garland and Heckbert in "Surface Simplification Using Quadric Error
+  Metrics" (SIGGRAPH 97). Vertex normals, texture coordinates and
+  colors are kept, and seams between triangles with different
+  attributes and the boundaries of open meshes are kept in place.
+
+  The simplified shapes are SoIndexedFaceSet nodes with their
+  vertex data in an SoVertexProperty node. With more than one
+  simplification level, the versions of a shape are put below an
+  SoLevelOfDetail node.
+
+  The simplification can be controlled from the scene graph with
+  SoDecimationTypeElement and SoDecimationPercentageElement. With
+  SoDecimationTypeElement::AUTOMATIC (the default) all the
+  simplification levels of the action are made.
+  SoDecimationTypeElement::HIGHEST keeps the shapes at full
+  resolution, SoDecimationTypeElement::LOWEST makes only the lowest
+  level, and SoDecimationTypeElement::PERCENTAGE makes one level with
+  the fraction of triangles set in SoDecimationPercentageElement.
+
+  \sa SoShapeSimplifyAction, SoGlobalSimplifyAction
 */
 
 #include <Inventor/actions/SoSimplifyAction.h>
 
+#include <algorithm>
+#include <functional>
+
 #include <Inventor/SbName.h>
+#include <Inventor/elements/SoDecimationPercentageElement.h>
+#include <Inventor/elements/SoDecimationTypeElement.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoLevelOfDetail.h>
+#include <Inventor/nodes/SoVertexProperty.h>
 
-#include "coindefs.h" // COIN_STUB()
 #include "actions/SoSubActionP.h"
+#include "actions/SoSimplifyActionP.h"
+#include "base/SbQuadricSimplifier.h"
 
-class SoSimplifyActionP {
-public:
-};
+// the default level of detail screen areas give each triangle of a
+// level about this many pixels
+#define SOSIMPLIFY_PIXELS_PER_TRIANGLE 1.0f
+
+#define PRIVATE(obj) ((obj)->pimpl)
 
 SO_ACTION_SOURCE(SoSimplifyAction);
 
@@ -61,6 +95,9 @@ SoSimplifyAction::initClass(void)
 
 /*!
   A constructor.
+
+  The default simplification levels are 1.0, 0.3 and 0.1, and shapes
+  with less than 100 triangles are not simplified.
 */
 
 SoSimplifyAction::SoSimplifyAction(void)
@@ -99,3 +136,254 @@ SoSimplifyAction::apply(const SoPathList & pathlist, SbBool obeysrules)
 {
   inherited::apply(pathlist, obeysrules);
 }
+
+/*!
+  Sets the simplification levels, as the fraction of the triangles to
+  keep in each level. The values are clamped to [0, 1], and sorted
+  from the most to the least detailed level. A level of 1.0 is the
+  shape at full resolution.
+
+  With more than one level, the simplified shapes will be
+  SoLevelOfDetail nodes with one child for each level.
+
+  \since Coin 4.0
+*/
+void
+SoSimplifyAction::setSimplificationLevels(const int numlevels, const float levels[])
+{
+  PRIVATE(this)->levels.truncate(0);
+  for (int i = 0; i < numlevels; i++) {
+    PRIVATE(this)->levels.append(SbClamp(levels[i], 0.0f, 1.0f));
+  }
+  float * ptr = const_cast<float *>(PRIVATE(this)->levels.getArrayPtr());
+  std::sort(ptr, ptr + numlevels, std::greater<float>());
+}
+
+/*!
+  Returns the number of simplification levels.
+
+  \since Coin 4.0
+*/
+int
+SoSimplifyAction::getNumSimplificationLevels(void) const
+{
+  return PRIVATE(this)->levels.getLength();
+}
+
+/*!
+  Returns the simplification levels, sorted from the most to the least
+  detailed level.
+
+  \since Coin 4.0
+*/
+const float *
+SoSimplifyAction::getSimplificationLevels(void) const
+{
+  return PRIVATE(this)->levels.getArrayPtr();
+}
+
+/*!
+  Sets the values for the SoLevelOfDetail::screenArea field of the
+  simplified shapes. There should be one value less than the number
+  of simplification levels.
+
+  If too few values are set, which is the default, each level is used
+  as long as the projected bounding box of the shape covers about a
+  pixel per triangle of the level.
+
+  \since Coin 4.0
+*/
+void
+SoSimplifyAction::setScreenAreas(const int numareas, const float areas[])
+{
+  PRIVATE(this)->screenareas.truncate(0);
+  for (int i = 0; i < numareas; i++) {
+    PRIVATE(this)->screenareas.append(areas[i]);
+  }
+}
+
+/*!
+  Returns the number of screen areas set with setScreenAreas().
+
+  \since Coin 4.0
+*/
+int
+SoSimplifyAction::getNumScreenAreas(void) const
+{
+  return PRIVATE(this)->screenareas.getLength();
+}
+
+/*!
+  Returns the screen areas set with setScreenAreas().
+
+  \since Coin 4.0
+*/
+const float *
+SoSimplifyAction::getScreenAreas(void) const
+{
+  return PRIVATE(this)->screenareas.getArrayPtr();
+}
+
+/*!
+  Sets the number of triangles a shape needs to have to be
+  simplified. Smaller shapes are left as they are.
+
+  \since Coin 4.0
+*/
+void
+SoSimplifyAction::setMinTriangles(const int mintriangles)
+{
+  PRIVATE(this)->mintriangles = mintriangles;
+}
+
+/*!
+  Returns the number of triangles a shape needs to have to be
+  simplified.
+
+  \since Coin 4.0
+*/
+int
+SoSimplifyAction::getMinTriangles(void) const
+{
+  return PRIVATE(this)->mintriangles;
+}
+
+// *************************************************************************
+
+SoSimplifyActionP::SoSimplifyActionP(void)
+  : mintriangles(100)
+{
+  this->levels.append(1.0f);
+  this->levels.append(0.3f);
+  this->levels.append(0.1f);
+}
+
+// finds the simplification levels to make for a shape from the
+// decimation elements
+void
+SoSimplifyActionP::getLevels(const SoSimplifyAction * action, SoState * state,
+                             SbList<float> & levels)
+{
+  levels.truncate(0);
+  const int numlevels = action->getNumSimplificationLevels();
+  const float * actionlevels = action->getSimplificationLevels();
+
+  switch (SoDecimationTypeElement::get(state)) {
+  case SoDecimationTypeElement::HIGHEST:
+    levels.append(1.0f);
+    break;
+  case SoDecimationTypeElement::LOWEST:
+    levels.append(numlevels > 0 ? actionlevels[numlevels-1] : 1.0f);
+    break;
+  case SoDecimationTypeElement::PERCENTAGE:
+    levels.append(SbClamp(SoDecimationPercentageElement::get(state), 0.0f, 1.0f));
+    break;
+  case SoDecimationTypeElement::AUTOMATIC:
+  default:
+    for (int i = 0; i < numlevels; i++) levels.append(actionlevels[i]);
+    if (numlevels == 0) levels.append(1.0f);
+    break;
+  }
+}
+
+// simplifies the mesh set in simplifier to each of the levels, and
+// returns an SoIndexedFaceSet, or an SoLevelOfDetail with one
+// SoIndexedFaceSet for each level
+SoNode *
+SoSimplifyActionP::createMesh(const SoSimplifyAction * action,
+                              SbQuadricSimplifier & simplifier,
+                              const SbList<float> & levels,
+                              const MeshFormat & format)
+{
+  const int numattributes = format.getNumAttributes();
+  const int numtriangles = simplifier.getNumTriangles();
+  SoLevelOfDetail * lod = NULL;
+  SoIndexedFaceSet * ifs = NULL;
+  if (levels.getLength() > 1) {
+    lod = new SoLevelOfDetail;
+    lod->ref();
+  }
+  SbList<int> levelsize;
+  SbList<SbVec3f> coords;
+  SbList<float> attributes;
+  SbList<int32_t> indices;
+  for (int i = 0; i < levels.getLength(); i++) {
+    const int target = SbMax(int(levels[i] * float(numtriangles) + 0.5f), 1);
+    levelsize.append(simplifier.simplify(target));
+    simplifier.getMesh(coords, attributes, indices);
+
+    const int numvertices = coords.getLength();
+    const float * attr = attributes.getArrayPtr();
+    SoVertexProperty * vp = new SoVertexProperty;
+    vp->vertex.setValues(0, numvertices, coords.getArrayPtr());
+
+    int offset = 0;
+    if (format.normals) {
+      vp->normal.setNum(numvertices);
+      SbVec3f * dst = vp->normal.startEditing();
+      for (int j = 0; j < numvertices; j++) {
+        const float * src = attr + j * numattributes + offset;
+        dst[j].setValue(src[0], src[1], src[2]);
+        (void) dst[j].normalize();
+      }
+      vp->normal.finishEditing();
+      vp->normalBinding = SoVertexProperty::PER_VERTEX_INDEXED;
+      offset += 3;
+    }
+    if (format.texcoords) {
+      vp->texCoord.setNum(numvertices);
+      SbVec2f * dst = vp->texCoord.startEditing();
+      for (int j = 0; j < numvertices; j++) {
+        const float * src = attr + j * numattributes + offset;
+        dst[j].setValue(src[0], src[1]);
+      }
+      vp->texCoord.finishEditing();
+      offset += 2;
+    }
+    if (format.colors) {
+      vp->orderedRGBA.setNum(numvertices);
+      uint32_t * dst = vp->orderedRGBA.startEditing();
+      for (int j = 0; j < numvertices; j++) {
+        const float * src = attr + j * numattributes + offset;
+        uint32_t col = 0;
+        for (int k = 0; k < 4; k++) {
+          col = (col << 8) | uint32_t(SbClamp(src[k] + 0.5f, 0.0f, 255.0f));
+        }
+        dst[j] = col;
+      }
+      vp->orderedRGBA.finishEditing();
+      vp->materialBinding = SoVertexProperty::PER_VERTEX_INDEXED;
+    }
+    // without per vertex colors, the shape keeps using the material
+    // in the state
+
+    ifs = new SoIndexedFaceSet;
+    ifs->vertexProperty = vp;
+    const int numindices = indices.getLength();
+    ifs->coordIndex.setNum(numindices / 3 * 4);
+    int32_t * ptr = ifs->coordIndex.startEditing();
+    for (int j = 0; j < numindices; j += 3) {
+      *ptr++ = indices[j];
+      *ptr++ = indices[j+1];
+      *ptr++ = indices[j+2];
+      *ptr++ = -1;
+    }
+    ifs->coordIndex.finishEditing();
+    if (lod) lod->addChild(ifs);
+  }
+  if (lod == NULL) return ifs;
+
+  const int numareas = levels.getLength() - 1;
+  lod->screenArea.setNum(numareas);
+  float * areas = lod->screenArea.startEditing();
+  for (int i = 0; i < numareas; i++) {
+    areas[i] = action->getNumScreenAreas() >= numareas ?
+      action->getScreenAreas()[i] :
+      float(levelsize[i]) * SOSIMPLIFY_PIXELS_PER_TRIANGLE;
+  }
+  lod->screenArea.finishEditing();
+  lod->unrefNoDelete();
+  return lod;
+}
+
+#undef PRIVATE
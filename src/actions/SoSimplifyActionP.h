@@ -0,0 +1,79 @@
+#ifndef COIN_SOSIMPLIFYACTIONP_H
+#define COIN_SOSIMPLIFYACTIONP_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* !COIN_INTERNAL */
+
+#include <Inventor/lists/SbList.h>
+
+class SbQuadricSimplifier;
+class SoNode;
+class SoSimplifyAction;
+class SoState;
+
+class SoSimplifyActionP {
+public:
+  SoSimplifyActionP(void);
+
+  SbList<float> levels;
+  SbList<float> screenareas;
+  int mintriangles;
+
+  // The vertex attributes of a mesh sent to SbQuadricSimplifier. They
+  // are stored after each other for each vertex, in this order: the
+  // normal (3 floats), the texture coordinate (2 floats) and the RGBA
+  // color (4 floats, from 0 to 255).
+  class MeshFormat {
+  public:
+    MeshFormat(void)
+      : normals(FALSE), texcoords(FALSE), colors(FALSE) { }
+    int getNumAttributes(void) const {
+      return (this->normals ? 3 : 0) + (this->texcoords ? 2 : 0) + (this->colors ? 4 : 0);
+    }
+    SbBool normals;
+    SbBool texcoords;
+    SbBool colors;
+  };
+
+  static void getLevels(const SoSimplifyAction * action, SoState * state,
+                        SbList<float> & levels);
+  static SoNode * createMesh(const SoSimplifyAction * action,
+                             SbQuadricSimplifier & simplifier,
+                             const SbList<float> & levels,
+                             const MeshFormat & format);
+}; // SoSimplifyActionP
+
+#endif // !COIN_SOSIMPLIFYACTIONP_H
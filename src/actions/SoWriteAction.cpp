@@ -116,6 +116,7 @@
 
 #include "coindefs.h"
 #include "actions/SoSubActionP.h"
+#include "io/SoSceneCache.h"
 #include "io/SoWriterefCounter.h"
 
 class SoWriteActionP {
@@ -234,6 +235,14 @@ SoWriteAction::beginTraversal(SoNode * node)
 #if COIN_DEBUG
   SoNodeSensor *sensor = NULL;
 #endif
+  if (!this->continuing && this->outobj->isSceneCacheFormat() &&
+      this->getWhatAppliedTo() == SoAction::NODE) {
+    // the scene cache writer makes its own write action passes over
+    // the parts of the scene
+    SoSceneCache::write(this->outobj, node);
+    return;
+  }
+
   if (this->continuing == FALSE) { // Run through both stages.
     // call SoWriterefCounter::instance() before traversing to set the
     // "current" pointer in SoWriterefCounter. This is needed to be
@@ -293,6 +302,11 @@ SoWriteAction::shouldCompactPathLists(void) const
 #include <Inventor/fields/SoSFTime.h>
 #include <Inventor/nodes/SoSeparator.h>
 #include <Inventor/nodes/SoText2.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoPointSet.h>
+#include <Inventor/nodes/SoTranslation.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/SbViewportRegion.h>
 #include <Inventor/C/tidbits.h>
 
 BOOST_AUTO_TEST_CASE(GlobalField)
@@ -359,4 +373,247 @@ BOOST_AUTO_TEST_CASE(GlobalField)
 
 }
 
+// check that files compressed by several threads, as a sequence of
+// independent blocks, read back the same as files compressed by one
+
+BOOST_AUTO_TEST_CASE(CompressionThreads)
+{
+  SoDB::init();
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  root->addChild(coords);
+  const int numpoints = 100000;
+  coords->point.setNum(numpoints);
+  SbVec3f * pts = coords->point.startEditing();
+  for (int i = 0; i < numpoints; i++) {
+    pts[i].setValue(float(i) * 0.37f, float(i % 997) * 1.5f, -float(i) / 7.0f);
+  }
+  coords->point.finishEditing();
+
+  const std::string tmpname = TemporaryFileName(".iv");
+  const char * filename = tmpname.c_str();
+  unsigned int nummethods;
+  const SbName * methods = SoOutput::getAvailableCompressionMethods(nummethods);
+  for (unsigned int m = 0; m < nummethods; m++) {
+    for (int numthreads = 1; numthreads <= 3; numthreads += 2) {
+      SoOutput out;
+      // the lowest level gives the smallest bzip2 blocks
+      BOOST_REQUIRE(out.setCompression(methods[m], 0.0f));
+      out.setNumCompressionThreads(numthreads);
+      out.setRoundTripFloats(TRUE);
+      BOOST_REQUIRE(out.openFile(filename));
+      SoWriteAction wa(&out);
+      wa.apply(root);
+      out.closeFile();
+
+      SoInput in;
+      BOOST_REQUIRE(in.openFile(filename));
+      SoSeparator * result = SoDB::readAll(&in);
+      BOOST_REQUIRE(result);
+      result->ref();
+      BOOST_REQUIRE(result->getNumChildren() == 1);
+      const SoMFVec3f & read =
+        static_cast<SoCoordinate3 *>(result->getChild(0))->point;
+      BOOST_CHECK_MESSAGE(read == coords->point,
+                          "points differ for compression method " <<
+                          methods[m].getString() << " with " <<
+                          numthreads << " threads");
+      result->unref();
+    }
+  }
+  (void)remove(filename);
+
+  root->unref();
+}
+
+// check that scene cache files read back the same scene, both from a
+// file and from memory, and that the bounding box is known before the
+// large subgraphs have been read
+
+static SbString
+write_scene_ascii(SoNode * root)
+{
+  SoOutput out;
+  out.setBuffer(malloc(1024), 1024, realloc);
+  SoWriteAction wa(&out);
+  wa.apply(root);
+  void * buffer;
+  size_t size;
+  out.getBuffer(buffer, size);
+  SbString result(static_cast<const char *>(buffer), 0, int(size) - 1);
+  free(buffer);
+  return result;
+}
+
+BOOST_AUTO_TEST_CASE(SceneCacheFormat)
+{
+  SoDB::init();
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  for (int k = 0; k < 3; k++) {
+    SoTranslation * translation = new SoTranslation;
+    translation->translation.setValue(float(k) * 10.0f, 0.0f, 0.0f);
+    root->addChild(translation);
+    SoSeparator * sep = new SoSeparator;
+    root->addChild(sep);
+    SoCoordinate3 * coords = new SoCoordinate3;
+    if (k == 1) coords->setName("SceneCacheCoords");
+    const int numpoints = 20000;
+    coords->point.setNum(numpoints);
+    SbVec3f * pts = coords->point.startEditing();
+    for (int i = 0; i < numpoints; i++) {
+      pts[i].setValue(float(i % 7), float(i % 11 + k), float(i % 13));
+    }
+    coords->point.finishEditing();
+    sep->addChild(coords);
+    sep->addChild(new SoPointSet);
+  }
+  // too small to get a chunk of its own
+  SoSeparator * small = new SoSeparator;
+  small->addChild(new SoPointSet);
+  root->addChild(small);
+
+  const SbString expected = write_scene_ascii(root);
+  SoGetBoundingBoxAction bboxaction((SbViewportRegion()));
+  bboxaction.apply(root);
+  const SbBox3f expectedbox = bboxaction.getBoundingBox();
+
+  // the chunks are read from the file itself, so it can't be a buffer
+  const std::string tmpname = TemporaryFileName(".iv");
+  const char * filename = tmpname.c_str();
+  {
+    SoOutput out;
+    out.setSceneCacheFormat(TRUE);
+    BOOST_REQUIRE(out.openFile(filename));
+    SoWriteAction wa(&out);
+    wa.apply(root);
+    out.closeFile();
+  }
+  root->unref();
+
+  SoInput in;
+  BOOST_REQUIRE(in.openFile(filename));
+  SoSeparator * result = SoDB::readAll(&in);
+  BOOST_REQUIRE(result);
+  result->ref();
+  BOOST_CHECK_MESSAGE(SoNode::getByName("SceneCacheCoords") == NULL,
+                      "large subgraph was read with the rest of the scene");
+  bboxaction.apply(result);
+  BOOST_CHECK_MESSAGE(bboxaction.getBoundingBox() == expectedbox,
+                      "bounding box differs before loading");
+  BOOST_CHECK_MESSAGE(SoNode::getByName("SceneCacheCoords") == NULL,
+                      "large subgraph was read for the bounding box");
+  BOOST_CHECK_MESSAGE(write_scene_ascii(result) == expected,
+                      "scene read from file differs");
+  BOOST_CHECK_MESSAGE(SoNode::getByName("SceneCacheCoords") != NULL,
+                      "large subgraph wasn't read when needed");
+  result->unref();
+  in.closeFile();
+
+  FILE * fp = fopen(filename, "rb");
+  BOOST_REQUIRE(fp);
+  (void)fseek(fp, 0, SEEK_END);
+  const long size = ftell(fp);
+  (void)fseek(fp, 0, SEEK_SET);
+  char * buffer = static_cast<char *>(malloc(size));
+  BOOST_REQUIRE(fread(buffer, 1, size, fp) == size_t(size));
+  (void)fclose(fp);
+  (void)remove(filename);
+
+  in.setBuffer(buffer, size);
+  result = SoDB::readAll(&in);
+  BOOST_REQUIRE(result);
+  result->ref();
+  BOOST_CHECK_MESSAGE(write_scene_ascii(result) == expected,
+                      "scene read from memory differs");
+  result->unref();
+  free(buffer);
+}
+
+// check that truncated and corrupt scene cache files are rejected,
+// both from a file and from memory
+
+static SoSeparator *
+read_scene_cache_file(const char * filename, const char * data, size_t size)
+{
+  FILE * fp = fopen(filename, "wb");
+  BOOST_REQUIRE(fp);
+  BOOST_REQUIRE(fwrite(data, 1, size, fp) == size);
+  (void)fclose(fp);
+  SoInput in;
+  BOOST_REQUIRE(in.openFile(filename));
+  return SoDB::readAll(&in);
+}
+
+BOOST_AUTO_TEST_CASE(SceneCacheTruncated)
+{
+  SoDB::init();
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoSeparator * sep = new SoSeparator;
+  root->addChild(sep);
+  SoCoordinate3 * coords = new SoCoordinate3;
+  const int numpoints = 20000;
+  coords->point.setNum(numpoints);
+  SbVec3f * pts = coords->point.startEditing();
+  for (int i = 0; i < numpoints; i++) {
+    pts[i].setValue(float(i % 7), float(i % 11), float(i % 13));
+  }
+  coords->point.finishEditing();
+  sep->addChild(coords);
+  sep->addChild(new SoPointSet);
+
+  SoOutput out;
+  out.setBuffer(malloc(1024), 1024, realloc);
+  out.setSceneCacheFormat(TRUE);
+  SoWriteAction wa(&out);
+  wa.apply(root);
+  root->unref();
+  void * buf;
+  size_t size;
+  out.getBuffer(buf, size);
+  char * buffer = static_cast<char *>(buf);
+
+  const std::string tmpname = TemporaryFileName(".iv");
+  const char * filename = tmpname.c_str();
+  SoSeparator * result = read_scene_cache_file(filename, buffer, size);
+  BOOST_REQUIRE(result);
+  result->ref();
+  result->unref();
+
+  // the header line, the fixed header, the chunk table, the skeleton,
+  // and the last byte of the only chunk
+  const size_t lengths[] = { 40, 80, 150, size / 2, size - 1 };
+  for (unsigned int i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+    BOOST_CHECK_MESSAGE(read_scene_cache_file(filename, buffer, lengths[i]) == NULL,
+                        "truncated file of " << lengths[i] << " bytes was read");
+    SoInput in;
+    in.setBuffer(buffer, lengths[i]);
+    BOOST_CHECK_MESSAGE(SoDB::readAll(&in) == NULL,
+                        "truncated buffer of " << lengths[i] << " bytes was read");
+  }
+
+  // the number of chunks and the skeleton size follow the 28 bytes
+  // long header line, the format version and the bounding box
+  char * corrupt = static_cast<char *>(malloc(size));
+  const size_t fields[] = { 32, 60 };
+  for (unsigned int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    memcpy(corrupt, buffer, size);
+    memset(corrupt + fields[i], 0xff, 4);
+    BOOST_CHECK_MESSAGE(read_scene_cache_file(filename, corrupt, size) == NULL,
+                        "corrupt field at " << fields[i] << " was read from file");
+    SoInput in;
+    in.setBuffer(corrupt, size);
+    BOOST_CHECK_MESSAGE(SoDB::readAll(&in) == NULL,
+                        "corrupt field at " << fields[i] << " was read from memory");
+  }
+  free(corrupt);
+  (void)remove(filename);
+  free(buffer);
+}
+
 #endif // COIN_TEST_SUITE
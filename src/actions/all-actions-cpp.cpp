@@ -45,12 +45,14 @@
 #include "SoGetBoundingBoxAction.cpp"
 #include "SoGetMatrixAction.cpp"
 #include "SoGetPrimitiveCountAction.cpp"
+#include "SoGlobalSimplifyAction.cpp"
 #include "SoHandleEventAction.cpp"
 #include "SoLineHighlightRenderAction.cpp"
 #include "SoPickAction.cpp"
 #include "SoRayPickAction.cpp"
 #include "SoReorganizeAction.cpp"
 #include "SoSearchAction.cpp"
+#include "SoShapeSimplifyAction.cpp"
 #include "SoSimplifyAction.cpp"
 #include "SoToVRMLAction.cpp"
 #include "SoWriteAction.cpp"
@@ -0,0 +1,254 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+/*!
+  \class SbBVH SbBVH.h
+  \brief The SbBVH class is a bounding volume hierarchy over a set of boxes.
+
+  \ingroup coin_base
+
+  The hierarchy is a binary tree, built top-down by splitting the
+  items at the median of their box centers along the longest axis. It
+  is built once from a static set of boxes, and is meant for fast
+  queries against large, non-changing geometry (ray picking,
+  triangle-triangle intersection testing).
+
+  Items are identified by their index in the array sent to build().
+
+  \internal
+*/
+
+// *************************************************************************
+
+#include "base/SbBVH.h"
+
+#include <algorithm>
+#include <cassert>
+
+// *************************************************************************
+
+namespace {
+
+// used to sort item indices on box center along an axis
+class sbbvh_center_compare {
+public:
+  sbbvh_center_compare(const SbVec3f * centers, const int axis)
+    : centers(centers), axis(axis) { }
+  bool operator()(const int a, const int b) const {
+    return this->centers[a][this->axis] < this->centers[b][this->axis];
+  }
+private:
+  const SbVec3f * centers;
+  int axis;
+};
+
+} // anonymous namespace
+
+// the maximum depth for a median split tree with 2^31 items is 31, so
+// this is plenty
+#define SBBVH_STACK_SIZE 64
+
+// *************************************************************************
+
+/*!
+  Constructor. Creates an empty hierarchy.
+*/
+SbBVH::SbBVH(void)
+{
+  this->emptybox.makeEmpty();
+}
+
+/*!
+  Destructor.
+*/
+SbBVH::~SbBVH()
+{
+}
+
+/*!
+  Removes all nodes and items from the hierarchy.
+*/
+void
+SbBVH::clear(void)
+{
+  this->nodes.truncate(0, TRUE);
+  this->items.truncate(0, TRUE);
+}
+
+/*!
+  Builds the hierarchy for \a numboxes boxes. Leaf nodes will contain
+  at most \a maxleafsize items. The \a boxes array is not needed after
+  this call.
+*/
+void
+SbBVH::build(const SbBox3f * boxes, const int numboxes, const int maxleafsize)
+{
+  assert(maxleafsize > 0);
+  this->clear();
+  if (numboxes == 0) return;
+
+  SbVec3f * centers = new SbVec3f[numboxes];
+  this->items.ensureCapacity(numboxes);
+  for (int i = 0; i < numboxes; i++) {
+    centers[i] = boxes[i].getCenter();
+    this->items.append(i);
+  }
+  // a binary tree with n leaves has 2n-1 nodes
+  this->nodes.ensureCapacity(2 * (numboxes / maxleafsize + 1));
+  this->nodes.append(Node());
+  this->buildNode(0, boxes, centers, 0, numboxes, maxleafsize);
+
+  delete[] centers;
+}
+
+void
+SbBVH::buildNode(const int nodeidx, const SbBox3f * boxes, const SbVec3f * centers,
+                 const int start, const int end, const int maxleafsize)
+{
+  int * itemptr = const_cast<int *>(this->items.getArrayPtr());
+
+  SbBox3f box;
+  SbBox3f centerbox;
+  for (int i = start; i < end; i++) {
+    box.extendBy(boxes[itemptr[i]]);
+    centerbox.extendBy(centers[itemptr[i]]);
+  }
+
+  this->nodes[nodeidx].box = box;
+  if (end - start <= maxleafsize) {
+    this->nodes[nodeidx].first = start;
+    this->nodes[nodeidx].count = end - start;
+    return;
+  }
+
+  float dx, dy, dz;
+  centerbox.getSize(dx, dy, dz);
+  int axis = 0;
+  if (dy > dx) axis = 1;
+  if (dz > SbMax(dx, dy)) axis = 2;
+
+  // always split at the median. This keeps the tree balanced even for
+  // degenerate input where all centers coincide.
+  const int mid = start + (end - start) / 2;
+  std::nth_element(itemptr + start, itemptr + mid, itemptr + end,
+                   sbbvh_center_compare(centers, axis));
+
+  // children are always stored next to each other
+  const int child = this->nodes.getLength();
+  this->nodes.append(Node());
+  this->nodes.append(Node());
+  this->nodes[nodeidx].first = child;
+  this->nodes[nodeidx].count = 0;
+
+  this->buildNode(child, boxes, centers, start, mid, maxleafsize);
+  this->buildNode(child + 1, boxes, centers, mid, end, maxleafsize);
+}
+
+/*!
+  Returns the bounding box of all items in the hierarchy.
+*/
+const SbBox3f &
+SbBVH::getBoundingBox(void) const
+{
+  if (this->nodes.getLength() == 0) return this->emptybox;
+  return this->nodes.getArrayPtr()[0].box;
+}
+
+/*!
+  Appends to \a destarray the indices of all items with a box that
+  intersects \a box.
+
+  Note that only the item boxes are tested, so the caller will need
+  to do exact testing on the returned items.
+*/
+void
+SbBVH::findItems(const SbBox3f & box, SbList<int> & destarray) const
+{
+  if (this->nodes.getLength() == 0 || box.isEmpty()) return;
+
+  const Node * nodeptr = this->nodes.getArrayPtr();
+  const int * itemptr = this->items.getArrayPtr();
+
+  int stack[SBBVH_STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node & node = nodeptr[stack[--top]];
+    if (!node.box.intersect(box)) continue;
+    if (node.count > 0) {
+      for (int i = 0; i < node.count; i++) {
+        destarray.append(itemptr[node.first + i]);
+      }
+    }
+    else {
+      assert(top + 2 <= SBBVH_STACK_SIZE);
+      stack[top++] = node.first + 1;
+      stack[top++] = node.first;
+    }
+  }
+}
+
+/*!
+  Generic depth-first traversal. \a boxcb is called for each node to
+  decide whether the node should be entered, and \a itemcb is called
+  for each item in the entered leaf nodes. If \a itemcb returns \c
+  FALSE, the traversal is stopped, and \c FALSE is returned.
+*/
+SbBool
+SbBVH::traverse(SbBVHBoxCB * boxcb, SbBVHItemCB * itemcb, void * closure) const
+{
+  if (this->nodes.getLength() == 0) return TRUE;
+
+  const Node * nodeptr = this->nodes.getArrayPtr();
+  const int * itemptr = this->items.getArrayPtr();
+
+  int stack[SBBVH_STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node & node = nodeptr[stack[--top]];
+    if (!boxcb(closure, node.box)) continue;
+    if (node.count > 0) {
+      for (int i = 0; i < node.count; i++) {
+        if (!itemcb(closure, itemptr[node.first + i])) return FALSE;
+      }
+    }
+    else {
+      assert(top + 2 <= SBBVH_STACK_SIZE);
+      stack[top++] = node.first + 1;
+      stack[top++] = node.first;
+    }
+  }
+  return TRUE;
+}
+
+#undef SBBVH_STACK_SIZE
@@ -0,0 +1,84 @@
+#ifndef COIN_SBBVH_H
+#define COIN_SBBVH_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* ! COIN_INTERNAL */
+
+// *************************************************************************
+
+#include <Inventor/SbBox3f.h>
+#include <Inventor/lists/SbList.h>
+
+// *************************************************************************
+
+class SbBVH {
+public:
+  SbBVH(void);
+  ~SbBVH();
+
+  typedef SbBool SbBVHBoxCB(void * closure, const SbBox3f & box);
+  typedef SbBool SbBVHItemCB(void * closure, const int item);
+
+  void build(const SbBox3f * boxes, const int numboxes, const int maxleafsize = 4);
+  void clear(void);
+
+  int getNumItems(void) const { return this->items.getLength(); }
+  int getNumNodes(void) const { return this->nodes.getLength(); }
+  const SbBox3f & getBoundingBox(void) const;
+
+  void findItems(const SbBox3f & box, SbList<int> & destarray) const;
+  SbBool traverse(SbBVHBoxCB * boxcb, SbBVHItemCB * itemcb, void * closure) const;
+
+private:
+  struct Node {
+    SbBox3f box;
+    // for leaf nodes: index of first entry in items, for internal
+    // nodes: index of the first child. The second child immediately
+    // follows the first child.
+    int first;
+    // number of items in a leaf node, 0 for internal nodes
+    int count;
+  };
+
+  void buildNode(const int nodeidx, const SbBox3f * boxes, const SbVec3f * centers,
+                 const int start, const int end, const int maxleafsize);
+
+  SbList<Node> nodes;
+  SbList<int> items;
+  SbBox3f emptybox;
+};
+
+#endif // !COIN_SBBVH_H
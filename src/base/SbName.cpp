@@ -376,3 +376,45 @@ SbName::empty(void) // static
   }
   return *emptyname;
 }
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SbString.h>
+#include <Inventor/lists/SbList.h>
+
+BOOST_AUTO_TEST_CASE(unique)
+{
+  // enough names to make the name table grow a few times
+  const int num = 20000;
+  SbList<const char *> addresses;
+  int i;
+  for (i = 0; i < num; i++) {
+    SbString str;
+    str.sprintf("name%d", i);
+    addresses.append(SbName(str).getString());
+  }
+  SbBool same = TRUE, different = TRUE;
+  for (i = 0; i < num; i++) {
+    SbString str;
+    str.sprintf("name%d", i);
+    const SbName name(str);
+    if (name.getString() != addresses[i] || str != addresses[i]) same = FALSE;
+    if (i > 0 && addresses[i] == addresses[i - 1]) different = FALSE;
+  }
+  BOOST_CHECK_MESSAGE(same, "Equal strings gave different names");
+  BOOST_CHECK_MESSAGE(different, "Different strings gave the same name");
+
+  // names longer than the chunks the strings are stored in
+  char * buf = new char[100001];
+  for (i = 0; i < 100000; i++) buf[i] = char('a' + i % 26);
+  buf[100000] = '\0';
+  const SbString longstr(buf);
+  delete[] buf;
+  const SbName longname(longstr);
+  BOOST_CHECK_MESSAGE(longname.getString() == SbName(longstr.getString()).getString() &&
+                      longstr == longname.getString(),
+                      "Long names are not handled correctly");
+  BOOST_CHECK_EQUAL(SbName("name0").getString(), addresses[0]);
+}
+
+#endif // COIN_TEST_SUITE
@@ -0,0 +1,709 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+/*!
+  \class SbQuadricSimplifier SbQuadricSimplifier.h
+  \brief The SbQuadricSimplifier class decimates triangle meshes with quadric error edge collapses.
+
+  \ingroup coin_base
+
+  This is the method from Garland and Heckbert, "Surface
+  Simplification Using Quadric Error Metrics", SIGGRAPH 97. Each point
+  gets the sum of the squared distance quadrics of the planes of the
+  triangles around it. Edges are collapsed in order of the error of
+  the collapsed point measured with the quadrics of both end points,
+  and the collapsed point is placed where this error is smallest.
+
+  Vertices with the same position share one point in the mesh
+  topology, but keep their own attributes (normals, texture
+  coordinates, colors) if these differ. Boundary edges, and seam edges where the
+  triangles on each side use different vertices, get extra quadrics
+  which keep them in place. Collapses which would fold triangles over
+  or make the mesh non-manifold are skipped.
+
+  The attributes of the vertices at the two ends of a collapsed edge
+  are interpolated to the position of the collapsed point. It is up
+  to the caller to normalize interpolated normals.
+
+  \internal
+*/
+
+// *************************************************************************
+
+#include "base/SbQuadricSimplifier.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+// *************************************************************************
+
+namespace {
+
+// sorts vertices on position, then on attributes
+class sbquadric_vertex_compare {
+public:
+  sbquadric_vertex_compare(const SbVec3f * coords, const float * attributes,
+                           const int numattributes)
+    : coords(coords), attributes(attributes), numattributes(numattributes) { }
+  bool operator()(const int a, const int b) const {
+    const SbVec3f & va = this->coords[a];
+    const SbVec3f & vb = this->coords[b];
+    if (va[0] != vb[0]) return va[0] < vb[0];
+    if (va[1] != vb[1]) return va[1] < vb[1];
+    if (va[2] != vb[2]) return va[2] < vb[2];
+    const int diff = this->compareAttributes(a, b);
+    if (diff != 0) return diff < 0;
+    return a < b;
+  }
+  int compareAttributes(const int a, const int b) const {
+    const float * aa = this->attributes + a * this->numattributes;
+    const float * ab = this->attributes + b * this->numattributes;
+    for (int i = 0; i < this->numattributes; i++) {
+      if (aa[i] != ab[i]) return aa[i] < ab[i] ? -1 : 1;
+    }
+    return 0;
+  }
+private:
+  const SbVec3f * coords;
+  const float * attributes;
+  int numattributes;
+};
+
+// a triangle edge, used to find boundary and seam edges
+struct sbquadric_edge {
+  int point0, point1; // point0 < point1
+  int corner; // the corner the edge starts at
+};
+
+class sbquadric_edge_compare {
+public:
+  bool operator()(const sbquadric_edge & a, const sbquadric_edge & b) const {
+    if (a.point0 != b.point0) return a.point0 < b.point0;
+    if (a.point1 != b.point1) return a.point1 < b.point1;
+    return a.corner < b.corner;
+  }
+};
+
+// keeps the cheapest collapse at the top of the heap
+class sbquadric_cost_compare {
+public:
+  template <class Candidate>
+  bool operator()(const Candidate & a, const Candidate & b) const {
+    return a.cost > b.cost;
+  }
+};
+
+} // anonymous namespace
+
+// weight of the quadrics keeping boundary and seam edges in place,
+// relative to the quadrics of the triangle planes. Seams get a much
+// lower weight, since meshes with flat shading have seams along all
+// edges.
+#define SBQUADRIC_BOUNDARY_WEIGHT 1000.0
+#define SBQUADRIC_SEAM_WEIGHT 0.1
+
+// collapses turning a triangle normal more than this (about 78
+// degrees) are not done
+#define SBQUADRIC_MIN_NORMAL_DOT 0.2f
+
+// *************************************************************************
+
+/*!
+  Constructor. Creates an empty mesh.
+*/
+SbQuadricSimplifier::SbQuadricSimplifier(void)
+  : numattributes(0),
+    numtriangles(0),
+    markstamp(0)
+{
+}
+
+/*!
+  Destructor.
+*/
+SbQuadricSimplifier::~SbQuadricSimplifier()
+{
+}
+
+/*!
+  Removes the mesh.
+*/
+void
+SbQuadricSimplifier::clear(void)
+{
+  this->numattributes = 0;
+  this->numtriangles = 0;
+  this->markstamp = 0;
+  this->vertexpoint.truncate(0, TRUE);
+  this->attributes.truncate(0, TRUE);
+  this->points.truncate(0, TRUE);
+  this->quadrics.truncate(0, TRUE);
+  this->stamps.truncate(0, TRUE);
+  this->marks.truncate(0, TRUE);
+  this->firstcorner.truncate(0, TRUE);
+  this->cornervertex.truncate(0, TRUE);
+  this->nextcorner.truncate(0, TRUE);
+  this->heap.truncate(0, TRUE);
+  this->remap.truncate(0);
+}
+
+/*!
+  Sets the mesh to simplify. \a numtriangles triangles are read from
+  \a indices, three vertex indices per triangle. Each vertex has a
+  position in \a coords, and \a numattributes floats in \a attributes
+  (which can be NULL if \a numattributes is 0).
+
+  Degenerate triangles and triangles with invalid indices are
+  removed. The arrays are copied, and are not needed after this call.
+*/
+void
+SbQuadricSimplifier::setMesh(const SbVec3f * coords, const float * attributes,
+                             const int numvertices, const int numattributes,
+                             const int32_t * indices, const int numtriangles)
+{
+  int i;
+  this->clear();
+  this->numattributes = numattributes;
+  if (numattributes > 0) {
+    this->attributes.ensureCapacity(numvertices * numattributes);
+    for (i = 0; i < numvertices * numattributes; i++) {
+      this->attributes.append(attributes[i]);
+    }
+  }
+
+  // weld vertices with the same position into points, and use one
+  // vertex for vertices which also have the same attributes
+  int * order = new int[numvertices];
+  int * vertexmap = new int[numvertices];
+  for (i = 0; i < numvertices; i++) order[i] = i;
+  const sbquadric_vertex_compare compare(coords, attributes, numattributes);
+  std::sort(order, order + numvertices, compare);
+
+  this->vertexpoint.ensureCapacity(numvertices);
+  for (i = 0; i < numvertices; i++) this->vertexpoint.append(-1);
+  for (i = 0; i < numvertices; i++) {
+    const int v = order[i];
+    if (i == 0 || coords[v] != coords[order[i-1]]) {
+      this->points.append(coords[v]);
+      vertexmap[v] = v;
+    }
+    else if (compare.compareAttributes(v, order[i-1]) != 0) {
+      vertexmap[v] = v;
+    }
+    else {
+      vertexmap[v] = vertexmap[order[i-1]];
+    }
+    this->vertexpoint[v] = this->points.getLength() - 1;
+  }
+  delete[] order;
+
+  const int numpoints = this->points.getLength();
+  Quadric zero;
+  memset(&zero, 0, sizeof(Quadric));
+  this->quadrics.ensureCapacity(numpoints);
+  this->stamps.ensureCapacity(numpoints);
+  this->marks.ensureCapacity(numpoints);
+  this->firstcorner.ensureCapacity(numpoints);
+  for (i = 0; i < numpoints; i++) {
+    this->quadrics.append(zero);
+    this->stamps.append(0);
+    this->marks.append(0);
+    this->firstcorner.append(-1);
+  }
+
+  // link the triangle corners to their points, and sum up the
+  // quadrics for the triangle planes
+  this->cornervertex.ensureCapacity(numtriangles * 3);
+  this->nextcorner.ensureCapacity(numtriangles * 3);
+  for (i = 0; i < numtriangles; i++) {
+    const int32_t * tri = indices + i * 3;
+    SbBool valid = TRUE;
+    int j;
+    for (j = 0; j < 3; j++) {
+      if (tri[j] < 0 || tri[j] >= numvertices) valid = FALSE;
+    }
+    int p[3] = { -1, -1, -1 };
+    if (valid) {
+      for (j = 0; j < 3; j++) p[j] = this->vertexpoint[tri[j]];
+      valid = p[0] != p[1] && p[0] != p[2] && p[1] != p[2];
+    }
+    for (j = 0; j < 3; j++) {
+      this->cornervertex.append(valid ? vertexmap[tri[j]] : -1);
+      this->nextcorner.append(-1);
+    }
+    if (!valid) continue;
+
+    this->numtriangles++;
+    for (j = 0; j < 3; j++) {
+      this->nextcorner[i*3+j] = this->firstcorner[p[j]];
+      this->firstcorner[p[j]] = i*3+j;
+    }
+    SbVec3f n = (this->points[p[1]] - this->points[p[0]]).cross(this->points[p[2]] - this->points[p[0]]);
+    const float len = n.normalize();
+    if (len > 0.0f) {
+      for (j = 0; j < 3; j++) {
+        this->addPlane(p[j], n, this->points[p[0]], len * 0.5);
+      }
+    }
+  }
+
+  delete[] vertexmap;
+
+  // find the boundary and seam edges, and add a collapse candidate
+  // for each edge
+  SbList<sbquadric_edge> edges(this->numtriangles * 3);
+  for (i = 0; i < numtriangles; i++) {
+    if (this->cornervertex[i*3] < 0) continue;
+    for (int j = 0; j < 3; j++) {
+      const int p0 = this->getCornerPoint(i*3+j);
+      const int p1 = this->getCornerPoint(i*3+(j+1)%3);
+      sbquadric_edge e;
+      e.point0 = SbMin(p0, p1);
+      e.point1 = SbMax(p0, p1);
+      e.corner = i*3+j;
+      edges.append(e);
+    }
+  }
+  sbquadric_edge * edgeptr = const_cast<sbquadric_edge *>(edges.getArrayPtr());
+  const int numedges = edges.getLength();
+  std::sort(edgeptr, edgeptr + numedges, sbquadric_edge_compare());
+
+  int start = 0;
+  while (start < numedges) {
+    int end = start + 1;
+    while (end < numedges &&
+           edgeptr[end].point0 == edgeptr[start].point0 &&
+           edgeptr[end].point1 == edgeptr[start].point1) end++;
+
+    const SbBool boundary = (end - start) != 2;
+    SbBool border = boundary;
+    if (!border) {
+      // a seam if the two triangles use different vertices at either end
+      for (int j = 0; j < 2 && !border; j++) {
+        const int point = j == 0 ? edgeptr[start].point0 : edgeptr[start].point1;
+        int v[2];
+        for (int k = 0; k < 2; k++) {
+          const int corner = edgeptr[start+k].corner;
+          const int other = corner - corner % 3 + (corner % 3 + 1) % 3;
+          v[k] = this->getCornerPoint(corner) == point ?
+            this->cornervertex[corner] : this->cornervertex[other];
+        }
+        border = v[0] != v[1];
+      }
+    }
+    if (border) {
+      // add a plane through the edge, perpendicular to the triangle
+      for (int j = start; j < end; j++) {
+        const int corner = edgeptr[j].corner;
+        const int tri = corner - corner % 3;
+        const SbVec3f & p0 = this->points[this->getCornerPoint(tri)];
+        const SbVec3f & p1 = this->points[this->getCornerPoint(tri+1)];
+        const SbVec3f & p2 = this->points[this->getCornerPoint(tri+2)];
+        SbVec3f n = (p1 - p0).cross(p2 - p0);
+        (void) n.normalize();
+        const SbVec3f dir =
+          this->points[edgeptr[j].point1] - this->points[edgeptr[j].point0];
+        SbVec3f m = dir.cross(n);
+        if (m.normalize() > 0.0f) {
+          const double weight = dir.sqrLength() *
+            (boundary ? SBQUADRIC_BOUNDARY_WEIGHT : SBQUADRIC_SEAM_WEIGHT);
+          this->addPlane(edgeptr[j].point0, m, this->points[edgeptr[j].point0], weight);
+          this->addPlane(edgeptr[j].point1, m, this->points[edgeptr[j].point0], weight);
+        }
+      }
+    }
+    this->heap.append(this->makeCandidate(edgeptr[start].point0, edgeptr[start].point1));
+    start = end;
+  }
+  Candidate * heapptr = const_cast<Candidate *>(this->heap.getArrayPtr());
+  std::make_heap(heapptr, heapptr + this->heap.getLength(), sbquadric_cost_compare());
+}
+
+/*!
+  Collapses edges until the mesh has no more than \a targettriangles
+  triangles, or until no more edges can be collapsed. Returns the
+  number of triangles left.
+
+  This can be called several times with a decreasing number of
+  triangles, to get a series of simplified meshes.
+*/
+int
+SbQuadricSimplifier::simplify(const int targettriangles)
+{
+  while (this->numtriangles > targettriangles && this->heap.getLength() > 0) {
+    Candidate * heapptr = const_cast<Candidate *>(this->heap.getArrayPtr());
+    const int len = this->heap.getLength();
+    std::pop_heap(heapptr, heapptr + len, sbquadric_cost_compare());
+    const Candidate candidate = heapptr[len-1];
+    this->heap.truncate(len-1);
+
+    // one of the points has changed since the candidate was made, and
+    // a new candidate has been pushed for the edge if it still exists
+    if (candidate.stamp0 != this->stamps[candidate.point0] ||
+        candidate.stamp1 != this->stamps[candidate.point1]) continue;
+
+    (void) this->collapse(candidate);
+  }
+  return this->numtriangles;
+}
+
+/*!
+  Returns the current mesh in \a coords, \a attributes and \a
+  indices. The vertices are numbered in the order they are first used
+  by the triangles, and vertices not used by any triangle are left
+  out.
+*/
+void
+SbQuadricSimplifier::getMesh(SbList<SbVec3f> & coords, SbList<float> & attributes,
+                             SbList<int32_t> & indices) const
+{
+  coords.truncate(0);
+  attributes.truncate(0);
+  indices.truncate(0);
+
+  const int numvertices = this->vertexpoint.getLength();
+  int * newindex = new int[numvertices];
+  for (int i = 0; i < numvertices; i++) newindex[i] = -1;
+
+  indices.ensureCapacity(this->numtriangles * 3);
+  const int numcorners = this->cornervertex.getLength();
+  const int * cornerptr = this->cornervertex.getArrayPtr();
+  const float * attrptr = this->attributes.getArrayPtr();
+  for (int i = 0; i < numcorners; i++) {
+    const int v = cornerptr[i];
+    if (v < 0) continue;
+    if (newindex[v] < 0) {
+      newindex[v] = coords.getLength();
+      coords.append(this->points[this->vertexpoint[v]]);
+      for (int j = 0; j < this->numattributes; j++) {
+        attributes.append(attrptr[v * this->numattributes + j]);
+      }
+    }
+    indices.append(newindex[v]);
+  }
+  delete[] newindex;
+}
+
+// *************************************************************************
+
+double
+SbQuadricSimplifier::evaluate(const Quadric & q, const SbVec3f & v)
+{
+  const double x = v[0], y = v[1], z = v[2];
+  return
+    q.a2*x*x + 2.0*q.ab*x*y + 2.0*q.ac*x*z + 2.0*q.ad*x +
+    q.b2*y*y + 2.0*q.bc*y*z + 2.0*q.bd*y +
+    q.c2*z*z + 2.0*q.cd*z +
+    q.d2;
+}
+
+void
+SbQuadricSimplifier::add(Quadric & q, const Quadric & q2)
+{
+  q.a2 += q2.a2; q.ab += q2.ab; q.ac += q2.ac; q.ad += q2.ad;
+  q.b2 += q2.b2; q.bc += q2.bc; q.bd += q2.bd;
+  q.c2 += q2.c2; q.cd += q2.cd;
+  q.d2 += q2.d2;
+}
+
+// adds the squared distance to the plane with unit normal \a normal
+// through \a p to the quadric of \a point
+void
+SbQuadricSimplifier::addPlane(const int point, const SbVec3f & normal,
+                              const SbVec3f & p, const double weight)
+{
+  const double a = normal[0], b = normal[1], c = normal[2];
+  const double d = -(a * p[0] + b * p[1] + c * p[2]);
+  Quadric & q = this->quadrics[point];
+  q.a2 += weight*a*a; q.ab += weight*a*b; q.ac += weight*a*c; q.ad += weight*a*d;
+  q.b2 += weight*b*b; q.bc += weight*b*c; q.bd += weight*b*d;
+  q.c2 += weight*c*c; q.cd += weight*c*d;
+  q.d2 += weight*d*d;
+}
+
+int
+SbQuadricSimplifier::getCornerPoint(const int corner) const
+{
+  return this->vertexpoint[this->cornervertex[corner]];
+}
+
+SbBool
+SbQuadricSimplifier::hasPoint(const int triangle, const int point) const
+{
+  return
+    this->getCornerPoint(triangle*3) == point ||
+    this->getCornerPoint(triangle*3+1) == point ||
+    this->getCornerPoint(triangle*3+2) == point;
+}
+
+// removes the corners of removed triangles from the list of a point
+void
+SbQuadricSimplifier::compactCorners(const int point)
+{
+  int last = -1;
+  int corner = this->firstcorner[point];
+  this->firstcorner[point] = -1;
+  while (corner >= 0) {
+    const int next = this->nextcorner[corner];
+    if (this->cornervertex[corner] >= 0) {
+      if (last < 0) this->firstcorner[point] = corner;
+      else this->nextcorner[last] = corner;
+      last = corner;
+    }
+    corner = next;
+  }
+  if (last >= 0) this->nextcorner[last] = -1;
+}
+
+void
+SbQuadricSimplifier::nextMark(void)
+{
+  // two mark values are used per round
+  this->markstamp += 2;
+  if (this->markstamp == 0) {
+    for (int i = 0; i < this->marks.getLength(); i++) this->marks[i] = 0;
+    this->markstamp = 2;
+  }
+}
+
+// finds where to put the collapsed point for the edge between point0
+// and point1. Returns the error at this position.
+double
+SbQuadricSimplifier::findPosition(const int point0, const int point1, SbVec3f & pos) const
+{
+  Quadric q = this->quadrics[point0];
+  SbQuadricSimplifier::add(q, this->quadrics[point1]);
+
+  const SbVec3f & p0 = this->points[point0];
+  const SbVec3f & p1 = this->points[point1];
+  const SbVec3f mid = (p0 + p1) * 0.5f;
+
+  // the best position is where the gradient of the quadric is zero
+  const double i00 = q.b2*q.c2 - q.bc*q.bc;
+  const double i01 = q.ac*q.bc - q.ab*q.c2;
+  const double i02 = q.ab*q.bc - q.ac*q.b2;
+  const double det = q.a2*i00 + q.ab*i01 + q.ac*i02;
+  const double trace = q.a2 + q.b2 + q.c2;
+  if (fabs(det) > 1.0e-9 * trace * trace * trace) {
+    const double i11 = q.a2*q.c2 - q.ac*q.ac;
+    const double i12 = q.ab*q.ac - q.a2*q.bc;
+    const double i22 = q.a2*q.b2 - q.ab*q.ab;
+    const double r0 = -q.ad, r1 = -q.bd, r2 = -q.cd;
+    pos.setValue(float((i00*r0 + i01*r1 + i02*r2) / det),
+                 float((i01*r0 + i11*r1 + i12*r2) / det),
+                 float((i02*r0 + i12*r1 + i22*r2) / det));
+    // nearly singular quadrics can put the point far away
+    if ((pos - mid).sqrLength() <= (p1 - p0).sqrLength()) {
+      return SbQuadricSimplifier::evaluate(q, pos);
+    }
+  }
+
+  pos = mid;
+  double error = SbQuadricSimplifier::evaluate(q, mid);
+  const double e0 = SbQuadricSimplifier::evaluate(q, p0);
+  const double e1 = SbQuadricSimplifier::evaluate(q, p1);
+  if (e0 < error) { pos = p0; error = e0; }
+  if (e1 < error) { pos = p1; error = e1; }
+  return error;
+}
+
+SbQuadricSimplifier::Candidate
+SbQuadricSimplifier::makeCandidate(const int point0, const int point1) const
+{
+  SbVec3f pos;
+  Candidate candidate;
+  candidate.cost = float(SbMax(this->findPosition(point0, point1, pos), 0.0));
+  candidate.point0 = point0;
+  candidate.point1 = point1;
+  candidate.stamp0 = this->stamps[point0];
+  candidate.stamp1 = this->stamps[point1];
+  return candidate;
+}
+
+void
+SbQuadricSimplifier::pushCandidate(const int point0, const int point1)
+{
+  this->heap.append(this->makeCandidate(point0, point1));
+  Candidate * heapptr = const_cast<Candidate *>(this->heap.getArrayPtr());
+  std::push_heap(heapptr, heapptr + this->heap.getLength(), sbquadric_cost_compare());
+}
+
+// collapses point1 of the candidate into point0. Returns FALSE if the
+// collapse would damage the mesh.
+SbBool
+SbQuadricSimplifier::collapse(const Candidate & candidate)
+{
+  const int a = candidate.point0;
+  const int b = candidate.point1;
+  SbVec3f pos;
+  (void) this->findPosition(a, b, pos);
+  int corner;
+
+  // the edge must be the only connection between the one-rings of
+  // the points, else the collapse makes the mesh non-manifold
+  this->nextMark();
+  const unsigned int neighbor = this->markstamp;
+  const unsigned int counted = this->markstamp + 1;
+  for (corner = this->firstcorner[a]; corner >= 0; corner = this->nextcorner[corner]) {
+    if (this->cornervertex[corner] < 0) continue;
+    const int tri = corner / 3;
+    for (int j = 0; j < 3; j++) {
+      this->marks[this->getCornerPoint(tri*3+j)] = neighbor;
+    }
+  }
+  int shared = 0;
+  int common = 0;
+  for (corner = this->firstcorner[b]; corner >= 0; corner = this->nextcorner[corner]) {
+    if (this->cornervertex[corner] < 0) continue;
+    const int tri = corner / 3;
+    if (this->hasPoint(tri, a)) shared++;
+    for (int j = 0; j < 3; j++) {
+      const int p = this->getCornerPoint(tri*3+j);
+      if (p != a && p != b && this->marks[p] == neighbor) {
+        this->marks[p] = counted;
+        common++;
+      }
+    }
+  }
+  if (shared == 0 || common > shared) return FALSE;
+
+  // the triangles left must not be folded over
+  for (int i = 0; i < 2; i++) {
+    const int point = i == 0 ? a : b;
+    const SbVec3f & oldpos = this->points[point];
+    for (corner = this->firstcorner[point]; corner >= 0; corner = this->nextcorner[corner]) {
+      if (this->cornervertex[corner] < 0) continue;
+      const int tri = corner / 3;
+      if (this->hasPoint(tri, i == 0 ? b : a)) continue;
+      const SbVec3f & p1 = this->points[this->getCornerPoint(tri*3 + (corner+1) % 3)];
+      const SbVec3f & p2 = this->points[this->getCornerPoint(tri*3 + (corner+2) % 3)];
+      const SbVec3f oldn = (p1 - oldpos).cross(p2 - oldpos);
+      const SbVec3f newn = (p1 - pos).cross(p2 - pos);
+      const float oldlen = oldn.length();
+      const float newlen = newn.length();
+      if (oldlen > 0.0f &&
+          (newlen == 0.0f ||
+           oldn.dot(newn) < SBQUADRIC_MIN_NORMAL_DOT * oldlen * newlen)) {
+        return FALSE;
+      }
+    }
+  }
+
+  // remove the triangles along the edge, and interpolate the
+  // attributes of the vertices of point0 towards the vertices of
+  // point1 they replace
+  const SbVec3f edge = this->points[b] - this->points[a];
+  const float edgelen2 = edge.sqrLength();
+  float t = 0.5f;
+  if (edgelen2 > 0.0f) {
+    t = SbClamp((pos - this->points[a]).dot(edge) / edgelen2, 0.0f, 1.0f);
+  }
+  this->remap.truncate(0);
+  for (corner = this->firstcorner[b]; corner >= 0; corner = this->nextcorner[corner]) {
+    if (this->cornervertex[corner] < 0) continue;
+    const int tri = corner / 3;
+    int acorner = -1;
+    for (int j = 0; j < 3; j++) {
+      if (this->getCornerPoint(tri*3+j) == a) acorner = tri*3+j;
+    }
+    if (acorner < 0) continue;
+
+    const int vb = this->cornervertex[corner];
+    const int va = this->cornervertex[acorner];
+    SbBool mapped = FALSE;
+    SbBool interpolated = FALSE;
+    for (int j = 0; j < this->remap.getLength(); j += 2) {
+      if (this->remap[j] == vb) mapped = TRUE;
+      if (this->remap[j+1] == va) interpolated = TRUE;
+    }
+    if (!mapped) {
+      this->remap.append(vb);
+      this->remap.append(va);
+      if (!interpolated) {
+        float * attr = const_cast<float *>(this->attributes.getArrayPtr());
+        float * dst = attr + va * this->numattributes;
+        const float * src = attr + vb * this->numattributes;
+        for (int j = 0; j < this->numattributes; j++) {
+          dst[j] += (src[j] - dst[j]) * t;
+        }
+      }
+    }
+    this->cornervertex[tri*3] = -1;
+    this->cornervertex[tri*3+1] = -1;
+    this->cornervertex[tri*3+2] = -1;
+    this->numtriangles--;
+  }
+
+  // move the remaining corners of point1 over to point0
+  for (corner = this->firstcorner[b]; corner >= 0; corner = this->nextcorner[corner]) {
+    const int vb = this->cornervertex[corner];
+    if (vb < 0) continue;
+    SbBool mapped = FALSE;
+    for (int j = 0; j < this->remap.getLength() && !mapped; j += 2) {
+      if (this->remap[j] == vb) {
+        this->cornervertex[corner] = this->remap[j+1];
+        mapped = TRUE;
+      }
+    }
+    if (!mapped) this->vertexpoint[vb] = a;
+  }
+  this->compactCorners(b);
+  corner = this->firstcorner[b];
+  if (corner >= 0) {
+    while (this->nextcorner[corner] >= 0) corner = this->nextcorner[corner];
+    this->nextcorner[corner] = this->firstcorner[a];
+    this->firstcorner[a] = this->firstcorner[b];
+    this->firstcorner[b] = -1;
+  }
+  this->compactCorners(a);
+
+  this->points[a] = pos;
+  SbQuadricSimplifier::add(this->quadrics[a], this->quadrics[b]);
+  this->stamps[a]++;
+  this->stamps[b]++;
+
+  // new collapse candidates for the edges around the collapsed point
+  this->nextMark();
+  for (corner = this->firstcorner[a]; corner >= 0; corner = this->nextcorner[corner]) {
+    const int tri = corner / 3;
+    for (int j = 0; j < 3; j++) {
+      const int p = this->getCornerPoint(tri*3+j);
+      if (p != a && this->marks[p] != this->markstamp) {
+        this->marks[p] = this->markstamp;
+        this->pushCandidate(a, p);
+      }
+    }
+  }
+  return TRUE;
+}
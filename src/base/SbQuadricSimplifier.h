@@ -0,0 +1,118 @@
+#ifndef COIN_SBQUADRICSIMPLIFIER_H
+#define COIN_SBQUADRICSIMPLIFIER_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* ! COIN_INTERNAL */
+
+// *************************************************************************
+
+#include <Inventor/SbVec3f.h>
+#include <Inventor/lists/SbList.h>
+
+// *************************************************************************
+
+class SbQuadricSimplifier {
+public:
+  SbQuadricSimplifier(void);
+  ~SbQuadricSimplifier();
+
+  void setMesh(const SbVec3f * coords, const float * attributes,
+               const int numvertices, const int numattributes,
+               const int32_t * indices, const int numtriangles);
+  void clear(void);
+
+  int simplify(const int targettriangles);
+  int getNumTriangles(void) const { return this->numtriangles; }
+
+  void getMesh(SbList<SbVec3f> & coords, SbList<float> & attributes,
+               SbList<int32_t> & indices) const;
+
+private:
+  // the coefficients of the symmetric 4x4 error quadric
+  struct Quadric {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+  };
+  // an edge collapse waiting in the heap. The point stamps are used
+  // to detect that the candidate has become stale.
+  struct Candidate {
+    float cost;
+    int point0, point1;
+    unsigned int stamp0, stamp1;
+  };
+
+  static double evaluate(const Quadric & q, const SbVec3f & v);
+  static void add(Quadric & q, const Quadric & q2);
+
+  void addPlane(const int point, const SbVec3f & normal, const SbVec3f & p,
+                const double weight);
+  double findPosition(const int point0, const int point1, SbVec3f & pos) const;
+  Candidate makeCandidate(const int point0, const int point1) const;
+  void pushCandidate(const int point0, const int point1);
+  SbBool collapse(const Candidate & candidate);
+  SbBool hasPoint(const int triangle, const int point) const;
+  int getCornerPoint(const int corner) const;
+  void compactCorners(const int point);
+  void nextMark(void);
+
+  int numattributes;
+  int numtriangles;
+
+  // per vertex (wedge). Vertices with the same position share a point
+  // but keep their own attributes.
+  SbList<int> vertexpoint;
+  SbList<float> attributes;
+
+  // per point
+  SbList<SbVec3f> points;
+  SbList<Quadric> quadrics;
+  SbList<unsigned int> stamps;
+  SbList<unsigned int> marks;
+  SbList<int> firstcorner;
+
+  // per triangle corner. The corners using a point are linked
+  // together, starting at firstcorner for the point.
+  SbList<int> cornervertex;
+  SbList<int> nextcorner;
+
+  SbList<Candidate> heap;
+  unsigned int markstamp;
+  // pairs of vertices, used to map the vertices of a removed point
+  // to the vertices of the point it is collapsed into
+  SbList<int> remap;
+};
+
+#endif // !COIN_SBQUADRICSIMPLIFIER_H
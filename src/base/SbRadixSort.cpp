@@ -0,0 +1,190 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+/*!
+  \class SbRadixSort SbRadixSort.h
+  \brief The SbRadixSort class sorts float keys with a stable radix sort.
+
+  \ingroup coin_base
+
+  The keys are not moved. sort() returns the order of the keys as a
+  list of indices into the key array, so that objects stored in other
+  arrays can be looked up in sorted order instead of being moved
+  around while sorting. Keys which are equal keep the order they have
+  in the key array, which gives the same result every time the same
+  keys are sorted.
+
+  The floats are turned into unsigned integers which sort in the same
+  order, and sorted with three passes of 11 bits each. Passes where
+  all keys have the same digit are skipped. Short arrays are sorted
+  with an insertion sort instead.
+
+  The buffers are kept between calls, so that sorting keys every frame
+  doesn't allocate memory.
+
+  \internal
+*/
+
+// *************************************************************************
+
+#include "base/SbRadixSort.h"
+
+#include <cstring>
+
+// *************************************************************************
+
+// arrays shorter than this are sorted with an insertion sort
+#define SBRADIXSORT_MIN_KEYS 64
+#define SBRADIXSORT_BITS 11
+#define SBRADIXSORT_BUCKETS (1 << SBRADIXSORT_BITS)
+
+// *************************************************************************
+
+/*!
+  Constructor.
+*/
+SbRadixSort::SbRadixSort(void)
+  : capacity(0),
+    order(NULL),
+    keys(NULL),
+    orderbuffer(NULL),
+    keybuffer(NULL)
+{
+}
+
+/*!
+  Destructor.
+*/
+SbRadixSort::~SbRadixSort()
+{
+  delete[] this->order;
+  delete[] this->keys;
+  delete[] this->orderbuffer;
+  delete[] this->keybuffer;
+}
+
+void
+SbRadixSort::reserve(const int numkeys)
+{
+  if (numkeys <= this->capacity) return;
+  delete[] this->order;
+  delete[] this->keys;
+  delete[] this->orderbuffer;
+  delete[] this->keybuffer;
+  this->capacity = numkeys;
+  this->order = new int32_t[numkeys];
+  this->keys = new uint32_t[numkeys];
+  this->orderbuffer = new int32_t[numkeys];
+  this->keybuffer = new uint32_t[numkeys];
+}
+
+/*!
+  Sorts the \a numkeys floats in \a keys, in increasing order, or in
+  decreasing order if \a descending is \c TRUE. Returns the indices of
+  the keys in sorted order. The returned array is valid until the next
+  call to sort().
+*/
+const int32_t *
+SbRadixSort::sort(const float * keys, const int numkeys,
+                  const SbBool descending)
+{
+  this->reserve(numkeys);
+  if (numkeys == 0) return this->order;
+
+  // flip the sign bit of positive floats, and all bits of negative
+  // floats, to get unsigned integers in the same order. For
+  // descending order, all bits are flipped once more.
+  const uint32_t invert = descending ? 0xffffffff : 0;
+  int i;
+  for (i = 0; i < numkeys; i++) {
+    uint32_t bits;
+    (void)memcpy(&bits, &keys[i], sizeof(uint32_t));
+    const uint32_t mask = (0 - (bits >> 31)) | 0x80000000;
+    this->keys[i] = (bits ^ mask) ^ invert;
+    this->order[i] = i;
+  }
+
+  if (numkeys < SBRADIXSORT_MIN_KEYS) {
+    for (i = 1; i < numkeys; i++) {
+      const uint32_t key = this->keys[i];
+      int j = i;
+      while (j > 0 && this->keys[j - 1] > key) {
+        this->keys[j] = this->keys[j - 1];
+        this->order[j] = this->order[j - 1];
+        j--;
+      }
+      this->keys[j] = key;
+      this->order[j] = i;
+    }
+    return this->order;
+  }
+
+  uint32_t histograms[3][SBRADIXSORT_BUCKETS];
+  (void)memset(histograms, 0, sizeof(histograms));
+  for (i = 0; i < numkeys; i++) {
+    const uint32_t key = this->keys[i];
+    histograms[0][key & (SBRADIXSORT_BUCKETS - 1)]++;
+    histograms[1][(key >> SBRADIXSORT_BITS) & (SBRADIXSORT_BUCKETS - 1)]++;
+    histograms[2][key >> (2 * SBRADIXSORT_BITS)]++;
+  }
+
+  for (int pass = 0; pass < 3; pass++) {
+    const int shift = pass * SBRADIXSORT_BITS;
+    uint32_t * histogram = histograms[pass];
+    const uint32_t firstdigit = (this->keys[0] >> shift) & (SBRADIXSORT_BUCKETS - 1);
+    if (histogram[firstdigit] == uint32_t(numkeys)) continue;
+
+    uint32_t offset = 0;
+    for (i = 0; i < SBRADIXSORT_BUCKETS; i++) {
+      const uint32_t count = histogram[i];
+      histogram[i] = offset;
+      offset += count;
+    }
+    for (i = 0; i < numkeys; i++) {
+      const uint32_t key = this->keys[i];
+      const uint32_t pos = histogram[(key >> shift) & (SBRADIXSORT_BUCKETS - 1)]++;
+      this->keybuffer[pos] = key;
+      this->orderbuffer[pos] = this->order[i];
+    }
+    uint32_t * tmpkeys = this->keys;
+    this->keys = this->keybuffer;
+    this->keybuffer = tmpkeys;
+    int32_t * tmporder = this->order;
+    this->order = this->orderbuffer;
+    this->orderbuffer = tmporder;
+  }
+  return this->order;
+}
+
+#undef SBRADIXSORT_MIN_KEYS
+#undef SBRADIXSORT_BITS
+#undef SBRADIXSORT_BUCKETS
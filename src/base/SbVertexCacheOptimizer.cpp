@@ -0,0 +1,499 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+/*!
+  \class SbVertexCacheOptimizer SbVertexCacheOptimizer.h
+  \brief The SbVertexCacheOptimizer class reorders triangle meshes for the post-transform vertex cache.
+
+  \ingroup coin_base
+
+  optimizeTriangles() reorders the triangles of an indexed mesh with
+  the method from Tom Forsyth, "Linear-Speed Vertex Cache
+  Optimisation", 2006. Each vertex gets a score from its position in
+  a simulated LRU cache and from the number of triangles still using
+  it, and the triangle with the highest sum of vertex scores is
+  output next.
+
+  optimizeOverdraw() splits the reordered triangles into clusters
+  where this doesn't cost too many extra cache misses, and sorts the
+  clusters so that the ones facing out from the center of the mesh
+  are drawn first. This is the method from Sander, Nehab and
+  Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+  Overdraw", SIGGRAPH 2007.
+
+  optimizeVertexFetch() renumbers the vertices in the order they are
+  first used, so that vertex data is read sequentially.
+
+  getCacheStatistics() counts the misses in a simulated FIFO cache,
+  which gives the average cache miss ratio (ACMR, misses per
+  triangle) and the average transformed vertex ratio (ATVR, misses
+  per vertex, 1.0 being the best possible).
+
+  \internal
+*/
+
+// *************************************************************************
+
+#include "base/SbVertexCacheOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include <Inventor/SbBasic.h>
+#include <Inventor/lists/SbList.h>
+
+// *************************************************************************
+
+// the size of the LRU cache used for the scores. Forsyth found that
+// this works well for any real cache size.
+#define SBVCACHE_LRU_SIZE 32
+#define SBVCACHE_DECAY_POWER 1.5f
+#define SBVCACHE_LAST_TRIANGLE_SCORE 0.75f
+#define SBVCACHE_VALENCE_BOOST_SCALE 2.0f
+#define SBVCACHE_VALENCE_BOOST_POWER 0.5f
+#define SBVCACHE_MAX_VALENCE 32
+
+namespace {
+
+class sbvcache_scoretable {
+public:
+  sbvcache_scoretable(void) {
+    int i;
+    for (i = 0; i < SBVCACHE_LRU_SIZE; i++) {
+      if (i < 3) {
+        // the vertices of the last triangle get a fixed score, so
+        // that the order within the triangle doesn't matter
+        this->position[i] = SBVCACHE_LAST_TRIANGLE_SCORE;
+      }
+      else {
+        const float scale = 1.0f / float(SBVCACHE_LRU_SIZE - 3);
+        this->position[i] =
+          std::pow(1.0f - float(i - 3) * scale, SBVCACHE_DECAY_POWER);
+      }
+    }
+    this->valence[0] = 0.0f;
+    for (i = 1; i <= SBVCACHE_MAX_VALENCE; i++) {
+      this->valence[i] = SBVCACHE_VALENCE_BOOST_SCALE *
+        std::pow(float(i), -SBVCACHE_VALENCE_BOOST_POWER);
+    }
+  }
+
+  // vertices with few triangles left get a boost, to get rid of
+  // lone triangles early
+  float get(const int cacheposition, const int numtriangles) const {
+    if (numtriangles == 0) return -1.0f;
+    float score = cacheposition < 0 ? 0.0f : this->position[cacheposition];
+    if (numtriangles <= SBVCACHE_MAX_VALENCE) {
+      score += this->valence[numtriangles];
+    }
+    else {
+      score += SBVCACHE_VALENCE_BOOST_SCALE *
+        std::pow(float(numtriangles), -SBVCACHE_VALENCE_BOOST_POWER);
+    }
+    return score;
+  }
+
+private:
+  float position[SBVCACHE_LRU_SIZE];
+  float valence[SBVCACHE_MAX_VALENCE + 1];
+};
+
+// a FIFO vertex cache. A vertex is in the cache if fewer than
+// cachesize vertices have been added after it.
+class sbvcache_fifo {
+public:
+  sbvcache_fifo(const int numvertices, const int cachesize)
+    : cachesize(cachesize), time(0) {
+    this->stamps = new int[numvertices];
+    for (int i = 0; i < numvertices; i++) this->stamps[i] = -cachesize - 1;
+  }
+  ~sbvcache_fifo() {
+    delete[] this->stamps;
+  }
+  // returns the number of misses for a triangle
+  int addTriangle(const int32_t * indices) {
+    return this->addVertex(indices[0]) + this->addVertex(indices[1]) +
+      this->addVertex(indices[2]);
+  }
+  int addVertex(const int32_t idx) {
+    if (this->time - this->stamps[idx] < this->cachesize) return 0;
+    this->stamps[idx] = ++this->time;
+    return 1;
+  }
+  void flush(void) {
+    this->time += this->cachesize;
+  }
+  SbBool isUsed(const int32_t idx) const {
+    return this->stamps[idx] > 0;
+  }
+private:
+  int cachesize;
+  int time;
+  int * stamps;
+};
+
+// a cluster of triangles, sorted on how much it faces away from the
+// center of the mesh
+struct sbvcache_cluster {
+  int start, end;
+  float sortkey;
+};
+
+class sbvcache_cluster_compare {
+public:
+  bool operator()(const sbvcache_cluster & a, const sbvcache_cluster & b) const {
+    return a.sortkey > b.sortkey;
+  }
+};
+
+} // anonymous namespace
+
+// *************************************************************************
+
+/*!
+  Reorders the \a numtriangles triangles in \a indices for the
+  post-transform vertex cache. The vertex indices must be less than \a
+  numvertices. The order of the vertices within each triangle is kept.
+*/
+void
+SbVertexCacheOptimizer::optimizeTriangles(int32_t * indices,
+                                          const int numtriangles,
+                                          const int numvertices)
+{
+  if (numtriangles == 0) return;
+  const sbvcache_scoretable scores;
+  const int numindices = numtriangles * 3;
+  int i, j;
+
+  // the triangles not yet output around each vertex, stored in one
+  // array with firsttriangle[v] as the start for vertex v
+  int * numleft = new int[numvertices];
+  int * firsttriangle = new int[numvertices];
+  int * vertextriangles = new int[numindices];
+  int * cacheposition = new int[numvertices];
+  float * vertexscore = new float[numvertices];
+  float * trianglescore = new float[numtriangles];
+  unsigned char * added = new unsigned char[numtriangles];
+  int32_t * result = new int32_t[numindices];
+
+  (void)memset(numleft, 0, numvertices * sizeof(int));
+  for (i = 0; i < numindices; i++) {
+    assert(indices[i] >= 0 && indices[i] < numvertices);
+    numleft[indices[i]]++;
+  }
+  int offset = 0;
+  for (i = 0; i < numvertices; i++) {
+    firsttriangle[i] = offset;
+    offset += numleft[i];
+    cacheposition[i] = 0; // used as fill counter below
+  }
+  for (i = 0; i < numindices; i++) {
+    const int32_t v = indices[i];
+    vertextriangles[firsttriangle[v] + cacheposition[v]++] = i / 3;
+  }
+  for (i = 0; i < numvertices; i++) {
+    cacheposition[i] = -1;
+    vertexscore[i] = scores.get(-1, numleft[i]);
+  }
+  int best = 0;
+  for (i = 0; i < numtriangles; i++) {
+    const int32_t * tri = indices + i * 3;
+    trianglescore[i] =
+      vertexscore[tri[0]] + vertexscore[tri[1]] + vertexscore[tri[2]];
+    if (trianglescore[i] > trianglescore[best]) best = i;
+  }
+  (void)memset(added, 0, numtriangles);
+
+  int cache[SBVCACHE_LRU_SIZE + 3];
+  int newcache[SBVCACHE_LRU_SIZE + 3];
+  int cachelength = 0;
+  int nextunused = 0;
+
+  for (int n = 0; n < numtriangles; n++) {
+    if (best < 0) {
+      // no triangle uses a vertex in the cache. Continue with the
+      // next one in the input order rather than searching them all.
+      while (added[nextunused]) nextunused++;
+      best = nextunused;
+    }
+    const int32_t * tri = indices + best * 3;
+    result[n * 3] = tri[0];
+    result[n * 3 + 1] = tri[1];
+    result[n * 3 + 2] = tri[2];
+    added[best] = 1;
+
+    int newlength = 0;
+    for (j = 0; j < 3; j++) {
+      const int32_t v = tri[j];
+      int * list = vertextriangles + firsttriangle[v];
+      const int num = numleft[v];
+      for (i = 0; i < num; i++) {
+        if (list[i] == best) {
+          list[i] = list[num - 1];
+          list[num - 1] = best;
+          break;
+        }
+      }
+      numleft[v]--;
+      if (std::find(newcache, newcache + newlength, v) == newcache + newlength) {
+        newcache[newlength++] = v;
+      }
+    }
+    for (i = 0; i < cachelength; i++) {
+      const int v = cache[i];
+      if (v != tri[0] && v != tri[1] && v != tri[2]) newcache[newlength++] = v;
+    }
+
+    // update the scores of the vertices which moved in the cache, and
+    // of their triangles
+    for (i = 0; i < newlength; i++) {
+      const int v = newcache[i];
+      const int pos = i < SBVCACHE_LRU_SIZE ? i : -1;
+      cacheposition[v] = pos;
+      const float score = scores.get(pos, numleft[v]);
+      const float delta = score - vertexscore[v];
+      vertexscore[v] = score;
+      const int * list = vertextriangles + firsttriangle[v];
+      for (j = 0; j < numleft[v]; j++) trianglescore[list[j]] += delta;
+    }
+
+    best = -1;
+    float bestscore = -1.0f;
+    cachelength = SbMin(newlength, SBVCACHE_LRU_SIZE);
+    for (i = 0; i < cachelength; i++) {
+      const int v = newcache[i];
+      cache[i] = v;
+      const int * list = vertextriangles + firsttriangle[v];
+      for (j = 0; j < numleft[v]; j++) {
+        if (trianglescore[list[j]] > bestscore) {
+          best = list[j];
+          bestscore = trianglescore[best];
+        }
+      }
+    }
+  }
+
+  (void)memcpy(indices, result, numindices * sizeof(int32_t));
+
+  delete[] numleft;
+  delete[] firsttriangle;
+  delete[] vertextriangles;
+  delete[] cacheposition;
+  delete[] vertexscore;
+  delete[] trianglescore;
+  delete[] added;
+  delete[] result;
+}
+
+/*!
+  Reorders clusters of the \a numtriangles triangles in \a indices to
+  reduce overdraw, drawing the clusters which face out from the center
+  of the mesh first. The triangles should already be ordered with
+  optimizeTriangles().
+
+  The triangles are split into clusters where the cache misses in a
+  FIFO cache of size \a cachesize, counting from the start of the
+  cluster, are at most \a threshold times the misses of the whole
+  ordering. A \a threshold of 1.0 keeps the cache efficiency, while
+  larger values give more and smaller clusters and less overdraw.
+*/
+void
+SbVertexCacheOptimizer::optimizeOverdraw(int32_t * indices,
+                                         const int numtriangles,
+                                         const SbVec3f * coords,
+                                         const int numvertices,
+                                         const int cachesize,
+                                         const float threshold)
+{
+  if (numtriangles == 0) return;
+  int i;
+
+  // triangles where all vertices miss the cache can start a cluster
+  // without any extra cost
+  SbList<int> hardstart;
+  {
+    sbvcache_fifo fifo(numvertices, cachesize);
+    for (i = 0; i < numtriangles; i++) {
+      if (fifo.addTriangle(indices + i * 3) == 3 || i == 0) hardstart.append(i);
+    }
+  }
+  hardstart.append(numtriangles);
+
+  SbList<sbvcache_cluster> clusters;
+  sbvcache_fifo fifo(numvertices, cachesize);
+  for (int h = 0; h < hardstart.getLength() - 1; h++) {
+    const int start = hardstart[h];
+    const int end = hardstart[h + 1];
+    int misses = 0;
+    fifo.flush();
+    for (i = start; i < end; i++) misses += fifo.addTriangle(indices + i * 3);
+    const float limit = threshold * float(misses) / float(end - start);
+
+    // start a new cluster each time the misses per triangle of the
+    // current cluster is down to the limit
+    fifo.flush();
+    const int first = clusters.getLength();
+    sbvcache_cluster cluster;
+    cluster.start = start;
+    cluster.sortkey = 0.0f;
+    int clustermisses = 0;
+    for (i = start; i < end; i++) {
+      clustermisses += fifo.addTriangle(indices + i * 3);
+      if (float(clustermisses) <= limit * float(i + 1 - cluster.start)) {
+        cluster.end = i + 1;
+        clusters.append(cluster);
+        cluster.start = i + 1;
+        clustermisses = 0;
+        fifo.flush();
+      }
+    }
+    if (cluster.start < end) {
+      // the rest didn't get down to the limit, merge it with the
+      // previous cluster
+      if (clusters.getLength() > first) {
+        clusters[clusters.getLength() - 1].end = end;
+      }
+      else {
+        cluster.end = end;
+        clusters.append(cluster);
+      }
+    }
+  }
+  if (clusters.getLength() < 2) return;
+
+  // find the area weighted center and normal of each cluster
+  const int numclusters = clusters.getLength();
+  SbList<SbVec3f> centers;
+  SbList<SbVec3f> normals;
+  SbVec3f meshcenter(0.0f, 0.0f, 0.0f);
+  float mesharea = 0.0f;
+  for (int c = 0; c < numclusters; c++) {
+    SbVec3f center(0.0f, 0.0f, 0.0f);
+    SbVec3f normal(0.0f, 0.0f, 0.0f);
+    float area = 0.0f;
+    for (i = clusters[c].start; i < clusters[c].end; i++) {
+      const SbVec3f & p0 = coords[indices[i * 3]];
+      const SbVec3f & p1 = coords[indices[i * 3 + 1]];
+      const SbVec3f & p2 = coords[indices[i * 3 + 2]];
+      const SbVec3f n = (p1 - p0).cross(p2 - p0);
+      const float a = n.length();
+      center += (p0 + p1 + p2) * (a / 3.0f);
+      normal += n;
+      area += a;
+    }
+    meshcenter += center;
+    mesharea += area;
+    if (area > 0.0f) center /= area;
+    (void)normal.normalize();
+    centers.append(center);
+    normals.append(normal);
+  }
+  if (mesharea > 0.0f) meshcenter /= mesharea;
+  for (int c = 0; c < numclusters; c++) {
+    clusters[c].sortkey = (centers[c] - meshcenter).dot(normals[c]);
+  }
+
+  sbvcache_cluster * array = const_cast<sbvcache_cluster *>(clusters.getArrayPtr());
+  std::stable_sort(array, array + numclusters, sbvcache_cluster_compare());
+
+  int32_t * result = new int32_t[numtriangles * 3];
+  int32_t * dst = result;
+  for (int c = 0; c < numclusters; c++) {
+    const int num = (array[c].end - array[c].start) * 3;
+    (void)memcpy(dst, indices + array[c].start * 3, num * sizeof(int32_t));
+    dst += num;
+  }
+  (void)memcpy(indices, result, numtriangles * 3 * sizeof(int32_t));
+  delete[] result;
+}
+
+/*!
+  Renumbers the vertices in the \a numindices indices in \a indices in
+  the order they are first used. The old index of each new vertex is
+  written to \a vertexorder, which must have room for \a numvertices
+  indices. Returns the number of vertices in use.
+*/
+int
+SbVertexCacheOptimizer::optimizeVertexFetch(int32_t * indices,
+                                            const int numindices,
+                                            const int numvertices,
+                                            int32_t * vertexorder)
+{
+  int32_t * newindex = new int32_t[numvertices];
+  for (int i = 0; i < numvertices; i++) newindex[i] = -1;
+  int numused = 0;
+  for (int i = 0; i < numindices; i++) {
+    const int32_t v = indices[i];
+    assert(v >= 0 && v < numvertices);
+    if (newindex[v] < 0) {
+      newindex[v] = numused;
+      vertexorder[numused++] = v;
+    }
+    indices[i] = newindex[v];
+  }
+  delete[] newindex;
+  return numused;
+}
+
+/*!
+  Simulates rendering the triangles in \a indices with a FIFO vertex
+  cache of size \a cachesize. Returns the number of cache misses in \a
+  misses, and the number of different vertices used in \a
+  usedvertices.
+*/
+void
+SbVertexCacheOptimizer::getCacheStatistics(const int32_t * indices,
+                                           const int numindices,
+                                           const int numvertices,
+                                           const int cachesize,
+                                           int & misses, int & usedvertices)
+{
+  sbvcache_fifo fifo(numvertices, cachesize);
+  misses = 0;
+  for (int i = 0; i < numindices; i++) {
+    assert(indices[i] >= 0 && indices[i] < numvertices);
+    misses += fifo.addVertex(indices[i]);
+  }
+  usedvertices = 0;
+  for (int i = 0; i < numvertices; i++) {
+    if (fifo.isUsed(i)) usedvertices++;
+  }
+}
+
+#undef SBVCACHE_LRU_SIZE
+#undef SBVCACHE_DECAY_POWER
+#undef SBVCACHE_LAST_TRIANGLE_SCORE
+#undef SBVCACHE_VALENCE_BOOST_SCALE
+#undef SBVCACHE_VALENCE_BOOST_POWER
+#undef SBVCACHE_MAX_VALENCE
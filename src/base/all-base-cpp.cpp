@@ -42,6 +42,7 @@
 #include "SbXfBox3d.cpp"
 
 #include "SbBSPTree.cpp"
+#include "SbBVH.cpp"
 #include "SbClip.cpp"
 #include "SbColor.cpp"
 #include "SbColor4f.cpp"
@@ -56,6 +57,8 @@
 #include "SbName.cpp"
 #include "SbOctTree.cpp"
 #include "SbPlane.cpp"
+#include "SbQuadricSimplifier.cpp"
+#include "SbRadixSort.cpp"
 #include "SbDPPlane.cpp"
 #include "SbRotation.cpp"
 #include "SbDPRotation.cpp"
@@ -90,6 +93,7 @@
 #include "SbVec4ui32.cpp"
 #include "SbVec4f.cpp"
 #include "SbVec4d.cpp"
+#include "SbVertexCacheOptimizer.cpp"
 
 #include "SbViewVolume.cpp"
 #include "SbDPViewVolume.cpp"
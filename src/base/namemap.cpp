@@ -43,8 +43,7 @@
 #ifndef COIN_WORKAROUND_NO_USING_STD_FUNCS
 using std::malloc;
 using std::free;
-using std::strcpy;
-using std::strlen;
+using std::memcpy;
 using std::strcmp;
 #endif // !COIN_WORKAROUND_NO_USING_STD_FUNCS
 
@@ -65,25 +64,43 @@ using std::strcmp;
 
 /* ************************************************************************* */
 
+/*
+  The table is split in NUM_SHARDS independent shards, selected by
+  the upper bits of the string hash value. Each shard has its own
+  mutex, so threads constructing SbName instances at the same time
+  rarely wait for each other, and its own bucket array, which is
+  doubled when the number of strings exceeds the number of
+  buckets. Strings and bucket entries are allocated from a list of
+  memory chunks per shard, which are only freed at exit.
+*/
+
 #define CHUNK_SIZE (65536-32)
-static const unsigned int NAME_TABLE_SIZE = 1999;
+#define SHARD_BITS 6
+#define NUM_SHARDS (1 << SHARD_BITS)
+static const unsigned int INITIAL_SHARD_SIZE = 64; /* must be 2^n */
 
 struct NamemapMemChunk {
-  char mem[CHUNK_SIZE];
   char * curbyte;
   size_t bytesleft;
   struct NamemapMemChunk * next;
 };
 
 struct NamemapBucketEntry {
-  unsigned long hashvalue;
+  uint32_t hashvalue;
   const char * str;
   struct NamemapBucketEntry * next;
 };
 
-static void * access_mutex = NULL;
-static struct NamemapBucketEntry ** nametable = NULL;
-static struct NamemapMemChunk * headchunk = NULL;
+struct NamemapShard {
+  void * mutex;
+  struct NamemapBucketEntry ** buckets;
+  unsigned int numbuckets;
+  unsigned int numentries;
+  struct NamemapMemChunk * headchunk;
+};
+
+static struct NamemapShard shards[NUM_SHARDS];
+static SbBool atexit_registered = FALSE;
 
 /* ************************************************************************* */
 
@@ -93,90 +110,149 @@ extern "C" {
 static void
 namemap_cleanup(void)
 {
-  unsigned int i;
-
-  struct NamemapMemChunk * chunkptr = headchunk;
-  while (chunkptr) {
-    struct NamemapMemChunk * next = chunkptr->next;
-    free(chunkptr);
-    chunkptr = next;
-  }
-  
-  for (i = 0; i < NAME_TABLE_SIZE; i++) {
-    struct NamemapBucketEntry * entry = nametable[i];
-    while (entry) {
-      struct NamemapBucketEntry * next = entry->next;
-      free(entry);
-      entry = next;
+  int i;
+  for (i = 0; i < NUM_SHARDS; i++) {
+    struct NamemapShard * shard = &shards[i];
+    struct NamemapMemChunk * chunkptr = shard->headchunk;
+    while (chunkptr) {
+      struct NamemapMemChunk * next = chunkptr->next;
+      free(chunkptr);
+      chunkptr = next;
     }
-  }
-  free(nametable);
-  nametable = static_cast<struct NamemapBucketEntry **>(NULL);
+    shard->headchunk = NULL;
 
-  CC_MUTEX_DESTRUCT(access_mutex);
+    free(shard->buckets);
+    shard->buckets = static_cast<struct NamemapBucketEntry **>(NULL);
+    shard->numbuckets = 0;
+    shard->numentries = 0;
+
+    if (shard->mutex) { CC_MUTEX_DESTRUCT(shard->mutex); }
+  }
+  atexit_registered = FALSE;
 }
 
 } // extern "C"
 
-/* Initializes static data. */
+/* Initializes the bucket array of a shard. */
 static void
-namemap_init(void)
+namemap_init_shard(struct NamemapShard * shard)
 {
   unsigned int i;
 
-  nametable = static_cast<struct NamemapBucketEntry **>(
-    malloc(sizeof(struct NamemapBucketEntry *) * NAME_TABLE_SIZE));
-  for (i = 0; i < NAME_TABLE_SIZE; i++) { nametable[i] = NULL; }
+  shard->numbuckets = INITIAL_SHARD_SIZE;
+  shard->numentries = 0;
+  shard->buckets = static_cast<struct NamemapBucketEntry **>(
+    malloc(sizeof(struct NamemapBucketEntry *) * shard->numbuckets));
+  for (i = 0; i < shard->numbuckets; i++) { shard->buckets[i] = NULL; }
 
-  headchunk = NULL;
+  shard->headchunk = NULL;
 
-  coin_atexit(static_cast<coin_atexit_f *>(namemap_cleanup), CC_ATEXIT_SBNAME);
+  CC_GLOBAL_LOCK;
+  if (!atexit_registered) {
+    coin_atexit(static_cast<coin_atexit_f *>(namemap_cleanup), CC_ATEXIT_SBNAME);
+    atexit_registered = TRUE;
+  }
+  CC_GLOBAL_UNLOCK;
 }
 
-static const char *
-find_string_address(const char * s)
+/* Doubles the number of buckets of a shard. */
+static void
+namemap_grow_shard(struct NamemapShard * shard)
 {
-  size_t len = strlen(s) + 1;
+  unsigned int i;
+  const unsigned int newnumbuckets = shard->numbuckets * 2;
+  struct NamemapBucketEntry ** newbuckets = static_cast<struct NamemapBucketEntry **>(
+    malloc(sizeof(struct NamemapBucketEntry *) * newnumbuckets));
+  for (i = 0; i < newnumbuckets; i++) { newbuckets[i] = NULL; }
 
-  /* FIXME: this is an unacceptable limitation. 20030608 mortene. */
-  assert(len < CHUNK_SIZE);
+  for (i = 0; i < shard->numbuckets; i++) {
+    struct NamemapBucketEntry * entry = shard->buckets[i];
+    while (entry) {
+      struct NamemapBucketEntry * next = entry->next;
+      const unsigned int idx = entry->hashvalue & (newnumbuckets - 1);
+      entry->next = newbuckets[idx];
+      newbuckets[idx] = entry;
+      entry = next;
+    }
+  }
+  free(shard->buckets);
+  shard->buckets = newbuckets;
+  shard->numbuckets = newnumbuckets;
+}
+
+/* Allocates memory from the chunks of a shard. Sizes larger than a
+   chunk gets a chunk of their own. */
+static void *
+namemap_alloc(struct NamemapShard * shard, size_t size)
+{
+  /* keep the bucket entries aligned */
+  size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
 
-  if (headchunk == NULL || headchunk->bytesleft < len) {
+  if (shard->headchunk == NULL || shard->headchunk->bytesleft < size) {
+    const size_t chunksize = (size > CHUNK_SIZE) ? size : CHUNK_SIZE;
+    const size_t headersize =
+      (sizeof(struct NamemapMemChunk) + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
     struct NamemapMemChunk * newchunk = static_cast<struct NamemapMemChunk *>(
-      malloc(sizeof(struct NamemapMemChunk))
+      malloc(headersize + chunksize)
       );
 
-    newchunk->curbyte = newchunk->mem;
-    newchunk->bytesleft = CHUNK_SIZE;
-    newchunk->next = headchunk;
+    newchunk->curbyte = reinterpret_cast<char *>(newchunk) + headersize;
+    newchunk->bytesleft = chunksize;
 
-    headchunk = newchunk;
-  }
+    /* keep a partly used chunk at the head when the new chunk is
+       for a single large allocation */
+    if (shard->headchunk && size > CHUNK_SIZE) {
+      newchunk->next = shard->headchunk->next;
+      shard->headchunk->next = newchunk;
+    }
+    else {
+      newchunk->next = shard->headchunk;
+      shard->headchunk = newchunk;
+    }
 
-  (void)strcpy(headchunk->curbyte, s);
-  s = headchunk->curbyte;
+    void * mem = newchunk->curbyte;
+    newchunk->curbyte += size;
+    newchunk->bytesleft -= size;
+    return mem;
+  }
 
-  headchunk->curbyte += len;
-  headchunk->bytesleft -= len;
+  void * mem = shard->headchunk->curbyte;
+  shard->headchunk->curbyte += size;
+  shard->headchunk->bytesleft -= size;
+  return mem;
+}
 
-  return s;
+/* FNV-1a, which spreads similar names (like "node1", "node2", ...)
+   much better than cc_string_hash_text(). Also returns the length of
+   the string. */
+static uint32_t
+namemap_hash(const char * str, size_t & len)
+{
+  uint32_t h = 2166136261u;
+  const unsigned char * s = reinterpret_cast<const unsigned char *>(str);
+  while (*s) {
+    h ^= *s++;
+    h *= 16777619u;
+  }
+  len = s - reinterpret_cast<const unsigned char *>(str);
+  return h;
 }
 
 static const char *
 namemap_find_or_add_string(const char * str, SbBool addifnotfound)
 {
-  unsigned long h, i;
-  struct NamemapBucketEntry * entry;
+  size_t len;
+  const uint32_t h = namemap_hash(str, len);
+  /* the lower bits are used for the bucket index */
+  struct NamemapShard * shard = &shards[h >> (32 - SHARD_BITS)];
 
-  if (access_mutex == NULL) { CC_MUTEX_CONSTRUCT(access_mutex); }
-  CC_MUTEX_LOCK(access_mutex);
+  if (shard->mutex == NULL) { CC_MUTEX_CONSTRUCT(shard->mutex); }
+  CC_MUTEX_LOCK(shard->mutex);
 
-  if (nametable == NULL) { namemap_init(); }
-  assert(nametable != static_cast<struct NamemapBucketEntry **>(NULL) && "name hash dead");
+  if (shard->buckets == NULL) { namemap_init_shard(shard); }
 
-  h = cc_string_hash_text(str);
-  i = h % NAME_TABLE_SIZE;
-  entry = nametable[i];
+  unsigned int i = h & (shard->numbuckets - 1);
+  struct NamemapBucketEntry * entry = shard->buckets[i];
 
   while (entry != NULL) {
     if (entry->hashvalue == h && strcmp(entry->str, str) == 0) { break; }
@@ -184,15 +260,24 @@ namemap_find_or_add_string(const char * str, SbBool addifnotfound)
   }
 
   if ((entry == NULL) && addifnotfound) {
-    entry = static_cast<struct NamemapBucketEntry *>(malloc(sizeof(struct NamemapBucketEntry)));
-    entry->str = find_string_address(str);
+    if (shard->numentries >= shard->numbuckets) {
+      namemap_grow_shard(shard);
+      i = h & (shard->numbuckets - 1);
+    }
+
+    entry = static_cast<struct NamemapBucketEntry *>(
+      namemap_alloc(shard, sizeof(struct NamemapBucketEntry)));
+    char * copy = static_cast<char *>(namemap_alloc(shard, len + 1));
+    (void)memcpy(copy, str, len + 1);
+    entry->str = copy;
     entry->hashvalue = h;
-    entry->next = nametable[i];
+    entry->next = shard->buckets[i];
 
-    nametable[i] = entry;
+    shard->buckets[i] = entry;
+    shard->numentries++;
   }
 
-  CC_MUTEX_UNLOCK(access_mutex);
+  CC_MUTEX_UNLOCK(shard->mutex);
   return entry ? entry->str : NULL;
 }
 
@@ -222,3 +307,5 @@ cc_namemap_peek_string(const char * str)
 }
 
 #undef CHUNK_SIZE
+#undef SHARD_BITS
+#undef NUM_SHARDS
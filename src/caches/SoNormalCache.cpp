@@ -234,12 +234,78 @@ calc_normal_vec(const SbVec3f * facenormals, const int facenum,
   }
 }
 
+//
+// Generates the vertex normals of a face set with
+// SoNormalGenerator, which finds the faces sharing a vertex from the
+// coordinate indices, and then gives vertices of the same coordinate
+// with equal normals the same normal index.
+//
+static void
+generate_indexed(const SbVec3f * coords, const unsigned int numcoords,
+                 const int32_t * vindex, const int numvi,
+                 const float crease_angle, const SbBool ccw,
+                 SbList <SbVec3f> & normalarray, SbList <int32_t> & indices)
+{
+  SoNormalGenerator generator(ccw);
+  generator.setIndexedFaces(coords, static_cast<int>(numcoords), vindex, numvi);
+  generator.generate(crease_angle);
+  const SbVec3f * vertnormals = generator.getNormals();
+
+  // the normals of each coordinate, in the order they were added
+  int32_t * firstnormal = new int32_t[numcoords > 0 ? numcoords : 1];
+  int32_t * lastnormal = new int32_t[numcoords > 0 ? numcoords : 1];
+  for (unsigned int c = 0; c < numcoords; c++) firstnormal[c] = -1;
+  SbList <int32_t> nextnormal;
+
+  indices.ensureCapacity(numvi);
+  int vertex = 0;
+  int nindex = 0;
+  for (int i = 0; i < numvi; i++) {
+    const int32_t currindex = vindex[i];
+    if (currindex < 0 || static_cast<unsigned int>(currindex) >= numcoords) {
+      indices.append(-1); // add a -1 for PER_VERTEX_INDEXED binding
+      continue;
+    }
+    const SbVec3f & normal = vertnormals[vertex++];
+
+    // try to find equal normal (total smoothing)
+    int32_t same_normal = firstnormal[currindex];
+    while (same_normal >= 0 &&
+           !normalarray[same_normal].equals(normal, NORMAL_EPSILON)) {
+      same_normal = nextnormal[same_normal];
+    }
+    if (same_normal >= 0) {
+      indices.append(same_normal);
+    }
+    // might be equal to the previous normal (when all normals for a face are equal)
+    else if ((nindex > 0) &&
+             normalarray[nindex-1].equals(normal, NORMAL_EPSILON)) {
+      indices.append(nindex-1);
+    }
+    else {
+      normalarray.append(normal);
+      nextnormal.append(-1);
+      if (firstnormal[currindex] < 0) firstnormal[currindex] = nindex;
+      else nextnormal[lastnormal[currindex]] = nindex;
+      lastnormal[currindex] = nindex;
+      indices.append(nindex);
+      nindex++;
+    }
+  }
+  delete [] firstnormal;
+  delete [] lastnormal;
+}
+
 /*!
   Generates normals for each vertex for each face. It is possible to
   specify face normals if these have been calculated somewhere else,
   otherwise the face normals will be calculated before the vertex
   normals are calculated. \a tristrip should be \c TRUE if the
   geometry consists of triangle strips.
+
+  Without face normals, the normals of faces which are not triangle
+  strips are calculated with SoNormalGenerator::setIndexedFaces(),
+  in parallel when set up with SoNormalGenerator::setNumThreads().
 */
 void
 SoNormalCache::generatePerVertex(const SbVec3f * const coords,
@@ -268,6 +334,15 @@ SoNormalCache::generatePerVertex(const SbVec3f * const coords,
   fprintf(stdout, "\n");
 #endif // debug
 
+  if (!tristrip && facenormals == NULL) {
+    generate_indexed(coords, numcoords, vindex, numvi, crease_angle, ccw,
+                     PRIVATE(this)->normalArray, PRIVATE(this)->indices);
+    if (PRIVATE(this)->normalArray.getLength()) {
+      PRIVATE(this)->normalData.normals = PRIVATE(this)->normalArray.getArrayPtr();
+      PRIVATE(this)->numNormals = PRIVATE(this)->normalArray.getLength();
+    }
+    return;
+  }
 
   int numfacenorm = numfacenormals;
   SoNormalCache tempcache(NULL);
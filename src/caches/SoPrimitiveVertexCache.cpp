@@ -48,6 +48,10 @@
 
 #include <Inventor/caches/SoPrimitiveVertexCache.h>
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
 #include <cstddef>
 #include <cstdlib>
 #include <cstring>
@@ -75,12 +79,23 @@
 #include <Inventor/SbPlane.h>
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/misc/SoGLDriverDatabase.h>
+#include <Inventor/actions/SoGLRenderAction.h>
+
+#ifdef HAVE_THREADS
+#include <Inventor/C/threads/wpool.h>
+#endif // HAVE_THREADS
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SOPVCACHE_HAVE_SSE
+#include <xmmintrin.h>
+#endif // SSE
 
 #include "tidbitsp.h"
 #include "misc/SbHash.h"
 #include "rendering/SoGL.h"
 #include "rendering/SoVBO.h"
 #include "rendering/SoVertexArrayIndexer.h"
+#include "base/SbRadixSort.h"
 #include "SbBasicP.h"
 
 // *************************************************************************
@@ -96,6 +111,8 @@ public:
       tangentlist(256),
       vhash(1024),
       deptharray(NULL),
+      vertexdeptharray(NULL),
+      sortindexarray(NULL),
       triangleindexer(NULL),
       lineindexer(NULL),
       pointindexer(NULL),
@@ -123,6 +140,8 @@ public:
       delete[] multitexcoords;
     }
     delete[] deptharray;
+    delete[] vertexdeptharray;
+    delete[] sortindexarray;
   }
 
   class Vertex {
@@ -173,6 +192,9 @@ public:
   SoState * state;
   SbPlane prevsortplane;
   float * deptharray;
+  float * vertexdeptharray;
+  GLint * sortindexarray;
+  SbRadixSort depthsorter;
 
   SoVertexArrayIndexer * triangleindexer;
   SoVertexArrayIndexer * lineindexer;
@@ -839,6 +861,94 @@ SoPrimitiveVertexCache::fit(void)
   if (PRIVATE(this)->pointindexer) PRIVATE(this)->pointindexer->close();
 }
 
+// Each depth sort thread gets at least this many vertices or triangles.
+static const int SOPVCACHE_MIN_SORT_PER_THREAD = 65536;
+
+namespace {
+
+// A range of vertices and triangles for one depth sort thread.
+class SoPrimitiveVertexCacheSortJob {
+public:
+  int vertexstart, vertexend;
+  int trianglestart, triangleend;
+
+  const SbVec3f * vertices;
+  const GLint * indices;
+  SbVec3f normal;
+  float distance;
+
+  float * vertexdepths;
+  float * triangledepths;
+};
+
+} // namespace
+
+// Calculates the distance from the sort plane to each vertex.
+static void
+sopvcache_vertex_depths(void * closure)
+{
+  const SoPrimitiveVertexCacheSortJob * job =
+    static_cast<SoPrimitiveVertexCacheSortJob *>(closure);
+  const SbVec3f * vertices = job->vertices;
+  float * depths = job->vertexdepths;
+  const float nx = job->normal[0];
+  const float ny = job->normal[1];
+  const float nz = job->normal[2];
+  const float d = job->distance;
+
+  int i = job->vertexstart;
+#ifdef SOPVCACHE_HAVE_SSE
+  // four vertices at a time. The 12 coordinates are shuffled into
+  // separate x, y and z vectors.
+  const __m128 nx4 = _mm_set1_ps(nx);
+  const __m128 ny4 = _mm_set1_ps(ny);
+  const __m128 nz4 = _mm_set1_ps(nz);
+  const __m128 d4 = _mm_set1_ps(d);
+  for (; i + 4 <= job->vertexend; i += 4) {
+    const float * ptr = vertices[i].getValue();
+    const __m128 a = _mm_loadu_ps(ptr);     // x0 y0 z0 x1
+    const __m128 b = _mm_loadu_ps(ptr + 4); // y1 z1 x2 y2
+    const __m128 c = _mm_loadu_ps(ptr + 8); // z2 x3 y3 z3
+    const __m128 x = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 3, 0)),
+                                    _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)),
+                                    _MM_SHUFFLE(2, 0, 1, 0));
+    const __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 0, 1)),
+                                    _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                                    _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                                    _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                                    _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, nx4),
+                                             _mm_mul_ps(y, ny4)),
+                                  _mm_mul_ps(z, nz4));
+    _mm_storeu_ps(depths + i, _mm_sub_ps(dot, d4));
+  }
+#endif // SOPVCACHE_HAVE_SSE
+  for (; i < job->vertexend; i++) {
+    const SbVec3f & v = vertices[i];
+    depths[i] = v[0] * nx + v[1] * ny + v[2] * nz - d;
+  }
+}
+
+// Calculates the depth of each triangle from its vertices. Only the
+// order of the depths matters, so the sum is used instead of the
+// average.
+static void
+sopvcache_triangle_depths(void * closure)
+{
+  const SoPrimitiveVertexCacheSortJob * job =
+    static_cast<SoPrimitiveVertexCacheSortJob *>(closure);
+  const float * vertexdepths = job->vertexdepths;
+  const GLint * indices = job->indices;
+  float * depths = job->triangledepths;
+  for (int i = job->trianglestart; i < job->triangleend; i++) {
+    depths[i] =
+      vertexdepths[indices[i*3]] +
+      vertexdepths[indices[i*3+1]] +
+      vertexdepths[indices[i*3+2]];
+  }
+}
+
 void
 SoPrimitiveVertexCache::depthSortTriangles(SoState * state)
 {
@@ -854,44 +964,71 @@ SoPrimitiveVertexCache::depthSortTriangles(SoState * state)
       (sortplane != PRIVATE(this)->prevsortplane)) {
     if (!PRIVATE(this)->deptharray) {
       PRIVATE(this)->deptharray = new float[numtri];
+      PRIVATE(this)->vertexdeptharray = new float[numv];
+      PRIVATE(this)->sortindexarray = new GLint[numtri * 3];
     }
     PRIVATE(this)->prevsortplane = sortplane;
-    float * darray = PRIVATE(this)->deptharray;
-    const SbVec3f * vptr = PRIVATE(this)->vertexlist.getArrayPtr();
     GLint * iptr = PRIVATE(this)->triangleindexer->getWriteableIndices();
-    int i,j;
-    for (i = 0; i < numtri; i++) {
-      float acc = 0.0;
-      for (j = 0; j < 3; j++) {
-        acc += sortplane.getDistance(vptr[iptr[i*3+j]]);
-      }
-      darray[i] = acc / 3.0f;
+
+    int numthreads = 1;
+    SoAction * action = state->getAction();
+    if (action->isOfType(SoGLRenderAction::getClassTypeId())) {
+      numthreads = static_cast<SoGLRenderAction *>(action)->getNumSortThreads();
     }
-    int distance;
-    float dtmp;
-    int itmp[3];
-
-    // shell sort algorithm (O(nlog(n))
-    for (distance = 1; distance <= numtri/9; distance = 3*distance + 1) ;
-    for (; distance > 0; distance /= 3) {
-      for (i = distance; i < numtri; i++) {
-        dtmp = darray[i];
-        itmp[0] = iptr[i*3];
-        itmp[1] = iptr[i*3+1];
-        itmp[2] = iptr[i*3+2];
-        j = i;
-        while (j >= distance && darray[j-distance] > dtmp) {
-          darray[j] = darray[j-distance];
-          iptr[j*3] = iptr[(j-distance)*3];
-          iptr[j*3+1] = iptr[(j-distance)*3+1];
-          iptr[j*3+2] = iptr[(j-distance)*3+2];
-          j -= distance;
-        }
-        darray[j] = dtmp;
-        iptr[j*3] = itmp[0];
-        iptr[j*3+1] = itmp[1];
-        iptr[j*3+2] = itmp[2];
+    int numjobs = SbMin(numthreads,
+                        SbMax(numv, numtri) / SOPVCACHE_MIN_SORT_PER_THREAD);
+    if (numjobs < 1) numjobs = 1;
+
+    SoPrimitiveVertexCacheSortJob * jobs = new SoPrimitiveVertexCacheSortJob[numjobs];
+    for (int i = 0; i < numjobs; i++) {
+      SoPrimitiveVertexCacheSortJob & job = jobs[i];
+      job.vertexstart = int((long long)(numv) * i / numjobs);
+      job.vertexend = int((long long)(numv) * (i + 1) / numjobs);
+      job.trianglestart = int((long long)(numtri) * i / numjobs);
+      job.triangleend = int((long long)(numtri) * (i + 1) / numjobs);
+      job.vertices = PRIVATE(this)->vertexlist.getArrayPtr();
+      job.indices = iptr;
+      job.normal = sortplane.getNormal();
+      job.distance = sortplane.getDistanceFromOrigin();
+      job.vertexdepths = PRIVATE(this)->vertexdeptharray;
+      job.triangledepths = PRIVATE(this)->deptharray;
+    }
+#ifdef HAVE_THREADS
+    if (numjobs > 1) {
+      // all vertex depths must be done before the triangle depths
+      cc_wpool * pool =
+        sogl_sort_pool(static_cast<SoGLRenderAction *>(action), numjobs);
+      cc_wpool_begin(pool, numjobs);
+      for (int i = 0; i < numjobs; i++) {
+        cc_wpool_start_worker(pool, sopvcache_vertex_depths, &jobs[i]);
+      }
+      cc_wpool_end(pool);
+      cc_wpool_wait_all(pool);
+      cc_wpool_begin(pool, numjobs);
+      for (int i = 0; i < numjobs; i++) {
+        cc_wpool_start_worker(pool, sopvcache_triangle_depths, &jobs[i]);
       }
+      cc_wpool_end(pool);
+      cc_wpool_wait_all(pool);
+      numjobs = 0;
+    }
+#endif // HAVE_THREADS
+    for (int i = 0; i < numjobs; i++) sopvcache_vertex_depths(&jobs[i]);
+    for (int i = 0; i < numjobs; i++) sopvcache_triangle_depths(&jobs[i]);
+    delete[] jobs;
+
+    // The triangles are sorted from the order they had after the
+    // previous sort, so triangles at the same depth keep their order
+    // between frames.
+    const int32_t * order =
+      PRIVATE(this)->depthsorter.sort(PRIVATE(this)->deptharray, numtri);
+    GLint * src = PRIVATE(this)->sortindexarray;
+    (void)memcpy(src, iptr, numtri * 3 * sizeof(GLint));
+    for (int i = 0; i < numtri; i++) {
+      const GLint * tri = src + order[i] * 3;
+      iptr[i*3] = tri[0];
+      iptr[i*3+1] = tri[1];
+      iptr[i*3+2] = tri[2];
     }
   }
 }
@@ -1134,3 +1271,85 @@ SoPrimitiveVertexCacheP::renderImmediate(const cc_glglue * glue,
 }
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoPerspectiveCamera.h>
+#include <Inventor/nodes/SoSeparator.h>
+
+static void
+add_triangle(void * userdata, SoCallbackAction *,
+             const SoPrimitiveVertex * v0,
+             const SoPrimitiveVertex * v1,
+             const SoPrimitiveVertex * v2)
+{
+  static_cast<SoPrimitiveVertexCache *>(userdata)->addTriangle(v0, v1, v2);
+}
+
+static SoCallbackAction::Response
+sort_triangles(void * userdata, SoCallbackAction * action, const SoNode *)
+{
+  SoPrimitiveVertexCache * cache = static_cast<SoPrimitiveVertexCache *>(userdata);
+  cache->fit();
+  cache->depthSortTriangles(action->getState());
+  return SoCallbackAction::CONTINUE;
+}
+
+BOOST_AUTO_TEST_CASE(depthSortTriangles)
+{
+  // triangles in a shuffled order of depth, with some at the same
+  // depth, and a vertex count which isn't a multiple of four
+  const int numtriangles = 333;
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoPerspectiveCamera * camera = new SoPerspectiveCamera;
+  camera->position.setValue(0.0f, 0.0f, 100.0f);
+  root->addChild(camera);
+  SoCoordinate3 * coords = new SoCoordinate3;
+  SoIndexedFaceSet * ifs = new SoIndexedFaceSet;
+  for (int i = 0; i < numtriangles; i++) {
+    const float z = -float((i * 37) % 101);
+    coords->point.set1Value(i * 3, SbVec3f(float(i), 0.0f, z));
+    coords->point.set1Value(i * 3 + 1, SbVec3f(float(i) + 1.0f, 0.0f, z));
+    coords->point.set1Value(i * 3 + 2, SbVec3f(float(i), 1.0f, z));
+    const int32_t idx[] = { i * 3, i * 3 + 1, i * 3 + 2, -1 };
+    ifs->coordIndex.setValues(i * 4, 4, idx);
+  }
+  root->addChild(coords);
+  root->addChild(ifs);
+
+  SoCallbackAction action(SbViewportRegion(100, 100));
+  action.apply(root); // to get a state for the cache
+  SoPrimitiveVertexCache * cache = new SoPrimitiveVertexCache(action.getState());
+  cache->ref();
+  action.addTriangleCallback(SoIndexedFaceSet::getClassTypeId(), add_triangle, cache);
+  action.addPostCallback(SoIndexedFaceSet::getClassTypeId(), sort_triangles, cache);
+  action.apply(root);
+
+  BOOST_REQUIRE(cache->getNumTriangleIndices() == numtriangles * 3);
+  const SbVec3f * vertices = cache->getVertexArray();
+  const GLint * indices = cache->getTriangleIndices();
+  SbBool sorted = TRUE;
+  float prevdepth = -1000.0f;
+  int prevx = -1;
+  for (int i = 0; i < numtriangles; i++) {
+    // back to front, so the distance to the camera shrinks with z
+    const SbVec3f & v = vertices[indices[i * 3]];
+    const float depth = v[2];
+    const int x = int(v[0]);
+    if (depth < prevdepth || (depth == prevdepth && x < prevx)) sorted = FALSE;
+    prevdepth = depth;
+    prevx = x;
+  }
+  BOOST_CHECK_MESSAGE(sorted,
+                      "Triangles should be sorted back to front, "
+                      "in input order at the same depth");
+  cache->unref();
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
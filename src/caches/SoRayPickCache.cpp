@@ -0,0 +1,427 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+/*!
+  \class SoRayPickCache SoRayPickCache.h
+  \brief The SoRayPickCache class caches the primitives of a shape for ray picking.
+
+  \ingroup coin_caches
+
+  The cache stores the triangles, line segments and points generated
+  by SoShape::generatePrimitives(), together with a copy of the
+  detail for each primitive, and organizes the triangles in a bounding
+  volume hierarchy. This way, SoShape::rayPick() only needs to test
+  the few triangles close to the pick ray, and doesn't need to
+  generate the primitives again as long as the cache is valid.
+
+  Face, line and point details are stored by value in an arena owned
+  by the cache, instead of as one or two heap allocated SoDetail
+  instances per primitive. A heap allocated copy is only created for
+  primitives that are actually picked. Set the environment variable
+  COIN_DEBUG_RAYPICK_CACHE to get the number of allocations avoided
+  this way reported when a cache is built.
+
+  The cache is only used when enabled with
+  SoRayPickAction::setBVHCaching().
+
+  \internal
+*/
+
+// *************************************************************************
+
+#include "caches/SoRayPickCache.h"
+
+#include <Inventor/details/SoFaceDetail.h>
+#include <Inventor/details/SoLineDetail.h>
+#include <Inventor/errors/SoDebugError.h>
+#include <Inventor/C/tidbits.h>
+
+#include <cstdlib>
+
+// *************************************************************************
+
+/*!
+  Constructor.
+*/
+SoRayPickCache::SoRayPickCache(SoState * state)
+  : SoCache(state),
+    numarenadetails(0),
+    numavoided(0)
+{
+}
+
+/*!
+  Destructor.
+*/
+SoRayPickCache::~SoRayPickCache()
+{
+  int i;
+  for (i = 0; i < this->triangledetails.getLength(); i++) {
+    delete this->triangledetails[i].detail;
+  }
+  for (i = 0; i < this->linedetails.getLength(); i++) {
+    delete this->linedetails[i].detail;
+  }
+  for (i = 0; i < this->pointdetails.getLength(); i++) {
+    delete this->pointdetails[i].detail;
+  }
+}
+
+void
+SoRayPickCache::addVertices(SbList <SoPrimitiveVertex> & list,
+                            const SoPrimitiveVertex * const * v, const int num)
+{
+  for (int i = 0; i < num; i++) {
+    SoPrimitiveVertex pv(*v[i]);
+    // the detail pointer is only valid during primitive generation
+    pv.setDetail(NULL);
+    list.append(pv);
+  }
+}
+
+void
+SoRayPickCache::addArenaDetail(SbList <DetailRecord> & list,
+                               const int index, const int partindex,
+                               const SoPointDetail * points, const int numpoints)
+{
+  DetailRecord record;
+  record.detail = NULL;
+  record.index = index;
+  record.partindex = partindex;
+  record.firstpoint = this->arenapoints.getLength();
+  record.numpoints = numpoints;
+  for (int i = 0; i < numpoints; i++) {
+    this->arenapoints.append(points[i]);
+  }
+  list.append(record);
+  this->numarenadetails++;
+}
+
+/*!
+  Adds a triangle to the cache. The cache takes over ownership of \a
+  detail, which may be \c NULL.
+*/
+void
+SoRayPickCache::addTriangle(const SoPrimitiveVertex * v0,
+                            const SoPrimitiveVertex * v1,
+                            const SoPrimitiveVertex * v2,
+                            SoDetail * detail)
+{
+  const SoPrimitiveVertex * v[3] = { v0, v1, v2 };
+  this->addVertices(this->trianglevertices, v, 3);
+  DetailRecord record;
+  record.detail = detail;
+  record.firstpoint = -1;
+  this->triangledetails.append(record);
+}
+
+/*!
+  Adds a triangle to the cache, with a face detail made from \a face
+  and the \a numpoints point details in \a points. The detail is
+  copied into the cache's arena.
+*/
+void
+SoRayPickCache::addTriangle(const SoPrimitiveVertex * v0,
+                            const SoPrimitiveVertex * v1,
+                            const SoPrimitiveVertex * v2,
+                            const SoFaceDetail * face,
+                            const SoPointDetail * points,
+                            const int numpoints)
+{
+  const SoPrimitiveVertex * v[3] = { v0, v1, v2 };
+  this->addVertices(this->trianglevertices, v, 3);
+  this->addArenaDetail(this->triangledetails,
+                       face->getFaceIndex(), face->getPartIndex(),
+                       points, numpoints);
+  // the face detail and its point array
+  this->numavoided += 2;
+}
+
+/*!
+  Adds a line segment to the cache. The cache takes over ownership of
+  \a detail, which may be \c NULL.
+*/
+void
+SoRayPickCache::addLine(const SoPrimitiveVertex * v0,
+                        const SoPrimitiveVertex * v1,
+                        SoDetail * detail)
+{
+  const SoPrimitiveVertex * v[2] = { v0, v1 };
+  this->addVertices(this->linevertices, v, 2);
+  DetailRecord record;
+  record.detail = detail;
+  record.firstpoint = -1;
+  this->linedetails.append(record);
+}
+
+/*!
+  Adds a line segment to the cache, with a line detail made from \a
+  line and the two point details in \a points. The detail is copied
+  into the cache's arena.
+*/
+void
+SoRayPickCache::addLine(const SoPrimitiveVertex * v0,
+                        const SoPrimitiveVertex * v1,
+                        const SoLineDetail * line,
+                        const SoPointDetail * points)
+{
+  const SoPrimitiveVertex * v[2] = { v0, v1 };
+  this->addVertices(this->linevertices, v, 2);
+  this->addArenaDetail(this->linedetails,
+                       line->getLineIndex(), line->getPartIndex(),
+                       points, 2);
+  this->numavoided++;
+}
+
+/*!
+  Adds a point to the cache. The cache takes over ownership of \a
+  detail, which may be \c NULL.
+*/
+void
+SoRayPickCache::addPoint(const SoPrimitiveVertex * v,
+                         SoDetail * detail)
+{
+  this->addVertices(this->pointvertices, &v, 1);
+  DetailRecord record;
+  record.detail = detail;
+  record.firstpoint = -1;
+  this->pointdetails.append(record);
+}
+
+/*!
+  Adds a point to the cache, with a copy of \a point as its detail.
+  The detail is copied into the cache's arena.
+*/
+void
+SoRayPickCache::addPoint(const SoPrimitiveVertex * v,
+                         const SoPointDetail * point)
+{
+  this->addVertices(this->pointvertices, &v, 1);
+  this->addArenaDetail(this->pointdetails, 0, 0, point, 1);
+  this->numavoided++;
+}
+
+/*!
+  Should be called after all primitives have been added. Builds the
+  triangle hierarchy.
+*/
+void
+SoRayPickCache::close(void)
+{
+  const int numtriangles = this->triangledetails.getLength();
+  SbBox3f * boxes = new SbBox3f[numtriangles];
+  SbBox3f shapebox;
+  const SoPrimitiveVertex * pv = this->trianglevertices.getArrayPtr();
+  int i;
+  for (i = 0; i < numtriangles; i++) {
+    boxes[i].extendBy(pv[i*3].getPoint());
+    boxes[i].extendBy(pv[i*3+1].getPoint());
+    boxes[i].extendBy(pv[i*3+2].getPoint());
+    shapebox.extendBy(boxes[i]);
+  }
+  // pad the boxes a tiny bit so that rays grazing a triangle edge
+  // aren't culled by the box test due to floating point inaccuracies
+  if (numtriangles) {
+    float dx, dy, dz;
+    shapebox.getSize(dx, dy, dz);
+    const float pad = SbMax(SbMax(dx, dy), dz) * 1.0e-5f;
+    const SbVec3f padvec(pad, pad, pad);
+    for (i = 0; i < numtriangles; i++) {
+      boxes[i].getMin() -= padvec;
+      boxes[i].getMax() += padvec;
+    }
+  }
+  this->trianglebvh.build(boxes, numtriangles);
+  delete[] boxes;
+
+  this->trianglevertices.fit();
+  this->triangledetails.fit();
+  this->linevertices.fit();
+  this->linedetails.fit();
+  this->pointvertices.fit();
+  this->pointdetails.fit();
+  this->arenapoints.fit();
+
+  static int debug = -1;
+  if (debug == -1) {
+    const char * env = coin_getenv("COIN_DEBUG_RAYPICK_CACHE");
+    debug = env && (atoi(env) > 0);
+  }
+  if (debug) {
+    SoDebugError::postInfo("SoRayPickCache::close",
+                           "%d triangles, %d lines, %d points. "
+                           "%d details stored in the arena, "
+                           "%d heap allocations avoided.",
+                           this->getNumTriangles(), this->getNumLines(),
+                           this->getNumPoints(), this->numarenadetails,
+                           this->numavoided);
+  }
+}
+
+/*!
+  Returns the number of triangles in the cache.
+*/
+int
+SoRayPickCache::getNumTriangles(void) const
+{
+  return this->triangledetails.getLength();
+}
+
+/*!
+  Returns a pointer to the three vertices of triangle \a idx.
+*/
+const SoPrimitiveVertex *
+SoRayPickCache::getTriangle(const int idx) const
+{
+  return this->trianglevertices.getArrayPtr(idx * 3);
+}
+
+/*!
+  Returns a new copy of the detail for triangle \a idx, or \c NULL if
+  the shape didn't supply any detail. The caller takes over ownership
+  of the detail.
+*/
+SoDetail *
+SoRayPickCache::createTriangleDetail(const int idx) const
+{
+  const DetailRecord & record = this->triangledetails[idx];
+  if (record.firstpoint < 0) {
+    return record.detail ? record.detail->copy() : NULL;
+  }
+  SoFaceDetail * detail = new SoFaceDetail;
+  detail->setFaceIndex(record.index);
+  detail->setPartIndex(record.partindex);
+  detail->setNumPoints(record.numpoints);
+  for (int i = 0; i < record.numpoints; i++) {
+    detail->setPoint(i, this->arenapoints.getArrayPtr(record.firstpoint + i));
+  }
+  return detail;
+}
+
+/*!
+  Returns the number of line segments in the cache.
+*/
+int
+SoRayPickCache::getNumLines(void) const
+{
+  return this->linedetails.getLength();
+}
+
+/*!
+  Returns a pointer to the two vertices of line segment \a idx.
+*/
+const SoPrimitiveVertex *
+SoRayPickCache::getLine(const int idx) const
+{
+  return this->linevertices.getArrayPtr(idx * 2);
+}
+
+/*!
+  Returns a new copy of the detail for line segment \a idx, or \c
+  NULL. The caller takes over ownership of the detail.
+*/
+SoDetail *
+SoRayPickCache::createLineDetail(const int idx) const
+{
+  const DetailRecord & record = this->linedetails[idx];
+  if (record.firstpoint < 0) {
+    return record.detail ? record.detail->copy() : NULL;
+  }
+  SoLineDetail * detail = new SoLineDetail;
+  detail->setLineIndex(record.index);
+  detail->setPartIndex(record.partindex);
+  detail->setPoint0(this->arenapoints.getArrayPtr(record.firstpoint));
+  detail->setPoint1(this->arenapoints.getArrayPtr(record.firstpoint + 1));
+  return detail;
+}
+
+/*!
+  Returns the number of points in the cache.
+*/
+int
+SoRayPickCache::getNumPoints(void) const
+{
+  return this->pointdetails.getLength();
+}
+
+/*!
+  Returns point \a idx.
+*/
+const SoPrimitiveVertex *
+SoRayPickCache::getPoint(const int idx) const
+{
+  return this->pointvertices.getArrayPtr(idx);
+}
+
+/*!
+  Returns a new copy of the detail for point \a idx, or \c NULL. The
+  caller takes over ownership of the detail.
+*/
+SoDetail *
+SoRayPickCache::createPointDetail(const int idx) const
+{
+  const DetailRecord & record = this->pointdetails[idx];
+  if (record.firstpoint < 0) {
+    return record.detail ? record.detail->copy() : NULL;
+  }
+  return this->arenapoints[record.firstpoint].copy();
+}
+
+/*!
+  Returns the bounding volume hierarchy for the cached triangles. Item
+  indices in the hierarchy are triangle indices.
+*/
+const SbBVH &
+SoRayPickCache::getTriangleBVH(void) const
+{
+  return this->trianglebvh;
+}
+
+/*!
+  Returns the number of primitive details stored by value in the
+  cache's arena.
+*/
+int
+SoRayPickCache::getNumArenaDetails(void) const
+{
+  return this->numarenadetails;
+}
+
+/*!
+  Returns the number of heap allocations avoided by storing details in
+  the arena instead of as SoDetail instances.
+*/
+int
+SoRayPickCache::getNumAvoidedAllocations(void) const
+{
+  return this->numavoided;
+}
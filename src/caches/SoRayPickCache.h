@@ -0,0 +1,132 @@
+#ifndef COIN_SORAYPICKCACHE_H
+#define COIN_SORAYPICKCACHE_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* ! COIN_INTERNAL */
+
+#include <Inventor/caches/SoCache.h>
+#include <Inventor/SoPrimitiveVertex.h>
+#include <Inventor/details/SoPointDetail.h>
+#include <Inventor/lists/SbList.h>
+
+#include "base/SbBVH.h"
+
+class SoDetail;
+class SoFaceDetail;
+class SoLineDetail;
+
+class SoRayPickCache : public SoCache {
+  typedef SoCache inherited;
+public:
+  SoRayPickCache(SoState * state);
+
+  void addTriangle(const SoPrimitiveVertex * v0,
+                   const SoPrimitiveVertex * v1,
+                   const SoPrimitiveVertex * v2,
+                   SoDetail * detail);
+  void addLine(const SoPrimitiveVertex * v0,
+               const SoPrimitiveVertex * v1,
+               SoDetail * detail);
+  void addPoint(const SoPrimitiveVertex * v,
+                SoDetail * detail);
+
+  void addTriangle(const SoPrimitiveVertex * v0,
+                   const SoPrimitiveVertex * v1,
+                   const SoPrimitiveVertex * v2,
+                   const SoFaceDetail * face,
+                   const SoPointDetail * points,
+                   const int numpoints);
+  void addLine(const SoPrimitiveVertex * v0,
+               const SoPrimitiveVertex * v1,
+               const SoLineDetail * line,
+               const SoPointDetail * points);
+  void addPoint(const SoPrimitiveVertex * v,
+                const SoPointDetail * point);
+
+  void close(void);
+
+  int getNumTriangles(void) const;
+  const SoPrimitiveVertex * getTriangle(const int idx) const;
+  SoDetail * createTriangleDetail(const int idx) const;
+
+  int getNumLines(void) const;
+  const SoPrimitiveVertex * getLine(const int idx) const;
+  SoDetail * createLineDetail(const int idx) const;
+
+  int getNumPoints(void) const;
+  const SoPrimitiveVertex * getPoint(const int idx) const;
+  SoDetail * createPointDetail(const int idx) const;
+
+  const SbBVH & getTriangleBVH(void) const;
+
+  int getNumArenaDetails(void) const;
+  int getNumAvoidedAllocations(void) const;
+
+protected:
+  virtual ~SoRayPickCache();
+
+private:
+  // The detail of a primitive. Face, line and point details are
+  // stored by value, with their point details in the point arena,
+  // so that no heap allocations are needed per primitive. Details
+  // of other types are copies owned by the cache.
+  struct DetailRecord {
+    SoDetail * detail;
+    int index;
+    int partindex;
+    int firstpoint;
+    int numpoints;
+  };
+
+  void addVertices(SbList <SoPrimitiveVertex> & list,
+                   const SoPrimitiveVertex * const * v, const int num);
+  void addArenaDetail(SbList <DetailRecord> & list,
+                      const int index, const int partindex,
+                      const SoPointDetail * points, const int numpoints);
+
+  SbList <SoPrimitiveVertex> trianglevertices;
+  SbList <DetailRecord> triangledetails;
+  SbList <SoPrimitiveVertex> linevertices;
+  SbList <DetailRecord> linedetails;
+  SbList <SoPrimitiveVertex> pointvertices;
+  SbList <DetailRecord> pointdetails;
+  SbList <SoPointDetail> arenapoints;
+  int numarenadetails;
+  int numavoided;
+  SbBVH trianglebvh;
+};
+
+#endif // !COIN_SORAYPICKCACHE_H
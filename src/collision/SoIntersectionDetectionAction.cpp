@@ -43,6 +43,12 @@
   high-performance component in Coin.  Using it in a continuous manner
   over complex scene graphs is doomed to be a performance killer.
 
+  The triangles of each shape, and the bounding volume hierarchy used
+  to find candidate triangle pairs, are kept by the action between
+  apply() calls. They are reused as long as neither the shape, the
+  state it depends on nor its transformation has changed, so repeated
+  tests on a mostly static scene will be faster than the first one.
+
   Below is a simple usage example for this class.  It was written as a
   standalone framework set up for profiling and optimization of the
   SoIntersectionDetectionAction.  It tests intersection of all shapes
@@ -139,6 +145,7 @@
 #include <Inventor/SbTime.h>
 #include <Inventor/SbViewportRegion.h>
 #include <Inventor/SbXfBox3f.h>
+#include <Inventor/SoFullPath.h>
 #include <Inventor/SoPath.h>
 #include <Inventor/SoPrimitiveVertex.h>
 #include <Inventor/actions/SoCallbackAction.h>
@@ -146,6 +153,7 @@
 #include <Inventor/actions/SoGetPrimitiveCountAction.h>
 #include <Inventor/actions/SoWriteAction.h>
 #include <Inventor/caches/SoBoundingBoxCache.h>
+#include <Inventor/elements/SoCacheElement.h>
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/lists/SbPList.h>
 #include <Inventor/nodes/SoBaseColor.h>
@@ -157,6 +165,11 @@
 #include <Inventor/nodes/SoText2.h>
 #include <Inventor/nodes/SoTranslation.h>
 
+#ifdef HAVE_THREADS
+#include <Inventor/C/threads/wpool.h>
+#include <Inventor/threads/SbMutex.h>
+#endif // HAVE_THREADS
+
 #ifdef HAVE_DRAGGERS
 #include <Inventor/draggers/SoDragger.h>
 #endif // HAVE_DRAGGERS
@@ -170,6 +183,7 @@
 #endif // HAVE_MANIPULATORS
 
 #include "actions/SoSubActionP.h"
+#include "base/SbBVH.h"
 #include "collision/SbTri3f.h"
 #include "coindefs.h"
 
@@ -180,7 +194,9 @@
 
 #include "SbBasicP.h"
 
+#include <algorithm>
 #include <list>
+#include <map>
 #include <vector>
 
 // *************************************************************************
@@ -213,6 +229,9 @@
 
 class ShapeData;
 class PrimitiveData;
+class IntersectionJob;
+
+typedef void ida_parallel_task_f(void * closure, const int idx);
 
 class SoIntersectionDetectionAction :: PImpl {
 public:
@@ -228,6 +247,12 @@ public:
   SbBool manipsenabled;
   SbBool internalsenabled;
 
+  int numthreads;
+#ifdef HAVE_THREADS
+  cc_wpool * pool;
+  void runParallel(ida_parallel_task_f * func, void * closure, const int numtasks);
+#endif // HAVE_THREADS
+
   SoIntersectionDetectionAction::SoIntersectionFilterCB * filtercb;
   void * filterclosure;
   
@@ -245,9 +270,29 @@ public:
   static SoCallbackAction::Response pruneCB(void * closure, SoCallbackAction * action, const SoNode * node);
 
   void reset(void);
+  void finish(void);
+  void releaseShapeData(void);
   void doIntersectionTesting(void);
   void doPrimitiveIntersectionTesting(PrimitiveData * primitives1, PrimitiveData * primitives2, SbBool & cont);
   void doInternalPrimitiveIntersectionTesting(PrimitiveData * primitives, SbBool & cont);
+  void doParallelPrimitiveIntersectionTesting(SbList<IntersectionJob*> & jobs);
+  SoIntersectionDetectionAction::Resp invokeCallbacks(const SoIntersectingPrimitive * p1,
+                                                      const SoIntersectingPrimitive * p2);
+
+  struct SerialHitData {
+    PImpl * thisp;
+    PrimitiveData * primitives1;
+    PrimitiveData * primitives2;
+    SoIntersectionDetectionAction::Resp resp;
+    unsigned int nrhits;
+  };
+  static SbBool serialHitCB(void * closure, SbTri3f * t1, SbTri3f * t2);
+
+  // primitive data from earlier apply() calls, for each shape
+  typedef std::map<const SoShape *, std::vector<PrimitiveData *> > PrimitiveCache;
+  PrimitiveCache primitivecache;
+  PrimitiveData * getPrimitiveData(SoState * state, const SoPath * path, const SbMatrix & transform);
+  void prunePrimitiveCache(const SbBool all);
 
   SoTypeList * prunetypes;
 
@@ -269,6 +314,10 @@ SoIntersectionDetectionAction::PImpl::PImpl(void)
   this->draggersenabled = TRUE;
   this->manipsenabled = TRUE;
   this->internalsenabled = FALSE;
+  this->numthreads = 1;
+#ifdef HAVE_THREADS
+  this->pool = NULL;
+#endif // HAVE_THREADS
   this->filtercb = NULL;
   this->filterclosure = NULL;
   this->traverser = NULL;
@@ -279,9 +328,13 @@ SoIntersectionDetectionAction::PImpl::PImpl(void)
 SoIntersectionDetectionAction::PImpl::~PImpl(void)
 {
   this->reset();
+  this->prunePrimitiveCache(TRUE);
   delete this->traverser;
   delete this->prunetypes;
   delete this->traversaltypes;
+#ifdef HAVE_THREADS
+  if (this->pool) { cc_wpool_destruct(this->pool); }
+#endif // HAVE_THREADS
 }
 
 float
@@ -542,6 +595,54 @@ SoIntersectionDetectionAction::isShapeInternalsEnabled(void) const
   return PRIVATE(this)->internalsenabled;
 }
 
+/*!
+  Sets the number of threads to use for the primitive intersection
+  tests. With more than one thread, the primitives of all candidate
+  shape pairs are tested in parallel by a pool of worker threads, and
+  the intersecting primitives are passed on to the intersection
+  callbacks afterwards.
+
+  The intersection callbacks are always invoked from the thread
+  calling apply(), and in the same order as when only one thread is
+  used. The filter callback will however be invoked for all shape
+  pairs before the intersection callbacks are invoked.
+
+  This setting is ignored if Coin was built without support for
+  threads.
+
+  Default is 1.
+
+  \sa getNumThreads()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+
+void
+SoIntersectionDetectionAction::setNumThreads(int numthreads)
+{
+  assert(numthreads >= 1);
+  PRIVATE(this)->numthreads = numthreads;
+}
+
+/*!
+  Returns the number of threads used for primitive intersection
+  testing.
+
+  \sa setNumThreads()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+
+int
+SoIntersectionDetectionAction::getNumThreads(void) const
+{
+  return PRIVATE(this)->numthreads;
+}
+
 /*!
   The scene graph traversal can be controlled with callbacks which
   you set with this method.  Use just like you would use
@@ -695,6 +796,7 @@ SoIntersectionDetectionAction::apply(SoNode * node)
   }
 
   PRIVATE(this)->doIntersectionTesting();
+  PRIVATE(this)->finish();
 
   if (ida_debug()) { // debug
     SoDebugError::postInfo("SoIntersectionDetectionAction::apply",
@@ -717,6 +819,7 @@ SoIntersectionDetectionAction::apply(SoPath * path)
 
   PRIVATE(this)->traverser->apply(path);
   PRIVATE(this)->doIntersectionTesting();
+  PRIVATE(this)->finish();
 }
 
 void
@@ -733,74 +836,72 @@ SoIntersectionDetectionAction::apply(const SoPathList & paths, SbBool obeysRules
 
   PRIVATE(this)->traverser->apply(paths, obeysRules);
   PRIVATE(this)->doIntersectionTesting();
+  PRIVATE(this)->finish();
 }
 
 // *************************************************************************
 
+// The triangles of a shape, in world space. The primitive data is
+// kept between apply() calls, and is reused for as long as the shape,
+// the elements it depends on and its transformation are unchanged.
+// No references are held to the nodes of the shape path between
+// apply() calls, so the path is recognized from its nodes and child
+// indices, and the node id of the shape.
 class PrimitiveData {
 public:
-  PrimitiveData(void)
+  PrimitiveData(SoPath * path, const SbMatrix & transform)
   {
-    this->path = NULL;
-    this->octtree = NULL;
+    const SoFullPath * fullpath = reclassify_cast<const SoFullPath *>(path);
+    for (int i = 0; i < fullpath->getLength(); i++) {
+      this->nodes.append(fullpath->getNode(i));
+      this->indices.append(fullpath->getIndex(i));
+    }
+    this->path = path;
+    this->transform = transform;
+    this->invtransform = transform.inverse();
+    this->cache = NULL;
+    this->nodeid = fullpath->getTail()->getNodeId();
+    this->generated = FALSE;
+    this->bvhbuilt = FALSE;
+    this->used = FALSE;
   }
 
   ~PrimitiveData()
   {
-    delete this->octtree;
     for (unsigned int i = 0; i < this->numTriangles(); i++) { delete this->getTriangle(i); }
+    if (this->cache) { this->cache->unref(); }
   }
 
+  SbBool matches(const SoPath * path) const;
 
-  const SbOctTree * getOctTree(void) {
-    if (this->octtree == NULL) {
-      const SbOctTreeFuncs funcs = {
-        NULL /* ptinsidefunc */,
-        PrimitiveData::insideboxfunc,
-        NULL /* insidespherefunc */,
-        NULL /* insideplanesfunc */
-      };
-
-      SbBox3f b = this->getBoundingBox();
-      // Add a 1% slack to the bounding box, to avoid problems in
-      // SbOctTree due to floating point inaccuracies (see assert() in
-      // SbOctTree::addItem()).
-      //
-      // This may be just a temporary hack -- see the FIXME at the
-      // same place as mentioned above.
-      SbMatrix m;
-      m.setTransform(SbVec3f(0, 0, 0), // translation
-                     SbRotation::identity(), // rotation
-                     SbVec3f(1.01f, 1.01f, 1.01f), // scalefactor
-                     SbRotation::identity(), // scaleorientation
-                     SbVec3f(b.getCenter())); // center
-      b.transform(m);
-
-      this->octtree = new SbOctTree(b, funcs);
+  void generate(void);
+  SbBool isGenerated(void) const { return this->generated; }
+  SbBool isValid(SoState * state, const SbMatrix & matrix) const;
 
-      if (ida_debug()) {
-        SoDebugError::postInfo("PrimitiveData::getOctTree",
-                               "made new octtree for PrimitiveData %p", this);
+  const SbBVH & getBVH(void) {
+    if (!this->bvhbuilt) {
+      const int numtris = this->triangles.getLength();
+      SbBox3f * boxes = new SbBox3f[numtris];
+      for (int i = 0; i < numtris; i++) {
+        boxes[i] = this->triangles[i]->getBoundingBox();
       }
+      this->bvh.build(boxes, numtris);
+      delete[] boxes;
+      this->bvhbuilt = TRUE;
 
-      for (unsigned int k = 0; k < this->numTriangles(); k++) {
-        SbTri3f * t = this->getTriangle(k);
-        this->octtree->addItem(t);
+      if (ida_debug()) {
+        SoDebugError::postInfo("PrimitiveData::getBVH",
+                               "made new BVH for PrimitiveData %p", this);
       }
     }
-    return this->octtree;
+    return this->bvh;
   }
+  SbBool hasBVH(void) const { return this->bvhbuilt; }
 
-
-  void setPath(SoPath * p) { this->path = p; }
+  // the path is only set while the primitive data is used by an
+  // apply(), and is owned by the ShapeData of that apply()
   SoPath * getPath(void) const { return this->path; }
-
-  void addTriangle(SbTri3f * t)
-  {
-    assert(this->octtree == NULL && "all triangles must be added before making octtree");
-    this->triangles.append(t);
-    this->bbox.extendBy(t->getBoundingBox());
-  }
+  void setPath(SoPath * path) { this->path = path; }
 
   unsigned int numTriangles(void) const { return this->triangles.getLength(); }
   SbTri3f * getTriangle(const int idx) const { return this->triangles[idx]; }
@@ -810,55 +911,69 @@ public:
   SbMatrix transform;
   SbMatrix invtransform;
 
+  // set for primitive data which has been used by the current apply()
+  SbBool used;
+
 private:
-  static SbBool insideboxfunc(void * const item, const SbBox3f & box);
+  void addTriangle(SbTri3f * t)
+  {
+    this->triangles.append(t);
+    this->bbox.extendBy(t->getBoundingBox());
+  }
+
+  static SoCallbackAction::Response preShapeCB(void * closure, SoCallbackAction * action, const SoNode * node);
+  static SoCallbackAction::Response postShapeCB(void * closure, SoCallbackAction * action, const SoNode * node);
+  static void triangleCB(void * closure, SoCallbackAction *,
+                         const SoPrimitiveVertex * v1,
+                         const SoPrimitiveVertex * v2,
+                         const SoPrimitiveVertex * v3);
 
   SoPath * path;
+  SbList<const SoNode *> nodes;
+  SbList<int> indices;
   SbList<SbTri3f*> triangles;
   SbBox3f bbox;
-  SbOctTree * octtree;
+  SbBVH bvh;
+  SbBool bvhbuilt;
+  SbBool generated;
+  // records the elements the primitives depend on
+  SoCache * cache;
+  uint32_t nodeid;
 };
 
-SbBool
-PrimitiveData::insideboxfunc(void * const item, const SbBox3f & box)
+// Opens a cache before the shape generates its primitives, so we
+// get hold of the elements the primitives depend on.
+SoCallbackAction::Response
+PrimitiveData::preShapeCB(void * closure, SoCallbackAction * action, const SoNode * node)
 {
-  SbTri3f * tri = static_cast<SbTri3f *>(item);
-  return box.intersect(tri->getBoundingBox());
-}
-
-// *************************************************************************
-
-class ShapeData {
-public:
-  ShapeData(void)
-  {
-    this->primitives = NULL;
+  PrimitiveData * primitives = static_cast<PrimitiveData *>(closure);
+  if (node == primitives->path->getTail()) {
+    SoState * state = action->getState();
+    // must push state to make cache dependencies work
+    state->push();
+    assert(primitives->cache == NULL);
+    primitives->cache = new SoCache(state);
+    primitives->cache->ref();
+    SoCacheElement::set(state, primitives->cache);
   }
+  return SoCallbackAction::CONTINUE;
+}
 
-  ~ShapeData()
-  {
-    delete this->primitives;
+SoCallbackAction::Response
+PrimitiveData::postShapeCB(void * closure, SoCallbackAction * action, const SoNode * node)
+{
+  PrimitiveData * primitives = static_cast<PrimitiveData *>(closure);
+  if (node == primitives->path->getTail()) {
+    action->getState()->pop();
   }
-
-  PrimitiveData * getPrimitives(void);
-
-  SoPath * path;
-  SbXfBox3f xfbbox;
-
-private:
-  static void triangleCB(void * closure, SoCallbackAction *,
-                         const SoPrimitiveVertex * v1,
-                         const SoPrimitiveVertex * v2,
-                         const SoPrimitiveVertex * v3);
-
-  PrimitiveData * primitives;
-};
+  return SoCallbackAction::CONTINUE;
+}
 
 void
-ShapeData::triangleCB(void * closure, SoCallbackAction *,
-                      const SoPrimitiveVertex * v1,
-                      const SoPrimitiveVertex * v2,
-                      const SoPrimitiveVertex * v3)
+PrimitiveData::triangleCB(void * closure, SoCallbackAction *,
+                          const SoPrimitiveVertex * v1,
+                          const SoPrimitiveVertex * v2,
+                          const SoPrimitiveVertex * v3)
 {
   PrimitiveData * primitives = static_cast<PrimitiveData *>(closure);
   const SbVec3f & oa = v1->getPoint();
@@ -879,7 +994,7 @@ ShapeData::triangleCB(void * closure, SoCallbackAction *,
     static SbBool warn = TRUE;
     if (warn) {
       warn = FALSE;
-      SoDebugError::postWarning("ShapeData::triangleCB",
+      SoDebugError::postWarning("PrimitiveData::triangleCB",
                                 "Found an invalid triangle while souping up "
                                 "triangle primitives from a shape for "
                                 "intersection testing. Transformed=="
@@ -898,21 +1013,401 @@ ShapeData::triangleCB(void * closure, SoCallbackAction *,
   }
 }
 
-PrimitiveData *
-ShapeData::getPrimitives(void)
+void
+PrimitiveData::generate(void)
 {
-  if (this->primitives) { return this->primitives; }
-
-  this->primitives = new PrimitiveData;
-  this->primitives->setPath(this->path);
-  this->primitives->transform = this->xfbbox.getTransform();
-  this->primitives->invtransform = primitives->transform.inverse();
+  assert(!this->generated);
   SoCallbackAction generator;
+  generator.addPreCallback(SoShape::getClassTypeId(),
+                           PrimitiveData::preShapeCB,
+                           this);
+  generator.addPostCallback(SoShape::getClassTypeId(),
+                            PrimitiveData::postShapeCB,
+                            this);
   generator.addTriangleCallback(SoShape::getClassTypeId(),
-                                ShapeData::triangleCB,
-                                this->primitives);
+                                PrimitiveData::triangleCB,
+                                this);
+  SbBool storedinvalid = SoCacheElement::setInvalid(FALSE);
   generator.apply(this->path);
-  return this->primitives;
+  SoCacheElement::setInvalid(storedinvalid);
+  this->generated = TRUE;
+}
+
+// Checks whether the primitive data was made for the same path.
+SbBool
+PrimitiveData::matches(const SoPath * path) const
+{
+  const SoFullPath * fullpath = reclassify_cast<const SoFullPath *>(path);
+  const int len = fullpath->getLength();
+  if (len != this->nodes.getLength()) return FALSE;
+  for (int i = len - 1; i >= 0; i--) {
+    if (fullpath->getNode(i) != this->nodes[i] ||
+        fullpath->getIndex(i) != this->indices[i]) return FALSE;
+  }
+  return TRUE;
+}
+
+// Checks whether the primitives can be reused for the shape at the
+// end of the path. The state must be the traversal state at the
+// shape.
+SbBool
+PrimitiveData::isValid(SoState * state, const SbMatrix & matrix) const
+{
+  return
+    this->generated &&
+    this->cache && this->cache->isValid(state) &&
+    this->nodeid == this->path->getTail()->getNodeId() &&
+    this->transform == matrix;
+}
+
+// *************************************************************************
+
+class ShapeData {
+public:
+  ShapeData(void)
+  {
+    this->primitives = NULL;
+  }
+
+  PrimitiveData * getPrimitives(void)
+  {
+    if (!this->primitives->isGenerated()) { this->primitives->generate(); }
+    return this->primitives;
+  }
+
+  SoPath * path;
+  SbXfBox3f xfbbox;
+  // owned by the primitive data cache of the action
+  PrimitiveData * primitives;
+};
+
+// *************************************************************************
+
+typedef SbBool ida_hit_f(void * closure, SbTri3f * t1, SbTri3f * t2);
+
+// Sorts a list of triangle indices, so triangles are tested in the
+// same order regardless of how they are stored in the BVH.
+static void
+ida_sort_indices(SbList<int> & indices)
+{
+  int * ptr = const_cast<int *>(indices.getArrayPtr());
+  std::sort(ptr, ptr + indices.getLength());
+}
+
+// Finds intersecting triangles between two shapes. Both shapes are
+// first queried for the triangles inside the overlap of their
+// bounding boxes, then each of those triangles from iterationprims
+// is tested against the triangles from the BVH of bvhprims. The hits
+// are reported to hitcb in the order of the triangle indices. Returns
+// FALSE if hitcb asked us to stop.
+static SbBool
+ida_find_intersections(PrimitiveData * iterationprims,
+                       PrimitiveData * bvhprims,
+                       const float epsilon,
+                       ida_hit_f * hitcb, void * closure,
+                       unsigned int & nrisectchks)
+{
+  const SbBox3f & box1 = iterationprims->getBoundingBox();
+  const SbBox3f & box2 = bvhprims->getBoundingBox();
+  if (box1.isEmpty() || box2.isEmpty()) { return TRUE; }
+
+  SbVec3f overlapmin, overlapmax;
+  for (int k = 0; k < 3; k++) {
+    overlapmin[k] = SbMax(box1.getMin()[k], box2.getMin()[k]) - epsilon;
+    overlapmax[k] = SbMin(box1.getMax()[k], box2.getMax()[k]) + epsilon;
+    if (overlapmin[k] > overlapmax[k]) { return TRUE; }
+  }
+  const SbBox3f overlap(overlapmin, overlapmax);
+
+  const SbBVH & bvh = bvhprims->getBVH();
+  if (!bvh.getBoundingBox().intersect(overlap)) { return TRUE; }
+
+  SbList<int> iterationtris;
+  iterationprims->getBVH().findItems(overlap, iterationtris);
+  ida_sort_indices(iterationtris);
+
+  const SbVec3f e(epsilon, epsilon, epsilon);
+  SbList<int> candidatetris;
+  for (int i = 0; i < iterationtris.getLength(); i++) {
+    SbTri3f * t1 = iterationprims->getTriangle(iterationtris[i]);
+
+    SbBox3f tribbox = t1->getBoundingBox();
+    if (epsilon > 0.0f) {
+      // Extend bbox in all 6 directions with the epsilon value.
+      tribbox.getMin() -= e;
+      tribbox.getMax() += e;
+    }
+
+    candidatetris.truncate(0);
+    bvh.findItems(tribbox, candidatetris);
+    ida_sort_indices(candidatetris);
+
+    for (int j = 0; j < candidatetris.getLength(); j++) {
+      SbTri3f * t2 = bvhprims->getTriangle(candidatetris[j]);
+      nrisectchks++;
+      if (t1->intersect(*t2, epsilon)) {
+        if (!hitcb(closure, t1, t2)) { return FALSE; }
+      }
+    }
+  }
+  return TRUE;
+}
+
+// Finds intersecting triangles within a shape, using the BVH of the
+// shape. Triangles are not tested against themselves, and each pair
+// is only tested once. Returns FALSE if hitcb asked us to stop.
+static SbBool
+ida_find_internal_intersections(PrimitiveData * primitives,
+                                ida_hit_f * hitcb, void * closure,
+                                unsigned int & nrisectchks)
+{
+  const SbBVH & bvh = primitives->getBVH();
+  SbList<int> candidatetris;
+  const int numprimitives = primitives->numTriangles();
+  for (int i = 0; i < numprimitives; i++) {
+    SbTri3f * t1 = primitives->getTriangle(i);
+    candidatetris.truncate(0);
+    bvh.findItems(t1->getBoundingBox(), candidatetris);
+    ida_sort_indices(candidatetris);
+
+    for (int j = 0; j < candidatetris.getLength(); j++) {
+      if (candidatetris[j] <= i) { continue; }
+      SbTri3f * t2 = primitives->getTriangle(candidatetris[j]);
+      nrisectchks++;
+      if (t1->intersect(*t2)) {
+        if (!hitcb(closure, t1, t2)) { return FALSE; }
+      }
+    }
+  }
+  return TRUE;
+}
+
+// *************************************************************************
+
+// The primitive intersection testing for a pair of shapes, or for a
+// single shape when testing for self-intersections, for running in a
+// worker thread. Intersecting triangles are stored pair-wise in the
+// hits list, in the same order as they are found by the serial code.
+class IntersectionJob {
+public:
+  IntersectionJob(PrimitiveData * iterationprims, PrimitiveData * bvhprims)
+  {
+    this->iterationprims = iterationprims;
+    this->bvhprims = bvhprims;
+  }
+
+  void findIntersections(const float epsilon);
+
+  PrimitiveData * iterationprims;
+  PrimitiveData * bvhprims; // NULL for self-intersection testing
+  SbList<SbTri3f*> hits;
+
+private:
+  static SbBool hitCB(void * closure, SbTri3f * t1, SbTri3f * t2);
+};
+
+SbBool
+IntersectionJob::hitCB(void * closure, SbTri3f * t1, SbTri3f * t2)
+{
+  IntersectionJob * job = static_cast<IntersectionJob *>(closure);
+  job->hits.append(t1);
+  job->hits.append(t2);
+  return TRUE;
+}
+
+void
+IntersectionJob::findIntersections(const float epsilon)
+{
+  // The BVHs must be made in advance, as it is not safe to make them
+  // from several threads at once.
+  unsigned int nrisectchks = 0;
+  if (this->bvhprims == NULL) {
+    assert(this->iterationprims->hasBVH());
+    (void) ida_find_internal_intersections(this->iterationprims,
+                                           IntersectionJob::hitCB, this,
+                                           nrisectchks);
+  }
+  else {
+    assert(this->iterationprims->hasBVH() && this->bvhprims->hasBVH());
+    (void) ida_find_intersections(this->iterationprims, this->bvhprims, epsilon,
+                                  IntersectionJob::hitCB, this,
+                                  nrisectchks);
+  }
+}
+
+// Fills in the intersecting primitive struct for a triangle from the
+// given primitive data.
+static void
+ida_set_primitive(SoIntersectingPrimitive & p, const PrimitiveData * primitives,
+                  const SbTri3f * t)
+{
+  p.path = primitives->getPath();
+  p.type = SoIntersectingPrimitive::TRIANGLE;
+  t->getValue(p.xf_vertex[0], p.xf_vertex[1], p.xf_vertex[2]);
+  primitives->invtransform.multVecMatrix(p.xf_vertex[0], p.vertex[0]);
+  primitives->invtransform.multVecMatrix(p.xf_vertex[1], p.vertex[1]);
+  primitives->invtransform.multVecMatrix(p.xf_vertex[2], p.vertex[2]);
+}
+
+// Invokes the intersection callbacks until one of them returns
+// something else than NEXT_PRIMITIVE.
+SoIntersectionDetectionAction::Resp
+SoIntersectionDetectionAction::PImpl::invokeCallbacks(const SoIntersectingPrimitive * p1,
+                                                      const SoIntersectingPrimitive * p2)
+{
+  std::vector<SoIntersectionCallback>::iterator it = this->callbacks.begin();
+  while (it != this->callbacks.end()) {
+    const SoIntersectionDetectionAction::Resp resp = (*it).first((*it).second, p1, p2);
+    switch (resp) {
+    case SoIntersectionDetectionAction::NEXT_PRIMITIVE:
+      // Break out of the switch, invoke next callback.
+      break;
+    case SoIntersectionDetectionAction::NEXT_SHAPE:
+    case SoIntersectionDetectionAction::ABORT:
+      // FIXME: remaining callbacks won't be invoked -- should they? 20030328 mortene.
+      return resp;
+    default:
+      assert(0);
+    }
+    ++it;
+  }
+  return SoIntersectionDetectionAction::NEXT_PRIMITIVE;
+}
+
+#ifdef HAVE_THREADS
+
+typedef struct {
+  ida_parallel_task_f * func;
+  void * closure;
+  int numtasks;
+  int nexttask;
+  SbMutex mutex;
+} ida_parallel_data;
+
+// Worker thread function, which runs tasks until there are no more
+// tasks left.
+static void
+ida_parallel_worker(void * closure)
+{
+  ida_parallel_data * data = static_cast<ida_parallel_data *>(closure);
+  for (;;) {
+    data->mutex.lock();
+    const int idx = data->nexttask++;
+    data->mutex.unlock();
+    if (idx >= data->numtasks) { break; }
+    data->func(data->closure, idx);
+  }
+}
+
+// Runs func(closure, idx) for idx = [0, numtasks> in the worker
+// pool, and waits for all tasks to finish.
+void
+SoIntersectionDetectionAction::PImpl::runParallel(ida_parallel_task_f * func,
+                                                  void * closure,
+                                                  const int numtasks)
+{
+  if (this->pool == NULL) {
+    this->pool = cc_wpool_construct(this->numthreads);
+  }
+  else if (cc_wpool_get_num_workers(this->pool) != this->numthreads) {
+    cc_wpool_set_num_workers(this->pool, this->numthreads);
+  }
+
+  ida_parallel_data data;
+  data.func = func;
+  data.closure = closure;
+  data.numtasks = numtasks;
+  data.nexttask = 0;
+
+  const int numworkers = SbMin(this->numthreads, numtasks);
+  cc_wpool_begin(this->pool, numworkers);
+  for (int i = 0; i < numworkers; i++) {
+    cc_wpool_start_worker(this->pool, ida_parallel_worker, &data);
+  }
+  cc_wpool_end(this->pool);
+  cc_wpool_wait_all(this->pool);
+}
+
+static void
+ida_make_bvh_task(void * closure, const int idx)
+{
+  std::vector<PrimitiveData *> * primitives =
+    static_cast<std::vector<PrimitiveData *> *>(closure);
+  (void) (*primitives)[idx]->getBVH();
+}
+
+typedef struct {
+  IntersectionJob * const * jobs;
+  float epsilon;
+} ida_job_batch;
+
+static void
+ida_job_task(void * closure, const int idx)
+{
+  ida_job_batch * batch = static_cast<ida_job_batch *>(closure);
+  batch->jobs[idx]->findIntersections(batch->epsilon);
+}
+
+// Number of shape pairs tested in parallel before the intersection
+// callbacks are invoked, so the memory usage for the hits is bounded
+// and so we can bail out early on ABORT.
+static const int IDA_JOB_BATCH_SIZE = 256;
+
+#endif // HAVE_THREADS
+
+// Tests the shape pairs in the worker pool, and invokes the
+// intersection callbacks in the same order as the serial code would.
+void
+SoIntersectionDetectionAction::PImpl::doParallelPrimitiveIntersectionTesting(SbList<IntersectionJob*> & jobs)
+{
+#ifdef HAVE_THREADS
+  int i;
+  const int numjobs = jobs.getLength();
+
+  // The primitives are generated by scene graph traversals, so that
+  // is done from this thread, while the BVHs can be made in
+  // parallel.
+  std::vector<PrimitiveData *> bvhprims;
+  for (i = 0; i < numjobs; i++) {
+    PrimitiveData * prims = jobs[i]->iterationprims;
+    if (!prims->hasBVH()) { bvhprims.push_back(prims); }
+    prims = jobs[i]->bvhprims;
+    if (prims && !prims->hasBVH()) { bvhprims.push_back(prims); }
+  }
+  std::sort(bvhprims.begin(), bvhprims.end());
+  bvhprims.erase(std::unique(bvhprims.begin(), bvhprims.end()),
+                 bvhprims.end());
+  if (!bvhprims.empty()) {
+    this->runParallel(ida_make_bvh_task, &bvhprims,
+                      static_cast<int>(bvhprims.size()));
+  }
+
+  ida_job_batch batch;
+  batch.epsilon = this->getEpsilon();
+
+  for (int start = 0; start < numjobs; start += IDA_JOB_BATCH_SIZE) {
+    const int end = SbMin(start + IDA_JOB_BATCH_SIZE, numjobs);
+    batch.jobs = jobs.getArrayPtr() + start;
+    this->runParallel(ida_job_task, &batch, end - start);
+
+    for (i = start; i < end; i++) {
+      IntersectionJob * job = jobs[i];
+      const PrimitiveData * prims2 =
+        job->bvhprims ? job->bvhprims : job->iterationprims;
+      for (int j = 0; j < job->hits.getLength(); j += 2) {
+        SoIntersectingPrimitive p1, p2;
+        ida_set_primitive(p1, job->iterationprims, job->hits[j]);
+        ida_set_primitive(p2, prims2, job->hits[j + 1]);
+        const SoIntersectionDetectionAction::Resp resp = this->invokeCallbacks(&p1, &p2);
+        if (resp == SoIntersectionDetectionAction::NEXT_SHAPE) { break; }
+        if (resp == SoIntersectionDetectionAction::ABORT) { return; }
+      }
+      job->hits.truncate(0, TRUE);
+    }
+  }
+#else // !HAVE_THREADS
+  assert(0 && "parallel intersection testing requires thread support");
+#endif // !HAVE_THREADS
 }
 
 // *************************************************************************
@@ -937,6 +1432,8 @@ SoIntersectionDetectionAction::PImpl::shape(SoCallbackAction * action, SoShape *
   data->path->ref();
   data->xfbbox = bbox;
   data->xfbbox.setTransform(action->getModelMatrix());
+  data->primitives = this->getPrimitiveData(action->getState(), data->path,
+                                            action->getModelMatrix());
   this->shapedata.append(data);
   return SoCallbackAction::CONTINUE;
 }
@@ -1005,15 +1502,31 @@ SoIntersectionDetectionAction::PImpl::pruneCB(void *, SoCallbackAction *, const
 }
 
 void
-SoIntersectionDetectionAction::PImpl::reset(void)
+SoIntersectionDetectionAction::PImpl::releaseShapeData(void)
 {
-  int i;
-  for (i = 0; i < this->shapedata.getLength(); i++) {
+  for (int i = 0; i < this->shapedata.getLength(); i++) {
     ShapeData * data = this->shapedata[i];
     data->path->unref();
     delete data;
   }
   this->shapedata.truncate(0);
+}
+
+// Releases the shape paths at the end of an apply(), so the scene
+// isn't kept alive by the action, and drops the primitive data which
+// wasn't used.
+void
+SoIntersectionDetectionAction::PImpl::finish(void)
+{
+  this->releaseShapeData();
+  this->prunePrimitiveCache(FALSE);
+}
+
+void
+SoIntersectionDetectionAction::PImpl::reset(void)
+{
+  int i;
+  this->releaseShapeData();
   delete this->traverser;
   this->traverser = new SoCallbackAction;
 #ifdef HAVE_DRAGGERS
@@ -1029,6 +1542,63 @@ SoIntersectionDetectionAction::PImpl::reset(void)
                                   shapeCB, this);
 }
 
+// Returns the primitive data for the shape at the end of the path,
+// reusing the primitive data from an earlier apply() if the shape is
+// unchanged.
+PrimitiveData *
+SoIntersectionDetectionAction::PImpl::getPrimitiveData(SoState * state,
+                                                       const SoPath * path,
+                                                       const SbMatrix & transform)
+{
+  const SoShape * shape = coin_assert_cast<const SoShape *>(path->getTail());
+  std::vector<PrimitiveData *> & entries = this->primitivecache[shape];
+  std::vector<PrimitiveData *>::iterator it = entries.begin();
+  while (it != entries.end()) {
+    PrimitiveData * primitives = *it;
+    if (primitives->matches(path)) {
+      primitives->setPath(const_cast<SoPath *>(path));
+      if (!primitives->used && primitives->isValid(state, transform)) {
+        primitives->used = TRUE;
+        return primitives;
+      }
+      delete primitives;
+      entries.erase(it);
+      break;
+    }
+    ++it;
+  }
+
+  PrimitiveData * primitives = new PrimitiveData(const_cast<SoPath *>(path), transform);
+  primitives->used = TRUE;
+  entries.push_back(primitives);
+  return primitives;
+}
+
+// Deletes the primitive data which was not used by the last apply(),
+// or all primitive data if all is TRUE.
+void
+SoIntersectionDetectionAction::PImpl::prunePrimitiveCache(const SbBool all)
+{
+  PrimitiveCache::iterator it = this->primitivecache.begin();
+  while (it != this->primitivecache.end()) {
+    std::vector<PrimitiveData *> & entries = it->second;
+    std::vector<PrimitiveData *>::iterator entry = entries.begin();
+    while (entry != entries.end()) {
+      if (all || !(*entry)->used) {
+        delete *entry;
+        entry = entries.erase(entry);
+      }
+      else {
+        (*entry)->used = FALSE;
+        (*entry)->setPath(NULL);
+        ++entry;
+      }
+    }
+    if (entries.empty()) { this->primitivecache.erase(it++); }
+    else { ++it; }
+  }
+}
+
 #if 0 //Do not compile debug functions normally
 
 // This is a helper function for debugging purposes: it sets up an
@@ -1219,6 +1789,13 @@ SoIntersectionDetectionAction::PImpl::doIntersectionTesting(void)
 
   const float theepsilon = this->getEpsilon();
 
+#ifdef HAVE_THREADS
+  const SbBool parallel = this->numthreads > 1;
+#else // !HAVE_THREADS
+  const SbBool parallel = FALSE;
+#endif // !HAVE_THREADS
+  SbList<IntersectionJob*> jobs;
+
   for (int i = 0; i < this->shapedata.getLength(); i++) {
     ShapeData * shape1 = this->shapedata[i];
 
@@ -1234,9 +1811,14 @@ SoIntersectionDetectionAction::PImpl::doIntersectionTesting(void)
     // FIXME: shouldn't we also invoke the filter-callback here? 20030403 mortene.
     if (this->internalsenabled) {
       nrselfisects++;
-      SbBool cont;
-      this->doInternalPrimitiveIntersectionTesting(shape1->getPrimitives(), cont);
-      if (!cont) { goto done; }
+      if (parallel) {
+        jobs.append(new IntersectionJob(shape1->getPrimitives(), NULL));
+      }
+      else {
+        SbBool cont;
+        this->doInternalPrimitiveIntersectionTesting(shape1->getPrimitives(), cont);
+        if (!cont) { goto done; }
+      }
     }
 
     SbBox3f shapebbox = shape1->xfbbox.project();
@@ -1300,13 +1882,32 @@ SoIntersectionDetectionAction::PImpl::doIntersectionTesting(void)
       if (!this->filtercb ||
           this->filtercb(this->filterclosure, shape1->path, shape2->path)) {
         nrshapeshapeisects++;
-        SbBool cont;
-        this->doPrimitiveIntersectionTesting(shape1->getPrimitives(), shape2->getPrimitives(), cont);
-        if (!cont) { goto done; }
+        if (parallel) {
+          // Use the BVH of the majority size shape, as in
+          // doPrimitiveIntersectionTesting().
+          PrimitiveData * primitives1 = shape1->getPrimitives();
+          PrimitiveData * primitives2 = shape2->getPrimitives();
+          if (primitives1->numTriangles() < primitives2->numTriangles()) {
+            jobs.append(new IntersectionJob(primitives1, primitives2));
+          }
+          else {
+            jobs.append(new IntersectionJob(primitives2, primitives1));
+          }
+        }
+        else {
+          SbBool cont;
+          this->doPrimitiveIntersectionTesting(shape1->getPrimitives(), shape2->getPrimitives(), cont);
+          if (!cont) { goto done; }
+        }
       }
     }
   }
 
+  if (parallel) {
+    this->doParallelPrimitiveIntersectionTesting(jobs);
+    for (int j = 0; j < jobs.getLength(); j++) { delete jobs[j]; }
+  }
+
  done:
   if (ida_debug()) {
     SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doIntersectionTesting",
@@ -1315,14 +1916,27 @@ SoIntersectionDetectionAction::PImpl::doIntersectionTesting(void)
   }
 }
 
+SbBool
+SoIntersectionDetectionAction::PImpl::serialHitCB(void * closure, SbTri3f * t1, SbTri3f * t2)
+{
+  SerialHitData * data = static_cast<SerialHitData *>(closure);
+  data->nrhits++;
+
+  SoIntersectingPrimitive p1;
+  ida_set_primitive(p1, data->primitives1, t1);
+  SoIntersectingPrimitive p2;
+  ida_set_primitive(p2, data->primitives2, t2);
+
+  data->resp = data->thisp->invokeCallbacks(&p1, &p2);
+  return data->resp == SoIntersectionDetectionAction::NEXT_PRIMITIVE;
+}
+
 // Intersection testing between primitives of different shapes.
 void
 SoIntersectionDetectionAction::PImpl::doPrimitiveIntersectionTesting(PrimitiveData * primitives1,
                                                              PrimitiveData * primitives2,
                                                              SbBool & cont)
 {
-  cont = TRUE;
-
   // for debugging
   if (ida_debug()) {
     SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doPrimitiveIntersectionTesting",
@@ -1331,85 +1945,30 @@ SoIntersectionDetectionAction::PImpl::doPrimitiveIntersectionTesting(PrimitiveDa
                            primitives2, primitives2->numTriangles());
   }
   unsigned int nrisectchks = 0;
-  unsigned int nrhits = 0;
 
-  // Use the majority size shape from an octtree.
+  // Use the BVH of the majority size shape for finding candidate
+  // triangles.
   //
   // (Some initial investigation indicates that this isn't a clear-cut
   // choice, by the way -- should investigate further. mortene.)
-  PrimitiveData * octtreeprims = primitives1;
+  PrimitiveData * bvhprims = primitives1;
   PrimitiveData * iterationprims = primitives2;
   if (primitives1->numTriangles() < primitives2->numTriangles()) {
-    octtreeprims = primitives2;
+    bvhprims = primitives2;
     iterationprims = primitives1;
   }
 
-  const SbOctTree * octtree = octtreeprims->getOctTree();
-
-  const float theepsilon = this->getEpsilon();
-  const SbVec3f e(theepsilon, theepsilon, theepsilon);
-
-  for (unsigned int i = 0; i < iterationprims->numTriangles(); i++) {
-    SbTri3f * t1 = static_cast<SbTri3f *>(iterationprims->getTriangle(i));
-
-    SbBox3f tribbox = t1->getBoundingBox();
-    if (theepsilon > 0.0f) {
-      // Extend bbox in all 6 directions with the epsilon value.
-      tribbox.getMin() -= e;
-      tribbox.getMax() += e;
-    }
+  SerialHitData data;
+  data.thisp = this;
+  data.primitives1 = iterationprims;
+  data.primitives2 = bvhprims;
+  data.resp = SoIntersectionDetectionAction::NEXT_PRIMITIVE;
+  data.nrhits = 0;
 
-    SbList<void*> candidatetris;
-    octtree->findItems(tribbox, candidatetris);
+  (void) ida_find_intersections(iterationprims, bvhprims, this->getEpsilon(),
+                                PImpl::serialHitCB, &data, nrisectchks);
+  cont = data.resp != SoIntersectionDetectionAction::ABORT;
 
-    for (int j = 0; j < candidatetris.getLength(); j++) {
-      SbTri3f * t2 = static_cast<SbTri3f *>(candidatetris[j]);
-
-      nrisectchks++;
-
-      if (t1->intersect(*t2, theepsilon)) {
-        nrhits++;
-
-        SoIntersectingPrimitive p1;
-        p1.path = iterationprims->getPath();
-        p1.type = SoIntersectingPrimitive::TRIANGLE;
-        t1->getValue(p1.xf_vertex[0], p1.xf_vertex[1], p1.xf_vertex[2]);
-        iterationprims->invtransform.multVecMatrix(p1.xf_vertex[0], p1.vertex[0]);
-        iterationprims->invtransform.multVecMatrix(p1.xf_vertex[1], p1.vertex[1]);
-        iterationprims->invtransform.multVecMatrix(p1.xf_vertex[2], p1.vertex[2]);
-
-        SoIntersectingPrimitive p2;
-        p2.path = octtreeprims->getPath();
-        p2.type = SoIntersectingPrimitive::TRIANGLE;
-        t2->getValue(p2.xf_vertex[0], p2.xf_vertex[1], p2.xf_vertex[2]);
-        octtreeprims->invtransform.multVecMatrix(p2.xf_vertex[0], p2.vertex[0]);
-        octtreeprims->invtransform.multVecMatrix(p2.xf_vertex[1], p2.vertex[1]);
-        octtreeprims->invtransform.multVecMatrix(p2.xf_vertex[2], p2.vertex[2]);
-
-        std::vector<SoIntersectionCallback>::iterator it = this->callbacks.begin();
-        while (it != this->callbacks.end()) {
-          switch ( (*it).first((*it).second, &p1, &p2) ) {
-          case SoIntersectionDetectionAction::NEXT_PRIMITIVE:
-            // Break out of the switch, invoke next callback.
-            break;
-          case SoIntersectionDetectionAction::NEXT_SHAPE:
-            // FIXME: remaining callbacks won't be invoked -- should they? 20030328 mortene.
-            cont = TRUE;
-            goto done;
-          case SoIntersectionDetectionAction::ABORT:
-            // FIXME: remaining callbacks won't be invoked -- should they? 20030328 mortene.
-            cont = FALSE;
-            goto done;
-          default:
-            assert(0);
-          }
-          ++it;
-        }
-      }
-    }
-  }
-
-done:
   // for debugging
   if (ida_debug()) {
     const unsigned int total = primitives1->numTriangles() + primitives2->numTriangles();
@@ -1417,10 +1976,10 @@ done:
                            "intersection checks = %d (pr primitive: %f)",
                            nrisectchks, float(nrisectchks) / total);
     SbString chksprhit;
-    if (nrhits == 0) { chksprhit = "-"; }
-    else { chksprhit.sprintf("%f", float(nrisectchks) / nrhits); }
+    if (data.nrhits == 0) { chksprhit = "-"; }
+    else { chksprhit.sprintf("%f", float(nrisectchks) / data.nrhits); }
     SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doPrimitiveIntersectionTesting",
-                           "hits = %d (chks pr hit: %s)", nrhits, chksprhit.getString());
+                           "hits = %d (chks pr hit: %s)", data.nrhits, chksprhit.getString());
   }
 }
 
@@ -1440,55 +1999,17 @@ SoIntersectionDetectionAction::PImpl::doInternalPrimitiveIntersectionTesting(Pri
   }
   unsigned int nrisectchks = 0;
 
-  // FIXME: use the SbOctTree optimization, as above. Should refactor
-  // doPrimitiveIntersectionTesting() and
-  // doInternalPrimitiveIntersectionTesting() into common
-  // code. 20030328 mortene.
+  SerialHitData data;
+  data.thisp = this;
+  data.primitives1 = primitives;
+  data.primitives2 = primitives;
+  data.resp = SoIntersectionDetectionAction::NEXT_PRIMITIVE;
+  data.nrhits = 0;
+
+  (void) ida_find_internal_intersections(primitives, PImpl::serialHitCB, &data,
+                                         nrisectchks);
+  cont = data.resp != SoIntersectionDetectionAction::ABORT;
 
-  cont = TRUE;
-  const int numprimitives = primitives->numTriangles();
-  for (int i = 0; i < numprimitives; i++ ) {
-    SbTri3f * t1 = static_cast<SbTri3f *>(primitives->getTriangle(i));
-    for (int j = i + 1; j < numprimitives; j++ ) {
-      SbTri3f * t2 = static_cast<SbTri3f *>(primitives->getTriangle(j));
-      nrisectchks++;
-      if ( t1->intersect(*t2) ) {
-        SoIntersectingPrimitive p1;
-        p1.path = primitives->getPath();
-        p1.type = SoIntersectingPrimitive::TRIANGLE;
-        t1->getValue(p1.xf_vertex[0], p1.xf_vertex[1], p1.xf_vertex[2]);
-        primitives->invtransform.multVecMatrix(p1.xf_vertex[0], p1.vertex[0]);
-        primitives->invtransform.multVecMatrix(p1.xf_vertex[1], p1.vertex[1]);
-        primitives->invtransform.multVecMatrix(p1.xf_vertex[2], p1.vertex[2]);
-
-        SoIntersectingPrimitive p2;
-        p2.path = primitives->getPath();
-        p2.type = SoIntersectingPrimitive::TRIANGLE;
-        t2->getValue(p2.xf_vertex[0], p2.xf_vertex[1], p2.xf_vertex[2]);
-        primitives->invtransform.multVecMatrix(p2.xf_vertex[0], p2.vertex[0]);
-        primitives->invtransform.multVecMatrix(p2.xf_vertex[1], p2.vertex[1]);
-        primitives->invtransform.multVecMatrix(p2.xf_vertex[2], p2.vertex[2]);
-
-        std::vector<SoIntersectionCallback>::iterator it = this->callbacks.begin();
-        while (it != this->callbacks.end()) {
-          switch ( (*it).first((*it).second, &p1, &p2) ) {
-          case SoIntersectionDetectionAction::NEXT_PRIMITIVE:
-            break;
-          case SoIntersectionDetectionAction::NEXT_SHAPE:
-            cont = TRUE;
-            goto done;
-          case SoIntersectionDetectionAction::ABORT:
-            cont = FALSE;
-            goto done;
-          default:
-            assert(0);
-          }
-          ++it;
-        }
-      }
-    }
-  }
- done:
   // for debugging
   if (ida_debug()) {
     SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doInternalPrimitiveIntersectionTesting",
@@ -1497,3 +2018,110 @@ SoIntersectionDetectionAction::PImpl::doInternalPrimitiveIntersectionTesting(Pri
 }
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+static SoIntersectionDetectionAction::Resp
+record_intersection_cb(void * closure,
+                       const SoIntersectingPrimitive * p1,
+                       const SoIntersectingPrimitive * p2)
+{
+  SbList<SbVec3f> * hits = static_cast<SbList<SbVec3f> *>(closure);
+  for (int i = 0; i < 3; i++) {
+    hits->append(p1->xf_vertex[i]);
+    hits->append(p2->xf_vertex[i]);
+  }
+  return SoIntersectionDetectionAction::NEXT_PRIMITIVE;
+}
+
+BOOST_AUTO_TEST_CASE(parallelintersections)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  for (int i = 0; i < 8; i++) {
+    SoSeparator * sep = new SoSeparator;
+    SoTranslation * translation = new SoTranslation;
+    translation->translation.setValue(i * 1.5f, (i % 3) * 0.5f, (i % 2) * 0.3f);
+    sep->addChild(translation);
+    sep->addChild(new SoCube);
+    root->addChild(sep);
+  }
+
+  SbList<SbVec3f> serialhits;
+  SoIntersectionDetectionAction serial;
+  serial.addIntersectionCallback(record_intersection_cb, &serialhits);
+  serial.apply(root);
+  BOOST_CHECK_MESSAGE(serialhits.getLength() > 0,
+                      "Expected intersecting cubes");
+
+  SbList<SbVec3f> parallelhits;
+  SoIntersectionDetectionAction parallel;
+  parallel.setNumThreads(4);
+  BOOST_CHECK_MESSAGE(parallel.getNumThreads() == 4,
+                      "Number of threads not set");
+  parallel.addIntersectionCallback(record_intersection_cb, &parallelhits);
+  parallel.apply(root);
+
+  BOOST_CHECK_MESSAGE(serialhits.getLength() == parallelhits.getLength(),
+                      "Parallel testing found a different number of intersections");
+  SbBool sameorder = serialhits.getLength() == parallelhits.getLength();
+  for (int j = 0; sameorder && j < serialhits.getLength(); j++) {
+    sameorder = serialhits[j] == parallelhits[j];
+  }
+  BOOST_CHECK_MESSAGE(sameorder,
+                      "Parallel testing reported intersections in a different order");
+
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(reusedprimitives)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCube * cube1 = new SoCube;
+  root->addChild(cube1);
+  SoTranslation * translation = new SoTranslation;
+  translation->translation.setValue(1.5f, 0.5f, 0.0f);
+  root->addChild(translation);
+  root->addChild(new SoCube);
+
+  SbList<SbVec3f> hits;
+  SoIntersectionDetectionAction ida;
+  ida.addIntersectionCallback(record_intersection_cb, &hits);
+  ida.apply(root);
+  const int numhits = hits.getLength();
+  BOOST_CHECK_MESSAGE(numhits > 0, "Expected intersecting cubes");
+
+  hits.truncate(0);
+  ida.apply(root);
+  BOOST_CHECK_MESSAGE(hits.getLength() == numhits,
+                      "Unchanged scene should give the same intersections");
+
+  hits.truncate(0);
+  translation->translation.setValue(5.0f, 0.0f, 0.0f);
+  ida.apply(root);
+  BOOST_CHECK_MESSAGE(hits.getLength() == 0,
+                      "Moved cube should not intersect");
+
+  hits.truncate(0);
+  translation->translation.setValue(1.5f, 0.5f, 0.0f);
+  cube1->width = 0.5f;
+  ida.apply(root);
+  BOOST_CHECK_MESSAGE(hits.getLength() == 0,
+                      "Resized cube should not intersect");
+
+  // the primitive data kept between apply() calls must not hold
+  // references to the scene
+  BOOST_CHECK_MESSAGE(root->getRefCount() == 1,
+                      "The action should not keep references to the scene");
+  BOOST_CHECK_MESSAGE(cube1->getRefCount() == 1,
+                      "The action should not keep references to the shapes");
+
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
@@ -143,6 +143,7 @@ inline unsigned int SbHashFunc(const void * key)
 {
   return SbHashFunc(reinterpret_cast<size_t>(key));
 }
+#include "misc/SoDBP.h"
 #include "coindefs.h" // COIN_STUB()
 
 #ifdef COIN_THREADSAFE
@@ -556,6 +557,8 @@ SoField::~SoField()
   // disconnecting connections.
   this->setStatusBits(FLAG_ISDESTRUCTING);
 
+  if (SoDBP::transactioncounter) SoDBP::removeDeferredNotification(this);
+
 #if COIN_DEBUG_EXTRA
   int wLevel =
     SoConfigSettings::getInstance()->settingAsInt("COIN_WARNING_LEVEL");
@@ -1438,6 +1441,12 @@ SoField::touch(void)
 void
 SoField::startNotify(void)
 {
+  // within a transaction, the notification is done at commit
+  if (SoDBP::transactioncounter && this->container &&
+      SoDBP::deferNotification(this)) {
+    return;
+  }
+
   SoNotList l;
 #if COIN_DEBUG_EXTRA
   int wLevel =
@@ -92,6 +92,23 @@ SoMFColor::read1Value(SoInput * in, int idx)
     in->read(this->values[idx][2]);
 }
 
+// Reads all the values in one go, instead of one value at a time
+// through read1Value().
+SbBool
+SoMFColor::readBinaryValues(SoInput * in, int num)
+{
+  assert(in->isBinary());
+  assert(num >= 0);
+  assert(num <= this->maxNum);
+  // subclasses might read their values differently
+  if (this->getTypeId() != SoMFColor::getClassTypeId()) {
+    for (int i = 0; i < num; i++) if (!this->read1Value(in, i)) return FALSE;
+    return TRUE;
+  }
+  if (num == 0) return TRUE;
+  return somfield_read_binary_values(in, &this->values[0][0], num * 3);
+}
+
 void
 SoMFColor::write1Value(SoOutput * out, int idx) const
 {
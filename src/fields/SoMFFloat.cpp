@@ -87,6 +87,23 @@ SoMFFloat::read1Value(SoInput * in, int idx)
   return in->read(this->values[idx]);
 }
 
+// Reads all the values in one go, instead of one value at a time
+// through read1Value().
+SbBool
+SoMFFloat::readBinaryValues(SoInput * in, int num)
+{
+  assert(in->isBinary());
+  assert(num >= 0);
+  assert(num <= this->maxNum);
+  // subclasses might read their values differently
+  if (this->getTypeId() != SoMFFloat::getClassTypeId()) {
+    for (int i = 0; i < num; i++) if (!this->read1Value(in, i)) return FALSE;
+    return TRUE;
+  }
+  if (num == 0) return TRUE;
+  return somfield_read_binary_values(in, this->values, num);
+}
+
 void
 SoMFFloat::write1Value(SoOutput * out, int idx) const
 {
@@ -56,6 +56,7 @@
 #endif // COIN_DEBUG
 
 #include "fields/SoSubFieldP.h"
+#include "fields/shared.h"
 
 
 SO_MFIELD_SOURCE_MALLOC(SoMFInt32, int32_t, int32_t);
@@ -90,6 +91,23 @@ SoMFInt32::read1Value(SoInput * in, int idx)
   return TRUE;
 }
 
+// Reads all the values in one go, instead of one value at a time
+// through read1Value().
+SbBool
+SoMFInt32::readBinaryValues(SoInput * in, int num)
+{
+  assert(in->isBinary());
+  assert(num >= 0);
+  assert(num <= this->maxNum);
+  // subclasses might read their values differently
+  if (this->getTypeId() != SoMFInt32::getClassTypeId()) {
+    for (int i = 0; i < num; i++) if (!this->read1Value(in, i)) return FALSE;
+    return TRUE;
+  }
+  if (num == 0) return TRUE;
+  return somfield_read_binary_values(in, this->values, num);
+}
+
 void
 SoMFInt32::write1Value(SoOutput * out, int idx) const
 {
@@ -92,6 +92,23 @@ SoMFUInt32::read1Value(SoInput * in, int idx)
   return TRUE;
 }
 
+// Reads all the values in one go, instead of one value at a time
+// through read1Value().
+SbBool
+SoMFUInt32::readBinaryValues(SoInput * in, int num)
+{
+  assert(in->isBinary());
+  assert(num >= 0);
+  assert(num <= this->maxNum);
+  // subclasses might read their values differently
+  if (this->getTypeId() != SoMFUInt32::getClassTypeId()) {
+    for (int i = 0; i < num; i++) if (!this->read1Value(in, i)) return FALSE;
+    return TRUE;
+  }
+  if (num == 0) return TRUE;
+  return somfield_read_binary_values(in, reinterpret_cast<int32_t *>(this->values), num);
+}
+
 void
 SoMFUInt32::write1Value(SoOutput * out, int idx) const
 {
@@ -92,6 +92,23 @@ SoMFVec2f::read1Value(SoInput * in, int idx)
     in->read(this->values[idx][1]);
 }
 
+// Reads all the values in one go, instead of one value at a time
+// through read1Value().
+SbBool
+SoMFVec2f::readBinaryValues(SoInput * in, int num)
+{
+  assert(in->isBinary());
+  assert(num >= 0);
+  assert(num <= this->maxNum);
+  // subclasses might read their values differently
+  if (this->getTypeId() != SoMFVec2f::getClassTypeId()) {
+    for (int i = 0; i < num; i++) if (!this->read1Value(in, i)) return FALSE;
+    return TRUE;
+  }
+  if (num == 0) return TRUE;
+  return somfield_read_binary_values(in, &this->values[0][0], num * 2);
+}
+
 void
 SoMFVec2f::write1Value(SoOutput * out, int idx) const
 {
@@ -98,6 +98,23 @@ SoMFVec3f::read1Value(SoInput * in, int idx)
 #endif // old, slower version
 }
 
+// Reads all the values in one go, instead of one value at a time
+// through read1Value().
+SbBool
+SoMFVec3f::readBinaryValues(SoInput * in, int num)
+{
+  assert(in->isBinary());
+  assert(num >= 0);
+  assert(num <= this->maxNum);
+  // subclasses might read their values differently
+  if (this->getTypeId() != SoMFVec3f::getClassTypeId()) {
+    for (int i = 0; i < num; i++) if (!this->read1Value(in, i)) return FALSE;
+    return TRUE;
+  }
+  if (num == 0) return TRUE;
+  return somfield_read_binary_values(in, &this->values[0][0], num * 3);
+}
+
 void
 SoMFVec3f::write1Value(SoOutput * out, int idx) const
 {
@@ -178,4 +195,165 @@ BOOST_AUTO_TEST_CASE(initialized)
   BOOST_CHECK_EQUAL(field.getNum(), 0);
 }
 
+#include <cstdio>
+#include <cstdlib>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/actions/SoWriteAction.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoSeparator.h>
+
+static SbBool
+somfvec3f_check_coords(SoSeparator * root, const SoMFVec3f & expected)
+{
+  if (root == NULL || root->getNumChildren() != 1 ||
+      !root->getChild(0)->isOfType(SoCoordinate3::getClassTypeId())) {
+    return FALSE;
+  }
+  const SoMFVec3f & point = static_cast<SoCoordinate3 *>(root->getChild(0))->point;
+  return point == expected;
+}
+
+BOOST_AUTO_TEST_CASE(binaryread)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  root->addChild(coords);
+  const int num = 50000;
+  coords->point.setNum(num);
+  SbVec3f * pts = coords->point.startEditing();
+  for (int i = 0; i < num; i++) {
+    pts[i].setValue(float(i), -0.5f * float(i), 1.0f / float(i + 1));
+  }
+  coords->point.finishEditing();
+
+  SoOutput out;
+  out.setBinary(TRUE);
+  out.setBuffer(malloc(1024), 1024, realloc);
+  SoWriteAction wa(&out);
+  wa.apply(root);
+  void * buf;
+  size_t size;
+  out.getBuffer(buf, size);
+
+  // from a memory buffer
+  SoInput in;
+  in.setBuffer(buf, size);
+  SoSeparator * result = SoDB::readAll(&in);
+  if (result) result->ref();
+  BOOST_CHECK_MESSAGE(somfvec3f_check_coords(result, coords->point),
+                      "Values read from a binary buffer differ");
+  if (result) result->unref();
+
+  // from a file, which is memory mapped where supported
+  const std::string filename = TemporaryFileName(".iv");
+  FILE * fp = fopen(filename.c_str(), "wb");
+  BOOST_REQUIRE_MESSAGE(fp != NULL, "Couldn't create temporary file");
+  BOOST_REQUIRE(fwrite(buf, 1, size, fp) == size);
+  fclose(fp);
+  SoInput fin;
+  BOOST_REQUIRE(fin.openFile(filename.c_str()));
+  result = SoDB::readAll(&fin);
+  if (result) result->ref();
+  BOOST_CHECK_MESSAGE(somfvec3f_check_coords(result, coords->point),
+                      "Values read from a binary file differ");
+  if (result) result->unref();
+  fin.closeFile();
+  remove(filename.c_str());
+
+  free(buf);
+  root->unref();
+}
+
+#include <Inventor/SbString.h>
+#include <Inventor/errors/SoReadError.h>
+
+static SoSeparator *
+somfvec3f_read_string(const SbString & str, const int numthreads)
+{
+  SoInput in;
+  in.setBuffer(str.getString(), str.getLength());
+  in.setNumParseThreads(numthreads);
+  SoSeparator * root = SoDB::readAll(&in);
+  if (root) root->ref();
+  return root;
+}
+
+BOOST_AUTO_TEST_CASE(asciiread)
+{
+  // a mix of number formats, separators and line endings
+  const char * formats[] = {
+    "%d %d %d", "%d.5 -%d.25 +%d.", "%de2 -.%de-3 %d.125E+1",
+    "-%d\r\n%d\t%d", "%d.000001\n%d.5e+0\r%d"
+  };
+  const int num = 30000;
+  SbString list;
+  for (int i = 0; i < num; i++) {
+    SbString value;
+    value.sprintf(formats[i % 5], i, i + 1, i % 77);
+    list += value;
+    list += (i % 3) ? ", " : "\n";
+  }
+
+  SbString file("#Inventor V2.1 ascii\n\nSeparator { Coordinate3 { point [\n");
+  file += list;
+  file += "] } }\n";
+
+  // a comment in the list makes it go through the value-by-value code
+  SbString slowfile("#Inventor V2.1 ascii\n\nSeparator { Coordinate3 { point [\n");
+  slowfile += list;
+  slowfile += "# end of list\n] } }\n";
+
+  SoSeparator * expected = somfvec3f_read_string(slowfile, 1);
+  BOOST_REQUIRE(expected != NULL);
+  BOOST_REQUIRE(expected->getNumChildren() == 1);
+  const SoMFVec3f & point = static_cast<SoCoordinate3 *>(expected->getChild(0))->point;
+  BOOST_CHECK_EQUAL(point.getNum(), num);
+
+  SoSeparator * result = somfvec3f_read_string(file, 1);
+  BOOST_CHECK_MESSAGE(somfvec3f_check_coords(result, point),
+                      "Values read in one go differ");
+  if (result) result->unref();
+
+  result = somfvec3f_read_string(file, 4);
+  BOOST_CHECK_MESSAGE(somfvec3f_check_coords(result, point),
+                      "Values read with several threads differ");
+  if (result) result->unref();
+
+  expected->unref();
+}
+
+static void
+somfvec3f_read_error_cb(const SoError * error, void * data)
+{
+  SbString * messages = static_cast<SbString *>(data);
+  *messages += error->getDebugString();
+}
+
+BOOST_AUTO_TEST_CASE(asciireaderror)
+{
+  // the line count must be right after reading a list in one go
+  const char * file =
+    "#Inventor V2.1 ascii\n\n"
+    "Separator {\n"
+    "  Coordinate3 { point [ 0 0 0,\r\n"
+    "    1 1 1,\r"
+    "    2 2 2 ] }\n"
+    "  Coordinate3 { point [ 0 0 0, 1 1 x ] }\n"
+    "}\n";
+
+  SbString messages;
+  SoErrorCB * prevcb = SoReadError::getHandlerCallback();
+  void * prevdata = SoReadError::getHandlerData();
+  SoReadError::setHandlerCallback(somfvec3f_read_error_cb, &messages);
+  SoSeparator * root = somfvec3f_read_string(SbString(file), 1);
+  SoReadError::setHandlerCallback(prevcb, prevdata);
+
+  BOOST_CHECK_MESSAGE(root == NULL, "Invalid file was read");
+  if (root) root->unref();
+  BOOST_CHECK_MESSAGE(messages.find("Occurred at line   7 in <memory>") != -1,
+                      messages.getString());
+}
+
 #endif // COIN_TEST_SUITE
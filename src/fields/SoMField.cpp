@@ -252,10 +252,18 @@
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/errors/SoReadError.h>
 #include <Inventor/fields/SoSubField.h>
+#include <Inventor/fields/SoMFColor.h>
+#include <Inventor/fields/SoMFFloat.h>
+#include <Inventor/fields/SoMFInt32.h>
+#include <Inventor/fields/SoMFUInt32.h>
+#include <Inventor/fields/SoMFVec2f.h>
+#include <Inventor/fields/SoMFVec3f.h>
+#include <Inventor/fields/SoMFVec4f.h>
 
 #include "threads/threadsutilp.h"
 #include "tidbitsp.h"
 #include "coindefs.h" // COIN_WORKAROUND_*
+#include "io/SoInputP.h"
 
 #ifndef COIN_WORKAROUND_NO_USING_STD_FUNCS
 using std::memcpy;
@@ -458,6 +466,31 @@ SoMField::get1(const int index, SbString & valuestring)
   CC_MUTEX_UNLOCK(somfield_mutex);
 }
 
+// Finds out if the values of a field can be read with the fast path
+// for ASCII arrays of numbers in SoInputP. Only exact type matches
+// are used, as subclasses might read their values differently.
+static SbBool
+somfield_get_array_type(const SoType type, SoInputP::ArrayType & arraytype,
+                        int & numcomponents)
+{
+  arraytype = SoInputP::FLOAT_ARRAY;
+  numcomponents = 1;
+  if (type == SoMFFloat::getClassTypeId()) return TRUE;
+  numcomponents = 3;
+  if (type == SoMFVec3f::getClassTypeId()) return TRUE;
+  if (type == SoMFColor::getClassTypeId()) return TRUE;
+  numcomponents = 2;
+  if (type == SoMFVec2f::getClassTypeId()) return TRUE;
+  numcomponents = 4;
+  if (type == SoMFVec4f::getClassTypeId()) return TRUE;
+  numcomponents = 1;
+  arraytype = SoInputP::INT32_ARRAY;
+  if (type == SoMFInt32::getClassTypeId()) return TRUE;
+  arraytype = SoInputP::UINT32_ARRAY;
+  if (type == SoMFUInt32::getClassTypeId()) return TRUE;
+  return FALSE;
+}
+
 /*!
   Read and set all values for this field from input stream \a in.
   Returns \c TRUE if import went ok, otherwise \c FALSE.
@@ -516,24 +549,38 @@ SoMField::readValue(SoInput * in)
       else {
         in->putBack(c);
 
-        while (TRUE) {
-          // makeRoom() makes sure the allocation strategy is decent.
-          if (currentidx >= this->num) this->makeRoom(currentidx + 1);
+        // Plain arrays of numbers are read in one go when possible.
+        SoInputP::ArrayType arraytype;
+        int numcomponents;
+        int numvalues = 0;
+        if (somfield_get_array_type(this->getTypeId(), arraytype, numcomponents)) {
+          numvalues = SoInputP::scanASCIIArray(in, arraytype, numcomponents);
+        }
+        if (numvalues > 0) {
+          this->makeRoom(numvalues);
+          SoInputP::readASCIIArray(in, this->valuesPtr());
+          currentidx = numvalues;
+        }
+        else {
+          while (TRUE) {
+            // makeRoom() makes sure the allocation strategy is decent.
+            if (currentidx >= this->num) this->makeRoom(currentidx + 1);
 
-          if (!this->read1Value(in, currentidx++)) return FALSE;
+            if (!this->read1Value(in, currentidx++)) return FALSE;
 
-          READ_VAL(c);
-          if (c == ',') { READ_VAL(c); } // Treat trailing comma as whitespace.
+            READ_VAL(c);
+            if (c == ',') { READ_VAL(c); } // Treat trailing comma as whitespace.
 
-          // That was the last array element, we're done.
-          if (c == ']') { break; }
+            // That was the last array element, we're done.
+            if (c == ']') { break; }
 
-          if (c == '}') {
-            SoReadError::post(in, "Premature end of array, got '%c'", c);
-            return FALSE;
-          }
+            if (c == '}') {
+              SoReadError::post(in, "Premature end of array, got '%c'", c);
+              return FALSE;
+            }
 
-          in->putBack(c);
+            in->putBack(c);
+          }
         }
       }
 
@@ -101,4 +101,77 @@ BOOST_AUTO_TEST_CASE(initialized)
                       "missing class initialization");
 }
 
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <Inventor/SoInput.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/SbString.h>
+
+BOOST_AUTO_TEST_CASE(ascii)
+{
+  const int num = 20000;
+  double * values = new double[num];
+  int i;
+  uint64_t state = 1;
+  for (i = 0; i < num; i++) {
+    do {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      memcpy(&values[i], &state, sizeof(double));
+      if (i % 2) values[i] = double(int64_t(state >> 11) % 1000000000) / 4099.0;
+    } while (!(values[i] == values[i]) || (values[i] > DBL_MAX) ||
+             (values[i] < -DBL_MAX));
+  }
+
+  // after the header, written like printf(), with at least three
+  // exponent digits
+  SoOutput out;
+  out.setBuffer(malloc(1024), 1024, realloc);
+  SbString expected = SoOutput::getDefaultASCIIHeader() + "\n\n";
+  for (i = 0; i < num; i++) {
+    const int precision = i % 9;
+    out.setFloatPrecision(precision);
+    out.write(values[i]);
+    out.write(' ');
+
+    SbString str;
+    str.sprintf("%.*g ", precision * 2, values[i]);
+    const int pos = str.find("e");
+    if (pos > 0) {
+      SbString exponent;
+      exponent.sprintf("%03d ", atoi(str.getSubString(pos + 2).getString()));
+      str = str.getSubString(0, pos + 1) + exponent;
+    }
+    expected += str;
+  }
+  void * buf;
+  size_t size;
+  out.getBuffer(buf, size);
+  BOOST_CHECK_MESSAGE(SbString(static_cast<const char *>(buf), 0, int(size) - 1) == expected,
+                      "Values not written like printf()");
+  free(buf);
+
+  // and read back as the same values when written with enough digits
+  SoOutput rtout;
+  rtout.setBuffer(malloc(1024), 1024, realloc);
+  rtout.setRoundTripFloats(TRUE);
+  for (i = 0; i < num; i++) {
+    rtout.write(values[i]);
+    rtout.write('\n');
+  }
+  rtout.getBuffer(buf, size);
+  SoInput in;
+  in.setBuffer(buf, size);
+  int mismatches = 0;
+  for (i = 0; i < num; i++) {
+    double value;
+    if (!in.read(value) || memcmp(&value, &values[i], sizeof(value))) mismatches++;
+  }
+  BOOST_CHECK_MESSAGE(mismatches == 0, "Values read back differ");
+  free(buf);
+  delete[] values;
+}
+
 #endif // COIN_TEST_SUITE
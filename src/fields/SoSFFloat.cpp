@@ -101,4 +101,139 @@ BOOST_AUTO_TEST_CASE(initialized)
                       "missing class initialization");
 }
 
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <Inventor/SoInput.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/SbString.h>
+
+// Random bit patterns, with some of them turned into the kind of
+// values usually found in scene graphs.
+static float
+sosffloat_random_value(uint32_t & state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  float value;
+  memcpy(&value, &state, sizeof(value));
+  switch (state % 4) {
+  case 0: value = float(int(state >> 8) % 20000) * 0.125f; break;
+  case 1: value = float(int(state >> 8) % 100000) / 997.0f; break;
+  default: break;
+  }
+  return value;
+}
+
+static SbString
+sosffloat_get_buffer(SoOutput & out)
+{
+  void * buf;
+  size_t size;
+  out.getBuffer(buf, size);
+  return SbString(static_cast<const char *>(buf), 0, int(size) - 1);
+}
+
+BOOST_AUTO_TEST_CASE(asciiwrite)
+{
+  // after the header, the same output as printf(), with at least
+  // three exponent digits
+  SoOutput out;
+  out.setBuffer(malloc(1024), 1024, realloc);
+  SbString expected = SoOutput::getDefaultASCIIHeader() + "\n\n";
+  uint32_t state = 1;
+  for (int i = 0; i < 20000; i++) {
+    const float value = sosffloat_random_value(state);
+    if (!(value == value) || (value > FLT_MAX) || (value < -FLT_MAX)) continue;
+    const int precision = i % 9;
+    out.setFloatPrecision(precision);
+    out.write(value);
+    out.write(' ');
+
+    SbString str;
+    str.sprintf("%.*g ", precision, double(value));
+    const int pos = str.find("e");
+    if (pos > 0) {
+      SbString exponent;
+      exponent.sprintf("%03d ", atoi(str.getSubString(pos + 2).getString()));
+      str = str.getSubString(0, pos + 1) + exponent;
+    }
+    expected += str;
+  }
+  const SbString result = sosffloat_get_buffer(out);
+  BOOST_CHECK_MESSAGE(result == expected, "Values not written like printf()");
+  void * buf;
+  size_t size;
+  out.getBuffer(buf, size);
+  free(buf);
+}
+
+BOOST_AUTO_TEST_CASE(asciiroundtrip)
+{
+  const int num = 100000;
+  float * values = new float[num];
+  values[0] = FLT_MIN;
+  values[1] = FLT_MAX;
+  values[2] = -FLT_MIN / 1024.0f;
+  values[3] = -0.0f;
+  int i;
+  uint32_t state = 2;
+  for (i = 4; i < num; i++) {
+    do {
+      values[i] = sosffloat_random_value(state);
+    } while (!(values[i] == values[i]) || (values[i] > FLT_MAX) ||
+             (values[i] < -FLT_MAX));
+  }
+
+  SoOutput out;
+  out.setBuffer(malloc(1024), 1024, realloc);
+  out.setRoundTripFloats(TRUE);
+  for (i = 0; i < num; i++) {
+    out.write(values[i]);
+    out.write((i % 10) ? ' ' : '\n');
+  }
+  void * buf;
+  size_t size;
+  out.getBuffer(buf, size);
+
+  SoInput in;
+  in.setBuffer(buf, size);
+  int mismatches = 0;
+  for (i = 0; i < num; i++) {
+    float value;
+    if (!in.read(value) || memcmp(&value, &values[i], sizeof(value))) mismatches++;
+  }
+  BOOST_CHECK_MESSAGE(mismatches == 0, "Values read back differ");
+  free(buf);
+  delete[] values;
+
+  // the nearest float, not the float nearest to the nearest double
+  const char * text = "16777217 1.000000059604644775390625000001 7e-46 8e-46";
+  const float expected[] = { 16777216.0f, 1.00000011920928955f, 0.0f, FLT_MIN / 8388608.0f };
+  SoInput textin;
+  textin.setBuffer(text, strlen(text));
+  for (i = 0; i < 4; i++) {
+    float value;
+    BOOST_CHECK(textin.read(value) && (value == expected[i]));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(asciireadlongnumber)
+{
+  // numbers at the end of the buffer are read character by character
+  const char * shorttext = "1.5";
+  SoInput shortin;
+  shortin.setBuffer(shorttext, strlen(shorttext));
+  float value;
+  BOOST_CHECK(shortin.read(value) && (value == 1.5f));
+
+  SbString longtext;
+  for (int i = 0; i < 4096; i++) longtext += '0';
+  longtext += "1.5";
+  SoInput longin;
+  longin.setBuffer(longtext.getString(), longtext.getLength());
+  BOOST_CHECK_MESSAGE(!longin.read(value), "Overlong number not reported");
+}
+
 #endif // COIN_TEST_SUITE
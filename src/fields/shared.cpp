@@ -593,3 +593,35 @@ sosfvec4d_write_value(SoOutput * out, const SbVec4d & v)
 }
 
 // *************************************************************************
+
+// Read num binary values in one go into values, instead of one value
+// at a time. Used from the readBinaryValues() methods of the
+// multiple-value fields with float components.
+SbBool
+somfield_read_binary_values(SoInput * in, float * values, int num)
+{
+  if (num == 0) return TRUE;
+  if (!in->readBinaryArray(values, num)) return FALSE;
+  for (int i = 0; i < num; i++) {
+    // same check as in SoInput::read(float &)
+    if (!coin_finite((double)values[i])) {
+      SoReadError::post(in,
+                        "Detected non-valid floating point number, replacing "
+                        "with 0.0f");
+      values[i] = 0.0f;
+    }
+  }
+  return TRUE;
+}
+
+// Read num binary values in one go into values. Used from the
+// readBinaryValues() methods of SoMFInt32 and SoMFUInt32.
+SbBool
+somfield_read_binary_values(SoInput * in, int32_t * values, int num)
+{
+  if (num == 0) return TRUE;
+  if (!in->readBinaryArray(values, num)) return FALSE;
+  return TRUE;
+}
+
+// *************************************************************************
@@ -111,6 +111,9 @@ void sosfvec4ui32_write_value(SoOutput * out, const SbVec4ui32 & v);
 void sosfvec4f_write_value(SoOutput * out, const SbVec4f & v);
 void sosfvec4d_write_value(SoOutput * out, const SbVec4d & v);
 
+SbBool somfield_read_binary_values(SoInput * in, float * values, int num);
+SbBool somfield_read_binary_values(SoInput * in, int32_t * values, int num);
+
 // *************************************************************************
 
 #endif // ! COIN_FIELDS_SHARED_H
@@ -70,6 +70,10 @@ typedef int (*cc_bzglue_BZ2_bzRead_t)(int * bzerror,
                                       void * bzfile, 
                                       void * buf, 
                                       int len);
+typedef void (*cc_bzglue_BZ2_bzReadGetUnused_t)(int * bzerror,
+                                                void * bzfile,
+                                                void ** unused,
+                                                int * nunused);
 typedef void * (*cc_bzglue_BZ2_bzWriteOpen_t)(int * bzerror,      
                                               FILE * fp, 
                                               int blocksize100k, 
@@ -84,6 +88,13 @@ typedef void (*cc_bzglue_BZ2_bzWrite_t)(int * bzerror,
                                         void * bzfile, 
                                         void * buf, 
                                         int len);
+typedef int (*cc_bzglue_BZ2_bzBuffToBuffCompress_t)(char * dest,
+                                                    unsigned int * destlen,
+                                                    char * source,
+                                                    unsigned int sourcelen,
+                                                    int blocksize100k,
+                                                    int verbosity,
+                                                    int workfactor);
 
 typedef struct {
   int available;
@@ -91,9 +102,11 @@ typedef struct {
   cc_bzglue_BZ2_bzReadOpen_t BZ2_bzReadOpen;
   cc_bzglue_BZ2_bzReadClose_t BZ2_bzReadClose; 
   cc_bzglue_BZ2_bzRead_t BZ2_bzRead;
+  cc_bzglue_BZ2_bzReadGetUnused_t BZ2_bzReadGetUnused;
   cc_bzglue_BZ2_bzWriteOpen_t BZ2_bzWriteOpen;
   cc_bzglue_BZ2_bzWriteClose_t BZ2_bzWriteClose;
   cc_bzglue_BZ2_bzWrite_t BZ2_bzWrite;
+  cc_bzglue_BZ2_bzBuffToBuffCompress_t BZ2_bzBuffToBuffCompress;
 } cc_bzglue_t;
 
 
@@ -211,9 +224,11 @@ bzglue_init(void)
         BZGLUE_REGISTER_FUNC(cc_bzglue_BZ2_bzReadOpen_t, BZ2_bzReadOpen);
         BZGLUE_REGISTER_FUNC(cc_bzglue_BZ2_bzReadClose_t, BZ2_bzReadClose); 
         BZGLUE_REGISTER_FUNC(cc_bzglue_BZ2_bzRead_t, BZ2_bzRead);
+        BZGLUE_REGISTER_FUNC(cc_bzglue_BZ2_bzReadGetUnused_t, BZ2_bzReadGetUnused);
         BZGLUE_REGISTER_FUNC(cc_bzglue_BZ2_bzWriteOpen_t, BZ2_bzWriteOpen);
         BZGLUE_REGISTER_FUNC(cc_bzglue_BZ2_bzWriteClose_t, BZ2_bzWriteClose);
         BZGLUE_REGISTER_FUNC(cc_bzglue_BZ2_bzWrite_t, BZ2_bzWrite);
+        BZGLUE_REGISTER_FUNC(cc_bzglue_BZ2_bzBuffToBuffCompress_t, BZ2_bzBuffToBuffCompress);
         
         /* Do this late, so we can detect recursive calls to this function. */
         bzlib_instance = bi;
@@ -273,6 +288,16 @@ cc_bzglue_BZ2_bzRead(int * bzerror,
   return bzlib_instance->BZ2_bzRead(bzerror, bzfile, buf, len);
 }
 
+void
+cc_bzglue_BZ2_bzReadGetUnused(int * bzerror,
+                              void * bzfile,
+                              void ** unused,
+                              int * nunused)
+{
+  bzglue_init();
+  bzlib_instance->BZ2_bzReadGetUnused(bzerror, bzfile, unused, nunused);
+}
+
 void *
 cc_bzglue_BZ2_bzWriteOpen(int * bzerror,      
                           FILE * fp, 
@@ -307,3 +332,19 @@ cc_bzglue_BZ2_bzWrite(int * bzerror,
   bzglue_init();
   bzlib_instance->BZ2_bzWrite(bzerror, bzfile, buf, len);
 }
+
+int
+cc_bzglue_BZ2_bzBuffToBuffCompress(char * dest,
+                                   unsigned int * destlen,
+                                   char * source,
+                                   unsigned int sourcelen,
+                                   int blocksize100k,
+                                   int verbosity,
+                                   int workfactor)
+{
+  bzglue_init();
+  return bzlib_instance->BZ2_bzBuffToBuffCompress(dest, destlen,
+                                                  source, sourcelen,
+                                                  blocksize100k,
+                                                  verbosity, workfactor);
+}
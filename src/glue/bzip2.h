@@ -63,6 +63,10 @@ int cc_bzglue_BZ2_bzRead(int * bzerror,
                          void * bzfile, 
                          void * buf, 
                          int len);
+void cc_bzglue_BZ2_bzReadGetUnused(int * bzerror,
+                                   void * bzfile,
+                                   void ** unused,
+                                   int * nunused);
 void * cc_bzglue_BZ2_bzWriteOpen(int * bzerror,      
                                  FILE * fp, 
                                  int blocksize100k, 
@@ -77,6 +81,13 @@ void cc_bzglue_BZ2_bzWrite(int * bzerror,
                            void * bzfile, 
                            void * buf, 
                            int len);
+int cc_bzglue_BZ2_bzBuffToBuffCompress(char * dest,
+                                       unsigned int * destlen,
+                                       char * source,
+                                       unsigned int sourcelen,
+                                       int blocksize100k,
+                                       int verbosity,
+                                       int workfactor);
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -264,9 +264,10 @@ glxglue_get_display(const cc_glglue * currentcontext = NULL)
                          "Couldn't open NULL display.");
       glxglue_opendisplay_failed = TRUE;
     }
-    
-    glxglue_screen = XScreenNumberOfScreen(
-      XDefaultScreenOfDisplay(glxglue_display));
+    else {
+      glxglue_screen = XScreenNumberOfScreen(
+        XDefaultScreenOfDisplay(glxglue_display));
+    }
 
     if (coin_glglue_debug()) {
       cc_debugerror_postinfo("glxglue_get_display", "got Display*==%p; got Screen==%d",
@@ -273,7 +273,10 @@ osmesaglue_context_make_current(void * ctx) {
                                    "current_context ctx:%p",
                                    current_context);
         }
-        if((current_context != 0) && (current_context != osmesa_ctx->storedcontext)) {
+        /* Store the current context, to be reinstated afterwards */
+        osmesa_ctx->storedcontext = 0;
+        if((current_context != 0) && (current_context != osmesa_ctx->ctx)) {
+            osmesa_ctx->storedcontext = current_context;
             OSMesaGetColorBuffer(osmesa_ctx->storedcontext,
                                  &osmesa_ctx->storedcontext_width,
                                  &osmesa_ctx->storedcontext_height,
@@ -326,6 +329,11 @@ void osmesaglue_context_reinstate_previous(void * ctx) {
                           context->storedcontext_width,
                           context->storedcontext_height);
     }
+    else {
+        /* Release the context, so it can be made current in another
+           thread. */
+        OSMesaMakeCurrent(NULL, NULL, 0, 0, 0);
+    }
 }
 
 /* ********************************************************************** */
@@ -85,7 +85,9 @@ typedef int (*cc_zlibglue_deflateInit2_t)(void * stream,
                                         int method,
                                         int windowbits,
                                         int memlevel,
-                                        int strategy);
+                                        int strategy,
+                                        const char * version,
+                                        int stream_size);
 
 typedef int (*cc_zlibglue_inflateInit2_t)(void * stream,
                                           int windowbits,
@@ -300,7 +302,9 @@ cc_zlibglue_deflateInit2(void * stream,
                                      method,
                                      windowbits,
                                      memlevel,
-                                     strategy);
+                                     strategy,
+                                     zlib_instance->zlibVersion(),
+                                     cc_gzm_sizeof_z_stream());
 }
 
 int 
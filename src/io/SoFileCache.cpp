@@ -0,0 +1,557 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+// Loading of files for the SoFile and SoVRMLInline nodes which delay
+// reading their file until they are first traversed.
+//
+// When threads are available, the bytes of a requested file are read
+// on a worker thread. Parsing happens on the main thread, from a
+// timer sensor polling the worker jobs, since SoInput's directory
+// list and the global name dictionaries are not protected against
+// concurrent reads. Each poll parses finished files until a small
+// time budget is spent, so a large number of requests doesn't stall
+// the application. Without threads, the timer sensor reads the files
+// itself.
+//
+// Files may be found and read from any thread, e.g. when nodes are
+// read, or traversed by actions in worker threads, so the shared
+// state is guarded by one lock. Loads are only requested from the
+// main thread, which owns the timer sensor.
+
+#include "io/SoFileCache.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include "coindefs.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SbName.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/errors/SoDebugError.h>
+#include <Inventor/errors/SoReadError.h>
+#include <Inventor/nodes/SoGroup.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/sensors/SoTimerSensor.h>
+
+#ifdef HAVE_THREADS
+#include <Inventor/C/threads/common.h>
+#include <Inventor/C/threads/recmutex.h>
+#include <Inventor/C/threads/sched.h>
+#include <Inventor/C/threads/thread.h>
+#endif // HAVE_THREADS
+
+#include "io/floatconv.h"
+#include "misc/SbHash.h"
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
+
+// *************************************************************************
+
+// reading files is mostly waiting for the disk or the network, so a
+// couple of threads is enough to keep the parser busy
+static const int SOFILECACHE_NUM_THREADS = 2;
+
+// how often the worker jobs are polled, and for how long each poll
+// may spend parsing finished files
+static const double SOFILECACHE_POLL_INTERVAL = 0.02;
+static const double SOFILECACHE_PARSE_BUDGET = 0.01;
+
+typedef SbHash<const char *, SoFileCache *> SoFileCacheDict;
+
+static SoFileCacheDict * sofilecache_dict[2] = { NULL, NULL };
+static SbList<SoFileCache *> * sofilecache_pending = NULL;
+static SoTimerSensor * sofilecache_timer = NULL;
+#ifdef HAVE_THREADS
+static cc_sched * sofilecache_sched = NULL;
+// recursive, as reading a file finds the files it refers to
+static cc_recmutex * sofilecache_mutex = NULL;
+static unsigned long sofilecache_mainthread = 0;
+#endif // HAVE_THREADS
+
+static void
+sofilecache_lock(void)
+{
+#ifdef HAVE_THREADS
+  if (sofilecache_mutex) (void)cc_recmutex_lock(sofilecache_mutex);
+#endif // HAVE_THREADS
+}
+
+static void
+sofilecache_unlock(void)
+{
+#ifdef HAVE_THREADS
+  if (sofilecache_mutex) (void)cc_recmutex_unlock(sofilecache_mutex);
+#endif // HAVE_THREADS
+}
+
+// *************************************************************************
+
+// Called from SoDB::init(), which also tells which thread is the main
+// thread.
+void
+SoFileCache::initClass(void)
+{
+  sofilecache_dict[NODES] = new SoFileCacheDict;
+  sofilecache_dict[SEPARATOR] = new SoFileCacheDict;
+  sofilecache_pending = new SbList<SoFileCache *>;
+#ifdef HAVE_THREADS
+  sofilecache_mutex = cc_recmutex_construct();
+  sofilecache_mainthread = cc_thread_id();
+#endif // HAVE_THREADS
+  coin_atexit(SoFileCache::cleanup, CC_ATEXIT_NORMAL);
+}
+
+/*!
+  Returns TRUE if called from the thread which initialized Coin.
+*/
+SbBool
+SoFileCache::isMainThread(void)
+{
+#ifdef HAVE_THREADS
+  return cc_thread_id() == sofilecache_mainthread;
+#else // !HAVE_THREADS
+  return TRUE;
+#endif // !HAVE_THREADS
+}
+
+void
+SoFileCache::cleanup(void)
+{
+#ifdef HAVE_THREADS
+  if (sofilecache_sched) {
+    cc_sched_destruct(sofilecache_sched);
+    sofilecache_sched = NULL;
+  }
+#endif // HAVE_THREADS
+  delete sofilecache_timer;
+  sofilecache_timer = NULL;
+
+  if (sofilecache_pending) {
+    for (int i = 0; i < sofilecache_pending->getLength(); i++) {
+      SoFileCache * file = (*sofilecache_pending)[i];
+      file->pending = FALSE;
+      file->jobqueued = FALSE;
+      file->unref();
+    }
+    delete sofilecache_pending;
+    sofilecache_pending = NULL;
+  }
+  delete sofilecache_dict[NODES];
+  delete sofilecache_dict[SEPARATOR];
+  sofilecache_dict[NODES] = NULL;
+  sofilecache_dict[SEPARATOR] = NULL;
+#ifdef HAVE_THREADS
+  cc_recmutex_destruct(sofilecache_mutex);
+  sofilecache_mutex = NULL;
+#endif // HAVE_THREADS
+}
+
+/*!
+  Returns the instance for the file \a fullname, read in \a format,
+  creating it if there is none. The instance is returned with an
+  extra reference, which the caller must release with unref().
+*/
+SoFileCache *
+SoFileCache::find(const SbString & fullname, const Format format)
+{
+  const char * key = SbName(fullname.getString()).getString();
+  SoFileCache * file;
+  sofilecache_lock();
+  if (!sofilecache_dict[format]->get(key, file)) {
+    file = new SoFileCache(fullname, format);
+    (void)sofilecache_dict[format]->put(key, file);
+  }
+  file->ref();
+  sofilecache_unlock();
+  return file;
+}
+
+SoFileCache::SoFileCache(const SbString & fullnamearg, const Format formatarg)
+  : refcount(0),
+    fullname(fullnamearg),
+    format(formatarg),
+    boxread(FALSE),
+    boxvalid(FALSE),
+    loaded(FALSE),
+    root(NULL),
+    pending(FALSE),
+    mutex(NULL),
+    jobqueued(FALSE),
+    jobdone(FALSE),
+    jobid(0),
+    data(NULL),
+    datasize(0)
+{
+  CC_MUTEX_CONSTRUCT(this->mutex);
+}
+
+SoFileCache::~SoFileCache()
+{
+  if (sofilecache_dict[this->format]) {
+    (void)sofilecache_dict[this->format]->erase(SbName(this->fullname.getString()).getString());
+  }
+  if (this->root) this->root->unref();
+  free(this->data);
+  CC_MUTEX_DESTRUCT(this->mutex);
+}
+
+void
+SoFileCache::ref(void)
+{
+  sofilecache_lock();
+  this->refcount++;
+  sofilecache_unlock();
+}
+
+void
+SoFileCache::unref(void)
+{
+  sofilecache_lock();
+  if (--this->refcount == 0) delete this;
+  sofilecache_unlock();
+}
+
+const SbString &
+SoFileCache::getFullName(void) const
+{
+  return this->fullname;
+}
+
+/*!
+  Returns the bounding box of the scene in the file, without reading
+  it. The bounding box is read from a sidecar file with the name of
+  the file and a ".bbox" suffix, holding the six numbers
+  "xmin ymin zmin xmax ymax zmax". Returns FALSE if there is no such
+  file.
+*/
+SbBool
+SoFileCache::getBoundingBox(SbBox3f & boxref)
+{
+  sofilecache_lock();
+  if (!this->boxread) {
+    this->boxread = TRUE;
+    SbString sidecar(this->fullname);
+    sidecar += ".bbox";
+    FILE * fp = fopen(sidecar.getString(), "rb");
+    if (fp) {
+      char buf[512];
+      const size_t len = fread(buf, 1, sizeof(buf), fp);
+      (void)fclose(fp);
+
+      float v[6];
+      const char * ptr = buf;
+      const char * end = buf + len;
+      int num = 0;
+      while (ptr && num < 6) {
+        while (ptr < end && strchr(" \t\r\n,", *ptr)) ptr++;
+        ptr = coin_parse_float(ptr, end, v[num]);
+        if (ptr) num++;
+      }
+      if (num == 6) {
+        this->box.setBounds(v[0], v[1], v[2], v[3], v[4], v[5]);
+        this->boxvalid = !this->box.isEmpty();
+      }
+      if (!this->boxvalid) {
+        SoDebugError::postWarning("SoFileCache::getBoundingBox",
+                                  "Invalid bounding box in ``%s''.",
+                                  sidecar.getString());
+      }
+    }
+  }
+  const SbBool valid = this->boxvalid;
+  if (valid) boxref = this->box;
+  sofilecache_unlock();
+  return valid;
+}
+
+/*!
+  Returns TRUE if the file has been read, even if reading it failed.
+*/
+SbBool
+SoFileCache::isLoaded(void) const
+{
+  sofilecache_lock();
+  const SbBool result = this->loaded;
+  sofilecache_unlock();
+  return result;
+}
+
+/*!
+  Returns the scene read from the file, or NULL if the file hasn't
+  been read, or couldn't be read.
+*/
+SoGroup *
+SoFileCache::getRoot(void) const
+{
+  sofilecache_lock();
+  SoGroup * result = this->root;
+  sofilecache_unlock();
+  return result;
+}
+
+/*!
+  Reads the file right away, if it hasn't been read already, and
+  returns the scene. Requests already made with requestLoad() are
+  still answered from the timer sensor.
+*/
+SoGroup *
+SoFileCache::load(void)
+{
+  sofilecache_lock();
+  if (!this->loaded) {
+    // the worker may be done with the file already
+    CC_MUTEX_LOCK(this->mutex);
+    char * buf = this->jobdone ? this->data : NULL;
+    const size_t bufsize = this->datasize;
+    this->data = NULL;
+    CC_MUTEX_UNLOCK(this->mutex);
+
+    this->readScene(buf, bufsize);
+    free(buf);
+  }
+  SoGroup * result = this->root;
+  sofilecache_unlock();
+  return result;
+}
+
+// Reads the scene from the file bytes in buf, or from the file
+// itself when buf is NULL.
+void
+SoFileCache::readScene(const char * buf, const size_t bufsize)
+{
+  assert(!this->loaded);
+  this->loaded = TRUE;
+
+  SoInput in;
+  SbString dir;
+  // SoInput::setBuffer() can't read bzip2 compressed data
+  if (buf && !(bufsize >= 3 && strncmp(buf, "BZh", 3) == 0)) {
+    in.setBuffer(buf, bufsize);
+    // references to other files are relative to this file, as when
+    // the file itself is pushed on the SoInput stack
+    dir = SoInput::getPathname(this->fullname);
+    if (dir.getLength()) SoInput::addDirectoryFirst(dir.getString());
+  }
+  else if (!in.openFile(this->fullname.getString())) {
+    return;
+  }
+
+  SoGroup * result = NULL;
+  if (this->format == SEPARATOR) {
+    result = SoDB::readAll(&in);
+  }
+  else {
+    result = new SoGroup;
+    result->ref();
+    SoNode * node;
+    do {
+      // not SoDB::readAll(), which adds an SoSeparator if there is
+      // more than one node at the top level
+      if (!SoDB::read(&in, node)) {
+        result->unref();
+        result = NULL;
+        break;
+      }
+      if (node == NULL) break;
+      result->addChild(node);
+    } while (!in.eof());
+    if (result) result->unrefNoDelete();
+  }
+  if (dir.getLength()) SoInput::removeDirectory(dir.getString());
+
+  if (result) {
+    result->ref();
+    this->root = result;
+  }
+  else {
+    SoReadError::post(&in, "Unable to read subfile: ``%s''",
+                      this->fullname.getString());
+  }
+}
+
+// *************************************************************************
+
+/*!
+  Asks for the file to be loaded, and \a cb to be called with \a
+  closure from a timer sensor when it has been. The callback is also
+  called if the file couldn't be read, and if the file had been read
+  already.
+
+  Returns FALSE, and does nothing, if not called from the main thread.
+*/
+SbBool
+SoFileCache::requestLoad(LoadCB * cb, void * closure)
+{
+  if (!SoFileCache::isMainThread()) return FALSE;
+
+  sofilecache_lock();
+  Request request;
+  request.cb = cb;
+  request.closure = closure;
+  this->requests.append(request);
+  if (this->pending) {
+    sofilecache_unlock();
+    return TRUE;
+  }
+
+  this->pending = TRUE;
+  this->ref();
+  sofilecache_pending->append(this);
+
+#ifdef HAVE_THREADS
+  if (!this->loaded && !this->jobqueued &&
+      cc_thread_implementation() != CC_NO_THREADS) {
+    if (sofilecache_sched == NULL) {
+      sofilecache_sched = cc_sched_construct(SOFILECACHE_NUM_THREADS);
+    }
+    this->jobqueued = TRUE;
+    this->jobdone = FALSE;
+    this->jobid = cc_sched_schedule(sofilecache_sched, SoFileCache::readFile, this, 0.0f);
+  }
+#endif // HAVE_THREADS
+
+  if (sofilecache_timer == NULL) {
+    sofilecache_timer = new SoTimerSensor(SoFileCache::timerCB, NULL);
+    sofilecache_timer->setInterval(SbTime(SOFILECACHE_POLL_INTERVAL));
+  }
+  if (!sofilecache_timer->isScheduled()) sofilecache_timer->schedule();
+  sofilecache_unlock();
+  return TRUE;
+}
+
+/*!
+  Cancels a request made with requestLoad(). The file may still be
+  read.
+*/
+void
+SoFileCache::cancelLoad(LoadCB * cb, void * closure)
+{
+  sofilecache_lock();
+  for (int i = 0; i < this->requests.getLength(); i++) {
+    const Request request = this->requests[i];
+    if (request.cb == cb && request.closure == closure) {
+      this->requests.remove(i);
+      break;
+    }
+  }
+  sofilecache_unlock();
+}
+
+// Reads the bytes of the file. Called on a worker thread.
+void
+SoFileCache::readFile(void * closure)
+{
+  SoFileCache * thisp = static_cast<SoFileCache *>(closure);
+  char * buf = NULL;
+  size_t bufsize = 0;
+  FILE * fp = fopen(thisp->fullname.getString(), "rb");
+  if (fp) {
+    if (fseek(fp, 0, SEEK_END) == 0) {
+      const long size = ftell(fp);
+      if (size > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        buf = static_cast<char *>(malloc(size_t(size)));
+        bufsize = buf ? fread(buf, 1, size_t(size), fp) : 0;
+        if (bufsize != size_t(size)) {
+          free(buf);
+          buf = NULL;
+          bufsize = 0;
+        }
+      }
+    }
+    (void)fclose(fp);
+  }
+
+  CC_MUTEX_LOCK(thisp->mutex);
+  thisp->data = buf;
+  thisp->datasize = bufsize;
+  thisp->jobdone = TRUE;
+  CC_MUTEX_UNLOCK(thisp->mutex);
+}
+
+// Reads and parses the file, unless it is still being read by the
+// worker thread. Returns FALSE if it is.
+SbBool
+SoFileCache::finishLoad(void)
+{
+  CC_MUTEX_LOCK(this->mutex);
+  const SbBool running = this->jobqueued && !this->jobdone;
+  char * buf = this->data;
+  const size_t bufsize = this->datasize;
+  this->data = NULL;
+  CC_MUTEX_UNLOCK(this->mutex);
+  if (running) return FALSE;
+
+  this->jobqueued = FALSE;
+  // nobody but the pending list is interested in the file any more
+  if (!this->loaded && (this->refcount > 1 || this->requests.getLength() > 0)) {
+    this->readScene(buf, bufsize);
+  }
+  free(buf);
+  return TRUE;
+}
+
+void
+SoFileCache::timerCB(void * COIN_UNUSED_ARG(closure), SoSensor * COIN_UNUSED_ARG(sensor))
+{
+  const SbTime start = SbTime::getTimeOfDay();
+  sofilecache_lock();
+  int i = 0;
+  while (i < sofilecache_pending->getLength()) {
+    SoFileCache * file = (*sofilecache_pending)[i];
+    if (!file->finishLoad()) {
+      i++;
+      continue;
+    }
+    sofilecache_pending->remove(i);
+    file->pending = FALSE;
+
+    // the callbacks may ask for new files, or cancel requests
+    SbList<Request> requests(file->requests);
+    file->requests.truncate(0);
+    for (int j = 0; j < requests.getLength(); j++) {
+      const Request request = requests[j];
+      request.cb(request.closure, file);
+    }
+    file->unref();
+
+    if ((SbTime::getTimeOfDay() - start).getValue() > SOFILECACHE_PARSE_BUDGET) break;
+  }
+  if (sofilecache_pending->getLength() == 0) sofilecache_timer->unschedule();
+  sofilecache_unlock();
+}
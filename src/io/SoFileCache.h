@@ -0,0 +1,126 @@
+#ifndef COIN_SOFILECACHE_H
+#define COIN_SOFILECACHE_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* !COIN_INTERNAL */
+
+#include <stdlib.h>
+#include <Inventor/SbBox3f.h>
+#include <Inventor/SbString.h>
+#include <Inventor/lists/SbList.h>
+
+class SoGroup;
+
+// The scene read from one file by the SoFile and SoVRMLInline nodes
+// which delay reading their file until they are first
+// traversed. There is one instance for each file (and format), shared
+// by all the nodes referring to the same file, so duplicate
+// references share one parsed scene graph.
+//
+// Loading can be requested asynchronously. The file is then read on
+// a worker thread, parsed on the main thread from a timer sensor, and
+// handed to the requesting nodes from the same sensor callback.
+//
+// The instances may be found and read from any thread, but loads can
+// only be requested from the main thread, which runs the sensor.
+class SoFileCache {
+public:
+  // NODES reads the top level nodes of the file as the children of
+  // an SoGroup, the way SoFile reads them. SEPARATOR reads the file
+  // with SoDB::readAll(), the way SoVRMLInline reads it.
+  enum Format {
+    NODES,
+    SEPARATOR
+  };
+
+  typedef void LoadCB(void * closure, SoFileCache * file);
+
+  static void initClass(void);
+  static SbBool isMainThread(void);
+  static SoFileCache * find(const SbString & fullname, const Format format);
+
+  void ref(void);
+  void unref(void);
+
+  const SbString & getFullName(void) const;
+  SbBool getBoundingBox(SbBox3f & box);
+
+  SbBool isLoaded(void) const;
+  SoGroup * getRoot(void) const;
+  SoGroup * load(void);
+
+  SbBool requestLoad(LoadCB * cb, void * closure);
+  void cancelLoad(LoadCB * cb, void * closure);
+
+private:
+  SoFileCache(const SbString & fullname, const Format format);
+  ~SoFileCache();
+
+  SbBool finishLoad(void);
+  void readScene(const char * buf, const size_t bufsize);
+
+  static void readFile(void * closure);
+  static void timerCB(void * closure, class SoSensor * sensor);
+  static void cleanup(void);
+
+  struct Request {
+    LoadCB * cb;
+    void * closure;
+  };
+
+  int refcount;
+  SbString fullname;
+  Format format;
+
+  SbBool boxread;
+  SbBool boxvalid;
+  SbBox3f box;
+
+  SbBool loaded;
+  SoGroup * root;
+  SbList<Request> requests;
+  SbBool pending;
+
+  // shared with the worker thread reading the file
+  void * mutex;
+  SbBool jobqueued;
+  SbBool jobdone;
+  uint32_t jobid;
+  char * data;
+  size_t datasize;
+};
+
+#endif // !COIN_SOFILECACHE_H
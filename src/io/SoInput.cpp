@@ -175,6 +175,54 @@ soinput_destruct_tls_data(void * closure)
 
 // *************************************************************************
 
+// Bulk conversion from network byte order. The byte swapping is
+// written so that compilers can vectorize the loops. The source may
+// be unaligned, and may be the same memory as the destination.
+
+static void
+soinput_ntoh_array32(const char * from, void * to, const int len)
+{
+  if (coin_host_get_endianness() == COIN_HOST_IS_BIGENDIAN) {
+    if (from != to) memmove(to, from, len * sizeof(uint32_t));
+    return;
+  }
+  char * dst = static_cast<char *>(to);
+  for (int i = 0; i < len; i++) {
+    uint32_t v;
+    memcpy(&v, from + i * sizeof(uint32_t), sizeof(uint32_t));
+    v =
+      (v >> 24) | ((v >> 8) & 0x0000ff00) |
+      ((v << 8) & 0x00ff0000) | (v << 24);
+    memcpy(dst + i * sizeof(uint32_t), &v, sizeof(uint32_t));
+  }
+}
+
+static void
+soinput_ntoh_array64(const char * from, void * to, const int len)
+{
+  if (coin_host_get_endianness() == COIN_HOST_IS_BIGENDIAN) {
+    if (from != to) memmove(to, from, len * sizeof(uint64_t));
+    return;
+  }
+  char * dst = static_cast<char *>(to);
+  for (int i = 0; i < len; i++) {
+    uint64_t v;
+    memcpy(&v, from + i * sizeof(uint64_t), sizeof(uint64_t));
+    const uint32_t hi = (uint32_t)(v >> 32);
+    const uint32_t lo = (uint32_t)v;
+    const uint64_t swappedlo =
+      (lo >> 24) | ((lo >> 8) & 0x0000ff00) |
+      ((lo << 8) & 0x00ff0000) | (lo << 24);
+    const uint32_t swappedhi =
+      (hi >> 24) | ((hi >> 8) & 0x0000ff00) |
+      ((hi << 8) & 0x00ff0000) | (hi << 24);
+    v = (swappedlo << 32) | swappedhi;
+    memcpy(dst + i * sizeof(uint64_t), &v, sizeof(uint64_t));
+  }
+}
+
+// *************************************************************************
+
 #define PRIVATE(obj) (obj->pimpl)
 
 // *************************************************************************
@@ -1229,8 +1277,10 @@ READ_NUM(readInteger, int32_t, num, type)
 #define READ_UNSIGNED_INTEGER(num, type) \
 READ_NUM(readUnsignedInteger, uint32_t, num, type)
 
+// Floats are read with their own readReal(), as rounding to a double
+// first could give a different float.
 #define READ_REAL(num, type) \
-READ_NUM(readReal, double, num, type)
+READ_NUM(readReal, type, num, type)
 
 /*!
   Read integer from current file or buffer position and place it in \a i.
@@ -1457,12 +1507,18 @@ SbBool
 SoInput::readBinaryArray(int32_t * l, int length)
 {
   assert(length > 0);
-  if (!this->checkHeader() ||
-      !this->getTopOfStack()->getChunkOfBytes((unsigned char *)l,
-                                              length * sizeof(int32_t)))
-    return FALSE;
+  if (!this->checkHeader()) return FALSE;
 
-  this->convertInt32Array((char *)l, l, length);
+  // convert straight from the read buffer when possible, to avoid
+  // copying the data twice
+  SoInput_FileInfo * fi = this->getTopOfStack();
+  const char * src = fi->getChunkPointer(length * sizeof(int32_t));
+  if (src == NULL) {
+    if (!fi->getChunkOfBytes((unsigned char *)l, length * sizeof(int32_t)))
+      return FALSE;
+    src = (const char *)l;
+  }
+  this->convertInt32Array(const_cast<char *>(src), l, length);
   return TRUE;
 }
 
@@ -1475,13 +1531,16 @@ SbBool
 SoInput::readBinaryArray(float * f, int length)
 {
   assert(length > 0);
-  if (!this->checkHeader() ||
-      !this->getTopOfStack()->getChunkOfBytes((unsigned char *)f,
-                                              length * sizeof(float)))
-    return FALSE;
-
-  this->convertFloatArray((char *)f, f, length);
+  if (!this->checkHeader()) return FALSE;
 
+  SoInput_FileInfo * fi = this->getTopOfStack();
+  const char * src = fi->getChunkPointer(length * sizeof(float));
+  if (src == NULL) {
+    if (!fi->getChunkOfBytes((unsigned char *)f, length * sizeof(float)))
+      return FALSE;
+    src = (const char *)f;
+  }
+  this->convertFloatArray(const_cast<char *>(src), f, length);
   return TRUE;
 }
 
@@ -1494,12 +1553,16 @@ SbBool
 SoInput::readBinaryArray(double * d, int length)
 {
   assert(length > 0);
-  if (!this->checkHeader() ||
-      !this->getTopOfStack()->getChunkOfBytes((unsigned char *)d,
-                                              length * sizeof(double)))
-    return FALSE;
+  if (!this->checkHeader()) return FALSE;
 
-  this->convertDoubleArray((char *)d, d, length);
+  SoInput_FileInfo * fi = this->getTopOfStack();
+  const char * src = fi->getChunkPointer(length * sizeof(double));
+  if (src == NULL) {
+    if (!fi->getChunkOfBytes((unsigned char *)d, length * sizeof(double)))
+      return FALSE;
+    src = (const char *)d;
+  }
+  this->convertDoubleArray(const_cast<char *>(src), d, length);
   return TRUE;
 }
 
@@ -2362,11 +2425,7 @@ SoInput::convertShortArray(char * from, short * to, int len)
 void
 SoInput::convertInt32Array(char * from, int32_t * to, int len)
 {
-  for (int i=0; i < len; i++) {
-    this->convertInt32(from, to);
-    from += sizeof(int32_t);
-    to++;
-  }
+  soinput_ntoh_array32(from, to, len);
 }
 
 /*!
@@ -2378,11 +2437,7 @@ SoInput::convertInt32Array(char * from, int32_t * to, int len)
 void
 SoInput::convertFloatArray(char * from, float * to, int len)
 {
-  for (int i=0; i < len; i++) {
-    this->convertFloat(from, to);
-    from += sizeof(float);
-    to++;
-  }
+  soinput_ntoh_array32(from, to, len);
 }
 
 /*!
@@ -2394,11 +2449,7 @@ SoInput::convertFloatArray(char * from, float * to, int len)
 void
 SoInput::convertDoubleArray(char * from, double * to, int len)
 {
-  for (int i=0; i < len; i++) {
-    this->convertDouble(from, to);
-    from += sizeof(double);
-    to++;
-  }
+  soinput_ntoh_array64(from, to, len);
 }
 
 /*!
@@ -2429,6 +2480,64 @@ SoInput::isFileVRML2(void)
   return FALSE;
 }
 
+/*!
+  Sets the number of threads used for reading large ASCII arrays of
+  numbers, like the point list of an SoCoordinate3 node or the
+  coordIndex list of an SoIndexedFaceSet node.
+
+  When a complete array is available in the input buffer, its values
+  are converted in one go instead of one at a time. Arrays which are
+  large enough are then split in pieces which are converted in
+  parallel. The values read are the same as when only one thread is
+  used.
+
+  Multiple threads are only used if Coin was built with thread
+  support.
+
+  The setting is also used by SoDB::readAll() and
+  SoDB::readAllVRML(), for ASCII files which are read from a memory
+  buffer or a memory mapped file. If the file has many nodes at the
+  top level, or a single root SoSeparator or SoGroup with many
+  children, these are split in as many pieces as there are threads,
+  and the pieces are read with separate SoInput instances. The pieces
+  are never split between a DEF and a USE of the same name, and the
+  names are registered in file order when all pieces have been read,
+  so the resulting scene graph is the same as when the file is read
+  in one go. Files with PROTOs or ROUTEs, nodes which read other
+  files (like SoFile, SoVRMLInline or textures) or unknown node types
+  are always read in one go. Files are only read in pieces if Coin
+  was built thread safe.
+
+  Default is 1.
+
+  \sa getNumParseThreads()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoInput::setNumParseThreads(const int numthreads)
+{
+  assert(numthreads >= 1);
+  PRIVATE(this)->numparsethreads = numthreads;
+}
+
+/*!
+  Returns the number of threads used for reading large ASCII arrays.
+
+  \sa setNumParseThreads()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+int
+SoInput::getNumParseThreads(void) const
+{
+  return PRIVATE(this)->numparsethreads;
+}
+
 /*!
   This function has been obsoleted in Coin.
 */
@@ -37,8 +37,29 @@
 
 #include <Inventor/SoInput.h>
 
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#include <Inventor/SbBasic.h>
+#include <Inventor/C/tidbits.h>
+
+#ifdef HAVE_THREADS
+#include <Inventor/C/threads/wpool.h>
+#endif // HAVE_THREADS
+
 #include "io/SoInputP.h"
 #include "io/SoInput_FileInfo.h"
+#include "io/floatconv.h"
+
+// *************************************************************************
+
+SoInputP::~SoInputP()
+{
+#ifdef HAVE_THREADS
+  if (this->parsepool) cc_wpool_destruct(this->parsepool);
+#endif // HAVE_THREADS
+}
 
 // *************************************************************************
 
@@ -64,6 +85,16 @@ SoInputP::debugBinary(void)
   return debug ? TRUE : FALSE;
 }
 
+SbBool
+SoInputP::deferName(SoInput * in, SoBase * base, const SbName & name)
+{
+  SoInputP * thisp = in->pimpl;
+  if (!thisp->defernames) return FALSE;
+  thisp->deferredbases.append(base);
+  thisp->deferrednames.append(name);
+  return TRUE;
+}
+
 // *************************************************************************
 /*
   Important note: Up until Coin 3.1.1 we used to have a bug in SoInput
@@ -324,3 +355,298 @@ SoInputP::isNameCharVRML2(unsigned char c, SbBool validIdent)
   if (validIdent) return (valid_ident_invalid_vrml2_table[c] == 0);
   return (invalid_vrml2_table[c] == 0);
 }
+
+// *************************************************************************
+
+// Fast path for ASCII arrays of numbers.
+//
+// The bracketed value list of fields like SoMFVec3f or SoMFInt32 is
+// otherwise read one value at a time through SoInput::read(float &)
+// and friends, with every character going through
+// SoInput_FileInfo::get() and putBack(). When the complete list is
+// available in the read buffer (which is always the case for memory
+// buffers and memory mapped files), it is instead tokenized and
+// converted straight from the buffer. Large lists are split in
+// chunks, which are handled in parallel when more than one parse
+// thread has been set up with SoInput::setNumParseThreads().
+//
+// Only lists which the value-by-value code would read without posting
+// any errors or warnings are accepted. Comments, hexadecimal or octal
+// integers, unexpected characters, syntax errors or numbers that
+// might not convert to a finite value make scanASCIIArray() give up,
+// and the list is then read the normal way, so that error messages
+// and their getLocationString() are the same as before. Floating
+// point numbers are converted with coin_parse_float(), like in
+// SoInput_FileInfo::readReal(), so the values are the same too.
+
+// Lists shorter than this are not split.
+static const size_t SOINPUT_MIN_CHUNK_SIZE = 64 * 1024;
+
+// Same as SoInput_FileInfo::isSpace().
+static inline SbBool
+soinput_array_is_space(const char c, const SbBool vrml2)
+{
+  return (c == ' ') || (c == '\n') || (c == '\t') || (c == '\r') ||
+    (c == '\f') || (c == '\v') || (vrml2 && (c == ','));
+}
+
+static inline SbBool
+soinput_array_is_digit(const char c)
+{
+  return (c >= '0') && (c <= '9');
+}
+
+// Checks the syntax of the number starting at s, and returns a
+// pointer to the first character after it. Returns NULL if the number
+// is not valid, or if it has to be left to the value-by-value code.
+static const char *
+soinput_array_scan_number(const char * s, const char * end,
+                          const SoInputP::ArrayType type)
+{
+  if ((s < end) && ((*s == '-') || (*s == '+'))) {
+    if (type == SoInputP::UINT32_ARRAY) return NULL;
+    s++;
+  }
+  const char * digits = s;
+  while ((s < end) && soinput_array_is_digit(*s)) s++;
+  const ptrdiff_t numdigits = s - digits;
+
+  if (type != SoInputP::FLOAT_ARRAY) {
+    // strtol() reads numbers with a leading zero as octal or
+    // hexadecimal, and more digits than this might overflow.
+    if ((numdigits == 0) || (numdigits > 9)) return NULL;
+    if ((numdigits > 1) && (digits[0] == '0')) return NULL;
+    return s;
+  }
+
+  SbBool gotnum = (numdigits > 0);
+  // the digits which count towards the magnitude of the value
+  const char * significant = digits;
+  while ((significant < s) && (*significant == '0')) significant++;
+  const ptrdiff_t magnitude = s - significant;
+  if ((s < end) && (*s == '.')) {
+    s++;
+    const char * fraction = s;
+    while ((s < end) && soinput_array_is_digit(*s)) s++;
+    if (s > fraction) gotnum = TRUE;
+  }
+  if (!gotnum) return NULL;
+
+  int exp10 = 0;
+  if ((s < end) && ((*s == 'e') || (*s == 'E'))) {
+    s++;
+    SbBool minus = FALSE;
+    if ((s < end) && ((*s == '-') || (*s == '+'))) {
+      minus = (*s == '-');
+      s++;
+    }
+    const char * exponent = s;
+    int e = 0;
+    while ((s < end) && soinput_array_is_digit(*s) && (s - exponent < 4)) {
+      e = e * 10 + (*s - '0');
+      s++;
+    }
+    if ((s == exponent) || ((s < end) && soinput_array_is_digit(*s))) return NULL;
+    exp10 = minus ? -e : e;
+  }
+  // Keep the value below 10^38, within the range of a float.
+  if (magnitude + exp10 > 38) return NULL;
+  return s;
+}
+
+// Tokenizes a chunk, counting its numbers and keeping track of the
+// commas.
+static void
+soinput_array_scan_chunk(void * closure)
+{
+  SoInputP::ArrayChunk * chunk = static_cast<SoInputP::ArrayChunk *>(closure);
+  const char * s = chunk->start;
+  const char * end = chunk->end;
+  const SbBool vrml2 = chunk->vrml2;
+
+  enum { START, AFTER_NUMBER, AFTER_COMMA } state = START;
+  while (s < end) {
+    const char c = *s;
+    if (soinput_array_is_space(c, vrml2)) {
+      s++;
+    }
+    else if (c == ',') {
+      // There can be one comma after each value.
+      if (state == AFTER_COMMA) return;
+      if (state == START) chunk->leadingcomma = TRUE;
+      chunk->commamask |= 1 << (chunk->numnumbers % chunk->numcomponents);
+      state = AFTER_COMMA;
+      s++;
+    }
+    else {
+      const char * next = soinput_array_scan_number(s, end, chunk->type);
+      if (next == NULL) return;
+      if ((next < end) && !soinput_array_is_space(*next, vrml2) && (*next != ',')) return;
+      chunk->numnumbers++;
+      state = AFTER_NUMBER;
+      s = next;
+    }
+  }
+  chunk->trailingcomma = (state == AFTER_COMMA);
+  chunk->ok = TRUE;
+}
+
+// Converts the numbers of a chunk which has been checked by
+// soinput_array_scan_chunk(). The chunk always ends in front of
+// whitespace, a comma or the closing ']', so the loops below don't
+// need to check for the end of the chunk.
+static void
+soinput_array_convert_chunk(void * closure)
+{
+  SoInputP::ArrayChunk * chunk = static_cast<SoInputP::ArrayChunk *>(closure);
+  const char * s = chunk->start;
+  const SbBool vrml2 = chunk->vrml2;
+  const int num = chunk->numnumbers;
+
+  if (chunk->type == SoInputP::FLOAT_ARRAY) {
+    float * values = static_cast<float *>(chunk->values) + chunk->firstnumber;
+    for (int i = 0; i < num; i++) {
+      while (soinput_array_is_space(*s, vrml2) || (*s == ',')) s++;
+      s = coin_parse_float(s, chunk->end, values[i]);
+      assert(s != NULL);
+    }
+  }
+  else {
+    int32_t * values = static_cast<int32_t *>(chunk->values) + chunk->firstnumber;
+    for (int i = 0; i < num; i++) {
+      while (soinput_array_is_space(*s, vrml2) || (*s == ',')) s++;
+      SbBool minus = FALSE;
+      if (*s == '-') { minus = TRUE; s++; }
+      else if (*s == '+') { s++; }
+      int32_t l = 0;
+      while (soinput_array_is_digit(*s)) { l = l * 10 + (*s++ - '0'); }
+      values[i] = minus ? -l : l;
+    }
+  }
+}
+
+void
+SoInputP::runArrayChunks(void (*func)(void *))
+{
+  const int num = this->arraychunks.getLength();
+#ifdef HAVE_THREADS
+  if (num > 1) {
+    if (this->parsepool == NULL) {
+      this->parsepool = cc_wpool_construct(num);
+    }
+    else if (cc_wpool_get_num_workers(this->parsepool) < num) {
+      cc_wpool_set_num_workers(this->parsepool, num);
+    }
+    cc_wpool_begin(this->parsepool, num);
+    for (int i = 0; i < num; i++) {
+      cc_wpool_start_worker(this->parsepool, func, &this->arraychunks[i]);
+    }
+    cc_wpool_end(this->parsepool);
+    cc_wpool_wait_all(this->parsepool);
+    return;
+  }
+#endif // HAVE_THREADS
+  for (int i = 0; i < num; i++) { func(&this->arraychunks[i]); }
+}
+
+int
+SoInputP::scanASCIIArray(SoInput * in, const ArrayType type,
+                         const int numcomponents)
+{
+  static int disabled = -1;
+  if (disabled == -1) {
+    const char * env = coin_getenv("COIN_SOINPUT_NO_FAST_ARRAYS");
+    disabled = (env && (atoi(env) > 0)) ? 1 : 0;
+  }
+  if (disabled) return 0;
+
+  assert((numcomponents >= 1) && (numcomponents <= 4));
+
+  SoInput_FileInfo * fi = in->getTopOfStack();
+  if (fi->isBinary()) return 0;
+
+  // The complete list must be in the read buffer.
+  size_t length;
+  const char * start = fi->getBufferSpan(length);
+  if (start == NULL) return 0;
+  const char * end = static_cast<const char *>(memchr(start, ']', length));
+  if (end == NULL) return 0;
+  length = end - start;
+
+  SoInputP * thisp = in->pimpl;
+  int numchunks = 1;
+  if (thisp->numparsethreads > 1) {
+    numchunks = SbMax(1, SbMin(thisp->numparsethreads,
+                               int(length / SOINPUT_MIN_CHUNK_SIZE)));
+  }
+
+  thisp->arraychunks.truncate(0);
+  const char * chunkstart = start;
+  for (int i = 0; i < numchunks; i++) {
+    const char * chunkend = end;
+    if (i < numchunks - 1) {
+      chunkend = SbMax(chunkstart, start + length / numchunks * (i + 1));
+      // don't split numbers
+      while ((chunkend < end) && !coin_isspace(*chunkend) && (*chunkend != ',')) {
+        chunkend++;
+      }
+    }
+    ArrayChunk chunk;
+    chunk.start = chunkstart;
+    chunk.end = chunkend;
+    chunk.type = type;
+    chunk.numcomponents = numcomponents;
+    chunk.vrml2 = fi->isFileVRML2();
+    chunk.values = NULL;
+    chunk.firstnumber = 0;
+    chunk.numnumbers = 0;
+    chunk.commamask = 0;
+    chunk.leadingcomma = FALSE;
+    chunk.trailingcomma = FALSE;
+    chunk.ok = FALSE;
+    thisp->arraychunks.append(chunk);
+    chunkstart = chunkend;
+  }
+
+  thisp->runArrayChunks(soinput_array_scan_chunk);
+
+  // Check the commas against the values they follow, also across
+  // chunk boundaries.
+  int numnumbers = 0;
+  SbBool aftercomma = FALSE;
+  for (int i = 0; i < numchunks; i++) {
+    ArrayChunk & chunk = thisp->arraychunks[i];
+    if (!chunk.ok) return 0;
+    if (chunk.leadingcomma && ((numnumbers == 0) || aftercomma)) return 0;
+    for (int r = 0; r < numcomponents; r++) {
+      if ((chunk.commamask & (1 << r)) && ((numnumbers + r) % numcomponents)) {
+        return 0;
+      }
+    }
+    chunk.firstnumber = numnumbers;
+    numnumbers += chunk.numnumbers;
+    if ((chunk.numnumbers > 0) || chunk.leadingcomma) {
+      aftercomma = chunk.trailingcomma;
+    }
+  }
+  if ((numnumbers == 0) || (numnumbers % numcomponents)) return 0;
+
+  thisp->arraylength = length;
+  return numnumbers / numcomponents;
+}
+
+void
+SoInputP::readASCIIArray(SoInput * in, void * values)
+{
+  SoInputP * thisp = in->pimpl;
+  const int numchunks = thisp->arraychunks.getLength();
+  assert(numchunks > 0);
+  for (int i = 0; i < numchunks; i++) {
+    thisp->arraychunks[i].values = values;
+  }
+  thisp->runArrayChunks(soinput_array_convert_chunk);
+  thisp->arraychunks.truncate(0);
+
+  // skip past the list, including the closing bracket
+  in->getTopOfStack()->skipBufferSpan(thisp->arraylength + 1);
+}
@@ -39,8 +39,14 @@
 
 // *************************************************************************
 
+#include <Inventor/SbName.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/C/threads/common.h>
+
 #include "misc/SbHash.h"
 
+class SoBase;
+class SoGroup;
 class SoInput;
 class SoInput_FileInfo;
 
@@ -51,7 +57,11 @@ public:
   SoInputP(SoInput * owner) {
     this->owner = owner;
     this->usingstdin = FALSE;
+    this->numparsethreads = 1;
+    this->parsepool = NULL;
+    this->defernames = FALSE;
   }
+  ~SoInputP();
 
   static SbBool debug(void);
   static SbBool debugBinary(void);
@@ -65,12 +75,68 @@ public:
   static SbBool isNameStartCharVRML2(unsigned char c, SbBool validIdent);
   static SbBool isNameCharVRML2(unsigned char c, SbBool validIdent);
 
+  // Fast path for the bracketed value lists of ASCII multiple-value
+  // fields of plain numbers. scanASCIIArray() returns the number of
+  // values in the list, without consuming any input, or 0 if the
+  // list must be read value by value. readASCIIArray() then converts
+  // the values into the given storage, and skips past the closing
+  // ']'.
+  enum ArrayType { FLOAT_ARRAY, INT32_ARRAY, UINT32_ARRAY };
+  static int scanASCIIArray(SoInput * in, const ArrayType type,
+                            const int numcomponents);
+  static void readASCIIArray(SoInput * in, void * values);
+
+  class ArrayChunk {
+  public:
+    const char * start;
+    const char * end;
+    ArrayType type;
+    int numcomponents;
+    SbBool vrml2;
+    void * values;
+    int firstnumber;
+    int numnumbers;
+    unsigned int commamask;
+    SbBool leadingcomma;
+    SbBool trailingcomma;
+    SbBool ok;
+  };
+
+  // Parallel reading of the top-level nodes of a file, for
+  // SoDB::readAll(). If the rest of the input can be split in pieces
+  // which are independent of each other, the pieces are read with
+  // separate SoInput instances, and the nodes are added to root in
+  // file order. Returns PARALLEL_READ_SKIPPED, without consuming any
+  // input, if the input must be read the normal way.
+  enum ParallelReadResult {
+    PARALLEL_READ_SKIPPED, PARALLEL_READ_OK, PARALLEL_READ_FAILED
+  };
+  static ParallelReadResult readAllInParallel(SoInput * in, SoGroup * root);
+
+  // Called when a DEF'ed instance is read. While the pieces of a file
+  // are read in parallel, the names are not set right away, but in
+  // file order after all pieces have been read, so that the global
+  // name lists end up the same as after a serial read. Returns FALSE
+  // if the caller should set the name itself.
+  static SbBool deferName(SoInput * in, SoBase * base, const SbName & name);
+
   SbBool usingstdin;
+  int numparsethreads;
 
   SbHash<const char *, SoBase *> copied_references;
 
 private:
+  void runArrayChunks(void (*func)(void *));
+
   SoInput * owner;
+
+  SbList<ArrayChunk> arraychunks;
+  size_t arraylength;
+  cc_wpool * parsepool;
+
+  SbBool defernames;
+  SbList<SoBase *> deferredbases;
+  SbList<SbName> deferrednames;
 };
 
 // *************************************************************************
@@ -33,7 +33,6 @@
 #include "io/SoInput_FileInfo.h"
 
 #include <cstring>
-#include <cmath> // pow()
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -47,10 +46,12 @@
 
 #include "tidbitsp.h"
 #include "glue/zlib.h"
+#include "io/floatconv.h"
 
 // *************************************************************************
 
 const unsigned int READBUFSIZE = 65536*2;
+const int REALBUFSIZE = 2048;
 
 // *************************************************************************
 
@@ -71,8 +72,10 @@ SoInput_FileInfo::SoInput_FileInfo(SoInput_Reader * readerptr,
   this->threadbufidx = 0;
   this->threadeof = FALSE;
   this->readbuf = NULL;
+  this->ownreadbuf = NULL;
 #else // HAVE_THREADS && SOINPUT_ASYNC_IO
-  this->readbuf = new char[READBUFSIZE];
+  this->ownreadbuf = new char[READBUFSIZE];
+  this->readbuf = this->ownreadbuf;
 #endif // !(HAVE_THREADS && SOINPUT_ASYNC_IO)
   this->readbuflen = 0;
   this->readbufidx = 0;
@@ -110,7 +113,7 @@ SoInput_FileInfo::~SoInput_FileInfo()
   delete[] this->threadbuf[0];
   delete[] this->threadbuf[1];
 #else // HAVE_THREADS && SOINPUT_ASYNC_IO
-  delete[] this->readbuf;
+  delete[] this->ownreadbuf;
 #endif // !(HAVE_THREADS && SOINPUT_ASYNC_IO)
   delete this->reader;
   // to be safe, delete this after deleting the reader
@@ -181,7 +184,17 @@ SoInput_FileInfo::doBufferRead(void)
 
 #else // HAVE_THREADS && SOINPUT_ASYNC_IO
 
-  size_t len = this->getReader()->readBuffer(this->readbuf, READBUFSIZE);
+  // readers with the data already in memory (memory buffers and
+  // mapped files) are read without copying the data
+  size_t len = 0;
+  const char * direct = this->getReader()->readDirect(len);
+  if (direct) {
+    this->readbuf = const_cast<char *>(direct);
+  }
+  else {
+    this->readbuf = this->ownreadbuf;
+    len = this->getReader()->readBuffer(this->readbuf, READBUFSIZE);
+  }
   if (len == 0) {
     this->readbufidx = 0;
     this->readbuflen = 0;
@@ -215,10 +228,12 @@ SoInput_FileInfo::getChunkOfBytes(unsigned char * ptr, size_t length)
 
   do {
     // Grab bytes from the buffer.
-    while ((this->readbufidx < this->readbuflen) && (length > 0)) {
-      *ptr++ = this->readbuf[this->readbufidx++];
-      --length;
-    }
+    size_t n = this->readbuflen - this->readbufidx;
+    if (n > length) n = length;
+    memcpy(ptr, this->readbuf + this->readbufidx, n);
+    this->readbufidx += n;
+    ptr += n;
+    length -= n;
 
     // Fetch more bytes if necessary. doBufferRead() sets the eof-flag
     // as a side-effect.
@@ -229,6 +244,81 @@ SoInput_FileInfo::getChunkOfBytes(unsigned char * ptr, size_t length)
   return !this->eof;
 }
 
+// Returns a pointer to the next length bytes in the read buffer, and
+// skips past them, if they are all available in the buffer. Returns
+// NULL otherwise, in which case getChunkOfBytes() must be used.
+const char *
+SoInput_FileInfo::getChunkPointer(size_t length)
+{
+  if (this->backbuffer.getLength() > 0 ||
+      this->readbuflen - this->readbufidx < length) return NULL;
+  const char * ptr = this->readbuf + this->readbufidx;
+  this->readbufidx += length;
+  return ptr;
+}
+
+// Returns a pointer to the unread part of the read buffer, with its
+// length in the length argument, or NULL if characters have been put
+// back in front of it. Nothing is consumed; see skipBufferSpan().
+const char *
+SoInput_FileInfo::getBufferSpan(size_t & length)
+{
+  if (this->backbuffer.getLength() > 0) return NULL;
+  length = this->readbuflen - this->readbufidx;
+  return this->readbuf + this->readbufidx;
+}
+
+// Skips past the first length characters returned by
+// getBufferSpan(), counting lines the same way as get() does.
+void
+SoInput_FileInfo::skipBufferSpan(size_t length)
+{
+  assert(this->backbuffer.getLength() == 0);
+  assert(length <= this->readbuflen - this->readbufidx);
+  if (length == 0) return;
+
+  const char * ptr = this->readbuf + this->readbufidx;
+  int prev = this->lastchar;
+  for (size_t i = 0; i < length; i++) {
+    const char c = ptr[i];
+    if ((c == '\r') || ((c == '\n') && (prev != '\r'))) this->linenr++;
+    prev = c;
+  }
+  this->lastchar = ptr[length - 1];
+  this->lastputback = -1;
+  this->readbufidx += length;
+}
+
+// Returns the unread rest of the input, when all of it is already in
+// the read buffer (memory buffers and memory mapped files), or NULL
+// otherwise. Nothing is consumed; see skipBufferSpan().
+const char *
+SoInput_FileInfo::getRemainingInput(size_t & length)
+{
+#if defined(HAVE_THREADS) && defined(SOINPUT_ASYNC_IO)
+  return NULL;
+#else // HAVE_THREADS && SOINPUT_ASYNC_IO
+  if ((this->reader == NULL) || this->eof || (this->readbuflen == 0)) return NULL;
+  const SoInput_Reader::ReaderType type = this->getReader()->getType();
+  if ((type != SoInput_Reader::MEMBUFFER) &&
+      (type != SoInput_Reader::MMAPFILE)) return NULL;
+  return this->getBufferSpan(length);
+#endif // !(HAVE_THREADS && SOINPUT_ASYNC_IO)
+}
+
+// Makes this input use the same file format as other, as if the
+// header of other had been read from it.
+void
+SoInput_FileInfo::copyHeader(const SoInput_FileInfo * other)
+{
+  this->headerisread = TRUE;
+  this->header = other->header;
+  this->ivversion = other->ivversion;
+  this->isbinary = other->isbinary;
+  this->vrml1file = other->vrml1file;
+  this->vrml2file = other->vrml2file;
+}
+
 void
 SoInput_FileInfo::addReference(const SbName & name, SoBase * base,
                                SbBool /* addToGlobalDict */) // FIXME: why the unused arg?
@@ -590,58 +680,66 @@ SoInput_FileInfo::readInteger(int32_t & l)
   return TRUE;
 }
 
+// Returns the rest of the read buffer, if that is where get() will
+// read the next characters from.
 SbBool
-SoInput_FileInfo::readReal(double & d)
+SoInput_FileInfo::getBufferedChars(const char *& start, const char *& end) const
+{
+  if ((this->readbufidx == 0) && (this->backbuffer.getLength() > 0)) return FALSE;
+  if (this->readbufidx >= this->readbuflen) return FALSE;
+  start = this->readbuf + this->readbufidx;
+  end = this->readbuf + this->readbuflen;
+  return TRUE;
+}
+
+// Skips characters returned by getBufferedChars(), like get() would,
+// up to next. They must not include any newlines.
+void
+SoInput_FileInfo::skipBufferedChars(const char * next)
+{
+  this->readbufidx = next - this->readbuf;
+  this->lastchar = this->readbuf[this->readbufidx - 1];
+  this->lastputback = -1;
+}
+
+// Reads the characters of a floating point number into str, which
+// has room for size characters, and returns how many there were, or 0
+// if they didn't make up a valid number or didn't fit.
+int
+SoInput_FileInfo::readRealString(char * str, const int size)
 {
-  assert(!this->isBinary());
-  const int BUFSIZE = 2048;
-  SbBool minus = FALSE;
   SbBool gotNum = FALSE;
-  int i, n;
-  char str[BUFSIZE];
+  int n;
   char * s = str;
-
-  double number;
-  double exponent;
+  // keep the last slot free, so a full buffer means a truncated number
+  char * const last = str + size - 1;
 
   n = this->readChar(s, '-');
-  if (n == 0) {
-    n = this->readChar(s, '+');
-  }
-  else minus = TRUE;
+  if (n == 0) n = this->readChar(s, '+');
   s += n;
 
-  if ((n = this->readDigits(s)) > 0) {
+  if ((n = this->readDigits(s, (int)(last - s))) > 0) {
     gotNum = TRUE;
-    number = 0.0;
-    double mul = 1.0;
-    for (i = 0; i < n; i++) {
-      number += (s[(n-1)-i] - '0') * mul;
-      mul *= 10.0;
-    }
     s += n;
   }
-  else {
-    number = 0.0;
-  }
-  if (this->readChar(s, '.') > 0) {
+  if ((s < last) && (this->readChar(s, '.') > 0)) {
     s++;
-
-    if ((n = this->readDigits(s)) > 0) {
+    if ((n = this->readDigits(s, (int)(last - s))) > 0) {
       gotNum = TRUE;
-      double mul = 0.1;
-      for (i = 0; i < n; i++) {
-        number += (s[i]-'0') * mul;
-        mul *= 0.1;
-      }
       s += n;
     }
   }
 
-  if (! gotNum)
-    return FALSE;
+  if (s == last) {
+#if COIN_DEBUG
+    SoDebugError::postWarning("SoInput_FileInfo::readRealString",
+                              "number exceeds %d characters", size - 1);
+#endif // COIN_DEBUG
+    return 0;
+  }
 
-  if (minus) number = -number;
+  if (! gotNum)
+    return 0;
 
   n = this->readChar(s, 'e');
   if (n == 0)
@@ -650,31 +748,60 @@ SoInput_FileInfo::readReal(double & d)
   if (n > 0) {
     s += n;
 
-    minus = FALSE;
     n = this->readChar(s, '-');
-    if (n == 0) {
-      n = this->readChar(s, '+');
-    }
-    else minus = TRUE;
+    if (n == 0) n = this->readChar(s, '+');
     s += n;
 
-    if ((n = this->readDigits(s)) > 0) {
-      exponent = 0.0;
-      double mul = 1.0;
-      for (i = 0; i < n; i++) {
-        exponent += (s[(n-1)-i]-'0') * mul;
-        mul *= 10.0;
-      }
-      if (minus) exponent = -exponent;
+    if ((n = this->readDigits(s, (int)(last - s))) > 0) s += n;
+    else return 0;
 
-      number *= pow(10.0, exponent);
+    if (s == last) return 0;
+  }
+
+  return (int)(s - str);
+}
+
+// The numbers are normally converted straight from the read buffer.
+// Only when a number isn't complete in the buffer (or isn't valid),
+// the characters are read one by one, to get the same error handling
+// as for other tokens.
+
+SbBool
+SoInput_FileInfo::readReal(double & d)
+{
+  assert(!this->isBinary());
+  const char * start, * end;
+  if (this->getBufferedChars(start, end)) {
+    const char * next = coin_parse_double(start, end, d);
+    if (next && (next < end)) {
+      this->skipBufferedChars(next);
+      return TRUE;
     }
-    else
-      return FALSE;
   }
 
-  d = number;
-  return TRUE;
+  char str[REALBUFSIZE];
+  const int n = this->readRealString(str, REALBUFSIZE);
+  if (n == 0) return FALSE;
+  return coin_parse_double(str, str + n, d) != NULL;
+}
+
+SbBool
+SoInput_FileInfo::readReal(float & f)
+{
+  assert(!this->isBinary());
+  const char * start, * end;
+  if (this->getBufferedChars(start, end)) {
+    const char * next = coin_parse_float(start, end, f);
+    if (next && (next < end)) {
+      this->skipBufferedChars(next);
+      return TRUE;
+    }
+  }
+
+  char str[REALBUFSIZE];
+  const int n = this->readRealString(str, REALBUFSIZE);
+  if (n == 0) return FALSE;
+  return coin_parse_float(str, str + n, f) != NULL;
 }
 
 int
@@ -694,6 +821,26 @@ SoInput_FileInfo::readChar(char * s, char charToRead)
   return ret;
 }
 
+// Like readDigits(char *), but stops after maxlen digits, leaving any
+// further digits in the input.
+int
+SoInput_FileInfo::readDigits(char * str, const int maxlen)
+{
+  assert(!this->isBinary());
+  char c, * s = str;
+
+  while ((s - str < maxlen) && this->get(c)) {
+    if (isdigit(c))
+      *s++ = c;
+    else {
+      this->putBack(c);
+      break;
+    }
+  }
+  const ptrdiff_t offset = s - str;
+  return (int)offset;
+}
+
 int
 SoInput_FileInfo::readDigits(char * str)
 {
@@ -79,6 +79,10 @@ public:
   size_t getNumBytesParsedSoFar(void) const;
 
   SbBool getChunkOfBytes(unsigned char * ptr, size_t length);
+  const char * getChunkPointer(size_t length);
+  const char * getBufferSpan(size_t & length);
+  void skipBufferSpan(size_t length);
+  const char * getRemainingInput(size_t & length);
   SbBool get(char & c);
 
   void putBack(const char c);
@@ -126,12 +130,16 @@ public:
   void setIvVersion(const float v) {
       this->ivversion = v;
   }
+  void copyHeader(const SoInput_FileInfo * other);
   const SbString & ivHeader(void) {
     return this->header;
   }
   unsigned int lineNr(void) {
     return this->linenr;
   }
+  void setLineNr(const unsigned int nr) {
+    this->linenr = nr;
+  }
   FILE * ivFilePointer(void) {
     // if reader == NULL, it means that we're reading from stdin
     if (this->reader == NULL) return coin_get_stdin();
@@ -145,6 +153,9 @@ public:
   SbBool isEndOfFile(void) const {
     return this->eof;
   }
+  void setEndOfFile(void) {
+    this->eof = TRUE;
+  }
   void applyPostCallback(SoInput * soinput) {
     if (this->postfunc) this->postfunc(this->userdata, soinput);
   }
@@ -203,12 +214,15 @@ public:
   void unrefProtos(void);
   int readChar(char * s, char charToRead);
   int readDigits(char * str);
+  int readDigits(char * str, const int maxlen);
   int readHexDigits(char * str);
 
   SbBool readUnsignedIntegerString(char * str);
   SbBool readUnsignedInteger(uint32_t & l);
   SbBool readInteger(int32_t & l);
+  int readRealString(char * str, const int size);
   SbBool readReal(double & d);
+  SbBool readReal(float & f);
 
   const SbHash<const char *, SoBase *> & getReferences() const {
     return this->references;
@@ -218,6 +232,8 @@ private:
   SoInput_Reader * getReader(void);
   SoInput_Reader * reader;
   SbBool readHeaderInternal(SoInput * input);
+  SbBool getBufferedChars(const char *& start, const char *& end) const;
+  void skipBufferedChars(const char * next);
 
   unsigned int linenr;
 
@@ -229,6 +245,7 @@ private:
   SbBool isbinary;
 
   char * readbuf;
+  char * ownreadbuf; // readbuf, when not reading directly from the reader
   size_t readbufidx;
   size_t readbuflen;
   size_t totalread;
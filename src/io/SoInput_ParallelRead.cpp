@@ -0,0 +1,808 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+// Parallel reading of files with many top-level nodes, for
+// SoDB::readAll().
+//
+// A quick scan of the input, which must all be in memory (a memory
+// buffer or a memory mapped file), first finds where each node
+// starts and ends, by matching braces and brackets outside of
+// strings and comments. This is done for the children of the root
+// group when the file has a single root SoSeparator or SoGroup (as
+// most exported files do), or else for the nodes at the top level of
+// the file. The list of nodes is then cut in one piece per parse
+// thread, and each piece is read with its own SoInput over its part
+// of the buffer. The fields of the root group are read from a copy
+// of the text in front of its first child.
+//
+// A piece can only be read on its own if it doesn't USE nodes DEF'ed
+// in other pieces, so the list is never cut between a DEF and a USE
+// of the same name. The DEF'ed names are registered with the
+// SoInput, and set on the instances, in file order after all pieces
+// have been read, so the scene graph and the global name lists are
+// the same as after a serial read.
+//
+// The file is read the normal way if the scan finds anything which
+// might read differently in pieces, or which is not safe to read
+// from several threads at the same time: PROTOs and ROUTEs, USE of
+// names not DEF'ed earlier in the file, node types which are unknown
+// or read other files (SoFile, textures, inlines and the like),
+// global fields, and old file format versions which need upgrading.
+//
+// Node instances can only be created from several threads at the
+// same time when Coin is built thread safe, so otherwise the file is
+// always read the normal way.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <Inventor/SoInput.h>
+
+#include <cassert>
+#include <cstring>
+
+#include <Inventor/SbName.h>
+#include <Inventor/SbString.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/engines/SoEngine.h>
+#include <Inventor/misc/SoProto.h>
+#include <Inventor/misc/SoProtoInstance.h>
+#include <Inventor/nodes/SoAnnotation.h>
+#include <Inventor/nodes/SoBumpMap.h>
+#include <Inventor/nodes/SoFile.h>
+#include <Inventor/nodes/SoGroup.h>
+#include <Inventor/nodes/SoImage.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoShaderObject.h>
+#include <Inventor/nodes/SoSwitch.h>
+#include <Inventor/nodes/SoTexture2.h>
+#include <Inventor/nodes/SoTexture3.h>
+#include <Inventor/nodes/SoTextureCubeMap.h>
+#include <Inventor/nodes/SoTransformSeparator.h>
+#include <Inventor/nodes/SoWWWInline.h>
+
+#ifdef HAVE_VRML97
+#include <Inventor/VRMLnodes/SoVRMLAudioClip.h>
+#include <Inventor/VRMLnodes/SoVRMLBackground.h>
+#include <Inventor/VRMLnodes/SoVRMLImageTexture.h>
+#include <Inventor/VRMLnodes/SoVRMLInline.h>
+#include <Inventor/VRMLnodes/SoVRMLMovieTexture.h>
+#include <Inventor/VRMLnodes/SoVRMLScript.h>
+#endif // HAVE_VRML97
+
+#include "io/SoInputP.h"
+
+#ifdef COIN_THREADSAFE
+
+#include <Inventor/C/threads/wpool.h>
+
+#include "io/SoInput_FileInfo.h"
+#include "misc/SbHash.h"
+#include "nodes/SoUnknownNode.h"
+
+// *************************************************************************
+
+// Pieces smaller than this are not worth the overhead of a separate
+// SoInput.
+static const size_t SOINPUT_MIN_PIECE_SIZE = 16 * 1024;
+
+namespace {
+
+// Finds the nodes at one level of the input, and the DEF and USE
+// names within each of them.
+class SoInput_Scanner {
+public:
+  SoInput_Scanner(SoInput * in, const char * start, const char * end,
+                  const SbBool vrml1, const SbBool vrml2)
+    : in(in), start(start), end(end), p(start), vrml1(vrml1), vrml2(vrml2)
+  {
+  }
+
+  SbBool scanRootGroup(void);
+  SbBool scanTopLevel(void);
+
+  SoInput * in;
+  const char * start;
+  const char * end;
+
+  // the root group up to its first child, and where its children end
+  const char * rootstart;
+  const char * rootfieldsend;
+  const char * rootend;
+
+  // the extent of each node
+  SbList<const char *> itemstarts;
+  SbList<const char *> itemends;
+  // the DEF and USE names, with the index of the node they are in
+  SbList<const char *> defnames;
+  SbList<int> defitems;
+  SbList<const char *> usenames;
+  SbList<int> useitems;
+
+private:
+  enum ItemResult { ITEM, NO_MORE_ITEMS, GIVE_UP };
+
+  SbBool isSpace(const char c) const {
+    // the same characters as coin_isspace(), inlined as this is
+    // called for nearly every character of the file
+    return (c == ' ') || (c == '\n') || (c == '\t') || (c == '\r') ||
+      (c == '\f') || (c == '\v') || (this->vrml2 && (c == ','));
+  }
+  SbBool isNameStartChar(const unsigned char c, const SbBool validident) const {
+    if (this->vrml2) return SoInputP::isNameStartCharVRML2(c, validident);
+    if (this->vrml1) return SoInputP::isNameStartCharVRML1(c, validident);
+    return SoInputP::isNameStartChar(c, validident);
+  }
+  SbBool isNameChar(const unsigned char c, const SbBool validident) const {
+    if (this->vrml2) return SoInputP::isNameCharVRML2(c, validident);
+    if (this->vrml1) return SoInputP::isNameCharVRML1(c, validident);
+    return SoInputP::isNameChar(c, validident);
+  }
+  static SbBool isWord(const char * s, const char * e, const char * word) {
+    const size_t len = strlen(word);
+    return (size_t(e - s) == len) && (strncmp(s, word, len) == 0);
+  }
+  static SbBool isDelimiter(const char c) {
+    return (c == '{') || (c == '}') || (c == '[') || (c == ']') ||
+      (c == '"') || (c == '#');
+  }
+
+  SbBool skipSpace(void);
+  SbBool skipString(void);
+  SbBool readName(const SbBool validident, const char *& s, const char *& e);
+  const char * readWord(void);
+  SbBool nextIsOpenBrace(void);
+
+  SbBool addDef(void);
+  SbBool addUse(const SbBool toplevel);
+  SbBool checkType(const char * s, const char * e);
+  SoType findType(const SbName & name) const;
+
+  SbBool skipBody(void);
+  ItemResult scanItem(void);
+
+  const char * p;
+  SbBool vrml1, vrml2;
+  SbList<char> open;
+  // a file usually has few distinct node types, so these are just
+  // searched from the start
+  SbList<SbString> checkedtypes;
+  SbList<SbBool> typesok;
+};
+
+// Skips whitespace and comments the way SoInput_FileInfo does.
+// Returns FALSE at the end of the input.
+SbBool
+SoInput_Scanner::skipSpace(void)
+{
+  while (TRUE) {
+    while ((this->p < this->end) && this->isSpace(*this->p)) this->p++;
+    if ((this->p < this->end) && (*this->p == '#')) {
+      while ((this->p < this->end) && (*this->p != '\n') && (*this->p != '\r')) {
+        this->p++;
+      }
+    }
+    else {
+      return (this->p < this->end);
+    }
+  }
+}
+
+// Skips past a quoted string.
+SbBool
+SoInput_Scanner::skipString(void)
+{
+  assert(*this->p == '"');
+  this->p++;
+  while (this->p < this->end) {
+    if (*this->p == '"') { this->p++; return TRUE; }
+    if ((*this->p == '\\') && (this->p + 1 < this->end)) this->p++;
+    this->p++;
+  }
+  return FALSE;
+}
+
+// Reads a name the way SoInput::read(SbName &, SbBool) does.
+SbBool
+SoInput_Scanner::readName(const SbBool validident, const char *& s, const char *& e)
+{
+  if (!this->skipSpace()) return FALSE;
+  if (!this->isNameStartChar(*this->p, validident)) return FALSE;
+  s = this->p++;
+  while ((this->p < this->end) && this->isNameChar(*this->p, validident)) {
+    this->p++;
+  }
+  e = this->p;
+  return TRUE;
+}
+
+// Reads up to the next whitespace, brace, bracket, quote or comment,
+// and returns where the word started.
+const char *
+SoInput_Scanner::readWord(void)
+{
+  const char * s = this->p;
+  while ((this->p < this->end) && !this->isSpace(*this->p) &&
+         !isDelimiter(*this->p)) {
+    this->p++;
+  }
+  return s;
+}
+
+SbBool
+SoInput_Scanner::nextIsOpenBrace(void)
+{
+  return this->skipSpace() && (*this->p == '{');
+}
+
+SbBool
+SoInput_Scanner::addDef(void)
+{
+  const char * s, * e;
+  if (!this->readName(FALSE, s, e)) return FALSE;
+  this->defnames.append(SbName(SbString(s, 0, int(e - s) - 1)).getString());
+  this->defitems.append(this->itemstarts.getLength() - 1);
+  return TRUE;
+}
+
+// Adds the name after a USE keyword. Like
+// SoBase::PImpl::readReference(), a field name following the node
+// name is cut off, which is only valid within a node.
+SbBool
+SoInput_Scanner::addUse(const SbBool toplevel)
+{
+  const char * s, * e;
+  if (!this->readName(FALSE, s, e)) return FALSE;
+  const char * dot = static_cast<const char *>(memchr(s, '.', e - s));
+  if (dot) {
+    if (toplevel) return FALSE;
+    e = dot;
+  }
+  if (e == s) return FALSE;
+  this->usenames.append(SbName(SbString(s, 0, int(e - s) - 1)).getString());
+  this->useitems.append(this->itemstarts.getLength() - 1);
+  return TRUE;
+}
+
+// Same lookup as in SoBase::PImpl::createInstance().
+SoType
+SoInput_Scanner::findType(const SbName & name) const
+{
+  if (this->vrml2) {
+    SbString vrmlname("VRML");
+    vrmlname += name.getString();
+    const SoType type = SoType::fromName(SbName(vrmlname.getString()));
+    if (type != SoType::badType()) return type;
+  }
+  return SoType::fromName(name);
+}
+
+// Checks that nodes of the given type can be read in a piece on
+// their own.
+SbBool
+SoInput_Scanner::checkType(const char * s, const char * e)
+{
+  const int len = int(e - s);
+  for (int i = 0; i < this->checkedtypes.getLength(); i++) {
+    const SbString & checked = this->checkedtypes[i];
+    if ((checked.getLength() == len) && (strncmp(checked.getString(), s, len) == 0)) {
+      return this->typesok[i];
+    }
+  }
+
+  const SbName name(SbString(s, 0, len - 1));
+  SbBool ok = FALSE;
+  const SoType type = this->findType(name);
+  if ((this->in->findProto(name) == NULL) &&
+      (SoProto::findProto(name) == NULL) &&
+      (type != SoType::badType()) &&
+      (type != SoUnknownNode::getClassTypeId()) &&
+      type.canCreateInstance() &&
+      (type.isDerivedFrom(SoNode::getClassTypeId()) ||
+       type.isDerivedFrom(SoEngine::getClassTypeId()))) {
+    // types which read other files or data, or which are otherwise
+    // tied to global state while being read
+    const SoType unsafe[] = {
+      SoFile::getClassTypeId(),
+      SoWWWInline::getClassTypeId(),
+      SoTexture2::getClassTypeId(),
+      SoTexture3::getClassTypeId(),
+      SoTextureCubeMap::getClassTypeId(),
+      SoBumpMap::getClassTypeId(),
+      SoImage::getClassTypeId(),
+      SoShaderObject::getClassTypeId(),
+      SoProtoInstance::getClassTypeId(),
+#ifdef HAVE_VRML97
+      SoVRMLInline::getClassTypeId(),
+      SoVRMLImageTexture::getClassTypeId(),
+      SoVRMLMovieTexture::getClassTypeId(),
+      SoVRMLAudioClip::getClassTypeId(),
+      SoVRMLScript::getClassTypeId(),
+      SoVRMLBackground::getClassTypeId(),
+#endif // HAVE_VRML97
+    };
+    ok = TRUE;
+    for (size_t i = 0; ok && (i < sizeof(unsafe) / sizeof(unsafe[0])); i++) {
+      if (type.isDerivedFrom(unsafe[i])) ok = FALSE;
+    }
+  }
+  this->checkedtypes.append(name.getString());
+  this->typesok.append(ok);
+  return ok;
+}
+
+// Skips the contents of a node, after its opening brace, and past
+// the closing brace. Records the DEF and USE names within it, and
+// checks the types of the nodes within it.
+SbBool
+SoInput_Scanner::skipBody(void)
+{
+  SbList<char> & open = this->open;
+  open.truncate(0);
+  open.push('{');
+  while (this->skipSpace()) {
+    const char c = *this->p;
+    if (c == '"') {
+      if (!this->skipString()) return FALSE;
+    }
+    else if ((c == '{') || (c == '[')) {
+      open.push(c);
+      this->p++;
+    }
+    else if ((c == '}') || (c == ']')) {
+      if (open.pop() != ((c == '}') ? '{' : '[')) return FALSE;
+      this->p++;
+      if (open.getLength() == 0) return TRUE;
+    }
+    else {
+      const char * s = this->readWord();
+      if (this->p == s) return FALSE; // a lone control character
+      const char * e = this->p;
+      // numbers, which most of a file usually is, can be neither
+      // keywords nor node types
+      if (((*s >= '0') && (*s <= '9')) || (*s == '-') || (*s == '+') ||
+          (*s == '.')) continue;
+      if (isWord(s, e, "DEF")) {
+        if (!this->addDef()) return FALSE;
+      }
+      else if (isWord(s, e, "USE")) {
+        if (!this->addUse(FALSE)) return FALSE;
+      }
+      else if (isWord(s, e, "ROUTE") || isWord(s, e, "PROTO") ||
+               isWord(s, e, "EXTERNPROTO") || isWord(s, e, "IS")) {
+        return FALSE;
+      }
+      else if (this->nextIsOpenBrace()) {
+        // a node type
+        for (const char * n = s; n < e; n++) {
+          if (!(n == s ? this->isNameStartChar(*n, TRUE) :
+                this->isNameChar(*n, TRUE))) return FALSE;
+        }
+        if (!this->checkType(s, e)) return FALSE;
+      }
+    }
+  }
+  return FALSE;
+}
+
+// Scans the next node at the current level, as read by
+// SoBase::read(): "[DEF name] type { ... }" or "USE name".
+SoInput_Scanner::ItemResult
+SoInput_Scanner::scanItem(void)
+{
+  if (!this->skipSpace() || (*this->p == '}')) return NO_MORE_ITEMS;
+
+  this->itemstarts.append(this->p);
+  const char * s, * e;
+  if (!this->readName(TRUE, s, e)) return GIVE_UP;
+  if (isWord(s, e, "USE")) {
+    if (!this->addUse(TRUE)) return GIVE_UP;
+  }
+  else {
+    if (isWord(s, e, "DEF")) {
+      if (!this->addDef() || !this->readName(TRUE, s, e)) return GIVE_UP;
+    }
+    if (!this->nextIsOpenBrace() || !this->checkType(s, e)) return GIVE_UP;
+    this->p++;
+    if (!this->skipBody()) return GIVE_UP;
+  }
+  this->itemends.append(this->p);
+  return ITEM;
+}
+
+// Scans the children of a single root group. The root group must be
+// of a type which reads its fields and children with
+// SoGroup::readInstance(), and has no node fields, so that its first
+// child is the first node type or DEF or USE keyword in it.
+SbBool
+SoInput_Scanner::scanRootGroup(void)
+{
+  this->p = this->start;
+  this->itemstarts.truncate(0);
+  this->itemends.truncate(0);
+  this->defnames.truncate(0);
+  this->defitems.truncate(0);
+  this->usenames.truncate(0);
+  this->useitems.truncate(0);
+
+  if (!this->skipSpace()) return FALSE;
+  this->rootstart = this->p;
+  const char * s, * e;
+  if (!this->readName(TRUE, s, e)) return FALSE;
+  if (isWord(s, e, "DEF")) {
+    // the name of the root is registered with the root group piece
+    if (!this->readName(FALSE, s, e) || !this->readName(TRUE, s, e)) return FALSE;
+  }
+  if (!this->nextIsOpenBrace() || !this->checkType(s, e)) return FALSE;
+  const SoType type = this->findType(SbName(SbString(s, 0, int(e - s) - 1)));
+  if ((type != SoGroup::getClassTypeId()) &&
+      (type != SoSeparator::getClassTypeId()) &&
+      (type != SoSwitch::getClassTypeId()) &&
+      (type != SoTransformSeparator::getClassTypeId()) &&
+      (type != SoAnnotation::getClassTypeId())) {
+    return FALSE;
+  }
+  this->p++;
+
+  // the fields of the root group
+  int depth = 0;
+  while (TRUE) {
+    if (!this->skipSpace()) return FALSE;
+    const char c = *this->p;
+    if (c == '"') {
+      if (!this->skipString()) return FALSE;
+    }
+    else if (c == '[') {
+      depth++;
+      this->p++;
+    }
+    else if (c == ']') {
+      if (--depth < 0) return FALSE;
+      this->p++;
+    }
+    else if ((c == '{') || ((c == '}') && (depth > 0))) {
+      return FALSE;
+    }
+    else if (c == '}') {
+      break; // no children
+    }
+    else {
+      const char * word = this->p;
+      s = this->readWord();
+      if (this->p == s) return FALSE;
+      e = this->p;
+      if (memchr(s, '=', e - s)) return FALSE; // a field connection
+      if ((depth == 0) &&
+          (isWord(s, e, "DEF") || isWord(s, e, "USE") || this->nextIsOpenBrace())) {
+        this->p = word;
+        break;
+      }
+    }
+  }
+  this->rootfieldsend = this->p;
+
+  ItemResult result;
+  while ((result = this->scanItem()) == ITEM) { }
+  if ((result == GIVE_UP) || (this->p == this->end)) return FALSE;
+  assert(*this->p == '}');
+  this->p++;
+  this->rootend = this->p;
+
+  // there must be nothing but whitespace after the root group
+  return !this->skipSpace();
+}
+
+// Scans the nodes at the top level of the input.
+SbBool
+SoInput_Scanner::scanTopLevel(void)
+{
+  this->p = this->start;
+  this->itemstarts.truncate(0);
+  this->itemends.truncate(0);
+  this->defnames.truncate(0);
+  this->defitems.truncate(0);
+  this->usenames.truncate(0);
+  this->useitems.truncate(0);
+
+  ItemResult result;
+  while ((result = this->scanItem()) == ITEM) { }
+  return (result == NO_MORE_ITEMS) && (this->p == this->end);
+}
+
+// *************************************************************************
+
+// An SoInput reading one piece of the input. It keeps track of the
+// names DEF'ed in the piece, and reports read errors with the name
+// of the file the piece is from.
+class SoInput_PieceInput : public SoInput {
+public:
+  SoInput_PieceInput(const char * filename) {
+    if (filename) this->filename = filename;
+  }
+
+  virtual const char * getCurFileName(void) const {
+    return (this->filename.getLength() > 0) ? this->filename.getString() : NULL;
+  }
+
+  virtual void addReference(const SbName & name, SoBase * base,
+                            SbBool addToGlobalDict = TRUE) {
+    SoInput::addReference(name, base, addToGlobalDict);
+    this->refnames.append(name);
+    this->refbases.append(base);
+  }
+
+  SbList<SbName> refnames;
+  SbList<SoBase *> refbases;
+
+private:
+  SbString filename;
+};
+
+class SoInput_Piece {
+public:
+  SoInput_PieceInput * input;
+  // read with SoBase::read() like the children of a group, instead
+  // of with SoDB::read() like top-level nodes
+  SbBool children;
+  SbList<SoNode *> nodes;
+  SbBool ok;
+};
+
+} // namespace
+
+static void
+soinput_read_piece(void * closure)
+{
+  SoInput_Piece * piece = static_cast<SoInput_Piece *>(closure);
+  SoInput * in = piece->input;
+  piece->ok = TRUE;
+  while (TRUE) {
+    SoNode * node = NULL;
+    if (piece->children) {
+      SoBase * base;
+      if (!SoBase::read(in, base, SoNode::getClassTypeId())) {
+        piece->ok = FALSE;
+        break;
+      }
+      node = static_cast<SoNode *>(base);
+    }
+    else if (!SoDB::read(in, node)) {
+      piece->ok = FALSE;
+      break;
+    }
+    if (node == NULL) break;
+    node->ref();
+    piece->nodes.append(node);
+  }
+  // everything in the piece must have been read
+  if (piece->ok && !in->eof()) piece->ok = FALSE;
+}
+
+// Counts lines the same way as SoInput_FileInfo.
+static unsigned int
+soinput_count_lines(const char * s, const char * e)
+{
+  unsigned int lines = 0;
+  for (const char * c = s; c < e; c++) {
+    if ((*c == '\r') || ((*c == '\n') && ((c == s) || (c[-1] != '\r')))) lines++;
+  }
+  return lines;
+}
+
+SoInputP::ParallelReadResult
+SoInputP::readAllInParallel(SoInput * in, SoGroup * root)
+{
+  SoInputP * thisp = in->pimpl;
+  if (thisp->numparsethreads < 2) return PARALLEL_READ_SKIPPED;
+
+  SoInput_FileInfo * fi = in->getTopOfStack();
+  if (fi->isBinary() || (fi->getCurrentProto() != NULL)) return PARALLEL_READ_SKIPPED;
+  // files which need upgrading
+  const float version = fi->ivVersion();
+  if ((version == 1.0f) || (version == 2.0f)) return PARALLEL_READ_SKIPPED;
+
+  size_t length;
+  const char * start = fi->getRemainingInput(length);
+  if (start == NULL) return PARALLEL_READ_SKIPPED;
+  const int maxpieces = SbMin(thisp->numparsethreads,
+                              int(length / SOINPUT_MIN_PIECE_SIZE));
+  if (maxpieces < 2) return PARALLEL_READ_SKIPPED;
+
+  const char * end = start + length;
+  SoInput_Scanner scanner(in, start, end, fi->isFileVRML1(), fi->isFileVRML2());
+  const SbBool rootgroup = scanner.scanRootGroup();
+  if (!rootgroup && !scanner.scanTopLevel()) return PARALLEL_READ_SKIPPED;
+  const int numitems = scanner.itemstarts.getLength();
+  if (numitems < 2) return PARALLEL_READ_SKIPPED;
+
+  // Find where the list of nodes can be cut: not between a DEF and
+  // a USE of the same name. A USE of a name not DEF'ed before it is
+  // left to the serial read, which reports it.
+  SbList<int> spans;
+  int i;
+  for (i = 0; i <= numitems; i++) spans.append(0);
+  SbHash<const char *, int> lastdef;
+  int def = 0, use = 0;
+  for (i = 0; i < numitems; i++) {
+    for (; (use < scanner.usenames.getLength()) && (scanner.useitems[use] == i); use++) {
+      int item;
+      if (lastdef.get(scanner.usenames[use], item)) {
+        spans[item + 1]++;
+        spans[i + 1]--;
+      }
+      else {
+        SbBool local = FALSE;
+        for (int d = def; !local && (d < scanner.defnames.getLength()) &&
+               (scanner.defitems[d] == i); d++) {
+          local = (scanner.defnames[d] == scanner.usenames[use]);
+        }
+        if (!local) return PARALLEL_READ_SKIPPED;
+      }
+    }
+    for (; (def < scanner.defnames.getLength()) && (scanner.defitems[def] == i); def++) {
+      lastdef.put(scanner.defnames[def], i);
+    }
+  }
+
+  // Cut the list in pieces of about the same size.
+  const SbBool noheader = (fi->ivHeader().getLength() == 0);
+  SbList<int> cuts;
+  cuts.append(0);
+  const char * first = scanner.itemstarts[0];
+  const size_t total = scanner.itemends[numitems - 1] - first;
+  int open = spans[0];
+  for (i = 1; (i < numitems) && (cuts.getLength() < maxpieces); i++) {
+    open += spans[i];
+    const char * itemstart = scanner.itemstarts[i];
+    // SoDB::read() would take a piece starting with "MM" for a 3D
+    // Studio file if there is no header
+    if (noheader && (itemstart[0] == 'M') && (itemstart[1] == 'M')) continue;
+    const size_t target = total / maxpieces * cuts.getLength();
+    if ((open == 0) && (size_t(itemstart - first) >= target)) cuts.append(i);
+  }
+  if (cuts.getLength() < 2) return PARALLEL_READ_SKIPPED;
+  cuts.append(numitems);
+
+  // Set up the pieces, with the fields of the root group first.
+  SbString rootfields;
+  if (rootgroup) {
+    rootfields = SbString(scanner.rootstart, 0,
+                          int(scanner.rootfieldsend - scanner.rootstart) - 1);
+    rootfields += "}";
+  }
+  SbList<SoInput_Piece *> pieces;
+  const char * filename = in->getCurFileName();
+  unsigned int linenr = fi->lineNr();
+  const char * counted = start;
+  const int firstpiece = rootgroup ? -1 : 0;
+  for (i = firstpiece; i < cuts.getLength() - 1; i++) {
+    const char * piecestart, * pieceend;
+    if (i < 0) {
+      piecestart = scanner.rootstart;
+      pieceend = scanner.rootfieldsend;
+    }
+    else {
+      piecestart = scanner.itemstarts[cuts[i]];
+      pieceend = scanner.itemends[cuts[i + 1] - 1];
+    }
+    linenr += soinput_count_lines(counted, piecestart);
+    counted = piecestart;
+
+    SoInput_Piece * piece = new SoInput_Piece;
+    piece->input = new SoInput_PieceInput(filename);
+    if (i < 0) {
+      piece->input->setBuffer(rootfields.getString(), rootfields.getLength());
+    }
+    else {
+      piece->input->setBuffer(piecestart, pieceend - piecestart);
+    }
+    SoInput_FileInfo * piecefi = piece->input->getTopOfStack();
+    piecefi->copyHeader(fi);
+    piecefi->setLineNr(linenr);
+    piece->input->pimpl->defernames = TRUE;
+    piece->children = rootgroup;
+    piece->ok = FALSE;
+    pieces.append(piece);
+  }
+
+  const int numpieces = pieces.getLength();
+  if (thisp->parsepool == NULL) {
+    thisp->parsepool = cc_wpool_construct(numpieces);
+  }
+  else if (cc_wpool_get_num_workers(thisp->parsepool) < numpieces) {
+    cc_wpool_set_num_workers(thisp->parsepool, numpieces);
+  }
+  cc_wpool_begin(thisp->parsepool, numpieces);
+  for (i = 0; i < numpieces; i++) {
+    cc_wpool_start_worker(thisp->parsepool, soinput_read_piece, pieces[i]);
+  }
+  cc_wpool_end(thisp->parsepool);
+  cc_wpool_wait_all(thisp->parsepool);
+
+  SbBool ok = TRUE;
+  for (i = 0; i < numpieces; i++) {
+    if (!pieces[i]->ok) ok = FALSE;
+  }
+  if (rootgroup && ok && (pieces[0]->nodes.getLength() != 1)) ok = FALSE;
+
+  if (ok) {
+    // the names, in file order
+    int j;
+    for (i = 0; i < numpieces; i++) {
+      SoInput_PieceInput * pin = pieces[i]->input;
+      for (j = 0; j < pin->refnames.getLength(); j++) {
+        in->addReference(pin->refnames[j], pin->refbases[j]);
+      }
+      SoInputP * piecep = pin->pimpl;
+      for (j = 0; j < piecep->deferredbases.getLength(); j++) {
+        piecep->deferredbases[j]->setName(piecep->deferrednames[j]);
+      }
+    }
+
+    // the nodes, in file order
+    SoGroup * parent = root;
+    if (rootgroup) {
+      SoNode * group = pieces[0]->nodes[0];
+      assert(group->isOfType(SoGroup::getClassTypeId()));
+      root->addChild(group);
+      parent = static_cast<SoGroup *>(group);
+    }
+    for (i = rootgroup ? 1 : 0; i < numpieces; i++) {
+      const SbList<SoNode *> & nodes = pieces[i]->nodes;
+      for (j = 0; j < nodes.getLength(); j++) parent->addChild(nodes[j]);
+    }
+  }
+
+  for (i = 0; i < numpieces; i++) {
+    SoInput_Piece * piece = pieces[i];
+    for (int j = 0; j < piece->nodes.getLength(); j++) piece->nodes[j]->unref();
+    delete piece->input;
+    delete piece;
+  }
+
+  // consume the input, as the serial read would have done
+  fi->skipBufferSpan(length);
+  (void) fi->skipWhiteSpace();
+
+  return ok ? PARALLEL_READ_OK : PARALLEL_READ_FAILED;
+}
+
+#else // !COIN_THREADSAFE
+
+SoInputP::ParallelReadResult
+SoInputP::readAllInParallel(SoInput * COIN_UNUSED_ARG(in), SoGroup * COIN_UNUSED_ARG(root))
+{
+  return PARALLEL_READ_SKIPPED;
+}
+
+#endif // !COIN_THREADSAFE
@@ -33,6 +33,7 @@
 #include "io/SoInput_Reader.h"
 
 #include <cstring>
+#include <cstdlib>
 #include <cassert>
 #ifdef HAVE_CONFIG_H
 #include <config.h>
@@ -50,8 +51,14 @@
 #include <sys/stat.h>
 #endif
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif // HAVE_MMAP
+
 #include <Inventor/errors/SoDebugError.h>
+#include <Inventor/C/tidbits.h>
 
+#include "coindefs.h"
 #include "io/gzmemio.h"
 #include "glue/zlib.h"
 #include "glue/bzip2.h"
@@ -66,6 +73,10 @@
 #define BZ_STREAM_END 4
 #endif // BZ_STREAM_END
 
+#ifndef BZ_MAX_UNUSED
+#define BZ_MAX_UNUSED 5000
+#endif // BZ_MAX_UNUSED
+
 //
 // abstract class
 //
@@ -91,6 +102,12 @@ SoInput_Reader::getFilePointer(void)
   return NULL;
 }
 
+const char *
+SoInput_Reader::readDirect(size_t & COIN_UNUSED_ARG(readlen))
+{
+  return NULL;
+}
+
 // creates the correct reader based on the file type in fp (will
 // examine the file header). If fullname is empty, it's assumed that
 // file FILE pointer is passed from the user, and that we cannot
@@ -134,7 +151,7 @@ SoInput_Reader::createReader(FILE * fp, const SbString & fullname)
         int bzerror = BZ_OK;
         void * bzfp = cc_bzglue_BZ2_bzReadOpen(&bzerror,  fp, 0, 0, NULL, 0);
         if ((bzerror == BZ_OK) && (bzfp != NULL)) {
-          reader = new SoInput_BZ2FileReader(fullname.getString(), bzfp);
+          reader = new SoInput_BZ2FileReader(fullname.getString(), bzfp, fp);
         }
         else {
           SoDebugError::postWarning("SoInput_Reader::createReader",
@@ -181,6 +198,33 @@ SoInput_Reader::createReader(FILE * fp, const SbString & fullname)
     }
   }
 
+#if defined(HAVE_MMAP) && defined(HAVE_FSTAT)
+  // Map regular files we have opened ourselves into memory, so the
+  // data can be parsed without copying it through the FILE
+  // buffers. FILE pointers from the user are read with fread(),
+  // since the user may expect the file position to be updated.
+  if ((reader == NULL) && trycompression &&
+      fullname.getLength() && (fullname != "<stdin>") && (sb.st_size > 0)) {
+    static int usemmap = -1;
+    if (usemmap == -1) {
+      const char * env = coin_getenv("COIN_SOINPUT_NO_MMAP");
+      usemmap = !(env && (atoi(env) > 0));
+    }
+    const long offset = ftell(fp);
+    if (usemmap && (offset >= 0) && (offset <= sb.st_size)) {
+      const size_t maplen = (size_t) sb.st_size;
+      void * map = mmap(NULL, maplen, PROT_READ, MAP_PRIVATE, fn, 0);
+      if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+        (void) madvise(map, maplen, MADV_SEQUENTIAL);
+#endif // MADV_SEQUENTIAL
+        reader = new SoInput_MMapReader(fullname.getString(), fp,
+                                        map, maplen, (size_t) offset);
+      }
+    }
+  }
+#endif // HAVE_MMAP && HAVE_FSTAT
+
   if (reader == NULL) {
     reader = new SoInput_FileReader(fullname.getString(), fp);
   }
@@ -269,6 +313,79 @@ SoInput_MemBufferReader::readBuffer(char * buffer, const size_t readlen)
   return len;
 }
 
+const char *
+SoInput_MemBufferReader::readDirect(size_t & readlen)
+{
+  const char * ptr = this->buf + this->bufpos;
+  readlen = this->buflen - this->bufpos;
+  this->bufpos = this->buflen;
+  return ptr;
+}
+
+//
+// memory mapped file class
+//
+
+SoInput_MMapReader::SoInput_MMapReader(const char * const filenamearg,
+                                       FILE * filepointer,
+                                       void * mapptr, const size_t maplenarg,
+                                       const size_t offset)
+{
+  this->filename = filenamearg;
+  this->fp = filepointer;
+  this->map = mapptr;
+  this->maplen = maplenarg;
+  this->mappos = offset;
+}
+
+SoInput_MMapReader::~SoInput_MMapReader()
+{
+#ifdef HAVE_MMAP
+  (void) munmap(this->map, this->maplen);
+#endif // HAVE_MMAP
+  // we only map files we have opened ourselves
+  fclose(this->fp);
+}
+
+SoInput_Reader::ReaderType
+SoInput_MMapReader::getType(void) const
+{
+  return MMAPFILE;
+}
+
+size_t
+SoInput_MMapReader::readBuffer(char * buffer, const size_t readlen)
+{
+  size_t len = this->maplen - this->mappos;
+  if (len > readlen) len = readlen;
+
+  memcpy(buffer, static_cast<const char *>(this->map) + this->mappos, len);
+  this->mappos += len;
+
+  return len;
+}
+
+const char *
+SoInput_MMapReader::readDirect(size_t & readlen)
+{
+  const char * ptr = static_cast<const char *>(this->map) + this->mappos;
+  readlen = this->maplen - this->mappos;
+  this->mappos = this->maplen;
+  return ptr;
+}
+
+const SbString &
+SoInput_MMapReader::getFilename(void)
+{
+  return this->filename;
+}
+
+FILE *
+SoInput_MMapReader::getFilePointer(void)
+{
+  return this->fp;
+}
+
 //
 // gzip readers
 //
@@ -352,9 +469,11 @@ SoInput_GZFileReader::getFilename(void)
 // bzFile class
 //
 
-SoInput_BZ2FileReader::SoInput_BZ2FileReader(const char * const filenamearg, void * fp)
+SoInput_BZ2FileReader::SoInput_BZ2FileReader(const char * const filenamearg, void * bzfparg,
+                                             FILE * fparg)
 {
-  this->bzfp = fp;
+  this->bzfp = bzfparg;
+  this->fp = fparg;
   this->filename = filenamearg;
 }
 
@@ -382,6 +501,15 @@ SoInput_BZ2FileReader::readBuffer(char * buf, const size_t readlen)
   // above. 20050525 mortene.
   int ret = cc_bzglue_BZ2_bzRead(&bzerror, this->bzfp,
                                  buf, (uint32_t)readlen);
+  while (bzerror == BZ_STREAM_END) {
+    // Files written by several compression threads (see
+    // SoOutput::setNumCompressionThreads()) are a sequence of
+    // independent bzip2 streams, so continue with the next one, the
+    // way the bzip2 tool does.
+    if (!this->openNextStream() || (ret > 0)) break;
+    ret = cc_bzglue_BZ2_bzRead(&bzerror, this->bzfp,
+                               buf, (uint32_t)readlen);
+  }
   if ((bzerror != BZ_OK) && (bzerror != BZ_STREAM_END)) {
     ret = 0;
     cc_bzglue_BZ2_bzReadClose(&bzerror, this->bzfp);
@@ -395,6 +523,39 @@ SoInput_BZ2FileReader::readBuffer(char * buf, const size_t readlen)
   return (size_t) ret;
 }
 
+// Closes the current stream at its end, and opens the stream
+// following it in the file, if any. Returns FALSE at the end of the
+// file.
+SbBool
+SoInput_BZ2FileReader::openNextStream(void)
+{
+  int bzerror = BZ_OK;
+  void * unused = NULL;
+  int numunused = 0;
+  cc_bzglue_BZ2_bzReadGetUnused(&bzerror, this->bzfp, &unused, &numunused);
+  // the unused data belongs to the stream, so copy it before closing
+  char unusedbuf[BZ_MAX_UNUSED];
+  if ((bzerror == BZ_OK) && (numunused > 0)) {
+    assert(numunused <= BZ_MAX_UNUSED);
+    (void)memcpy(unusedbuf, unused, numunused);
+  }
+  else {
+    numunused = 0;
+  }
+  cc_bzglue_BZ2_bzReadClose(&bzerror, this->bzfp);
+  this->bzfp = NULL;
+
+  if ((numunused == 0) && (this->fp == NULL || feof(this->fp))) return FALSE;
+
+  this->bzfp = cc_bzglue_BZ2_bzReadOpen(&bzerror, this->fp, 0, 0,
+                                        unusedbuf, numunused);
+  if ((bzerror != BZ_OK) && this->bzfp) {
+    cc_bzglue_BZ2_bzReadClose(&bzerror, this->bzfp);
+    this->bzfp = NULL;
+  }
+  return this->bzfp != NULL;
+}
+
 const SbString &
 SoInput_BZ2FileReader::getFilename(void)
 {
@@ -403,3 +564,4 @@ SoInput_BZ2FileReader::getFilename(void)
 
 #undef BZ_OK
 #undef BZ_STREAM_END
+#undef BZ_MAX_UNUSED
@@ -55,7 +55,8 @@ public:
     MEMBUFFER,
     GZFILE,
     BZ2FILE,
-    GZMEMBUFFER
+    GZMEMBUFFER,
+    MMAPFILE
   };
 
   // must be overloaded to return type
@@ -73,6 +74,13 @@ public:
   // reader uses FILE * to read data.
   virtual FILE * getFilePointer(void);
 
+  // can be overloaded by readers which already have the data in
+  // memory. Should return a pointer to the next readlen bytes of
+  // data, which must stay valid until the reader is destructed, and
+  // set readlen to 0 on eof. Default method returns NULL, which
+  // means that readBuffer() must be used.
+  virtual const char * readDirect(size_t & readlen);
+
   static SoInput_Reader * createReader(FILE * fp, const SbString & fullname);
 
 public:
@@ -103,6 +111,7 @@ public:
 
   virtual ReaderType getType(void) const;
   virtual size_t readBuffer(char * buf, const size_t readlen);
+  virtual const char * readDirect(size_t & readlen);
 
 public:
   char * buf;
@@ -110,6 +119,27 @@ public:
   size_t bufpos;
 };
 
+class SoInput_MMapReader : public SoInput_Reader {
+public:
+  SoInput_MMapReader(const char * const filename, FILE * filepointer,
+                     void * map, const size_t maplen, const size_t offset);
+  virtual ~SoInput_MMapReader();
+
+  virtual ReaderType getType(void) const;
+  virtual size_t readBuffer(char * buf, const size_t readlen);
+  virtual const char * readDirect(size_t & readlen);
+
+  virtual const SbString & getFilename(void);
+  virtual FILE * getFilePointer(void);
+
+public:
+  SbString filename;
+  FILE * fp;
+  void * map;
+  size_t maplen;
+  size_t mappos;
+};
+
 class SoInput_GZMemBufferReader : public SoInput_Reader {
 public:
   SoInput_GZMemBufferReader(const void * bufPointer, size_t bufSize);
@@ -141,7 +171,7 @@ public:
 
 class SoInput_BZ2FileReader : public SoInput_Reader {
 public:
-  SoInput_BZ2FileReader(const char * const filename, void * fp);
+  SoInput_BZ2FileReader(const char * const filename, void * bzfp, FILE * fp);
   virtual ~SoInput_BZ2FileReader();
 
   virtual ReaderType getType(void) const;
@@ -150,7 +180,10 @@ public:
   virtual const SbString & getFilename(void);
 
 public:
+  SbBool openNextStream(void);
+
   void * bzfp;
+  FILE * fp;
   SbString filename;
 };
 
@@ -99,6 +99,8 @@
 #include "glue/zlib.h"
 #include "glue/bzip2.h"
 #include "io/SoOutput_Writer.h"
+#include "io/SoSceneCache.h"
+#include "io/floatconv.h"
 #include "io/SoWriterefCounter.h"
 
 // *************************************************************************
@@ -184,6 +186,10 @@ public:
   SbBool usercalledopenfile;
   SbString fltprecision;
   SbString dblprecision;
+  int fltdigits;
+  int dbldigits;
+  SbBool roundtripfloats;
+  SbBool scenecache;
   int indentlevel;
   SbBool writecompact;
   SbBool disabledwriting;
@@ -197,6 +203,7 @@ public:
 
   SbName compmethod;
   float complevel;
+  int numcompthreads;
 
   void pushRoutes(const SbBool copyprev) {
     const int oldidx = this->routestack.getLength() - 1;
@@ -255,7 +262,8 @@ public:
   SoOutput_Writer * getWriter(void) {
     if (this->writer == NULL) {
       this->writer = SoOutput_Writer::createWriter(coin_get_stdout(), FALSE,
-                                                   this->compmethod, this->complevel);
+                                                   this->compmethod, this->complevel,
+                                                   this->numcompthreads);
     }
     return this->writer;
   }
@@ -340,6 +348,10 @@ SoOutput::constructorCommon(void)
   PRIVATE(this)->binarystream = FALSE;
   PRIVATE(this)->fltprecision = "%.8g";
   PRIVATE(this)->dblprecision = "%.16lg";
+  PRIVATE(this)->fltdigits = 8;
+  PRIVATE(this)->dbldigits = 16;
+  PRIVATE(this)->roundtripfloats = FALSE;
+  PRIVATE(this)->scenecache = FALSE;
   PRIVATE(this)->disabledwriting = FALSE;
   this->wroteHeader = FALSE;
   PRIVATE(this)->writecompact = FALSE;
@@ -350,6 +362,7 @@ SoOutput::constructorCommon(void)
 
   PRIVATE(this)->compmethod = SbName("NONE");
   PRIVATE(this)->complevel = 0.0f;;
+  PRIVATE(this)->numcompthreads = 1;
 }
 
 /*!
@@ -379,7 +392,8 @@ SoOutput::setFilePointer(FILE * newFP)
   this->reset();
   PRIVATE(this)->setWriter(SoOutput_Writer::createWriter(newFP, FALSE,
                                                          PRIVATE(this)->compmethod,
-                                                         PRIVATE(this)->complevel));
+                                                         PRIVATE(this)->complevel,
+                                                         PRIVATE(this)->numcompthreads));
 }
 
 /*!
@@ -418,7 +432,8 @@ SoOutput::openFile(const char * const fileName)
   if (newfile) {
     PRIVATE(this)->setWriter(SoOutput_Writer::createWriter(newfile, TRUE,
                                                            PRIVATE(this)->compmethod,
-                                                           PRIVATE(this)->complevel));
+                                                           PRIVATE(this)->complevel,
+                                                           PRIVATE(this)->numcompthreads));
     PRIVATE(this)->usercalledopenfile = TRUE;
   }
   else {
@@ -511,6 +526,50 @@ SoOutput::getAvailableCompressionMethods(unsigned int & num)
   return SoOutput_compmethods->getArrayPtr();
 }
 
+/*!
+  Sets the number of threads used for compressing files written with
+  \e GZIP or \e BZIP2 compression.
+
+  With more than one thread, the output is cut into blocks which are
+  compressed in parallel while the scene is still being written. Each
+  block becomes an independent gzip member or bzip2 stream, which
+  makes the file slightly larger. Such files are read back by SoInput,
+  and by the gzip and bzip2 tools.
+
+  The setting takes effect the next time a file is opened or set up
+  for writing. Multiple threads are only used if Coin was built with
+  thread support.
+
+  Default is 1.
+
+  \sa getNumCompressionThreads(), setCompression()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoOutput::setNumCompressionThreads(const int numthreads)
+{
+  assert(numthreads >= 1);
+  PRIVATE(this)->numcompthreads = numthreads;
+}
+
+/*!
+  Returns the number of threads used for compressing files.
+
+  \sa setNumCompressionThreads()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+int
+SoOutput::getNumCompressionThreads(void) const
+{
+  return PRIVATE(this)->numcompthreads;
+}
+
 /*!
   Sets up a memory buffer of size \a initSize for writing.
   Writing will start at \a bufPointer + \a offset.
@@ -724,6 +783,85 @@ SoOutput::setFloatPrecision(const int precision)
 
   PRIVATE(this)->fltprecision.sprintf("%%.%dg", fltnum);
   PRIVATE(this)->dblprecision.sprintf("%%.%dlg", dblnum);
+  PRIVATE(this)->fltdigits = fltnum;
+  PRIVATE(this)->dbldigits = dblnum;
+}
+
+/*!
+  Set whether floating point numbers should be written to ASCII files
+  with the fewest digits that read back as exactly the same value,
+  instead of with the precision set by setFloatPrecision().
+
+  This makes an ASCII file preserve the values of a scene graph just
+  like a binary file does, and usually makes the numbers shorter than
+  with the default precision. The default is \c FALSE.
+
+  \sa getRoundTripFloats(), setFloatPrecision()
+  \COIN_FUNCTION_EXTENSION
+  \since Coin 4.0
+*/
+void
+SoOutput::setRoundTripFloats(const SbBool flag)
+{
+  PRIVATE(this)->roundtripfloats = flag;
+}
+
+/*!
+  Returns whether floating point numbers are written with the fewest
+  digits that read back as the same value.
+
+  \sa setRoundTripFloats()
+  \COIN_FUNCTION_EXTENSION
+  \since Coin 4.0
+*/
+SbBool
+SoOutput::getRoundTripFloats(void) const
+{
+  return PRIVATE(this)->roundtripfloats;
+}
+
+/*!
+  Set whether SoWriteAction should write scenes in the binary scene
+  cache format, which is meant for opening very large scenes quickly.
+
+  In this format, large self-contained SoSeparator subgraphs (those
+  which no node outside them refer to, and with no field connections
+  crossing their borders) are stored separately from the rest of the
+  scene, along with their bounding boxes. When such a file is read
+  with SoDB::readAll() or SoDB::read(), only the rest of the scene is
+  read at first. The children of each of the separators are read the
+  first time the separator is traversed by an action which needs
+  them, and render actions cull against the stored bounding boxes
+  without reading the children.
+
+  Reading children on demand works when the file is read directly
+  from disk. A scene cache read from a memory buffer or from a
+  compressed file is kept in memory, and parsed on demand.
+
+  The format is always binary, regardless of setBinary(). The default
+  is \c FALSE.
+
+  \sa isSceneCacheFormat(), setBinary()
+  \COIN_FUNCTION_EXTENSION
+  \since Coin 4.0
+*/
+void
+SoOutput::setSceneCacheFormat(const SbBool flag)
+{
+  PRIVATE(this)->scenecache = flag;
+}
+
+/*!
+  Returns whether scenes are written in the scene cache format.
+
+  \sa setSceneCacheFormat()
+  \COIN_FUNCTION_EXTENSION
+  \since Coin 4.0
+*/
+SbBool
+SoOutput::isSceneCacheFormat(void) const
+{
+  return PRIVATE(this)->scenecache;
 }
 
 /*!
@@ -935,6 +1073,17 @@ void
 SoOutput::write(const float f)
 {
   if (!this->isBinary()) {
+    // Infinity, NaN and precisions above 17 digits are left to
+    // sprintf() below.
+    char buf[COIN_FORMAT_REAL_BUFSIZE];
+    const int len =
+      coin_format_float(buf, f, PRIVATE(this)->roundtripfloats ?
+                        -1 : PRIVATE(this)->fltdigits);
+    if (len >= 0) {
+      this->writeBytesWithPadding(buf, len);
+      return;
+    }
+
     // Use portable locale, to make sure we don't write thousands
     // separators for integers.
     cc_string storedlocale;
@@ -972,6 +1121,15 @@ void
 SoOutput::write(const double d)
 {
   if (!this->isBinary()) {
+    char buf[COIN_FORMAT_REAL_BUFSIZE];
+    const int len =
+      coin_format_double(buf, d, PRIVATE(this)->roundtripfloats ?
+                         -1 : PRIVATE(this)->dbldigits);
+    if (len >= 0) {
+      this->writeBytesWithPadding(buf, len);
+      return;
+    }
+
     // Use portable locale, to make sure we don't write thousands
     // separators for integers.
     cc_string storedlocale;
@@ -1309,14 +1467,16 @@ SoOutput::checkHeader(void)
     // end up in an eternal double-recursive loop.
     this->wroteHeader = TRUE;
 
+    const SbBool binary = this->isBinary() || PRIVATE(this)->scenecache;
     SbString h;
-    if (PRIVATE(this)->headerstring) h = *(PRIVATE(this)->headerstring);
-    else if (this->isBinary()) h = SoOutput::getDefaultBinaryHeader();
+    if (PRIVATE(this)->scenecache) h = SoSceneCache::getHeaderString();
+    else if (PRIVATE(this)->headerstring) h = *(PRIVATE(this)->headerstring);
+    else if (binary) h = SoOutput::getDefaultBinaryHeader();
     else h = SoOutput::getDefaultASCIIHeader();
 
-    if (this->isBinary()) h = this->padHeader(h);
+    if (binary) h = this->padHeader(h);
     h += EOLSTR;
-    if (!this->isBinary()) h += EOLSTR;
+    if (!binary) h += EOLSTR;
     // Note: SoField::get() and SoFieldContainer::get() depends on the
     // fact that the header identification line ends in "\n\n".
 
@@ -48,11 +48,16 @@
 #include <io.h> // Win32 dup()
 #endif // HAVE_IO_H
 
+#ifdef HAVE_THREADS
+#include <Inventor/C/threads/wpool.h>
+#endif // HAVE_THREADS
+
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/SbName.h>
 
 #include "glue/zlib.h"
 #include "glue/bzip2.h"
+#include "io/gzmemio.h"
 
 // We don't want to include bzlib.h, so we just define the constants
 // we use here
@@ -88,18 +93,25 @@ SoOutput_Writer *
 SoOutput_Writer::createWriter(FILE * fp, 
                               const SbBool shouldclose,
                               const SbName & compmethod,
-                              const float level)
+                              const float level,
+                              const int numthreads)
 {
+#ifdef HAVE_THREADS
+  const int numcompthreads = numthreads;
+#else // !HAVE_THREADS
+  const int numcompthreads = 1;
+  (void)numthreads;
+#endif // !HAVE_THREADS
   if (compmethod == "GZIP") {
     if (cc_zlibglue_available()) {
-      return new SoOutput_GZFileWriter(fp, shouldclose, level);
+      return new SoOutput_GZFileWriter(fp, shouldclose, level, numcompthreads);
     }
     SoDebugError::postWarning("SoOutput_Writer::createWriter",
                               "Requested zlib compression, but zlib is not available.");
   }
   if (compmethod == "BZIP2") {
     if (cc_bzglue_available()) {
-      return new SoOutput_BZ2FileWriter(fp, shouldclose, level);
+      return new SoOutput_BZ2FileWriter(fp, shouldclose, level, numcompthreads);
     }
     SoDebugError::postWarning("SoOutput_Writer::createWriter",
                               "Requested bzip2 compression, but libz2 is not available.");
@@ -220,21 +232,197 @@ SoOutput_MemBufferWriter::makeRoomInBuf(size_t bytes)
   return TRUE;
 }
 
+//
+// parallel block compression
+//
+
+SoOutput_BlockCompressor::SoOutput_BlockCompressor(FILE * fparg,
+                                                   CompressFunc * compressarg,
+                                                   BoundFunc * bound,
+                                                   const int levelarg,
+                                                   const size_t blocksizearg,
+                                                   const int numthreadsarg)
+{
+  assert(numthreadsarg >= 1);
+  this->fp = fparg;
+  this->compress = compressarg;
+  this->level = levelarg;
+  this->blocksize = blocksizearg;
+  this->numthreads = numthreadsarg;
+  this->pool = NULL;
+
+  this->outsize = bound(blocksizearg);
+  this->blocks = new Block[2 * numthreadsarg];
+  for (int i = 0; i < 2 * numthreadsarg; i++) {
+    Block & block = this->blocks[i];
+    block.owner = this;
+    block.in = new char[blocksizearg];
+    block.inlen = 0;
+    block.out = new char[this->outsize];
+    block.outlen = 0;
+  }
+  this->fillbatch = this->blocks;
+  this->numfilled = 0;
+  this->runbatch = this->blocks + numthreadsarg;
+  this->numrunning = 0;
+
+  this->numbytesin = 0;
+  this->failed = FALSE;
+}
+
+SoOutput_BlockCompressor::~SoOutput_BlockCompressor()
+{
+  (void)this->flush();
+#ifdef HAVE_THREADS
+  if (this->pool) cc_wpool_destruct(this->pool);
+#endif // HAVE_THREADS
+  for (int i = 0; i < 2 * this->numthreads; i++) {
+    delete[] this->blocks[i].in;
+    delete[] this->blocks[i].out;
+  }
+  delete[] this->blocks;
+}
+
+size_t
+SoOutput_BlockCompressor::write(const char * buf, size_t numbytes)
+{
+  if (this->failed) return 0;
+  size_t left = numbytes;
+  while (left > 0) {
+    Block & block = this->fillbatch[this->numfilled];
+    const size_t n = SbMin(left, this->blocksize - block.inlen);
+    (void)memcpy(block.in + block.inlen, buf, n);
+    block.inlen += n;
+    buf += n;
+    left -= n;
+    if (block.inlen == this->blocksize) {
+      if (++this->numfilled == this->numthreads) this->startBatch();
+    }
+  }
+  this->numbytesin += numbytes;
+  return numbytes;
+}
+
+// Compresses the blocks written so far, and writes them to the file.
+SbBool
+SoOutput_BlockCompressor::flush(void)
+{
+  if (this->fillbatch[this->numfilled].inlen > 0) this->numfilled++;
+  if (this->numfilled > 0) this->startBatch();
+  this->finishBatch();
+  return !this->failed;
+}
+
+void
+SoOutput_BlockCompressor::compressBlock(void * closure)
+{
+  Block * block = static_cast<Block *>(closure);
+  SoOutput_BlockCompressor * thisp = block->owner;
+  block->outlen = thisp->compress(block->in, block->inlen,
+                                  block->out, thisp->outsize, thisp->level);
+}
+
+// Starts compressing the filled blocks, after the previous batch has
+// been written.
+void
+SoOutput_BlockCompressor::startBatch(void)
+{
+  this->finishBatch();
+
+  Block * batch = this->fillbatch;
+  const int num = this->numfilled;
+  this->fillbatch = this->runbatch;
+  this->numfilled = 0;
+  this->runbatch = batch;
+  this->numrunning = num;
+
+#ifdef HAVE_THREADS
+  if (this->numthreads > 1) {
+    if (this->pool == NULL) {
+      this->pool = cc_wpool_construct(this->numthreads);
+    }
+    cc_wpool_begin(this->pool, num);
+    for (int i = 0; i < num; i++) {
+      cc_wpool_start_worker(this->pool, compressBlock, &batch[i]);
+    }
+    cc_wpool_end(this->pool);
+    return;
+  }
+#endif // HAVE_THREADS
+  for (int i = 0; i < num; i++) { compressBlock(&batch[i]); }
+}
+
+// Waits for the running batch, and writes its blocks to the file.
+void
+SoOutput_BlockCompressor::finishBatch(void)
+{
+  if (this->numrunning == 0) return;
+#ifdef HAVE_THREADS
+  if (this->pool) cc_wpool_wait_all(this->pool);
+#endif // HAVE_THREADS
+
+  for (int i = 0; i < this->numrunning; i++) {
+    Block & block = this->runbatch[i];
+    if (!this->failed) {
+      if ((block.outlen == 0) ||
+          (fwrite(block.out, 1, block.outlen, this->fp) != block.outlen)) {
+        SoDebugError::postWarning("SoOutput_BlockCompressor::finishBatch",
+                                  "Error while compressing or writing.");
+        this->failed = TRUE;
+      }
+    }
+    block.inlen = 0;
+  }
+  this->numrunning = 0;
+}
+
 //
 // zlib writer
 //
 
-SoOutput_GZFileWriter::SoOutput_GZFileWriter(FILE * fp, const SbBool shouldclose, const float level)
+// Independent gzip members of this size are compressed in parallel.
+// Bigger blocks compress better, as the compression of each block
+// starts with an empty dictionary.
+static const size_t SOOUTPUT_GZIP_BLOCK_SIZE = 1024 * 1024;
+
+static size_t
+soutput_gzip_compress(const char * src, size_t srclen,
+                      char * dst, size_t dstlen, int level)
+{
+  return cc_gzm_compress(src, (uint32_t)srclen, dst, (uint32_t)dstlen, level);
+}
+
+static size_t
+soutput_gzip_bound(size_t srclen)
+{
+  return cc_gzm_compress_bound((uint32_t)srclen);
+}
+
+SoOutput_GZFileWriter::SoOutput_GZFileWriter(FILE * fparg, const SbBool shouldclosearg,
+                                             const float level, const int numthreads)
 {
   this->gzfp = NULL;
+  this->fp = fparg;
+  this->shouldclose = shouldclosearg;
+  this->blocks = NULL;
 
-  int fd = fileno(fp);
-  if (fd >= 0 && !shouldclose) fd = dup(fd);
+  // convert level from [0.0, 1.0] to [1, 9]
+  const int gzlevel = (int) SbClamp((level * 8.0f) + 1.0f, 1.0f, 9.0f);
+
+  if (numthreads > 1) {
+    this->blocks = new SoOutput_BlockCompressor(fparg, soutput_gzip_compress,
+                                                soutput_gzip_bound, gzlevel,
+                                                SOOUTPUT_GZIP_BLOCK_SIZE,
+                                                numthreads);
+    return;
+  }
+
+  int fd = fileno(fparg);
+  if (fd >= 0 && !shouldclosearg) fd = dup(fd);
 
   if (fd >= 0) {
     SbString mode = "wb";
-    // convert level from [0.0, 1.0] to [1, 9]
-    mode.addIntString((int) SbClamp((level * 8.0f) + 1.0f, 1.0f, 9.0f));
+    mode.addIntString(gzlevel);
 
     this->gzfp = cc_zlibglue_gzdopen(fd, mode.getString());
     if (!this->gzfp) {
@@ -251,6 +439,10 @@ SoOutput_GZFileWriter::SoOutput_GZFileWriter(FILE * fp, const SbBool shouldclose
 
 SoOutput_GZFileWriter::~SoOutput_GZFileWriter()
 {
+  if (this->blocks) {
+    delete this->blocks;
+    if (this->shouldclose) fclose(this->fp);
+  }
   if (this->gzfp) {
     cc_zlibglue_gzclose(this->gzfp);
   }
@@ -266,6 +458,9 @@ SoOutput_GZFileWriter::getType(void) const
 size_t
 SoOutput_GZFileWriter::write(const char * buf, size_t numbytes, const SbBool COIN_UNUSED_ARG(binary))
 {
+  if (this->blocks) {
+    return this->blocks->write(buf, numbytes);
+  }
   if (this->gzfp) {
     // FIXME: the numbytes cast (as size_t can be 64 bits wide) is
     // there to humour the interface of *gzwrite() -- should really be
@@ -278,6 +473,9 @@ SoOutput_GZFileWriter::write(const char * buf, size_t numbytes, const SbBool COI
 size_t 
 SoOutput_GZFileWriter::bytesInBuf(void)
 {
+  if (this->blocks) {
+    return this->blocks->getNumBytesIn();
+  }
   if (this->gzfp) {
     return cc_zlibglue_gztell(this->gzfp);
   }
@@ -288,13 +486,46 @@ SoOutput_GZFileWriter::bytesInBuf(void)
 // bzip2 writer
 //
 
-SoOutput_BZ2FileWriter::SoOutput_BZ2FileWriter(FILE * fparg, const SbBool shouldclose, const float level)
+// Each bzip2 stream written in parallel holds one full size bzip2
+// block, of 100000 bytes times the block size setting.
+static size_t
+soutput_bzip2_compress(const char * src, size_t srclen,
+                       char * dst, size_t dstlen, int level)
+{
+  unsigned int len = (unsigned int)dstlen;
+  if (cc_bzglue_BZ2_bzBuffToBuffCompress(dst, &len, (char *)src,
+                                         (unsigned int)srclen,
+                                         level, 0, 0) != BZ_OK) {
+    return 0;
+  }
+  return len;
+}
+
+static size_t
+soutput_bzip2_bound(size_t srclen)
+{
+  // from the BZ2_bzBuffToBuffCompress() documentation
+  return srclen + srclen / 100 + 600;
+}
+
+SoOutput_BZ2FileWriter::SoOutput_BZ2FileWriter(FILE * fparg, const SbBool shouldclose,
+                                               const float level, const int numthreads)
 {
   this->fp = shouldclose ? fparg : NULL;
   this->writecounter = 0;
+  this->bzfp = NULL;
+  this->blocks = NULL;
 
   int bzerror = BZ_OK;
   int numblocks =  (int) SbClamp((level * 8.0f) + 1.0f, 1.0f, 9.0f);
+
+  if (numthreads > 1) {
+    this->blocks = new SoOutput_BlockCompressor(fparg, soutput_bzip2_compress,
+                                                soutput_bzip2_bound, numblocks,
+                                                numblocks * 100000,
+                                                numthreads);
+    return;
+  }
   
   this->bzfp = cc_bzglue_BZ2_bzWriteOpen(&bzerror, fparg, numblocks, 0, 0);
   if (this->bzfp && (bzerror != BZ_OK)) {
@@ -307,6 +538,7 @@ SoOutput_BZ2FileWriter::SoOutput_BZ2FileWriter(FILE * fparg, const SbBool should
 
 SoOutput_BZ2FileWriter::~SoOutput_BZ2FileWriter()
 {
+  delete this->blocks;
   if (this->bzfp) {
     int bzerror = BZ_OK;
     cc_bzglue_BZ2_bzWriteClose(&bzerror, this->bzfp, 0, NULL, NULL);
@@ -329,6 +561,9 @@ SoOutput_BZ2FileWriter::getType(void) const
 size_t
 SoOutput_BZ2FileWriter::write(const char * buf, size_t numbytes, const SbBool COIN_UNUSED_ARG(binary))
 {
+  if (this->blocks) {
+    return this->blocks->write(buf, numbytes);
+  }
   if (this->bzfp) {
     int bzerror = BZ_OK;
     // FIXME: about the cast; see note about the call to *gzmwrite()
@@ -352,6 +587,9 @@ SoOutput_BZ2FileWriter::write(const char * buf, size_t numbytes, const SbBool CO
 size_t 
 SoOutput_BZ2FileWriter::bytesInBuf(void)
 {
+  if (this->blocks) {
+    return this->blocks->getNumBytesIn();
+  }
   return this->writecounter;
 }
 
@@ -40,6 +40,7 @@
 // *************************************************************************
 
 #include <Inventor/SoOutput.h>
+#include <Inventor/C/threads/common.h> // cc_wpool
 #include <stdio.h>
 
 // *************************************************************************
@@ -74,10 +75,64 @@ public:
   static SoOutput_Writer * createWriter(FILE * fp,
                                         const SbBool shouldclose,
                                         const SbName & compmethod,
-                                        const float level);
+                                        const float level,
+                                        const int numthreads = 1);
 
 };
 
+// Cuts the data written into fixed size blocks, which are compressed
+// independently on a pool of worker threads and written to the file
+// in order. One batch of blocks is compressed while the next batch is
+// being filled, so writing the scene overlaps with the compression.
+class SoOutput_BlockCompressor {
+public:
+  // compresses srclen bytes into dst, which holds at least
+  // bound(srclen) bytes. Must return the compressed size, or 0 on
+  // failure.
+  typedef size_t CompressFunc(const char * src, size_t srclen,
+                              char * dst, size_t dstlen, int level);
+  typedef size_t BoundFunc(size_t srclen);
+
+  SoOutput_BlockCompressor(FILE * fp, CompressFunc * compress,
+                           BoundFunc * bound, const int level,
+                           const size_t blocksize, const int numthreads);
+  ~SoOutput_BlockCompressor();
+
+  size_t write(const char * buf, size_t numbytes);
+  SbBool flush(void);
+  size_t getNumBytesIn(void) const { return this->numbytesin; }
+
+private:
+  struct Block {
+    SoOutput_BlockCompressor * owner;
+    char * in;
+    size_t inlen;
+    char * out;
+    size_t outlen;
+  };
+  static void compressBlock(void * closure);
+  void startBatch(void);
+  void finishBatch(void);
+
+  FILE * fp;
+  CompressFunc * compress;
+  int level;
+  size_t blocksize;
+  size_t outsize;
+  int numthreads;
+  cc_wpool * pool;
+
+  // two batches of numthreads blocks each
+  Block * blocks;
+  Block * fillbatch;
+  int numfilled;
+  Block * runbatch;
+  int numrunning;
+
+  size_t numbytesin;
+  SbBool failed;
+};
+
 // class for stdio writing
 class SoOutput_FileWriter : public SoOutput_Writer {
 public:
@@ -121,7 +176,8 @@ public:
 // class for zlib writing
 class SoOutput_GZFileWriter : public SoOutput_Writer {
 public:
-  SoOutput_GZFileWriter(FILE * fp, const SbBool shouldclose, const float level);
+  SoOutput_GZFileWriter(FILE * fp, const SbBool shouldclose, const float level,
+                        const int numthreads);
   virtual ~SoOutput_GZFileWriter();
 
   virtual size_t bytesInBuf(void);
@@ -130,11 +186,15 @@ public:
 
 public:
   void * gzfp;
+  FILE * fp;
+  SbBool shouldclose;
+  SoOutput_BlockCompressor * blocks;
 };
 
 class SoOutput_BZ2FileWriter : public SoOutput_Writer {
 public:
-  SoOutput_BZ2FileWriter(FILE * fp, const SbBool shouldclose, const float level);
+  SoOutput_BZ2FileWriter(FILE * fp, const SbBool shouldclose, const float level,
+                         const int numthreads);
   virtual ~SoOutput_BZ2FileWriter();
 
   virtual size_t bytesInBuf(void);
@@ -145,6 +205,7 @@ public:
   void * bzfp;
   FILE * fp;
   size_t writecounter;
+  SoOutput_BlockCompressor * blocks;
 };
 
 #endif // COIN_SOOUTPUT_WRITER_H
@@ -0,0 +1,847 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+// The scene cache file format, written by SoWriteAction when
+// SoOutput::setSceneCacheFormat() is set, and read by SoDB::read()
+// and SoDB::readAll().
+//
+// The scene is cut into chunks: self-contained SoSeparator subgraphs,
+// which no node outside them refer to and with no field connections
+// crossing their borders. Each chunk is stored as a complete binary
+// Inventor file of its own, while the rest of the scene (the
+// "skeleton") is stored as a binary Inventor file where the chunks
+// are replaced by SoSceneCacheSeparator nodes. When the file is read,
+// only the skeleton is parsed, and the chunks are loaded when their
+// SoSceneCacheSeparator is first traversed.
+//
+// Layout, with all numbers in network byte order:
+//
+//   header line        SCENECACHE_HEADER, padded to 4 bytes
+//   uint32             format version
+//   uint32             number of chunks
+//   float[6]           bounding box of the scene (min, max)
+//   uint64             size of the skeleton
+//   uint32             padding between the skeleton and the first chunk
+//   uint64             file offset of the first chunk
+//   chunk table        for each chunk:
+//     uint64             file offset
+//     uint64             size
+//     uint32             1 if the center point below is set, else 0
+//     float[6]           bounding box (min, max) in the chunk's frame
+//     float[3]           center point
+//   skeleton           binary Inventor file
+//   chunks             binary Inventor files, each starting on a
+//                      SCENECACHE_ALIGNMENT boundary
+//
+// File offsets count from the start of the header line. The chunks
+// are aligned so the field arrays in them can be mapped straight from
+// the file.
+
+#include "io/SoSceneCache.h"
+
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/SoPath.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/actions/SoWriteAction.h>
+#include <Inventor/errors/SoDebugError.h>
+#include <Inventor/errors/SoReadError.h>
+#include <Inventor/fields/SoMField.h>
+#include <Inventor/fields/SoMFEngine.h>
+#include <Inventor/fields/SoMFNode.h>
+#include <Inventor/fields/SoMFPath.h>
+#include <Inventor/fields/SoSFEngine.h>
+#include <Inventor/fields/SoSFNode.h>
+#include <Inventor/fields/SoSFPath.h>
+#include <Inventor/lists/SoFieldList.h>
+#include <Inventor/misc/SoChildList.h>
+#include <Inventor/misc/SoProto.h>
+#include <Inventor/misc/SoProtoInstance.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/VRMLnodes/SoVRMLParent.h>
+
+#include "misc/SbHash.h"
+#include "nodes/SoSceneCacheSeparator.h"
+#include "tidbitsp.h"
+
+// *************************************************************************
+
+#define SCENECACHE_HEADER "#Coin3D scene cache V1.0"
+
+static const uint32_t SCENECACHE_VERSION = 1;
+static const uint32_t SCENECACHE_ALIGNMENT = 4096;
+
+// sizes of the fixed part after the header line, and of one entry in
+// the chunk table
+static const int SCENECACHE_HEADERSIZE = 4 + 4 + 24 + 8 + 4 + 8;
+static const int SCENECACHE_ENTRYSIZE = 8 + 8 + 4 + 24 + 12;
+
+// A self-contained separator becomes a chunk when it holds at least
+// SCENECACHE_MINWEIGHT nodes and field values, and is searched for
+// smaller chunks if it holds more than SCENECACHE_MAXWEIGHT.
+static const size_t SCENECACHE_MINWEIGHT = 16384;
+static const size_t SCENECACHE_MAXWEIGHT = 4 * 1024 * 1024;
+
+// Chunks are written to memory first, to find their sizes. They are
+// kept there for the second pass as long as they fit within this many
+// bytes, and written again otherwise.
+static const size_t SCENECACHE_KEEPBYTES = 256 * 1024 * 1024;
+
+// the largest block handed to SoOutput and SoInput at a time
+static const size_t SCENECACHE_BLOCKSIZE = 1024 * 1024 * 1024;
+
+// Sizes read from files whose length isn't known are trusted up to
+// this many bytes. Larger buffers are grown as the data arrives.
+static const size_t SCENECACHE_TRUSTBYTES = 16 * 1024 * 1024;
+
+// the largest offset or size accepted from a scene cache file
+static const uint64_t SCENECACHE_MAXSIZE = uint64_t(1) << 62;
+
+typedef SbHash<const SoBase *, int> SoSceneCacheNodeCount;
+
+// *************************************************************************
+
+// length of the header line, including padding and newline
+static size_t
+soscenecache_header_length(void)
+{
+  const size_t len = strlen(SCENECACHE_HEADER) + 1;
+  return (len + 3) & ~size_t(3);
+}
+
+static uint64_t
+soscenecache_align(const uint64_t offset)
+{
+  return (offset + SCENECACHE_ALIGNMENT - 1) & ~uint64_t(SCENECACHE_ALIGNMENT - 1);
+}
+
+// Encodes numbers in network byte order.
+class SoSceneCacheRecord {
+public:
+  void putUInt32(const uint32_t v) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      this->bytes.append((unsigned char)((v >> shift) & 0xff));
+    }
+  }
+  void putUInt64(const uint64_t v) {
+    this->putUInt32(uint32_t(v >> 32));
+    this->putUInt32(uint32_t(v & 0xffffffff));
+  }
+  void putFloat(const float f) {
+    uint32_t v;
+    (void)memcpy(&v, &f, sizeof(v));
+    this->putUInt32(v);
+  }
+  void putVec3f(const SbVec3f & v) {
+    for (int i = 0; i < 3; i++) { this->putFloat(v[i]); }
+  }
+  void putBox(const SbBox3f & box) {
+    this->putVec3f(box.getMin());
+    this->putVec3f(box.getMax());
+  }
+  const unsigned char * getBytes(void) const {
+    return this->bytes.getArrayPtr();
+  }
+  int getLength(void) const {
+    return this->bytes.getLength();
+  }
+
+private:
+  SbList<unsigned char> bytes;
+};
+
+// Decodes numbers written with SoSceneCacheRecord.
+class SoSceneCacheParser {
+public:
+  SoSceneCacheParser(const unsigned char * bytes) : ptr(bytes) { }
+
+  uint32_t getUInt32(void) {
+    const uint32_t v =
+      (uint32_t(this->ptr[0]) << 24) | (uint32_t(this->ptr[1]) << 16) |
+      (uint32_t(this->ptr[2]) << 8) | uint32_t(this->ptr[3]);
+    this->ptr += 4;
+    return v;
+  }
+  uint64_t getUInt64(void) {
+    const uint64_t hi = this->getUInt32();
+    return (hi << 32) | this->getUInt32();
+  }
+  float getFloat(void) {
+    const uint32_t v = this->getUInt32();
+    float f;
+    (void)memcpy(&f, &v, sizeof(f));
+    return f;
+  }
+  SbVec3f getVec3f(void) {
+    const float x = this->getFloat();
+    const float y = this->getFloat();
+    const float z = this->getFloat();
+    return SbVec3f(x, y, z);
+  }
+  SbBox3f getBox(void) {
+    const SbVec3f min = this->getVec3f();
+    const SbVec3f max = this->getVec3f();
+    return SbBox3f(min, max);
+  }
+
+private:
+  const unsigned char * ptr;
+};
+
+static void
+soscenecache_write_bytes(SoOutput * out, const unsigned char * bytes, size_t size)
+{
+  while (size > 0) {
+    const size_t block = size < SCENECACHE_BLOCKSIZE ? size : SCENECACHE_BLOCKSIZE;
+    out->writeBinaryArray(bytes, (int)block);
+    bytes += block;
+    size -= block;
+  }
+}
+
+static void
+soscenecache_write_padding(SoOutput * out, size_t size)
+{
+  static const unsigned char zeros[SCENECACHE_ALIGNMENT] = { 0 };
+  assert(size < SCENECACHE_ALIGNMENT);
+  if (size > 0) { out->writeBinaryArray(zeros, (int)size); }
+}
+
+static SbBool
+soscenecache_read_bytes(SoInput * in, unsigned char * bytes, size_t size)
+{
+  while (size > 0) {
+    const size_t block = size < SCENECACHE_BLOCKSIZE ? size : SCENECACHE_BLOCKSIZE;
+    if (!in->readBinaryArray(bytes, (int)block)) return FALSE;
+    bytes += block;
+    size -= block;
+  }
+  return TRUE;
+}
+
+// Reads size bytes into a buffer, which must be freed by the caller.
+// Returns NULL if the input ends early or memory runs out.
+static unsigned char *
+soscenecache_read_buffer(SoInput * in, const uint64_t size)
+{
+  if (size == 0 || size > SCENECACHE_MAXSIZE || size > ~size_t(0) / 2) {
+    return NULL;
+  }
+  unsigned char * buffer = NULL;
+  size_t got = 0;
+  while (got < size) {
+    // a corrupt size in a truncated stream must not allocate more than
+    // twice what the stream actually holds
+    size_t block = got > SCENECACHE_TRUSTBYTES ? got : SCENECACHE_TRUSTBYTES;
+    if (block > size - got) { block = (size_t)(size - got); }
+    unsigned char * grown =
+      static_cast<unsigned char *>(realloc(buffer, got + block));
+    if (!grown || !soscenecache_read_bytes(in, grown + got, block)) {
+      free(grown ? grown : buffer);
+      return NULL;
+    }
+    buffer = grown;
+    got += block;
+  }
+  return buffer;
+}
+
+// Writes a node and the graph below it as a binary Inventor file in
+// memory. The buffer must be freed by the caller.
+static void
+soscenecache_serialize(SoNode * node, void *& buffer, size_t & size)
+{
+  SoOutput out;
+  out.setBuffer(malloc(1024), 1024, realloc);
+  out.setBinary(TRUE);
+  SoWriteAction wa(&out);
+  wa.apply(node);
+  (void)out.getBuffer(buffer, size);
+}
+
+// *************************************************************************
+
+// Picks the chunks of a scene, and finds their bounding boxes.
+class SoSceneCachePlanner {
+public:
+  SoSceneCachePlanner(void) : bboxaction(SbViewportRegion()) { }
+
+  void plan(SoNode * root);
+
+  SbList<SoSeparator *> chunks;
+  SbList<SoSceneCacheFile::Chunk> entries;
+
+private:
+  static SbBool isTraversable(SoNode * node);
+  SbBool isSelfContained(SoSeparator * sep, size_t & weight);
+  SbBool weigh(SoNode * node, SoSceneCacheNodeCount & edges, size_t & weight);
+  void planChildren(SoNode * node, SoPath * path);
+  void addChunk(SoSeparator * sep, SoPath * path);
+
+  SoGetBoundingBoxAction bboxaction;
+};
+
+void
+SoSceneCachePlanner::plan(SoNode * root)
+{
+  if (!SoSceneCachePlanner::isTraversable(root)) return;
+  SoPath * path = new SoPath(root);
+  path->ref();
+  this->planChildren(root, path);
+  path->unref();
+}
+
+// Only plain groups are searched for chunks. VRML grouping nodes and
+// nodekits keep their children in fields, which must be written along
+// with the node.
+SbBool
+SoSceneCachePlanner::isTraversable(SoNode * node)
+{
+  return
+    node->isOfType(SoGroup::getClassTypeId()) &&
+    !node->isOfType(SoVRMLParent::getClassTypeId());
+}
+
+// Returns TRUE if no node in the graph below sep is referred to from
+// outside it, and no field is connected across its border. Every
+// reference to a node counts in its reference count, so the subgraph
+// is self-contained when the number of references found inside it
+// adds up to the reference count of each node.
+SbBool
+SoSceneCachePlanner::isSelfContained(SoSeparator * sep, size_t & weight)
+{
+  SoSceneCacheNodeCount edges;
+  weight = 0;
+  if (!this->weigh(sep, edges, weight)) return FALSE;
+
+  for (SoSceneCacheNodeCount::const_iterator it = edges.const_begin();
+       it != edges.const_end(); ++it) {
+    if (it->key->getRefCount() != it->obj) return FALSE;
+  }
+  return TRUE;
+}
+
+// Counts the references to each node below node, and adds up the
+// number of nodes and field values. Returns FALSE if something in
+// the subgraph can't be moved to a chunk.
+SbBool
+SoSceneCachePlanner::weigh(SoNode * node, SoSceneCacheNodeCount & edges,
+                           size_t & weight)
+{
+  int count;
+  if (edges.get(node, count)) {
+    (void)edges.put(node, count + 1);
+    return TRUE;
+  }
+  (void)edges.put(node, 1);
+
+  if (node->isOfType(SoProto::getClassTypeId()) ||
+      node->isOfType(SoProtoInstance::getClassTypeId()) ||
+      SoProtoInstance::findProtoInstance(node)) {
+    return FALSE;
+  }
+  weight++;
+
+  SoFieldList fields, connections;
+  const int numfields = node->getFields(fields);
+  for (int i = 0; i < numfields; i++) {
+    SoField * field = fields[i];
+    if (field->isConnected() || field->getForwardConnections(connections) > 0) {
+      return FALSE;
+    }
+    const SoType type = field->getTypeId();
+    if (type.isDerivedFrom(SoSFPath::getClassTypeId()) ||
+        type.isDerivedFrom(SoMFPath::getClassTypeId()) ||
+        type.isDerivedFrom(SoSFEngine::getClassTypeId()) ||
+        type.isDerivedFrom(SoMFEngine::getClassTypeId())) {
+      return FALSE;
+    }
+    if (type.isDerivedFrom(SoMField::getClassTypeId())) {
+      weight += static_cast<SoMField *>(field)->getNum();
+    }
+    if (type.isDerivedFrom(SoSFNode::getClassTypeId())) {
+      SoNode * value = static_cast<SoSFNode *>(field)->getValue();
+      if (value && !this->weigh(value, edges, weight)) return FALSE;
+    }
+    else if (type.isDerivedFrom(SoMFNode::getClassTypeId())) {
+      SoMFNode * mfnode = static_cast<SoMFNode *>(field);
+      for (int j = 0; j < mfnode->getNum(); j++) {
+        SoNode * value = (*mfnode)[j];
+        if (value && !this->weigh(value, edges, weight)) return FALSE;
+      }
+    }
+  }
+
+  SoChildList * children = node->getChildren();
+  if (children) {
+    for (int i = 0; i < children->getLength(); i++) {
+      if (!this->weigh((*children)[i], edges, weight)) return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+void
+SoSceneCachePlanner::planChildren(SoNode * node, SoPath * path)
+{
+  SoChildList * children = node->getChildren();
+  for (int i = 0; i < children->getLength(); i++) {
+    SoNode * child = (*children)[i];
+
+    // check before adding the child to the path, which refs it
+    size_t weight = 0;
+    const SbBool selfcontained =
+      child->getTypeId() == SoSeparator::getClassTypeId() &&
+      this->isSelfContained(static_cast<SoSeparator *>(child), weight);
+    if (selfcontained && weight < SCENECACHE_MINWEIGHT) {
+      // small subgraphs are left in the skeleton, and so are all the
+      // separators below them
+      continue;
+    }
+    if (!selfcontained && !SoSceneCachePlanner::isTraversable(child)) continue;
+
+    path->append(i);
+    if (!selfcontained) {
+      this->planChildren(child, path);
+    }
+    else if (weight > SCENECACHE_MAXWEIGHT) {
+      // use smaller chunks inside it if there are any, so that
+      // loading one chunk doesn't take too long
+      const int numchunks = this->chunks.getLength();
+      this->planChildren(child, path);
+      if (this->chunks.getLength() == numchunks) {
+        this->addChunk(static_cast<SoSeparator *>(child), path);
+      }
+    }
+    else {
+      this->addChunk(static_cast<SoSeparator *>(child), path);
+    }
+    path->pop();
+  }
+}
+
+void
+SoSceneCachePlanner::addChunk(SoSeparator * sep, SoPath * path)
+{
+  // the bounding box in the separator's own frame, which is what
+  // SoSceneCacheSeparator needs to stand in for it
+  this->bboxaction.setResetPath(path, TRUE, SoGetBoundingBoxAction::ALL);
+  this->bboxaction.apply(path);
+
+  SoSceneCacheFile::Chunk entry;
+  entry.offset = 0;
+  entry.size = 0;
+  entry.bbox = this->bboxaction.getBoundingBox();
+  entry.centerset = this->bboxaction.isCenterSet();
+  entry.center = this->bboxaction.getCenter();
+
+  this->chunks.append(sep);
+  this->entries.append(entry);
+}
+
+// *************************************************************************
+
+SoSceneCacheFile::SoSceneCacheFile(FILE * fp, char * data,
+                                   const uint64_t dataoffset)
+  : refcount(0), fp(fp), data(data), dataoffset(dataoffset)
+{
+}
+
+SoSceneCacheFile::~SoSceneCacheFile()
+{
+  if (this->fp) { (void)fclose(this->fp); }
+  free(this->data);
+}
+
+void
+SoSceneCacheFile::ref(void)
+{
+  this->refcount++;
+}
+
+void
+SoSceneCacheFile::unref(void)
+{
+  assert(this->refcount > 0);
+  if (--this->refcount == 0) { delete this; }
+}
+
+int
+SoSceneCacheFile::getNumChunks(void) const
+{
+  return this->chunks.getLength();
+}
+
+SbBox3f
+SoSceneCacheFile::getBoundingBox(const int chunk) const
+{
+  return this->chunks[chunk].bbox;
+}
+
+SbBool
+SoSceneCacheFile::getCenter(const int chunk, SbVec3f & center) const
+{
+  center = this->chunks[chunk].center;
+  return this->chunks[chunk].centerset;
+}
+
+// Reads a chunk, and returns the separator at its top with a
+// reference count of zero. Returns NULL on error.
+SoSeparator *
+SoSceneCacheFile::readChunk(const int chunk)
+{
+  const Chunk entry = this->chunks[chunk];
+  char * buffer;
+  if (this->fp) {
+    buffer = static_cast<char *>(malloc((size_t)entry.size));
+    if (!buffer ||
+        coin_fseek64(this->fp, (int64_t)entry.offset, SEEK_SET) != 0 ||
+        fread(buffer, 1, (size_t)entry.size, this->fp) != entry.size) {
+      SoDebugError::post("SoSceneCacheFile::readChunk",
+                         "Couldn't read chunk %d of scene cache file.", chunk);
+      free(buffer);
+      return NULL;
+    }
+  }
+  else {
+    buffer = this->data + (entry.offset - this->dataoffset);
+  }
+
+  SoSeparator * sep;
+  {
+    SoInput in;
+    in.setBuffer(buffer, (size_t)entry.size);
+    sep = SoDB::readAll(&in);
+  }
+  if (this->fp) { free(buffer); }
+  return sep;
+}
+
+// *************************************************************************
+
+const char *
+SoSceneCache::getHeaderString(void)
+{
+  return SCENECACHE_HEADER;
+}
+
+// Returns TRUE if in is reading a scene cache file.
+SbBool
+SoSceneCache::isSceneCache(SoInput * in)
+{
+  const SbString & header = in->getHeader();
+  return strncmp(header.getString(), SCENECACHE_HEADER,
+                 strlen(SCENECACHE_HEADER)) == 0;
+}
+
+// Opens the file the chunks are read from, if it's the scene cache
+// file itself and not, for instance, a compressed copy of it.
+static FILE *
+soscenecache_open(const char * filename)
+{
+  FILE * fp = fopen(filename, "rb");
+  if (!fp) return NULL;
+
+  const size_t len = soscenecache_header_length();
+  char * line = new char[len];
+  const SbBool ok =
+    fread(line, 1, len, fp) == len &&
+    strncmp(line, SCENECACHE_HEADER, strlen(SCENECACHE_HEADER)) == 0;
+  delete[] line;
+  if (!ok) {
+    (void)fclose(fp);
+    return NULL;
+  }
+  return fp;
+}
+
+static uint64_t
+soscenecache_file_size(FILE * fp)
+{
+  const int64_t pos = coin_ftell64(fp);
+  if (pos < 0 || coin_fseek64(fp, 0, SEEK_END) != 0) return 0;
+  const int64_t size = coin_ftell64(fp);
+  (void)coin_fseek64(fp, pos, SEEK_SET);
+  return size < 0 ? 0 : (uint64_t)size;
+}
+
+// Finds the SoSceneCacheSeparator nodes in a skeleton, and hands them
+// the file their chunks are read from.
+static void
+soscenecache_attach(SoNode * node, SoSceneCacheFile * file,
+                    SoSceneCacheNodeCount & visited)
+{
+  int dummy;
+  if (visited.get(node, dummy)) return;
+  (void)visited.put(node, 0);
+
+  if (node->isOfType(SoSceneCacheSeparator::getClassTypeId())) {
+    SoSceneCacheSeparator * sep = static_cast<SoSceneCacheSeparator *>(node);
+    const int chunk = sep->chunk.getValue();
+    if (chunk >= 0 && chunk < file->getNumChunks()) {
+      sep->setSource(file);
+    }
+    else {
+      SoDebugError::postWarning("SoSceneCache::read",
+                                "Invalid chunk index %d.", chunk);
+    }
+    return;
+  }
+
+  SoChildList * children = node->getChildren();
+  if (children) {
+    for (int i = 0; i < children->getLength(); i++) {
+      soscenecache_attach((*children)[i], file, visited);
+    }
+  }
+}
+
+// Reads the rest of a scene cache file after the header line. Returns
+// the root of the scene with a reference count of zero, or NULL on
+// error.
+SoSeparator *
+SoSceneCache::read(SoInput * in)
+{
+  unsigned char header[SCENECACHE_HEADERSIZE];
+  if (!in->readBinaryArray(header, SCENECACHE_HEADERSIZE)) {
+    SoReadError::post(in, "Premature end of file");
+    return NULL;
+  }
+  SoSceneCacheParser parser(header);
+  const uint32_t version = parser.getUInt32();
+  if (version != SCENECACHE_VERSION) {
+    SoReadError::post(in, "Unsupported scene cache version %u", version);
+    return NULL;
+  }
+  const uint32_t numentries = parser.getUInt32();
+  (void)parser.getBox(); // the scene's bounding box, for other readers
+  const uint64_t skeletonsize = parser.getUInt64();
+  const uint32_t padsize = parser.getUInt32();
+  const uint64_t dataoffset = parser.getUInt64();
+
+  // Read chunks straight from the file when we can, otherwise keep
+  // the rest of the stream in memory. The file's size also bounds
+  // the sizes and offsets in it.
+  FILE * fp = NULL;
+  const char * filename = in->getCurFileName();
+  if (filename) { fp = soscenecache_open(filename); }
+  const uint64_t limit = fp ? soscenecache_file_size(fp) : SCENECACHE_MAXSIZE;
+
+  const uint64_t skeletonoffset = soscenecache_header_length() +
+    SCENECACHE_HEADERSIZE + uint64_t(numentries) * SCENECACHE_ENTRYSIZE;
+  if (numentries > (uint32_t)INT_MAX ||
+      skeletonoffset > limit || skeletonsize == 0 ||
+      skeletonsize > limit - skeletonoffset ||
+      padsize >= SCENECACHE_ALIGNMENT ||
+      dataoffset != skeletonoffset + skeletonsize + padsize) {
+    SoReadError::post(in, "Corrupt scene cache header");
+    if (fp) { (void)fclose(fp); }
+    return NULL;
+  }
+  const int numchunks = (int)numentries;
+
+  SbList<SoSceneCacheFile::Chunk> chunks;
+  uint64_t dataend = dataoffset;
+  unsigned char entry[SCENECACHE_ENTRYSIZE];
+  for (int i = 0; i < numchunks; i++) {
+    if (!in->readBinaryArray(entry, SCENECACHE_ENTRYSIZE)) {
+      SoReadError::post(in, "Premature end of file");
+      if (fp) { (void)fclose(fp); }
+      return NULL;
+    }
+    SoSceneCacheParser entryparser(entry);
+    SoSceneCacheFile::Chunk chunk;
+    chunk.offset = entryparser.getUInt64();
+    chunk.size = entryparser.getUInt64();
+    chunk.centerset = entryparser.getUInt32() != 0;
+    chunk.bbox = entryparser.getBox();
+    chunk.center = entryparser.getVec3f();
+    if (chunk.offset < dataoffset || chunk.offset > limit ||
+        chunk.size == 0 || chunk.size > limit - chunk.offset) {
+      SoReadError::post(in, "Corrupt scene cache entry for chunk %d", i);
+      if (fp) { (void)fclose(fp); }
+      return NULL;
+    }
+    if (chunk.offset + chunk.size > dataend) {
+      dataend = chunk.offset + chunk.size;
+    }
+    chunks.append(chunk);
+  }
+
+  unsigned char * skeleton = soscenecache_read_buffer(in, skeletonsize);
+  if (!skeleton) {
+    SoReadError::post(in, "Couldn't read the scene cache skeleton");
+    if (fp) { (void)fclose(fp); }
+    return NULL;
+  }
+  SoSeparator * root;
+  {
+    SoInput skeletonin;
+    skeletonin.setBuffer(skeleton, (size_t)skeletonsize);
+    root = SoDB::readAll(&skeletonin);
+  }
+  free(skeleton);
+  if (!root) {
+    SoReadError::post(in, "Couldn't read the scene cache skeleton");
+    if (fp) { (void)fclose(fp); }
+    return NULL;
+  }
+  if (numchunks == 0) {
+    if (fp) { (void)fclose(fp); }
+    return root;
+  }
+  root->ref();
+
+  char * data = NULL;
+  if (!fp) {
+    unsigned char padding[SCENECACHE_ALIGNMENT];
+    if (padsize == 0 || in->readBinaryArray(padding, (int)padsize)) {
+      data = reinterpret_cast<char *>
+        (soscenecache_read_buffer(in, dataend - dataoffset));
+    }
+    if (!data) {
+      SoReadError::post(in, "Premature end of file");
+      root->unref();
+      return NULL;
+    }
+  }
+
+  SoSceneCacheFile * file = new SoSceneCacheFile(fp, data, dataoffset);
+  file->ref();
+  file->chunks = chunks;
+  SoSceneCacheNodeCount visited;
+  soscenecache_attach(root, file, visited);
+  file->unref();
+
+  root->unrefNoDelete();
+  return root;
+}
+
+// Writes the scene below root to out as a scene cache file.
+void
+SoSceneCache::write(SoOutput * out, SoNode * root)
+{
+  SoSceneCachePlanner planner;
+  planner.plan(root);
+  const int numchunks = planner.chunks.getLength();
+
+  SoGetBoundingBoxAction bboxaction((SbViewportRegion()));
+  bboxaction.apply(root);
+  const SbBox3f scenebox = bboxaction.getBoundingBox();
+
+  int i;
+  SbList<void *> buffers(numchunks);
+  size_t keptbytes = 0;
+  for (i = 0; i < numchunks; i++) {
+    void * buffer;
+    size_t size;
+    soscenecache_serialize(planner.chunks[i], buffer, size);
+    planner.entries[i].size = size;
+    if (keptbytes + size <= SCENECACHE_KEEPBYTES) {
+      keptbytes += size;
+    }
+    else {
+      free(buffer);
+      buffer = NULL;
+    }
+    buffers.append(buffer);
+  }
+
+  // The skeleton is a copy of the scene, with the chunks replaced by
+  // SoSceneCacheSeparator nodes. Registering those as the copies of
+  // the chunks before copying keeps the copy from going below them.
+  SoFieldContainer::initCopyDict();
+  for (i = 0; i < numchunks; i++) {
+    SoSceneCacheSeparator * placeholder = new SoSceneCacheSeparator;
+    placeholder->chunk = i;
+    SoFieldContainer::addCopy(planner.chunks[i], placeholder);
+  }
+  SoNode * skeleton = root->addToCopyDict();
+  skeleton->ref();
+  (void)SoFieldContainer::findCopy(root, TRUE);
+  SoFieldContainer::copyDone();
+
+  void * skeletonbuffer;
+  size_t skeletonsize;
+  soscenecache_serialize(skeleton, skeletonbuffer, skeletonsize);
+  skeleton->unref();
+
+  const uint64_t skeletonend = soscenecache_header_length() +
+    SCENECACHE_HEADERSIZE + numchunks * SCENECACHE_ENTRYSIZE + skeletonsize;
+  const uint64_t dataoffset = soscenecache_align(skeletonend);
+  uint64_t offset = dataoffset;
+  for (i = 0; i < numchunks; i++) {
+    planner.entries[i].offset = offset;
+    offset = soscenecache_align(offset + planner.entries[i].size);
+  }
+
+  SoSceneCacheRecord record;
+  record.putUInt32(SCENECACHE_VERSION);
+  record.putUInt32(numchunks);
+  record.putBox(scenebox);
+  record.putUInt64(skeletonsize);
+  record.putUInt32(uint32_t(dataoffset - skeletonend));
+  record.putUInt64(dataoffset);
+  for (i = 0; i < numchunks; i++) {
+    const SoSceneCacheFile::Chunk entry = planner.entries[i];
+    record.putUInt64(entry.offset);
+    record.putUInt64(entry.size);
+    record.putUInt32(entry.centerset ? 1 : 0);
+    record.putBox(entry.bbox);
+    record.putVec3f(entry.center);
+  }
+  soscenecache_write_bytes(out, record.getBytes(), record.getLength());
+  soscenecache_write_bytes(out, (unsigned char *)skeletonbuffer, skeletonsize);
+  free(skeletonbuffer);
+  soscenecache_write_padding(out, (size_t)(dataoffset - skeletonend));
+
+  for (i = 0; i < numchunks; i++) {
+    void * buffer = buffers[i];
+    size_t size = (size_t)planner.entries[i].size;
+    if (!buffer) { soscenecache_serialize(planner.chunks[i], buffer, size); }
+    soscenecache_write_bytes(out, (unsigned char *)buffer, size);
+    free(buffer);
+    if (i < numchunks - 1) {
+      const uint64_t end = planner.entries[i].offset + size;
+      soscenecache_write_padding(out, (size_t)(soscenecache_align(end) - end));
+    }
+  }
+}
+
+#undef SCENECACHE_HEADER
@@ -0,0 +1,93 @@
+#ifndef COIN_SOSCENECACHE_H
+#define COIN_SOSCENECACHE_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* !COIN_INTERNAL */
+
+#include <stdio.h>
+#include <Inventor/SbBox3f.h>
+#include <Inventor/SbString.h>
+#include <Inventor/lists/SbList.h>
+
+class SoInput;
+class SoOutput;
+class SoNode;
+class SoSeparator;
+
+// The chunks of a scene cache file which has been read, and where to
+// read them from. Shared by the SoSceneCacheSeparator nodes standing
+// in for the chunks.
+class SoSceneCacheFile {
+public:
+  SoSceneCacheFile(FILE * fp, char * data, const uint64_t dataoffset);
+
+  void ref(void);
+  void unref(void);
+
+  int getNumChunks(void) const;
+  SbBox3f getBoundingBox(const int chunk) const;
+  SbBool getCenter(const int chunk, SbVec3f & center) const;
+  SoSeparator * readChunk(const int chunk);
+
+  struct Chunk {
+    uint64_t offset;
+    uint64_t size;
+    SbBool centerset;
+    SbBox3f bbox;
+    SbVec3f center;
+  };
+
+private:
+  ~SoSceneCacheFile();
+  friend class SoSceneCache;
+
+  int refcount;
+  FILE * fp;
+  char * data;
+  uint64_t dataoffset;
+  SbList<Chunk> chunks;
+};
+
+class SoSceneCache {
+public:
+  static const char * getHeaderString(void);
+  static SbBool isSceneCache(SoInput * in);
+
+  static SoSeparator * read(SoInput * in);
+  static void write(SoOutput * out, SoNode * root);
+};
+
+#endif // !COIN_SOSCENECACHE_H
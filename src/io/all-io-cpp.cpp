@@ -31,13 +31,17 @@
 \**************************************************************************/
 
 #include "SoByteStream.cpp"
+#include "SoFileCache.cpp"
 #include "SoInput.cpp"
 #include "SoInputP.cpp"
 #include "SoInput_FileInfo.cpp"
+#include "SoInput_ParallelRead.cpp"
 #include "SoInput_Reader.cpp"
 #include "SoOutput.cpp"
 #include "SoOutput_Writer.cpp"
+#include "SoSceneCache.cpp"
 #include "SoTranReceiver.cpp"
 #include "SoTranSender.cpp"
 #include "SoWriterefCounter.cpp"
 #include "gzmemio.cpp"
+#include "floatconv.cpp"
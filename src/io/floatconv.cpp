@@ -0,0 +1,970 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+// The conversions in this file are exact, and don't depend on the
+// current locale, so there is no need to switch to the portable
+// locale around them.
+//
+// Numbers are formatted by computing the correctly rounded decimal
+// digits with integer arithmetic, and rounding ties to even like the
+// GNU C library does, so the output is the same as from printf(). The
+// shortest representation of a float is found with the Ryu algorithm
+// (Ulf Adams, "Ryu: Fast Float-to-String Conversion", PLDI 2018),
+// and that of a double by finding the fewest digits which read back
+// as the same value.
+//
+// Numbers are parsed with a fast path for the common case of a few
+// significant digits and a small exponent, which only needs one
+// correctly rounded floating point operation (W. D. Clinger, "How to
+// Read Floating Point Numbers Accurately", PLDI 1990). All other
+// numbers are converted with arbitrary precision integers.
+
+#include "io/floatconv.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include <Inventor/SbBasic.h>
+
+#include "tidbitsp.h"
+
+// *************************************************************************
+
+// Unsigned integers of up to 4096 bits, which is enough for all the
+// numbers handled below.
+class CoinBigUInt {
+public:
+  enum { MAXLIMBS = 128 };
+
+  CoinBigUInt(void) : n(0) { }
+  explicit CoinBigUInt(const uint64_t v) { this->set(v); }
+
+  void set(uint64_t v) {
+    this->n = 0;
+    while (v) { this->limb[this->n++] = (uint32_t) v; v >>= 32; }
+  }
+
+  SbBool isZero(void) const { return this->n == 0; }
+
+  int bitLength(void) const {
+    if (this->n == 0) return 0;
+    uint32_t top = this->limb[this->n - 1];
+    int bits = (this->n - 1) * 32;
+    while (top) { bits++; top >>= 1; }
+    return bits;
+  }
+
+  uint64_t toUint64(void) const {
+    assert(this->n <= 2);
+    uint64_t v = 0;
+    if (this->n > 1) v = (uint64_t) this->limb[1] << 32;
+    if (this->n > 0) v |= this->limb[0];
+    return v;
+  }
+
+  // this = this * f + add
+  void mulAdd(const uint32_t f, const uint32_t add) {
+    uint64_t carry = add;
+    for (int i = 0; i < this->n; i++) {
+      const uint64_t p = (uint64_t) this->limb[i] * f + carry;
+      this->limb[i] = (uint32_t) p;
+      carry = p >> 32;
+    }
+    if (carry) {
+      assert(this->n < MAXLIMBS);
+      this->limb[this->n++] = (uint32_t) carry;
+    }
+  }
+
+  void mulPow5(int k) {
+    static const uint32_t pow5[13] = {
+      1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125, 9765625,
+      48828125, 244140625
+    };
+    while (k >= 13) { this->mulAdd(1220703125, 0); k -= 13; }
+    if (k > 0) this->mulAdd(pow5[k], 0);
+  }
+
+  // this -= b, where b must not be larger than this
+  void sub(const CoinBigUInt & b) {
+    uint32_t borrow = 0;
+    for (int i = 0; i < this->n; i++) {
+      const uint64_t d = (uint64_t) this->limb[i] -
+        (i < b.n ? b.limb[i] : 0) - borrow;
+      this->limb[i] = (uint32_t) d;
+      borrow = (uint32_t) (d >> 63);
+    }
+    assert(borrow == 0);
+    this->trim();
+  }
+
+  void shiftLeft(const int bits) {
+    if ((this->n == 0) || (bits == 0)) return;
+    const int words = bits / 32;
+    const int rest = bits % 32;
+    if (rest) {
+      uint32_t carry = 0;
+      for (int i = 0; i < this->n; i++) {
+        const uint32_t l = this->limb[i];
+        this->limb[i] = (l << rest) | carry;
+        carry = l >> (32 - rest);
+      }
+      if (carry) {
+        assert(this->n < MAXLIMBS);
+        this->limb[this->n++] = carry;
+      }
+    }
+    if (words) {
+      assert(this->n + words <= MAXLIMBS);
+      memmove(this->limb + words, this->limb, this->n * sizeof(uint32_t));
+      memset(this->limb, 0, words * sizeof(uint32_t));
+      this->n += words;
+    }
+  }
+
+  void shiftRight(const int bits) {
+    const int words = bits / 32;
+    const int rest = bits % 32;
+    if (words >= this->n) { this->n = 0; return; }
+    if (words) {
+      memmove(this->limb, this->limb + words,
+              (this->n - words) * sizeof(uint32_t));
+      this->n -= words;
+    }
+    if (rest) {
+      for (int i = 0; i < this->n; i++) {
+        const uint32_t next =
+          (i + 1 < this->n) ? (this->limb[i + 1] << (32 - rest)) : 0;
+        this->limb[i] = (this->limb[i] >> rest) | next;
+      }
+    }
+    this->trim();
+  }
+
+  SbBool testBit(const int bit) const {
+    const int word = bit / 32;
+    if (word >= this->n) return FALSE;
+    return (this->limb[word] >> (bit % 32)) & 1;
+  }
+
+  // Whether any of the bits below the given one are set.
+  SbBool anyBitsBelow(const int bit) const {
+    const int word = SbMin(bit / 32, this->n);
+    for (int i = 0; i < word; i++) {
+      if (this->limb[i]) return TRUE;
+    }
+    if (word == this->n) return FALSE;
+    return (this->limb[word] & ((1u << (bit % 32)) - 1)) != 0;
+  }
+
+  static int compare(const CoinBigUInt & a, const CoinBigUInt & b) {
+    if (a.n != b.n) return (a.n < b.n) ? -1 : 1;
+    for (int i = a.n - 1; i >= 0; i--) {
+      if (a.limb[i] != b.limb[i]) return (a.limb[i] < b.limb[i]) ? -1 : 1;
+    }
+    return 0;
+  }
+
+  // Returns a / b, and leaves the remainder in a. The quotient must
+  // fit in 64 bits.
+  static uint64_t divide(CoinBigUInt & a, CoinBigUInt b) {
+    const int shift = a.bitLength() - b.bitLength();
+    if (shift < 0) return 0;
+    assert(shift < 64);
+    b.shiftLeft(shift);
+    uint64_t q = 0;
+    for (int i = shift; i >= 0; i--) {
+      q <<= 1;
+      if (compare(a, b) >= 0) { a.sub(b); q |= 1; }
+      if (i > 0) b.shiftRight(1);
+    }
+    return q;
+  }
+
+private:
+  void trim(void) {
+    while ((this->n > 0) && (this->limb[this->n - 1] == 0)) this->n--;
+  }
+
+  int n;
+  uint32_t limb[MAXLIMBS];
+};
+
+// *************************************************************************
+
+static const uint64_t floatconv_pow10[20] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+  10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+  100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL, 1000000000000000000ULL,
+  10000000000000000000ULL
+};
+
+static const uint64_t floatconv_pow5[28] = {
+  1ULL, 5ULL, 25ULL, 125ULL, 625ULL, 3125ULL, 15625ULL, 78125ULL,
+  390625ULL, 1953125ULL, 9765625ULL, 48828125ULL, 244140625ULL,
+  1220703125ULL, 6103515625ULL, 30517578125ULL, 152587890625ULL,
+  762939453125ULL, 3814697265625ULL, 19073486328125ULL,
+  95367431640625ULL, 476837158203125ULL, 2384185791015625ULL,
+  11920928955078125ULL, 59604644775390625ULL, 298023223876953125ULL,
+  1490116119384765625ULL, 7450580596923828125ULL
+};
+
+// Powers of ten as the nearest doubles. Up to 10^22, they are exact.
+#define FLOATCONV_POW10_MIN -65
+#define FLOATCONV_POW10_MAX 40
+
+static const double floatconv_pow10_double[FLOATCONV_POW10_MAX - FLOATCONV_POW10_MIN + 1] = {
+  1e-65, 1e-64, 1e-63, 1e-62, 1e-61, 1e-60, 1e-59, 1e-58, 1e-57,
+  1e-56, 1e-55, 1e-54, 1e-53, 1e-52, 1e-51, 1e-50, 1e-49, 1e-48,
+  1e-47, 1e-46, 1e-45, 1e-44, 1e-43, 1e-42, 1e-41, 1e-40, 1e-39,
+  1e-38, 1e-37, 1e-36, 1e-35, 1e-34, 1e-33, 1e-32, 1e-31, 1e-30,
+  1e-29, 1e-28, 1e-27, 1e-26, 1e-25, 1e-24, 1e-23, 1e-22, 1e-21,
+  1e-20, 1e-19, 1e-18, 1e-17, 1e-16, 1e-15, 1e-14, 1e-13, 1e-12,
+  1e-11, 1e-10, 1e-9, 1e-8, 1e-7, 1e-6, 1e-5, 1e-4, 1e-3,
+  1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+  1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+  1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22, 1e23, 1e24,
+  1e25, 1e26, 1e27, 1e28, 1e29, 1e30, 1e31, 1e32, 1e33,
+  1e34, 1e35, 1e36, 1e37, 1e38, 1e39, 1e40
+};
+
+static int
+floatconv_numdigits(const uint64_t v)
+{
+  int n = 1;
+  while ((n < 20) && (v >= floatconv_pow10[n])) n++;
+  return n;
+}
+
+static SbBool
+floatconv_signbit(const double value)
+{
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return (bits >> 63) != 0;
+}
+
+// *************************************************************************
+
+// Writes the number digits * 10^(exponent - numdigits + 1), where
+// digits has exactly numdigits digits, the way printf("%g") does with
+// the given precision, but with at least three exponent digits.
+static int
+floatconv_write(char * buf, const SbBool negative, uint64_t digits,
+                const int numdigits, const int exponent, const int precision)
+{
+  char d[20];
+  int i;
+  for (i = numdigits - 1; i >= 0; i--) {
+    d[i] = (char) ('0' + digits % 10);
+    digits /= 10;
+  }
+  // %g leaves out trailing zeros
+  int n = numdigits;
+  while ((n > 1) && (d[n - 1] == '0')) n--;
+
+  char * s = buf;
+  if (negative) *s++ = '-';
+
+  if ((exponent < -4) || (exponent >= precision)) {
+    *s++ = d[0];
+    if (n > 1) {
+      *s++ = '.';
+      for (i = 1; i < n; i++) *s++ = d[i];
+    }
+    *s++ = 'e';
+    *s++ = (exponent < 0) ? '-' : '+';
+    int e = (exponent < 0) ? -exponent : exponent;
+    char expdigits[4];
+    int numexpdigits = 0;
+    do { expdigits[numexpdigits++] = (char) ('0' + e % 10); e /= 10; } while (e);
+    while (numexpdigits < 3) expdigits[numexpdigits++] = '0';
+    while (numexpdigits > 0) *s++ = expdigits[--numexpdigits];
+  }
+  else if (exponent >= 0) {
+    for (i = 0; i <= exponent; i++) *s++ = (i < n) ? d[i] : '0';
+    if (n > exponent + 1) {
+      *s++ = '.';
+      for (i = exponent + 1; i < n; i++) *s++ = d[i];
+    }
+  }
+  else {
+    *s++ = '0';
+    *s++ = '.';
+    for (i = exponent + 1; i < 0; i++) *s++ = '0';
+    for (i = 0; i < n; i++) *s++ = d[i];
+  }
+  *s = '\0';
+  return (int) (s - buf);
+}
+
+static int
+floatconv_write_zero(char * buf, const SbBool negative)
+{
+  char * s = buf;
+  if (negative) *s++ = '-';
+  *s++ = '0';
+  *s = '\0';
+  return (int) (s - buf);
+}
+
+// Finds the digits of the finite, positive value rounded to precision
+// digits, and the decimal exponent of the first digit.
+static void
+floatconv_digits(const double value, const int precision,
+                 uint64_t & digits, int & exponent)
+{
+  // value = m * 2^e, with m odd
+  int e;
+  uint64_t m = (uint64_t) ldexp(frexp(value, &e), 53);
+  e -= 53;
+  while ((m & 1) == 0) { m >>= 1; e++; }
+
+  const uint64_t low = floatconv_pow10[precision - 1];
+  const uint64_t high = floatconv_pow10[precision];
+
+  // This estimate is at most one off, and corrected below.
+  int k = (int) floor(log10(value));
+  for (;;) {
+    // q = value * 10^s should get precision digits, and half tells
+    // whether the rest is below (-1), exactly (0) or above (1) one half
+    const int s = precision - 1 - k;
+    const int t = e + s;
+    uint64_t q;
+    int half;
+    if ((s >= 0) && (s < 28) && (t <= 0) && (-t < 64) &&
+        (m <= (~(uint64_t) 0) / floatconv_pow5[s])) {
+      // value * 10^s = m * 5^s / 2^-t
+      const uint64_t a = m * floatconv_pow5[s];
+      if (t == 0) { q = a; half = -1; }
+      else {
+        q = a >> -t;
+        const uint64_t rest = a & ((((uint64_t) 1) << -t) - 1);
+        const uint64_t halfway = ((uint64_t) 1) << (-t - 1);
+        half = (rest < halfway) ? -1 : ((rest == halfway) ? 0 : 1);
+      }
+    }
+    else if ((s >= 0) && (t <= 0)) {
+      CoinBigUInt a(m);
+      a.mulPow5(s);
+      if (a.bitLength() + t > 64) { k++; continue; }
+      if (t == 0) { q = a.toUint64(); half = -1; }
+      else {
+        const SbBool halfbit = a.testBit(-t - 1);
+        const SbBool rest = a.anyBitsBelow(-t - 1);
+        a.shiftRight(-t);
+        q = a.toUint64();
+        half = halfbit ? (rest ? 1 : 0) : -1;
+      }
+    }
+    else {
+      CoinBigUInt a(m), b(1);
+      if (s >= 0) a.mulPow5(s);
+      else b.mulPow5(-s);
+      if (t >= 0) a.shiftLeft(t);
+      else b.shiftLeft(-t);
+      if (a.bitLength() - b.bitLength() >= 64) { k++; continue; }
+      q = CoinBigUInt::divide(a, b);
+      a.shiftLeft(1);
+      half = CoinBigUInt::compare(a, b);
+    }
+
+    if (q >= high) { k++; continue; }
+    if (q < low) { k--; continue; }
+
+    if ((half > 0) || ((half == 0) && (q & 1))) q++;
+    if (q == high) { q = low; k++; }
+    digits = q;
+    exponent = k;
+    return;
+  }
+}
+
+// *************************************************************************
+
+// Tables and helpers for the Ryu algorithm, for floats. The tables
+// hold 5^-i and 5^i as 64 bit fixed point numbers.
+
+#define FLOATCONV_POW5_INV_BITCOUNT 59
+#define FLOATCONV_POW5_BITCOUNT 61
+
+static const uint64_t floatconv_pow5_inv_split[31] = {
+  576460752303423489ULL, 461168601842738791ULL, 368934881474191033ULL,
+  295147905179352826ULL, 472236648286964522ULL, 377789318629571618ULL,
+  302231454903657294ULL, 483570327845851670ULL, 386856262276681336ULL,
+  309485009821345069ULL, 495176015714152110ULL, 396140812571321688ULL,
+  316912650057057351ULL, 507060240091291761ULL, 405648192073033409ULL,
+  324518553658426727ULL, 519229685853482763ULL, 415383748682786211ULL,
+  332306998946228969ULL, 531691198313966350ULL, 425352958651173080ULL,
+  340282366920938464ULL, 544451787073501542ULL, 435561429658801234ULL,
+  348449143727040987ULL, 557518629963265579ULL, 446014903970612463ULL,
+  356811923176489971ULL, 570899077082383953ULL, 456719261665907162ULL,
+  365375409332725730ULL
+};
+
+static const uint64_t floatconv_pow5_split[48] = {
+  1152921504606846976ULL, 1441151880758558720ULL, 1801439850948198400ULL,
+  2251799813685248000ULL, 1407374883553280000ULL, 1759218604441600000ULL,
+  2199023255552000000ULL, 1374389534720000000ULL, 1717986918400000000ULL,
+  2147483648000000000ULL, 1342177280000000000ULL, 1677721600000000000ULL,
+  2097152000000000000ULL, 1310720000000000000ULL, 1638400000000000000ULL,
+  2048000000000000000ULL, 1280000000000000000ULL, 1600000000000000000ULL,
+  2000000000000000000ULL, 1250000000000000000ULL, 1562500000000000000ULL,
+  1953125000000000000ULL, 1220703125000000000ULL, 1525878906250000000ULL,
+  1907348632812500000ULL, 1192092895507812500ULL, 1490116119384765625ULL,
+  1862645149230957031ULL, 1164153218269348144ULL, 1455191522836685180ULL,
+  1818989403545856475ULL, 2273736754432320594ULL, 1421085471520200371ULL,
+  1776356839400250464ULL, 2220446049250313080ULL, 1387778780781445675ULL,
+  1734723475976807094ULL, 2168404344971008868ULL, 1355252715606880542ULL,
+  1694065894508600678ULL, 2117582368135750847ULL, 1323488980084844279ULL,
+  1654361225106055349ULL, 2067951531382569187ULL, 1292469707114105741ULL,
+  1615587133892632177ULL, 2019483917365790221ULL, 1262177448353618888ULL
+};
+
+// The number of bits of 5^e, for e > 0.
+static inline int
+floatconv_pow5bits(const int e)
+{
+  return (int) (((uint32_t) e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e)) and floor(log10(5^e)), for e >= 0.
+static inline int
+floatconv_log10pow2(const int e)
+{
+  return (int) (((uint32_t) e * 78913) >> 18);
+}
+
+static inline int
+floatconv_log10pow5(const int e)
+{
+  return (int) (((uint32_t) e * 732923) >> 20);
+}
+
+static inline int
+floatconv_pow5factor(uint32_t v)
+{
+  int count = 0;
+  while ((v % 5) == 0) { v /= 5; count++; }
+  return count;
+}
+
+static inline uint32_t
+floatconv_mulshift(const uint32_t m, const uint64_t factor, const int shift)
+{
+  assert(shift > 32);
+  const uint64_t low = (uint64_t) m * (uint32_t) factor;
+  const uint64_t high = (uint64_t) m * (uint32_t) (factor >> 32);
+  return (uint32_t) (((low >> 32) + high) >> (shift - 32));
+}
+
+// Finds the shortest digits which read back as the finite, nonzero
+// value, and returns the number of digits.
+static int
+floatconv_shortest_float(const float value, uint64_t & digits, int & exponent)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32_t ieeemantissa = bits & ((1u << 23) - 1);
+  const uint32_t ieeeexponent = (bits >> 23) & 0xff;
+
+  // value = m2 * 2^e2, with two extra bits for the interval bounds
+  int e2;
+  uint32_t m2;
+  if (ieeeexponent == 0) {
+    e2 = 1 - 127 - 23 - 2;
+    m2 = ieeemantissa;
+  }
+  else {
+    e2 = (int) ieeeexponent - 127 - 23 - 2;
+    m2 = (1u << 23) | ieeemantissa;
+  }
+  const SbBool acceptbounds = (m2 & 1) == 0;
+
+  // The value and the bounds of the interval that rounds to it,
+  // which is closer below when the value is a power of two
+  const uint32_t mv = 4 * m2;
+  const uint32_t mp = 4 * m2 + 2;
+  const uint32_t mmshift = ((ieeemantissa != 0) || (ieeeexponent <= 1)) ? 1 : 0;
+  const uint32_t mm = 4 * m2 - 1 - mmshift;
+
+  // Convert all three to decimal, with as few digits as possible
+  // while keeping the bounds apart.
+  uint32_t vr, vp, vm;
+  int e10;
+  SbBool vmtrailingzeros = FALSE, vrtrailingzeros = FALSE;
+  uint32_t lastremoved = 0;
+  if (e2 >= 0) {
+    const int q = floatconv_log10pow2(e2);
+    e10 = q;
+    const int k = FLOATCONV_POW5_INV_BITCOUNT + floatconv_pow5bits(q) - 1;
+    const int i = -e2 + q + k;
+    vr = floatconv_mulshift(mv, floatconv_pow5_inv_split[q], i);
+    vp = floatconv_mulshift(mp, floatconv_pow5_inv_split[q], i);
+    vm = floatconv_mulshift(mm, floatconv_pow5_inv_split[q], i);
+    if ((q != 0) && ((vp - 1) / 10 <= vm / 10)) {
+      // the last digit removed below must be computed separately
+      const int l = FLOATCONV_POW5_INV_BITCOUNT + floatconv_pow5bits(q - 1) - 1;
+      lastremoved = floatconv_mulshift(mv, floatconv_pow5_inv_split[q - 1],
+                                       -e2 + q - 1 + l) % 10;
+    }
+    if (q <= 9) {
+      // Only one of mp, mv and mm can be a multiple of 5, if any.
+      if ((mv % 5) == 0) {
+        vrtrailingzeros = floatconv_pow5factor(mv) >= q;
+      }
+      else if (acceptbounds) {
+        vmtrailingzeros = floatconv_pow5factor(mm) >= q;
+      }
+      else {
+        vp -= (floatconv_pow5factor(mp) >= q) ? 1 : 0;
+      }
+    }
+  }
+  else {
+    const int q = floatconv_log10pow5(-e2);
+    e10 = q + e2;
+    const int i = -e2 - q;
+    const int k = floatconv_pow5bits(i) - FLOATCONV_POW5_BITCOUNT;
+    int j = q - k;
+    vr = floatconv_mulshift(mv, floatconv_pow5_split[i], j);
+    vp = floatconv_mulshift(mp, floatconv_pow5_split[i], j);
+    vm = floatconv_mulshift(mm, floatconv_pow5_split[i], j);
+    if ((q != 0) && ((vp - 1) / 10 <= vm / 10)) {
+      j = q - 1 - (floatconv_pow5bits(i + 1) - FLOATCONV_POW5_BITCOUNT);
+      lastremoved = floatconv_mulshift(mv, floatconv_pow5_split[i + 1], j) % 10;
+    }
+    if (q <= 1) {
+      // mv has at least q trailing zero bits, as it is 4 * m2
+      vrtrailingzeros = TRUE;
+      if (acceptbounds) {
+        vmtrailingzeros = (mmshift == 1);
+      }
+      else {
+        vp--;
+      }
+    }
+    else if (q < 31) {
+      vrtrailingzeros = (mv & ((1u << (q - 1)) - 1)) == 0;
+    }
+  }
+
+  // Remove the digits which the bounds have in common, and round.
+  int removed = 0;
+  uint32_t output;
+  if (vmtrailingzeros || vrtrailingzeros) {
+    while (vp / 10 > vm / 10) {
+      vmtrailingzeros = vmtrailingzeros && ((vm % 10) == 0);
+      vrtrailingzeros = vrtrailingzeros && (lastremoved == 0);
+      lastremoved = vr % 10;
+      vr /= 10; vp /= 10; vm /= 10;
+      removed++;
+    }
+    if (vmtrailingzeros) {
+      while ((vm % 10) == 0) {
+        vrtrailingzeros = vrtrailingzeros && (lastremoved == 0);
+        lastremoved = vr % 10;
+        vr /= 10; vp /= 10; vm /= 10;
+        removed++;
+      }
+    }
+    if (vrtrailingzeros && (lastremoved == 5) && ((vr % 2) == 0)) {
+      // exactly halfway, round to even
+      lastremoved = 4;
+    }
+    output = vr + ((((vr == vm) && (!acceptbounds || !vmtrailingzeros)) ||
+                    (lastremoved >= 5)) ? 1 : 0);
+  }
+  else {
+    while (vp / 10 > vm / 10) {
+      lastremoved = vr % 10;
+      vr /= 10; vp /= 10; vm /= 10;
+      removed++;
+    }
+    output = vr + (((vr == vm) || (lastremoved >= 5)) ? 1 : 0);
+  }
+
+  const int numdigits = floatconv_numdigits(output);
+  digits = output;
+  exponent = e10 + removed + numdigits - 1;
+  return numdigits;
+}
+
+// *************************************************************************
+
+// The properties of a floating point format which matter when
+// converting decimal numbers to it.
+struct floatconv_format {
+  int mantissabits;
+  // the exponent of the least significant bit of the smallest
+  // subnormal and of the largest finite number
+  int minexponent, maxexponent;
+  // numbers with at most minlog10 digits in front of the decimal
+  // point are rounded to zero, and numbers with at least maxlog10 to
+  // infinity
+  int minlog10, maxlog10;
+};
+
+static const floatconv_format floatconv_float_format = {
+  24, -149, 104, -46, 40
+};
+
+static const floatconv_format floatconv_double_format = {
+  53, -1074, 971, -324, 310
+};
+
+// Numbers with more significant digits than this are rounded to this
+// many digits, with a sticky digit for the rest. It is enough to tell
+// all the halfway points between neighbouring doubles apart.
+#define FLOATCONV_MAX_DIGITS 780
+
+// A decimal number as it was written, with exponent being the value
+// after the 'e'.
+struct floatconv_decimal {
+  SbBool negative;
+  const char * integer;
+  int numinteger;
+  const char * fraction;
+  int numfraction;
+  int exponent;
+};
+
+static inline char
+floatconv_digit(const floatconv_decimal & d, const int i)
+{
+  return (i < d.numinteger) ? d.integer[i] : d.fraction[i - d.numinteger];
+}
+
+// Rounds (q + rest) * 2^exponent to the given format, where rest is
+// some fraction in [0, 1), nonzero if sticky is set. q must have more
+// bits than the mantissa of the format.
+static double
+floatconv_round(const uint64_t q, const int exponent, const SbBool sticky,
+                const floatconv_format & format)
+{
+  int bits = 0;
+  while ((bits < 64) && ((q >> bits) != 0)) bits++;
+  assert(bits > format.mantissabits);
+
+  int lsb = exponent + bits - format.mantissabits;
+  if (lsb < format.minexponent) lsb = format.minexponent;
+  const int drop = lsb - exponent;
+
+  uint64_t m;
+  SbBool halfbit, rest;
+  if (drop > 64) {
+    m = 0; halfbit = FALSE; rest = TRUE;
+  }
+  else if (drop == 64) {
+    m = 0;
+    halfbit = (q >> 63) != 0;
+    rest = sticky || ((q & ((((uint64_t) 1) << 63) - 1)) != 0);
+  }
+  else {
+    m = q >> drop;
+    halfbit = ((q >> (drop - 1)) & 1) != 0;
+    rest = sticky || ((q & ((((uint64_t) 1) << (drop - 1)) - 1)) != 0);
+  }
+  if (halfbit && (rest || (m & 1))) m++;
+  if (m == (((uint64_t) 1) << format.mantissabits)) { m >>= 1; lsb++; }
+  if (lsb > format.maxexponent) return HUGE_VAL;
+  return ldexp((double) m, lsb);
+}
+
+// Converts a number with too many digits or too large an exponent
+// for the fast path, using arbitrary precision integers.
+static double
+floatconv_convert_exact(const floatconv_decimal & d, const int first,
+                        const int numdigits, const floatconv_format & format)
+{
+  // the value is D * 10^E, with D an integer of at most
+  // FLOATCONV_MAX_DIGITS + 1 digits
+  CoinBigUInt D;
+  int i, chunk = 0, chunkdigits = 0;
+  const int used = SbMin(numdigits, FLOATCONV_MAX_DIGITS);
+  for (i = first; i < first + used; i++) {
+    chunk = chunk * 10 + (floatconv_digit(d, i) - '0');
+    if (++chunkdigits == 9) {
+      D.mulAdd(1000000000, chunk);
+      chunk = 0; chunkdigits = 0;
+    }
+  }
+  if (chunkdigits) D.mulAdd((uint32_t) floatconv_pow10[chunkdigits], chunk);
+  int E = d.exponent - d.numfraction + (numdigits - used);
+  if (used < numdigits) {
+    for (i = first + used; i < first + numdigits; i++) {
+      if (floatconv_digit(d, i) != '0') {
+        D.mulAdd(10, 1);
+        E--;
+        break;
+      }
+    }
+  }
+
+  uint64_t q;
+  int exponent;
+  SbBool sticky;
+  if (E >= 0) {
+    D.mulPow5(E);
+    D.shiftLeft(E);
+    // the top 64 bits
+    const int shift = D.bitLength() - 64;
+    sticky = FALSE;
+    if (shift >= 0) {
+      sticky = D.anyBitsBelow(shift);
+      D.shiftRight(shift);
+    }
+    else {
+      D.shiftLeft(-shift);
+    }
+    q = D.toUint64();
+    exponent = shift;
+  }
+  else {
+    // divide by 10^-E, with 63 or 64 bits in the quotient
+    CoinBigUInt divisor(1);
+    divisor.mulPow5(-E);
+    divisor.shiftLeft(-E);
+    const int shift = 63 + divisor.bitLength() - D.bitLength();
+    if (shift >= 0) D.shiftLeft(shift);
+    else divisor.shiftLeft(-shift);
+    q = CoinBigUInt::divide(D, divisor);
+    sticky = !D.isZero();
+    exponent = -shift;
+  }
+  return floatconv_round(q, exponent, sticky, format);
+}
+
+// Converts a decimal number to the given format, and returns it as a
+// double. The result is exactly representable in the format.
+static double
+floatconv_convert(const floatconv_decimal & d, const floatconv_format & format)
+{
+  const int total = d.numinteger + d.numfraction;
+  int first = 0;
+  while ((first < total) && (floatconv_digit(d, first) == '0')) first++;
+  const int numdigits = total - first;
+
+  double value;
+  const int log10 = numdigits + d.exponent - d.numfraction;
+  if ((numdigits == 0) || (log10 <= format.minlog10)) {
+    value = 0.0;
+  }
+  else if (log10 >= format.maxlog10) {
+    value = HUGE_VAL;
+  }
+  else {
+    // the first 19 significant digits
+    const int used = SbMin(numdigits, 19);
+    uint64_t w = 0;
+    int i;
+    for (i = first; i < first + used; i++) {
+      w = w * 10 + (floatconv_digit(d, i) - '0');
+    }
+    SbBool exact = TRUE;
+    for (; exact && (i < total); i++) {
+      if (floatconv_digit(d, i) != '0') exact = FALSE;
+    }
+    const int exponent = d.exponent - d.numfraction + (numdigits - used);
+
+    SbBool fast = FALSE;
+    if (exact && (w <= (((uint64_t) 1) << 53)) &&
+        (exponent >= -22) && (exponent <= 22)) {
+      // Both w and 10^|exponent| are exact doubles, so one operation
+      // gives a correctly rounded double.
+      value = (double) w;
+      if (exponent < 0) value /= floatconv_pow10_double[-exponent - FLOATCONV_POW10_MIN];
+      else value *= floatconv_pow10_double[exponent - FLOATCONV_POW10_MIN];
+      fast = TRUE;
+    }
+    else if ((format.mantissabits < 53) &&
+             (exponent >= FLOATCONV_POW10_MIN) && (exponent <= FLOATCONV_POW10_MAX)) {
+      // Off by a few units in the last place of a double, which is
+      // far below the precision of a float.
+      value = (double) w * floatconv_pow10_double[exponent - FLOATCONV_POW10_MIN];
+      fast = TRUE;
+    }
+    if (fast && (format.mantissabits < 53)) {
+      // Rounding the double again is only right if it is not close to
+      // halfway between two numbers of the format, and not subnormal
+      // in the format.
+      uint64_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      const int dropped = 53 - format.mantissabits;
+      const uint64_t mask = (((uint64_t) 1) << dropped) - 1;
+      const uint64_t halfway = ((uint64_t) 1) << (dropped - 1);
+      const uint64_t rest = bits & mask;
+      const uint64_t distance = (rest > halfway) ? (rest - halfway) : (halfway - rest);
+      const int minnormal = format.minexponent + format.mantissabits - 1;
+      if ((distance <= 8) || (value < ldexp(1.0, minnormal))) fast = FALSE;
+    }
+    if (!fast) {
+      value = floatconv_convert_exact(d, first, numdigits, format);
+    }
+  }
+  return d.negative ? -value : value;
+}
+
+// Splits up the number at str, and returns a pointer to the first
+// character after it, or NULL if it is not a valid number.
+static const char *
+floatconv_scan(const char * str, const char * end, floatconv_decimal & d)
+{
+  const char * s = str;
+  d.negative = FALSE;
+  if ((s < end) && ((*s == '-') || (*s == '+'))) {
+    d.negative = (*s == '-');
+    s++;
+  }
+  d.integer = s;
+  while ((s < end) && (*s >= '0') && (*s <= '9')) s++;
+  d.numinteger = (int) (s - d.integer);
+  d.fraction = s;
+  d.numfraction = 0;
+  if ((s < end) && (*s == '.')) {
+    s++;
+    d.fraction = s;
+    while ((s < end) && (*s >= '0') && (*s <= '9')) s++;
+    d.numfraction = (int) (s - d.fraction);
+  }
+  if ((d.numinteger == 0) && (d.numfraction == 0)) return NULL;
+
+  d.exponent = 0;
+  if ((s < end) && ((*s == 'e') || (*s == 'E'))) {
+    s++;
+    SbBool minus = FALSE;
+    if ((s < end) && ((*s == '-') || (*s == '+'))) {
+      minus = (*s == '-');
+      s++;
+    }
+    const char * digits = s;
+    int e = 0;
+    while ((s < end) && (*s >= '0') && (*s <= '9')) {
+      // anything beyond this is zero or infinity anyway
+      if (e < 100000) e = e * 10 + (*s - '0');
+      s++;
+    }
+    if (s == digits) return NULL;
+    d.exponent = minus ? -e : e;
+  }
+  return s;
+}
+
+// *************************************************************************
+
+int
+coin_format_double(char * buf, const double value, const int precision)
+{
+  if ((precision > 17) || !coin_finite(value)) return -1;
+
+  const SbBool negative = floatconv_signbit(value);
+  if (value == 0.0) return floatconv_write_zero(buf, negative);
+  const double a = fabs(value);
+
+  uint64_t digits;
+  int exponent;
+  if (precision >= 0) {
+    const int p = SbMax(precision, 1);
+    floatconv_digits(a, p, digits, exponent);
+    return floatconv_write(buf, negative, digits, p, exponent, p);
+  }
+
+  // The fewest digits which read back as the same value. 17 digits
+  // are always enough.
+  int numdigits = 17;
+  floatconv_digits(a, numdigits, digits, exponent);
+  int low = 1;
+  while (low < numdigits) {
+    const int p = (low + numdigits) / 2;
+    uint64_t pdigits;
+    int pexponent;
+    floatconv_digits(a, p, pdigits, pexponent);
+
+    char str[20];
+    uint64_t v = pdigits;
+    for (int i = p - 1; i >= 0; i--) { str[i] = (char) ('0' + v % 10); v /= 10; }
+    floatconv_decimal d;
+    d.negative = FALSE;
+    d.integer = str;
+    d.numinteger = p;
+    d.fraction = str + p;
+    d.numfraction = 0;
+    d.exponent = pexponent - p + 1;
+    if (floatconv_convert(d, floatconv_double_format) == a) {
+      numdigits = p;
+      digits = pdigits;
+      exponent = pexponent;
+    }
+    else {
+      low = p + 1;
+    }
+  }
+  return floatconv_write(buf, negative, digits, numdigits, exponent,
+                         SbMax(numdigits, 17));
+}
+
+int
+coin_format_float(char * buf, const float value, const int precision)
+{
+  if (precision >= 0) return coin_format_double(buf, (double) value, precision);
+  if (!coin_finite((double) value)) return -1;
+
+  const SbBool negative = floatconv_signbit((double) value);
+  if (value == 0.0f) return floatconv_write_zero(buf, negative);
+
+  uint64_t digits;
+  int exponent;
+  const int numdigits = floatconv_shortest_float(value, digits, exponent);
+  return floatconv_write(buf, negative, digits, numdigits, exponent,
+                         SbMax(numdigits, 9));
+}
+
+const char *
+coin_parse_double(const char * str, const char * end, double & value)
+{
+  floatconv_decimal d;
+  const char * next = floatconv_scan(str, end, d);
+  if (next) value = floatconv_convert(d, floatconv_double_format);
+  return next;
+}
+
+const char *
+coin_parse_float(const char * str, const char * end, float & value)
+{
+  floatconv_decimal d;
+  const char * next = floatconv_scan(str, end, d);
+  if (next) value = (float) floatconv_convert(d, floatconv_float_format);
+  return next;
+}
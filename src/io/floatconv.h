@@ -0,0 +1,63 @@
+#ifndef COIN_FLOATCONV_H
+#define COIN_FLOATCONV_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+// Locale independent conversion of floating point numbers to and from
+// the ASCII format of Inventor files.
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* ! COIN_INTERNAL */
+
+// Large enough for any string from coin_format_float() and
+// coin_format_double(), including the terminating zero.
+#define COIN_FORMAT_REAL_BUFSIZE 32
+
+// Formats value like printf("%.<precision>g"), but with at least
+// three digits in the exponent, as SoOutput writes it. A negative
+// precision gives the shortest string which reads back as the same
+// value. Returns the length of the string, or -1 for the values and
+// precisions (above 17) which are left to printf().
+int coin_format_float(char * buf, const float value, const int precision);
+int coin_format_double(char * buf, const double value, const int precision);
+
+// Reads a number of the form [+-]digits[.digits][(e|E)[+-]digits],
+// where either the integer or the fraction digits may be left out,
+// starting at str and stopping before end. Returns a pointer to the
+// first character after the number, or NULL if there is no valid
+// number at str. The value is correctly rounded.
+const char * coin_parse_float(const char * str, const char * end, float & value);
+const char * coin_parse_double(const char * str, const char * end, double & value);
+
+#endif // !COIN_FLOATCONV_H
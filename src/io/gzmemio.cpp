@@ -54,6 +54,7 @@ typedef void   (*free_func)(void * opaque, void * address);
 #define Z_ERRNO        (-1)
 #define Z_STREAM_END    1
 #define Z_NO_FLUSH      0
+#define Z_FINISH        4
 #define Z_DEFLATED   8
 #define MAX_WBITS   15 /* 32K LZ77 window */
 
@@ -90,6 +91,7 @@ cc_gzm_sizeof_z_stream(void)
 
 #define Z_BUFSIZE 16384
 #define Z_NO_DEFLATE 1
+#define Z_DEF_MEM_LEVEL 8
 
 #define Z_ALLOC(size) malloc(size)
 #define Z_TRYFREE(p) {if (p) free(p);}
@@ -783,6 +785,59 @@ int cc_gzm_close(void * file)
   return destroy((cc_gzm_stream*)file);
 }
 
+/* ===========================================================================
+     Compresses srclen bytes into a complete gzip member in dst, which
+     must hold at least cc_gzm_compress_bound(srclen) bytes. Returns
+     the size of the member, or 0 on failure. Members written this way
+     can be concatenated, and are read back by cc_gzm_read() and
+     gzread() as a single stream.
+*/
+
+uint32_t cc_gzm_compress_bound(uint32_t srclen)
+{
+  /* stored deflate blocks add 5 bytes per 16K, plus the gzip header
+     and trailer */
+  return srclen + (srclen >> 10) + 64;
+}
+
+uint32_t cc_gzm_compress(const void * src, uint32_t srclen,
+                         void * dst, uint32_t dstlen, int level)
+{
+  z_stream stream;
+  uint8_t * out = (uint8_t*) dst;
+  uint32_t crc, size;
+  int i, err;
+
+  if (dstlen < 18) return 0;
+
+  /* a minimal gzip header, as written by gzopen() */
+  out[0] = gz_magic[0]; out[1] = gz_magic[1];
+  out[2] = Z_DEFLATED;
+  for (i = 3; i < 9; i++) out[i] = 0; /* flags, time, xflags */
+  out[9] = 0x03; /* OS_CODE, unix */
+
+  (void) memset(&stream, 0, sizeof(z_stream));
+  err = cc_zlibglue_deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS,
+                                 Z_DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+  /* windowBits is passed < 0 to suppress the zlib header */
+  if (err != Z_OK) return 0;
+
+  stream.next_in = (unsigned char*) src;
+  stream.avail_in = srclen;
+  stream.next_out = out + 10;
+  stream.avail_out = dstlen - 18;
+  err = cc_zlibglue_deflate(&stream, Z_FINISH);
+  size = 10 + (uint32_t) stream.total_out;
+  (void) cc_zlibglue_deflateEnd(&stream);
+  if (err != Z_STREAM_END) return 0;
+
+  crc = cc_zlibglue_crc32(0L, NULL, 0);
+  crc = cc_zlibglue_crc32(crc, (const char*) src, srclen);
+  for (i = 0; i < 4; i++) out[size + i] = (uint8_t) (crc >> (i * 8));
+  for (i = 0; i < 4; i++) out[size + 4 + i] = (uint8_t) (srclen >> (i * 8));
+  return size + 8;
+}
+
 /* stdio layer */
 
 static int
@@ -852,6 +907,7 @@ cc_gzm_ferror(cc_gzm_file * COIN_UNUSED_ARG(file))
 
 #undef Z_BUFSIZE
 #undef Z_NO_DEFLATE
+#undef Z_DEF_MEM_LEVEL
 #undef Z_ALLOC
 #undef Z_TRYFREE
 #undef Z_ASCII_FLAG
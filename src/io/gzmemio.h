@@ -53,6 +53,10 @@ extern "C" {
   int cc_gzm_eof(void * file);
   int cc_gzm_close(void * file);
   int cc_gzm_sizeof_z_stream(void);
+
+  uint32_t cc_gzm_compress_bound(uint32_t srclen);
+  uint32_t cc_gzm_compress(const void * src, uint32_t srclen,
+                           void * dst, uint32_t dstlen, int level);
   
 
   /*
@@ -0,0 +1,385 @@
+#ifndef COIN_SBFLATHASH_H
+#define COIN_SBFLATHASH_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+// *************************************************************************
+// This class (SbFlatHash<Key, Type>) is internal and must not be
+// exposed in the Coin API.
+//
+// It has the same interface as SbHash<Key, Type>, but keeps all
+// entries in one flat array and resolves collisions by linear
+// probing, so there is no allocation per entry and a lookup usually
+// touches a single cache line. The table size is always a power of
+// two, and entries are removed by moving the following entries of
+// the probe sequence back, so no "deleted" markers are needed.
+//
+// Differences from SbHash that matter to the callers:
+//
+//  - Key and Type must be default constructible, as the array is
+//    allocated up front.
+//
+//  - Pointer keys (including "const char *" keys, which are expected
+//    to be SbName strings) are hashed on the pointer value, not the
+//    string contents. This matches the pointer comparison done on
+//    lookup.
+//
+//  - Any insertion may move the entries, and erase() may move other
+//    entries, so iterators and references into the table must not be
+//    kept across modifications.
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* ! COIN_INTERNAL */
+
+// *************************************************************************
+
+#include <assert.h>
+#include <stddef.h> // NULL
+#include <string.h> // memset()
+
+#include "misc/SbHash.h"
+
+// *************************************************************************
+
+// Hash values for the keys. Pointers are hashed on their value, other
+// types through the SbHashFunc() overloads used by SbHash.
+template <class Key>
+struct SbFlatHashKey {
+  static unsigned int hash(const Key & key) { return SbHashFunc(key); }
+};
+
+template <class T>
+struct SbFlatHashKey<T *> {
+  static unsigned int hash(T * key) {
+    return toUint<size_t>(reinterpret_cast<size_t>(key));
+  }
+};
+
+template <class Key, class Type>
+class SbFlatHash {
+ public:
+
+  class SbHashEntry {
+  public:
+    SbHashEntry(void) : key(), obj() {}
+
+    Key key;
+    Type obj;
+  };
+
+  class iterator {
+  public:
+    iterator(const iterator & iter) {
+      this->master = iter.master;
+      this->index  = iter.index;
+    }
+    SbHashEntry & operator*() {
+      return this->master->entries[this->index];
+    }
+    SbHashEntry * operator->() {
+      return &this->master->entries[this->index];
+    }
+    bool operator==(const iterator & rhs) const {
+      return rhs.index == this->index;
+    }
+    bool operator!=(const iterator & rhs) const {
+      return !((*this)==rhs);
+    }
+    iterator & operator++() {
+      this->index = this->master->nextUsed(this->index + 1);
+      return *this;
+    }
+  private:
+    iterator(const SbFlatHash<Key, Type> * master_in, unsigned int index_in) :
+      master(master_in), index(index_in) { }
+
+    const SbFlatHash<Key, Type> * master;
+    unsigned int index;
+    friend class SbFlatHash<Key, Type>;
+  };
+
+  class const_iterator {
+  public:
+    const_iterator(const iterator & iter) {
+      this->master = iter.master;
+      this->index  = iter.index;
+    }
+    const_iterator(const const_iterator & iter) {
+      this->master = iter.master;
+      this->index  = iter.index;
+    }
+    const SbHashEntry & operator*() {
+      return this->master->entries[this->index];
+    }
+    const SbHashEntry * operator->() {
+      return &this->master->entries[this->index];
+    }
+    bool operator==(const const_iterator & rhs) const {
+      return rhs.index == this->index;
+    }
+    bool operator!=(const const_iterator & rhs) const {
+      return !((*this)==rhs);
+    }
+    const_iterator & operator++() {
+      this->index = this->master->nextUsed(this->index + 1);
+      return *this;
+    }
+  private:
+    const_iterator(const SbFlatHash<Key, Type> * master_in, unsigned int index_in) :
+      master(master_in), index(index_in) { }
+
+    const SbFlatHash<Key, Type> * master;
+    unsigned int index;
+    friend class SbFlatHash<Key, Type>;
+  };
+
+  SbFlatHash(unsigned int sizearg = 256, float loadfactorarg = 0.0f)
+  {
+    this->commonConstructor(sizearg, loadfactorarg);
+  }
+
+  SbFlatHash(const SbFlatHash & from)
+  {
+    this->commonConstructor(from.size, from.loadfactor);
+    this->operator=(from);
+  }
+
+  SbFlatHash & operator=(const SbFlatHash & from)
+  {
+    if (this == &from) return *this;
+    this->clear();
+    for (unsigned int i = 0; i < from.size; ++i) {
+      if (from.used[i]) this->put(from.entries[i].key, from.entries[i].obj);
+    }
+    return *this;
+  }
+
+  ~SbFlatHash()
+  {
+    delete [] this->entries;
+    delete [] this->used;
+  }
+
+  void clear(void)
+  {
+    if (this->elements == 0) return;
+    for (unsigned int i = 0; i < this->size; i++) {
+      if (this->used[i]) this->entries[i] = SbHashEntry();
+    }
+    memset(this->used, 0, this->size);
+    this->elements = 0;
+  }
+
+  iterator begin() const {
+    return iterator(this, this->nextUsed(0));
+  }
+
+  iterator end() const {
+    return iterator(this, this->size);
+  }
+
+  const_iterator const_begin() const {
+    return const_iterator(this, this->nextUsed(0));
+  }
+
+  const_iterator const_end() const {
+    return const_iterator(this, this->size);
+  }
+
+  Type & operator[](const Key & key) {
+    unsigned int i;
+    if (!this->lookup(key, i)) {
+      i = this->insert(key, Type());
+    }
+    return this->entries[i].obj;
+  }
+
+  size_t erase(const Key & key)
+  {
+    unsigned int i;
+    if (!this->lookup(key, i)) return 0;
+
+    // Move entries which can't be found from their home slot without
+    // passing the hole back into it, until an empty slot is reached.
+    const unsigned int mask = this->size - 1;
+    unsigned int j = i;
+    for (;;) {
+      j = (j + 1) & mask;
+      if (!this->used[j]) break;
+      const unsigned int home = this->getIndex(this->entries[j].key);
+      // the distance from the home slot to j, and to the hole at i
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+        this->entries[i] = this->entries[j];
+        i = j;
+      }
+    }
+    this->entries[i] = SbHashEntry();
+    this->used[i] = 0;
+    this->elements--;
+    return 1;
+  }
+
+  void makeKeyList(SbList<Key> & l) const
+  {
+    for (unsigned int i = 0; i < this->size; ++i) {
+      if (this->used[i]) l.append(this->entries[i].key);
+    }
+  }
+
+  unsigned int getNumElements(void) const { return this->elements; }
+
+  const_iterator find(const Key & key) const
+  {
+    unsigned int i;
+    if (!this->lookup(key, i)) return this->const_end();
+    return const_iterator(this, i);
+  }
+
+  SbBool put(const Key & key, const Type & obj)
+  {
+    unsigned int i;
+    if (this->lookup(key, i)) {
+      /* Replace the old value */
+      this->entries[i].obj = obj;
+      return FALSE;
+    }
+    (void)this->insert(key, obj);
+    return TRUE;
+  }
+
+  SbBool get(const Key & key, Type & obj) const
+  {
+    unsigned int i;
+    if (!this->lookup(key, i)) return FALSE;
+    obj = this->entries[i].obj;
+    return TRUE;
+  }
+
+protected:
+  unsigned int getIndex(const Key & key) const {
+    // Fibonacci hashing, so that keys which only differ in the low
+    // or high bits (aligned pointers, small integers) are spread out
+    const unsigned int h = SbFlatHashKey<Key>::hash(key);
+    return static_cast<unsigned int>((h * 2654435769u) >> this->shift);
+  }
+
+private:
+  unsigned int nextUsed(unsigned int i) const {
+    while (i < this->size && !this->used[i]) ++i;
+    return i;
+  }
+
+  SbBool lookup(const Key & key, unsigned int & idx) const
+  {
+    const unsigned int mask = this->size - 1;
+    unsigned int i = this->getIndex(key);
+    while (this->used[i]) {
+      if (this->entries[i].key == key) {
+        idx = i;
+        return TRUE;
+      }
+      i = (i + 1) & mask;
+    }
+    return FALSE;
+  }
+
+  // Inserts a key known not to be in the table, and returns the slot.
+  unsigned int insert(const Key & key, const Type & obj)
+  {
+    if (this->elements >= this->threshold) {
+      this->resize(this->size * 2);
+    }
+    const unsigned int mask = this->size - 1;
+    unsigned int i = this->getIndex(key);
+    while (this->used[i]) i = (i + 1) & mask;
+    this->entries[i].key = key;
+    this->entries[i].obj = obj;
+    this->used[i] = 1;
+    this->elements++;
+    return i;
+  }
+
+  void resize(unsigned int newsize)
+  {
+    const unsigned int oldsize = this->size;
+    SbHashEntry * oldentries = this->entries;
+    unsigned char * oldused = this->used;
+
+    this->allocate(newsize);
+    const unsigned int mask = this->size - 1;
+    for (unsigned int i = 0; i < oldsize; i++) {
+      if (!oldused[i]) continue;
+      unsigned int j = this->getIndex(oldentries[i].key);
+      while (this->used[j]) j = (j + 1) & mask;
+      this->entries[j] = oldentries[i];
+      this->used[j] = 1;
+    }
+    delete [] oldentries;
+    delete [] oldused;
+  }
+
+  void allocate(unsigned int newsize)
+  {
+    this->size = newsize;
+    this->shift = 32;
+    while (newsize > 1) { newsize >>= 1; this->shift--; }
+    // always leave at least one empty slot, so probing terminates
+    this->threshold = static_cast<unsigned int>(this->size * this->loadfactor);
+    if (this->threshold >= this->size) this->threshold = this->size - 1;
+    this->entries = new SbHashEntry[this->size];
+    this->used = new unsigned char[this->size];
+    memset(this->used, 0, this->size);
+  }
+
+  void commonConstructor(unsigned int sizearg, float loadfactorarg)
+  {
+    if (loadfactorarg <= 0.0f) { loadfactorarg = 0.75f; }
+    unsigned int s = 8;
+    while (s < sizearg && s < 0x80000000u) s <<= 1;
+    this->loadfactor = loadfactorarg;
+    this->elements = 0;
+    this->allocate(s);
+  }
+
+  float loadfactor;
+  unsigned int size;
+  unsigned int shift;
+  unsigned int elements;
+  unsigned int threshold;
+
+  SbHashEntry * entries;
+  unsigned char * used;
+};
+
+#endif // !COIN_SBFLATHASH_H
@@ -365,8 +365,8 @@ SoBase::initClass(void)
 
   SoBase::classTypeId = SoType::createType(SoType::badType(), "Base");
 
-  SoBase::PImpl::name2obj = new SbHash<const char *, SbPList *>;
-  SoBase::PImpl::obj2name = new SbHash<const SoBase *, const char *>();
+  SoBase::PImpl::name2obj = new SbFlatHash<const char *, SbPList *>;
+  SoBase::PImpl::obj2name = new SbFlatHash<const SoBase *, const char *>();
   SoBase::PImpl::refwriteprefix = new SbString("+");
   SoBase::PImpl::allbaseobj = new SoBaseSet;
 
@@ -394,7 +394,7 @@ SoBase::cleanClass(void)
 
   // Delete the SbPLists in the dictionaries.
   for(
-      SbHash<const char *, SbPList *>::const_iterator iter =
+      SbFlatHash<const char *, SbPList *>::const_iterator iter =
        SoBase::PImpl::name2obj->const_begin();
       iter!=SoBase::PImpl::name2obj->const_end();
       ++iter
@@ -646,12 +646,12 @@ SoBase::getName(void) const
   // you have invoked SoDB::cleanup().
   assert(SoBase::PImpl::obj2name);
 
-  //const char * value = NULL;
+  const char * value = "";
   CC_MUTEX_LOCK(SoBase::PImpl::obj2name_mutex);
-  SbHash<const SoBase *, const char *>::const_iterator tmp = SoBase::PImpl::obj2name->find(this);
-  SbBool found = (tmp != SoBase::PImpl::obj2name->const_end());
+  SbFlatHash<const SoBase *, const char *>::const_iterator tmp = SoBase::PImpl::obj2name->find(this);
+  if (tmp != SoBase::PImpl::obj2name->const_end()) value = tmp->obj;
   CC_MUTEX_UNLOCK(SoBase::PImpl::obj2name_mutex);
-  return SbName(found ? tmp->obj : "");
+  return SbName(value);
 }
 
 /*!
@@ -742,7 +742,7 @@ SoBase::addName(SoBase * const b, const char * const name)
 
   SbPList * l;
   CC_MUTEX_LOCK(SoBase::PImpl::name2obj_mutex);
-  SbHash<const char*, SbPList*>::const_iterator tmp = SoBase::PImpl::name2obj->find(name);
+  SbFlatHash<const char*, SbPList*>::const_iterator tmp = SoBase::PImpl::name2obj->find(name);
   if (tmp==SoBase::PImpl::name2obj->const_end()) {
     // name not used before, create new list
     l = new SbPList;
@@ -757,7 +757,7 @@ SoBase::addName(SoBase * const b, const char * const name)
   CC_MUTEX_UNLOCK(SoBase::PImpl::name2obj_mutex);
 
   CC_MUTEX_LOCK(SoBase::PImpl::obj2name_mutex);
-  // set name of object. SbHash::put() will overwrite old name
+  // set name of object. SbFlatHash::put() will overwrite old name
   (*SoBase::PImpl::obj2name)[b] = name;
   CC_MUTEX_UNLOCK(SoBase::PImpl::obj2name_mutex);
 }
@@ -862,12 +862,12 @@ SoBase::getAuditors(void) const
   CC_MUTEX_LOCK(SoBase::PImpl::auditor_mutex);
 
   if (SoBase::PImpl::auditordict == NULL) {
-    SoBase::PImpl::auditordict = new SbHash<const SoBase *, SoAuditorList *>();
+    SoBase::PImpl::auditordict = new SbFlatHash<const SoBase *, SoAuditorList *>();
     coin_atexit((coin_atexit_f*)SoBase::PImpl::cleanup_auditordict, CC_ATEXIT_NORMAL);
   }
 
   SoAuditorList * l = NULL;
-  SbHash<const SoBase *, SoAuditorList *>::const_iterator iter
+  SbFlatHash<const SoBase *, SoAuditorList *>::const_iterator iter
     = 
     SoBase::PImpl::auditordict->find(this);
   if (iter!=SoBase::PImpl::auditordict->const_end()) {
@@ -965,7 +965,7 @@ SoBase *
 SoBase::getNamedBase(const SbName & name, SoType type)
 {
   CC_MUTEX_LOCK(SoBase::PImpl::name2obj_mutex);
-  SbHash<const char*, SbPList*>::const_iterator iter = 
+  SbFlatHash<const char*, SbPList*>::const_iterator iter = 
     SoBase::PImpl::name2obj->find((const char *)name);
   if (iter!=SoBase::PImpl::name2obj->const_end()) {
     SbPList * l = iter->obj;
@@ -994,7 +994,7 @@ SoBase::getNamedBases(const SbName & name, SoBaseList & baselist, SoType type)
 
   int matches = 0;
 
-  SbHash<const char*, SbPList*>::const_iterator iter = 
+  SbFlatHash<const char*, SbPList*>::const_iterator iter = 
     SoBase::PImpl::name2obj->find((const char *)name);
   if (iter!=SoBase::PImpl::name2obj->const_end()) {
     SbPList * l = iter->obj;
@@ -1828,6 +1828,76 @@ DEF root Separator {
 	   newroot->unref();
  }
 
+#include <Inventor/SbName.h>
+#include <Inventor/SbString.h>
+#include <Inventor/lists/SoNodeList.h>
+#include <Inventor/nodes/SoInfo.h>
+
+BOOST_AUTO_TEST_CASE(namedictionaries)
+{
+  // enough named and audited nodes that the dictionaries grow, and
+  // are then emptied out of order again
+  const int num = 4000;
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoInfo ** nodes = new SoInfo *[num];
+  int i;
+  for (i = 0; i < num; i++) {
+    nodes[i] = new SoInfo;
+    nodes[i]->ref();
+    SbString name;
+    name.sprintf("namedictionaries_%d", i % 100);
+    nodes[i]->setName(name.getString());
+    root->addChild(nodes[i]);
+  }
+  SoNodeList found;
+  BOOST_CHECK_EQUAL(SoNode::getByName("namedictionaries_7", found), num / 100);
+
+  // remove and destruct every third node, and rename every other
+  for (i = 0; i < num; i++) {
+    if (i % 3 == 0) {
+      root->removeChild(nodes[i]);
+      nodes[i]->unref();
+      nodes[i] = NULL;
+    }
+    else if (i % 2 == 0) {
+      nodes[i]->setName("namedictionaries_renamed");
+    }
+  }
+
+  int renamed = 0;
+  SbBool namesok = TRUE;
+  for (i = 0; i < num; i++) {
+    if (nodes[i] == NULL) continue;
+    SbString name;
+    if (i % 2 == 0) {
+      name = "namedictionaries_renamed";
+      renamed++;
+    }
+    else {
+      name.sprintf("namedictionaries_%d", i % 100);
+    }
+    if (nodes[i]->getName() != SbName(name.getString())) namesok = FALSE;
+  }
+  BOOST_CHECK_MESSAGE(namesok, "Node names were lost");
+
+  found.truncate(0);
+  BOOST_CHECK_EQUAL(SoNode::getByName("namedictionaries_renamed", found), renamed);
+  found.truncate(0);
+  // i % 100 == 7 and i odd, and i % 3 != 0
+  int expected = 0;
+  for (i = 7; i < num; i += 100) { if (i % 3 != 0 && i % 2 != 0) expected++; }
+  BOOST_CHECK_EQUAL(SoNode::getByName("namedictionaries_7", found), expected);
+
+  root->unref();
+  for (i = 0; i < num; i++) {
+    if (nodes[i]) nodes[i]->unref();
+  }
+  delete[] nodes;
+  found.truncate(0);
+  BOOST_CHECK_EQUAL(SoNode::getByName("namedictionaries_renamed", found), 0);
+}
+
 #endif // COIN_TEST_SUITE
 
 /* *********************************************************************** */
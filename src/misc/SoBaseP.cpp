@@ -72,7 +72,7 @@ void * SoBase::PImpl::obj2name_mutex = NULL;
 void * SoBase::PImpl::auditor_mutex = NULL;
 void * SoBase::PImpl::global_mutex = NULL;
 
-SbHash<const SoBase *, SoAuditorList *> * SoBase::PImpl::auditordict = NULL;
+SbFlatHash<const SoBase *, SoAuditorList *> * SoBase::PImpl::auditordict = NULL;
 
 // Only a small number of SoBase derived objects will under usual
 // conditions have designated names, so we use a couple of static
@@ -80,8 +80,8 @@ SbHash<const SoBase *, SoAuditorList *> * SoBase::PImpl::auditordict = NULL;
 // pointer for each and every object, we'll cut down on a decent
 // amount of memory use this way (SoBase should be kept as slim as
 // possible, as any dead weight is brought along in a lot of objects).
-SbHash<const char *, SbPList *> * SoBase::PImpl::name2obj = NULL;
-SbHash<const SoBase *, const char *> * SoBase::PImpl::obj2name = NULL;
+SbFlatHash<const char *, SbPList *> * SoBase::PImpl::name2obj = NULL;
+SbFlatHash<const SoBase *, const char *> * SoBase::PImpl::obj2name = NULL;
 
 // This is used for debugging purposes: it stores a pointer to all
 // SoBase-derived objects that have been allocated and not
@@ -114,7 +114,7 @@ void
 SoBase::PImpl::removeName2Obj(SoBase * const base, const char * const name)
 {
   CC_MUTEX_LOCK(SoBase::PImpl::name2obj_mutex);
-  SbHash<const char*, SbPList*>::const_iterator iter = SoBase::PImpl::name2obj->find(name);
+  SbFlatHash<const char*, SbPList*>::const_iterator iter = SoBase::PImpl::name2obj->find(name);
   SbBool found = (iter != SoBase::PImpl::name2obj->const_end());
   assert(found);
   
@@ -141,7 +141,7 @@ SoBase::PImpl::cleanup_auditordict(void)
 {
   if (SoBase::PImpl::auditordict) {
     for(
-       SbHash<const SoBase *, SoAuditorList *>::const_iterator iter =
+       SbFlatHash<const SoBase *, SoAuditorList *>::const_iterator iter =
          SoBase::PImpl::auditordict->const_begin();
        iter!=SoBase::PImpl::auditordict->const_end();
        ++iter
@@ -384,7 +384,9 @@ SoBase::PImpl::readBaseInstance(SoInput * in, const SbName & classname,
       const ptrdiff_t offset = occ - strp;
       if (occ) instancename = instancename.getSubString(0, (int)offset - 1);
       // Set name identifier for newly created SoBase instance.
-      base->setName(instancename);
+      if (!SoInputP::deferName(in, base, instancename)) {
+        base->setName(instancename);
+      }
     }
   }
 
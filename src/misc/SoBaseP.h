@@ -33,7 +33,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 \**************************************************************************/
 
-#include "misc/SbHash.h"
+#include "misc/SbFlatHash.h"
 
 class SoBase;
 class SoNode;
@@ -47,7 +47,7 @@ class SoInput;
 
 // FIXME: should implement and use a proper set-abstraction
 // datatype. 20050524 mortene.
-typedef SbHash<const SoBase *, void *> SoBaseSet;
+typedef SbFlatHash<const SoBase *, void *> SoBaseSet;
 
 class SoBase::PImpl {
 public:
@@ -68,9 +68,9 @@ public:
   static void * auditor_mutex;
   static void * global_mutex;
 
-  static SbHash<const SoBase *, SoAuditorList *> * auditordict;
-  static SbHash<const char *, SbPList *> * name2obj;
-  static SbHash<const SoBase *, const char *> * obj2name;
+  static SbFlatHash<const SoBase *, SoAuditorList *> * auditordict;
+  static SbFlatHash<const char *, SbPList *> * name2obj;
+  static SbFlatHash<const SoBase *, const char *> * obj2name;
 
   static SbBool trackbaseobjects;
   static void * allbaseobj_mutex;
@@ -112,6 +112,10 @@
 #include "shaders/SoShader.h"
 #include "tidbitsp.h"
 #include "fields/SoGlobalField.h"
+#include "io/SoFileCache.h"
+#include "io/SoInputP.h"
+#include "io/SoInput_FileInfo.h"
+#include "io/SoSceneCache.h"
 #include "misc/CoinStaticObjectInDLL.h"
 #include "misc/systemsanity.icc"
 #include "misc/SoDBP.h"
@@ -304,6 +308,7 @@ SoDB::init(void)
 
   CoinResources::init();
   SoInput::init();
+  SoFileCache::initClass();
   SoBase::initClass();
   SoDetail::initClass();
   // SoPath inherits SoBase, so initialize it after SoBase.
@@ -357,6 +362,9 @@ SoDB::init(void)
                        NULL, NULL, NULL);
   SoDB::registerHeader(SbString("#Inventor V2.1 binary  "), TRUE, 2.1f,
                        NULL, NULL, NULL);
+  // See SoOutput::setSceneCacheFormat().
+  SoDB::registerHeader(SbString(SoSceneCache::getHeaderString()), TRUE, 2.1f,
+                       NULL, NULL, NULL);
 
   // FIXME: this is really only valid if the HAVE_VRML97 define is in
   // place. If it is not, we should register the header in a way so
@@ -584,6 +592,18 @@ SoDB::read(SoInput * in, SoBase *& base)
   if (!valid) {
     return FALSE;
   }
+
+  if (SoSceneCache::isSceneCache(in)) {
+    // the whole scene is read in one go, so we're at the end of the
+    // file the next time around
+    if (in->eof()) {
+      base = NULL;
+      return TRUE;
+    }
+    base = SoSceneCache::read(in);
+    in->getTopOfStack()->setEndOfFile();
+    return (base != NULL);
+  }
   return SoBase::read(in, base, SoBase::getClassTypeId());
 }
 
@@ -669,6 +689,11 @@ SoDB::read(SoInput * in, SoNode *& rootnode)
 
   Returns \c NULL on any error.
 
+  When more than one parse thread has been set up with
+  SoInput::setNumParseThreads(), files with many nodes at the top
+  level, or with a single root group with many children, are read in
+  pieces, see SoInput::setNumParseThreads().
+
   Tip: a common operation to do after importing a scene graph is to
   pick out the memory pointers to one or more of the imported nodes
   for further handling. This can be accomplished by using either the
@@ -1170,6 +1195,86 @@ SoDB::endNotify(void)
 
 }
 
+/*!
+  Starts a notification transaction, for doing many field changes
+  with only one round of notification.
+
+  Until the matching endTransaction() call, changing the value of a
+  field which is part of a node or an engine will not notify the
+  field's auditors and container. The changed fields are instead
+  recorded, each one only once, and notified at the end of the
+  transaction. Each node is then passed only once, so parent groups,
+  caches and node sensors are notified once, no matter how many of
+  its fields were changed or how many times.
+
+  \code
+  SoDB::startTransaction();
+  for (int i = 0; i < num; i++) coords->point.set1Value(i, points[i]);
+  material->diffuseColor.setValue(color);
+  SoDB::endTransaction();
+  \endcode
+
+  Transactions can be nested, in which case the notifications are
+  delivered at the end of the outermost transaction. Structural
+  changes, like adding children to a group, are still notified right
+  away.
+
+  Note that fields and engines connected from a changed field are not
+  updated until the end of the transaction either, so reading them
+  within the transaction gives their old values.
+
+  \sa endTransaction(), isInTransaction()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoDB::startTransaction(void)
+{
+#ifdef COIN_THREADSAFE
+  (void) cc_recmutex_internal_notify_lock();
+#endif // COIN_THREADSAFE
+  SoDBP::transactioncounter++;
+}
+
+/*!
+  Returns \c TRUE if a notification transaction is open.
+
+  \sa startTransaction()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+SbBool
+SoDB::isInTransaction(void)
+{
+  return SoDBP::transactioncounter > 0;
+}
+
+/*!
+  Ends a notification transaction. If this was the outermost
+  transaction, the fields changed since startTransaction() are
+  notified.
+
+  \sa startTransaction()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoDB::endTransaction(void)
+{
+  assert(SoDBP::transactioncounter > 0);
+  SoDBP::transactioncounter--;
+  if (SoDBP::transactioncounter == 0) SoDBP::commitTransaction();
+#ifdef COIN_THREADSAFE
+  (void) cc_recmutex_internal_notify_unlock();
+#endif // COIN_THREADSAFE
+}
+
 /*!
   Turn on or off the real time sensor.
 
@@ -1240,18 +1345,45 @@ SoDB::readAllWrapper(SoInput * in, const SoType & grouptype)
     return NULL;
   }
 
+  if (SoSceneCache::isSceneCache(in)) {
+    SoSeparator * cacheroot = SoSceneCache::read(in);
+    in->getTopOfStack()->setEndOfFile();
+    in->popFile();
+    if (cacheroot == NULL) { return NULL; }
+
+    if (!cacheroot->isOfType(grouptype)) {
+      SoGroup * root = (SoGroup *)grouptype.createInstance();
+      root->addChild(cacheroot);
+      return root;
+    }
+    return cacheroot;
+  }
+
   const int stackdepth = in->filestack.getLength();
 
   SoGroup * root = (SoGroup *)grouptype.createInstance();
-  SoNode * topnode;
-  do {
-    if (!SoDB::read(in, topnode)) {
-      root->ref();
-      root->unref();
-      return NULL;
-    }
-    if (topnode) { root->addChild(topnode); }
-  } while (topnode && in->skipWhiteSpace());
+
+  // With more than one parse thread, files with many top-level nodes
+  // (or a root group with many children) are read in pieces.
+  const SoInputP::ParallelReadResult parallel =
+    SoInputP::readAllInParallel(in, root);
+  if (parallel == SoInputP::PARALLEL_READ_FAILED) {
+    root->ref();
+    root->unref();
+    return NULL;
+  }
+
+  if (parallel == SoInputP::PARALLEL_READ_SKIPPED) {
+    SoNode * topnode;
+    do {
+      if (!SoDB::read(in, topnode)) {
+        root->ref();
+        root->unref();
+        return NULL;
+      }
+      if (topnode) { root->addChild(topnode); }
+    } while (topnode && in->skipWhiteSpace());
+  }
 
   if (!in->eof()) {
     // All  characters  may not  have  been  read  from the  current
@@ -1896,4 +2028,168 @@ BOOST_AUTO_TEST_CASE(globalfield_import)
 
 // *************************************************************************
 
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoMaterial.h>
+#include <Inventor/sensors/SoFieldSensor.h>
+#include <Inventor/sensors/SoNodeSensor.h>
+
+static void
+sodb_count_cb(void * data, SoSensor *)
+{
+  (*static_cast<int *>(data))++;
+}
+
+BOOST_AUTO_TEST_CASE(transaction)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  SoMaterial * material = new SoMaterial;
+  root->addChild(coords);
+  root->addChild(material);
+
+  // immediate sensors, which trigger at the end of each notification
+  int rootcount = 0, fieldcount = 0;
+  SoNodeSensor rootsensor(sodb_count_cb, &rootcount);
+  rootsensor.setPriority(0);
+  rootsensor.attach(root);
+  SoFieldSensor fieldsensor(sodb_count_cb, &fieldcount);
+  fieldsensor.setPriority(0);
+  fieldsensor.attach(&coords->point);
+
+  const SbUniqueId rootid = root->getNodeId();
+  const int num = 1000;
+  SoDB::startTransaction();
+  BOOST_CHECK(SoDB::isInTransaction());
+  for (int i = 0; i < num; i++) {
+    coords->point.set1Value(i, SbVec3f(float(i), 0.0f, 0.0f));
+    SoDB::startTransaction(); // nested
+    material->transparency.setValue(float(i) / float(num));
+    SoDB::endTransaction();
+  }
+  // a node which is destructed before the end of the transaction
+  SoMaterial * tmp = new SoMaterial;
+  tmp->ref();
+  tmp->diffuseColor.setValue(1.0f, 0.0f, 0.0f);
+  tmp->unref();
+
+  BOOST_CHECK_EQUAL(rootcount, 0);
+  BOOST_CHECK_EQUAL(fieldcount, 0);
+  BOOST_CHECK_MESSAGE(root->getNodeId() == rootid,
+                      "Node notified within a transaction");
+  SoDB::endTransaction();
+  BOOST_CHECK(!SoDB::isInTransaction());
+
+  BOOST_CHECK_EQUAL(rootcount, 1);
+  BOOST_CHECK_EQUAL(fieldcount, 1);
+  BOOST_CHECK_MESSAGE(root->getNodeId() != rootid,
+                      "Node not notified at the end of the transaction");
+  BOOST_CHECK_EQUAL(coords->point.getNum(), num);
+  BOOST_CHECK_EQUAL(coords->point[num - 1][0], float(num - 1));
+
+  // without a transaction, every change is notified
+  coords->point.set1Value(0, SbVec3f(1.0f, 1.0f, 1.0f));
+  coords->point.set1Value(1, SbVec3f(1.0f, 1.0f, 1.0f));
+  BOOST_CHECK_EQUAL(rootcount, 3);
+  BOOST_CHECK_EQUAL(fieldcount, 3);
+
+  rootsensor.detach();
+  fieldsensor.detach();
+  root->unref();
+}
+
+// *************************************************************************
+
+#include <cstdlib>
+#include <Inventor/SoOutput.h>
+#include <Inventor/actions/SoWriteAction.h>
+
+// Files are only read in pieces in thread safe builds, so the test
+// would compare two serial reads in other builds.
+#ifdef COIN_THREADSAFE
+
+static SbString
+sodb_write(SoNode * root)
+{
+  SoOutput out;
+  out.setBuffer(malloc(1024), 1024, realloc);
+  SoWriteAction wa(&out);
+  wa.apply(root);
+  void * buf;
+  size_t size;
+  out.getBuffer(buf, size);
+  SbString s(static_cast<const char *>(buf), 0, int(size) - 1);
+  free(buf);
+  return s;
+}
+
+// Reads the scene serially and in pieces, and checks that the scene
+// graphs and the last node named "Item" are the same.
+static void
+sodb_check_pieces(const SbString & scene, const SbBool vrml, const int lastitem)
+{
+  SoGroup * roots[2];
+  SoNode * items[2];
+  for (int i = 0; i < 2; i++) {
+    SoInput in;
+    in.setBuffer(scene.getString(), scene.getLength());
+    in.setNumParseThreads(i == 0 ? 1 : 4);
+    roots[i] = vrml ? (SoGroup *) SoDB::readAllVRML(&in) : SoDB::readAll(&in);
+    BOOST_REQUIRE(roots[i] != NULL);
+    roots[i]->ref();
+    items[i] = SoNode::getByName("Item");
+  }
+  BOOST_CHECK(sodb_write(roots[0]) == sodb_write(roots[1]));
+  for (int i = 0; i < 2; i++) {
+    SoGroup * parent = static_cast<SoGroup *>(roots[i]->getChild(lastitem));
+    BOOST_CHECK(items[i] == parent->getChild(0));
+    roots[i]->unref();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(readAllInPieces)
+{
+  const int num = 2000;
+  SbString scene("#Inventor V2.1 ascii\n\n"
+                 "DEF Root Separator {\n"
+                 "  renderCaching OFF # not { a child\n"
+                 "  DEF Near0 Material { diffuseColor 1 0 0 }\n");
+  SbString line;
+  int lastitem = 0;
+  for (int i = 1; i < num; i++) {
+    if (i % 100 == 0) {
+      line.sprintf("  Separator { DEF Item Cube { width %d } }\n", i);
+      lastitem = i;
+    }
+    else if (i % 100 == 50) {
+      line.sprintf("  Separator { DEF Near%d Sphere { radius %d } }\n", i, i);
+    }
+    else if ((i % 100 == 51) || (i == 1)) {
+      line.sprintf("  Separator { USE Near%d Info { string \"} [ \\\" #\" } }\n", i - 1);
+    }
+    else {
+      line.sprintf("  Separator { Translation { translation %d 0 0 } Cube { } }\n", i);
+    }
+    scene += line;
+  }
+  scene += "}\n";
+  sodb_check_pieces(scene, FALSE, lastitem);
+
+  // the same at the top level of a VRML file
+  scene = "#VRML V2.0 utf8\n\n";
+  for (int i = 0; i < num; i++) {
+    if (i % 100 == 0) {
+      line.sprintf("Transform { children DEF Item Shape { geometry Box { size %d 1 1 } } }\n", i);
+      lastitem = i;
+    }
+    else {
+      line.sprintf("Transform { translation %d 0 0, children [ Shape { } ] }\n", i);
+    }
+    scene += line;
+  }
+  sodb_check_pieces(scene, TRUE, lastitem);
+}
+
+#endif // COIN_THREADSAFE
+
 #endif // COIN_TEST_SUITE
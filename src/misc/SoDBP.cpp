@@ -5,6 +5,7 @@
 #include <Inventor/fields/SoField.h>
 #include <Inventor/fields/SoSFTime.h>
 #include <Inventor/errors/SoDebugError.h>
+#include <Inventor/misc/SoNotification.h>
 #include <Inventor/sensors/SoTimerSensor.h>
 
 #ifdef HAVE_CONFIG_H
@@ -22,6 +23,7 @@
 // need to include SbRWMutex.h to make C++ call the actual destructor,
 // and not just default destructor
 #include <Inventor/threads/SbRWMutex.h>
+#include "threads/recmutexp.h"
 SbRWMutex * SoDBP::globalmutex = NULL;
 #endif // COIN_THREADSAFE
 SbList<SoDB_HeaderInfo *> * SoDBP::headerlist = NULL;
@@ -30,6 +32,9 @@ SoTimerSensor * SoDBP::globaltimersensor = NULL;
 UInt32ToInt16Map * SoDBP::converters = NULL;
 SbBool SoDBP::isinitialized = FALSE;
 int SoDBP::notificationcounter = 0;
+int SoDBP::transactioncounter = 0;
+SbList<SoField *> * SoDBP::transactionfields = NULL;
+FieldToIndexMap * SoDBP::transactiondict = NULL;
 SbList<SoDBP::ProgressCallbackInfo> * SoDBP::progresscblist = NULL;
 
 // *************************************************************************
@@ -124,6 +129,10 @@ SoDBP::clean(void)
   SoDBP::globaltimersensor = NULL;
   delete SoDBP::converters;
   SoDBP::converters = NULL;
+  delete SoDBP::transactionfields;
+  SoDBP::transactionfields = NULL;
+  delete SoDBP::transactiondict;
+  SoDBP::transactiondict = NULL;
 
   delete SoDBP::sensormanager;
   SoDBP::sensormanager = NULL;
@@ -166,6 +175,78 @@ SoDBP::updateRealTimeFieldCB(void * COIN_UNUSED_ARG(data), SoSensor * COIN_UNUSE
   }
 }
 
+// Called from SoField::startNotify() instead of notifying, when a
+// transaction may be open. Each field is only stored once. Returns
+// FALSE if there is no open transaction, and the field must notify
+// right away.
+//
+// The thread with the open transaction holds the notification lock
+// until the transaction ends, so the transaction state is only read
+// and changed under that lock.
+SbBool
+SoDBP::deferNotification(SoField * field)
+{
+#ifdef COIN_THREADSAFE
+  (void) cc_recmutex_internal_notify_lock();
+#endif // COIN_THREADSAFE
+  const SbBool defer = SoDBP::transactioncounter > 0;
+  if (defer) {
+    if (SoDBP::transactionfields == NULL) {
+      SoDBP::transactionfields = new SbList<SoField *>;
+      SoDBP::transactiondict = new FieldToIndexMap;
+    }
+    if (SoDBP::transactiondict->put(field, SoDBP::transactionfields->getLength())) {
+      SoDBP::transactionfields->append(field);
+    }
+  }
+#ifdef COIN_THREADSAFE
+  (void) cc_recmutex_internal_notify_unlock();
+#endif // COIN_THREADSAFE
+  return defer;
+}
+
+// Called when a field is destructed within a transaction, so that it
+// is not notified at commit.
+void
+SoDBP::removeDeferredNotification(const SoField * field)
+{
+#ifdef COIN_THREADSAFE
+  (void) cc_recmutex_internal_notify_lock();
+#endif // COIN_THREADSAFE
+  int idx;
+  if (SoDBP::transactiondict && SoDBP::transactiondict->get(field, idx)) {
+    (*SoDBP::transactionfields)[idx] = NULL;
+    (void)SoDBP::transactiondict->erase(field);
+  }
+#ifdef COIN_THREADSAFE
+  (void) cc_recmutex_internal_notify_unlock();
+#endif // COIN_THREADSAFE
+}
+
+// Delivers the notifications held back by the transaction which just
+// ended, as one notification sequence.
+void
+SoDBP::commitTransaction(void)
+{
+  if (SoDBP::transactionfields == NULL ||
+      SoDBP::transactionfields->getLength() == 0) return;
+
+  SbList<SoField *> fields(*SoDBP::transactionfields);
+  SoDBP::transactionfields->truncate(0);
+  SoDBP::transactiondict->clear();
+
+  SoDB::startNotify();
+  // All the lists share one time stamp, so that SoNode::notify()
+  // passes each node, and its parents, only once.
+  SoNotList stamp;
+  for (int i = 0; i < fields.getLength(); i++) {
+    if (fields[i] == NULL) continue;
+    SoNotList l(&stamp);
+    fields[i]->notify(&l);
+  }
+  SoDB::endNotify();
+}
+
 SbBool
 SoDBP::is3dsFile(SoInput * in)
 {
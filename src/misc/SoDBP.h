@@ -44,9 +44,10 @@
 #include <Inventor/SoDB.h>
 #include <Inventor/SbString.h>
 
-#include "misc/SbHash.h"
+#include "misc/SbFlatHash.h"
 
 class SoSensor;
+class SoField;
 class SbRWMutex;
 
 // *************************************************************************
@@ -66,7 +67,8 @@ public:
   void * userdata;
 };
 
-typedef SbHash<uint32_t, int16_t> UInt32ToInt16Map;
+typedef SbFlatHash<uint32_t, int16_t> UInt32ToInt16Map;
+typedef SbFlatHash<const SoField *, int> FieldToIndexMap;
 
 // *************************************************************************
 
@@ -94,6 +96,16 @@ public:
   static int notificationcounter;
   static SbBool isinitialized;
 
+  // fields changed within a transaction, in the order they were
+  // first changed, and their index in that list
+  static int transactioncounter;
+  static SbList<SoField *> * transactionfields;
+  static FieldToIndexMap * transactiondict;
+
+  static SbBool deferNotification(SoField * field);
+  static void removeDeferredNotification(const SoField * field);
+  static void commitTransaction(void);
+
   static SbBool is3dsFile(SoInput * in);
   static SoSeparator * read3DSFile(SoInput * in);
 
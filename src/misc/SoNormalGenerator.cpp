@@ -36,18 +36,144 @@
 
   \ingroup coin_general
 
+  Polygons are either added one vertex at a time, with
+  polygonVertex(), or all at once from an indexed face set, with
+  setIndexedFaces(). In the first case, vertices at the same position
+  are welded together to find which faces share a vertex. In the
+  second case, faces share a vertex when they use the same coordinate
+  index, which is a lot faster for large models.
+
   FIXME: document properly
 */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
 #include <Inventor/misc/SoNormalGenerator.h>
 
 #include <cstdio>
 
 #include <Inventor/errors/SoDebugError.h>
 
+#ifdef HAVE_THREADS
+#include <Inventor/C/threads/wpool.h>
+#endif // HAVE_THREADS
+
 #include "tidbitsp.h"
 #include "coindefs.h" // COIN_OBSOLETED()
 
+// *************************************************************************
+
+// Each worker thread gets at least this many faces or vertices.
+static const int SONORMALGENERATOR_MIN_PER_THREAD = 16384;
+
+static int sonormalgenerator_numthreads = 1;
+
+namespace {
+
+// A range of faces or vertices for one worker thread.
+class SoNormalGeneratorJob {
+public:
+  int start, end;
+
+  const SbVec3f * coords;
+  const int * vertexlist;
+  const int * vertexface;
+  // the first vertex of each face, for face normals
+  const int * facestart;
+  SbBool ccw;
+
+  // the faces of each point, for vertex normals
+  const SbVec3f * facenormals;
+  const int * pointstart;
+  const int * pointfaces;
+  float threshold;
+
+  SbVec3f * result;
+};
+
+} // namespace
+
+// Splits [0, num) in ranges of at least SONORMALGENERATOR_MIN_PER_THREAD
+// items, one per thread, and runs func on them.
+static void
+sonormalgenerator_run(SoNormalGeneratorJob & common, const int num,
+                      void (*func)(void *))
+{
+  int numjobs = SbMin(sonormalgenerator_numthreads,
+                      num / SONORMALGENERATOR_MIN_PER_THREAD);
+  if (numjobs < 1) numjobs = 1;
+
+  SoNormalGeneratorJob * jobs = new SoNormalGeneratorJob[numjobs];
+  for (int i = 0; i < numjobs; i++) {
+    jobs[i] = common;
+    jobs[i].start = int((long long)(num) * i / numjobs);
+    jobs[i].end = int((long long)(num) * (i + 1) / numjobs);
+  }
+#ifdef HAVE_THREADS
+  if (numjobs > 1) {
+    cc_wpool * pool = cc_wpool_construct(numjobs);
+    cc_wpool_begin(pool, numjobs);
+    for (int i = 0; i < numjobs; i++) {
+      cc_wpool_start_worker(pool, func, &jobs[i]);
+    }
+    cc_wpool_end(pool);
+    cc_wpool_wait_all(pool);
+    cc_wpool_destruct(pool);
+    numjobs = 0;
+  }
+#endif // HAVE_THREADS
+  for (int i = 0; i < numjobs; i++) { func(&jobs[i]); }
+  delete[] jobs;
+}
+
+// Calculates the normal of an indexed face the same way as
+// SoNormalCache::generatePerFace(). Faces with less than three
+// vertices, or with no area, get a null normal, so that they don't
+// influence the smoothing. normalize() leaves a null vector as it is.
+static SbVec3f
+sonormalgenerator_face_normal(const SbVec3f * coords, const int * cind,
+                              const int num, const SbBool ccw)
+{
+  SbVec3f ret(0.0f, 0.0f, 0.0f);
+  if (num < 3) return ret;
+
+  if (num == 3) { // triangle
+    const SbVec3f v0 = coords[cind[0]] - coords[cind[1]];
+    const SbVec3f v1 = coords[cind[2]] - coords[cind[1]];
+    if (!ccw) { ret = v0.cross(v1); }
+    else { ret = v1.cross(v0); }
+  }
+  else {
+    // Newell's method
+    const SbVec3f * vert1, * vert2;
+    vert2 = coords + cind[0];
+    for (int i = 1; i <= num; i++) {
+      vert1 = vert2;
+      vert2 = coords + cind[i < num ? i : 0];
+      ret[0] += ((*vert1)[1] - (*vert2)[1]) * ((*vert1)[2] + (*vert2)[2]);
+      ret[1] += ((*vert1)[2] - (*vert2)[2]) * ((*vert1)[0] + (*vert2)[0]);
+      ret[2] += ((*vert1)[0] - (*vert2)[0]) * ((*vert1)[1] + (*vert2)[1]);
+    }
+    if (!ccw) ret = -ret;
+  }
+  (void) ret.normalize();
+  return ret;
+}
+
+static void
+sonormalgenerator_face_normals(void * closure)
+{
+  const SoNormalGeneratorJob * job = static_cast<SoNormalGeneratorJob *>(closure);
+  for (int i = job->start; i < job->end; i++) {
+    const int start = job->facestart[i];
+    job->result[i] =
+      sonormalgenerator_face_normal(job->coords, job->vertexlist + start,
+                                    job->facestart[i + 1] - start, job->ccw);
+  }
+}
+
 /*!
   Constructor with \a isccw indicating if polygons are specified
   in counterclockwise order. The \a approxVertices can be used
@@ -159,24 +285,89 @@ SoNormalGenerator::quad(const SbVec3f &v0,
   this->endPolygon();
 }
 
+/*!
+  Adds all the faces of an indexed face set, replacing any polygons
+  added earlier. \a coordindex holds \a numindices indices into \a
+  coords, with each face ended by an index outside [0, \a numcoords),
+  usually -1, as in the SoIndexedFaceSet::coordIndex field.
+
+  Faces which use the same coordinate index share that vertex when
+  normals are generated, so vertices are not welded by position as
+  with polygonVertex(). Normals generated with generate() follow the
+  order of the valid indices in \a coordindex. The arrays are not
+  used after this call returns.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa setNumThreads()
+  \since Coin 4.0
+*/
+void
+SoNormalGenerator::setIndexedFaces(const SbVec3f * coords,
+                                   const int numcoords,
+                                   const int32_t * coordindex,
+                                   const int numindices)
+{
+  this->bsp.clear();
+  this->vertexList.truncate(0);
+  this->vertexFace.truncate(0);
+  this->faceNormals.truncate(0);
+  this->vertexNormals.truncate(0);
+
+  this->vertexList.ensureCapacity(numindices);
+  this->vertexFace.ensureCapacity(numindices);
+  SbList <int> facestart;
+  facestart.append(0);
+  int numfaces = 0;
+  for (int i = 0; i < numindices; i++) {
+    const int32_t idx = coordindex[i];
+    if (idx >= 0 && idx < numcoords) {
+      this->vertexList.append(idx);
+      this->vertexFace.append(numfaces);
+    }
+    else { // end of face
+      facestart.append(this->vertexList.getLength());
+      numfaces++;
+    }
+  }
+  // a last face without an end index
+  if (this->vertexList.getLength() > facestart[numfaces]) {
+    facestart.append(this->vertexList.getLength());
+    numfaces++;
+  }
+
+  this->faceNormals.ensureCapacity(numfaces);
+  for (int f = 0; f < numfaces; f++) {
+    this->faceNormals.append(SbVec3f(0.0f, 0.0f, 0.0f));
+  }
+  if (numfaces == 0) return;
+
+  SoNormalGeneratorJob job;
+  job.coords = coords;
+  job.vertexlist = this->vertexList.getArrayPtr();
+  job.facestart = facestart.getArrayPtr();
+  job.ccw = this->ccw;
+  job.result = &this->faceNormals[0];
+  sonormalgenerator_run(job, numfaces, sonormalgenerator_face_normals);
+}
+
 //
 // calculates the normal vector for a vertex, based on the
 // normal vectors of all incident faces
 //
 static void
 calc_normal_vec(const SbVec3f *facenormals, const int facenum,
-                SbList <int32_t> &faceArray, const float threshold,
-                SbVec3f &vertnormal)
+                const int * faces, const int numfaces,
+                const float threshold, SbVec3f &vertnormal)
 {
   // start with face normal vector
   const SbVec3f * facenormal = &facenormals[facenum];
   vertnormal = *facenormal;
 
-  int n = faceArray.getLength();
   int currface;
 
-  for (int i = 0; i < n; i++) {
-    currface = faceArray[i];
+  for (int i = 0; i < numfaces; i++) {
+    currface = faces[i];
     if (currface != facenum) { // check all but this face
       const SbVec3f &normal = facenormals[currface];
       if ((normal.dot(*facenormal)) > threshold) {
@@ -187,6 +378,28 @@ calc_normal_vec(const SbVec3f *facenormals, const int facenum,
   }
 }
 
+static void
+sonormalgenerator_vertex_normal(const SoNormalGeneratorJob * job, const int i,
+                                SbVec3f & vertnormal)
+{
+  const int point = job->vertexlist[i];
+  const int start = job->pointstart[point];
+  calc_normal_vec(job->facenormals, job->vertexface[i],
+                  job->pointfaces + start,
+                  job->pointstart[point + 1] - start,
+                  job->threshold, vertnormal);
+  (void) vertnormal.normalize();
+}
+
+static void
+sonormalgenerator_vertex_normals(void * closure)
+{
+  const SoNormalGeneratorJob * job = static_cast<SoNormalGeneratorJob *>(closure);
+  for (int i = job->start; i < job->end; i++) {
+    sonormalgenerator_vertex_normal(job, i, job->result[i]);
+  }
+}
+
 /*!
   Triggers the normal generation. Normals are generated using
   \a creaseAngle to find which edges should be flat-shaded
@@ -212,34 +425,47 @@ SoNormalGenerator::generate(const float creaseAngle,
   // longer triangle strips).
 
   int i;
+  const int numvi = this->vertexList.getLength();
+  // the points are either welded in bsp or indices given to
+  // setIndexedFaces(), and only those in vertexList matter
+  int numpoints = 0;
+  for (i = 0; i < numvi; i++) {
+    if (this->vertexList[i] >= numpoints) numpoints = this->vertexList[i] + 1;
+  }
 
-  // for each vertex, store all faceindices the vertex is a part of
-  SbList <int32_t> * vertexFaceArray = new SbList<int32_t>[bsp.numPoints()];
-
-  int numvi = this->vertexList.getLength();
+  // for each point, the indices of the faces the point is a part of,
+  // stored after each other in one array
+  int * pointstart = new int[numpoints + 1];
+  for (i = 0; i <= numpoints; i++) pointstart[i] = 0;
+  for (i = 0; i < numvi; i++) pointstart[this->vertexList[i] + 1]++;
+  for (i = 0; i < numpoints; i++) pointstart[i + 1] += pointstart[i];
 
+  int * pointfaces = new int[numvi > 0 ? numvi : 1];
+  int * fill = new int[numpoints > 0 ? numpoints : 1];
+  for (i = 0; i < numpoints; i++) fill[i] = pointstart[i];
   for (i = 0; i < numvi; i++) {
-    vertexFaceArray[vertexList[i]].append(this->vertexFace[i]);
+    pointfaces[fill[this->vertexList[i]]++] = this->vertexFace[i];
   }
+  delete[] fill;
 
   float threshold = (float)cos(SbClamp(creaseAngle, 0.0f, (float) M_PI));
 
+  SoNormalGeneratorJob job;
+  job.facenormals = this->faceNormals.getArrayPtr();
+  job.vertexlist = this->vertexList.getArrayPtr();
+  job.vertexface = this->vertexFace.getArrayPtr();
+  job.pointstart = pointstart;
+  job.pointfaces = pointfaces;
+  job.threshold = threshold;
+
   if (striplens) {
     i = 0;
     for (int j = 0; j < numstrips; j++) {
       assert(i+2 < numvi);
       SbVec3f tmpvec;
-      calc_normal_vec(this->faceNormals.getArrayPtr(),
-                      this->vertexFace[i],
-                      vertexFaceArray[vertexList[i]],
-                      threshold, tmpvec);
-      (void) tmpvec.normalize();
+      sonormalgenerator_vertex_normal(&job, i, tmpvec);
       this->vertexNormals.append(tmpvec);
-      calc_normal_vec(this->faceNormals.getArrayPtr(),
-                      this->vertexFace[i+1],
-                      vertexFaceArray[vertexList[i+1]],
-                      threshold, tmpvec);
-      (void) tmpvec.normalize();
+      sonormalgenerator_vertex_normal(&job, i+1, tmpvec);
       this->vertexNormals.append(tmpvec);
 
       int num = striplens[j] - 2;
@@ -247,28 +473,25 @@ SoNormalGenerator::generate(const float creaseAngle,
       while (num--) {
         i += 2;
         assert(i < numvi);
-        calc_normal_vec(this->faceNormals.getArrayPtr(),
-                        this->vertexFace[i],
-                        vertexFaceArray[vertexList[i]],
-                        threshold, tmpvec);
-        (void) tmpvec.normalize();
+        sonormalgenerator_vertex_normal(&job, i, tmpvec);
         this->vertexNormals.append(tmpvec);
         i++;
       }
     }
   }
   else {
+    const int first = this->vertexNormals.getLength();
+    this->vertexNormals.ensureCapacity(first + numvi);
     for (i = 0; i < numvi; i++) {
-      SbVec3f tmpvec;
-      calc_normal_vec(this->faceNormals.getArrayPtr(),
-                      this->vertexFace[i],
-                      vertexFaceArray[vertexList[i]],
-                      threshold, tmpvec);
-      (void) tmpvec.normalize();
-      this->vertexNormals.append(tmpvec);
+      this->vertexNormals.append(SbVec3f(0.0f, 0.0f, 0.0f));
+    }
+    if (numvi > 0) {
+      job.result = &this->vertexNormals[first];
+      sonormalgenerator_run(job, numvi, sonormalgenerator_vertex_normals);
     }
   }
-  delete [] vertexFaceArray;
+  delete[] pointstart;
+  delete[] pointfaces;
   this->vertexFace.truncate(0, TRUE);
   this->vertexList.truncate(0, TRUE);
   this->faceNormals.truncate(0, TRUE);
@@ -395,6 +618,44 @@ SoNormalGenerator::setNormal(const int32_t /* index */,
   COIN_OBSOLETED();
 }
 
+/*!
+  Sets the number of threads used to calculate face and vertex
+  normals for large models. The default is 1, which calculates all
+  normals in the calling thread.
+
+  The setting is global, and is also used when SoNormalCache
+  generates normals for vertex shapes like SoIndexedFaceSet,
+  SoVRMLIndexedFaceSet and SoVRMLElevationGrid. Face normals are only
+  calculated in parallel for faces added with setIndexedFaces(), and
+  vertex normals for anything but triangle strips. Each thread gets at
+  least 16384 faces or vertices, and the normals are the same for any
+  number of threads.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa getNumThreads()
+  \since Coin 4.0
+*/
+void
+SoNormalGenerator::setNumThreads(const int numthreads)
+{
+  sonormalgenerator_numthreads = SbMax(numthreads, 1);
+}
+
+/*!
+  Returns the number of threads used to calculate normals.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa setNumThreads()
+  \since Coin 4.0
+*/
+int
+SoNormalGenerator::getNumThreads(void)
+{
+  return sonormalgenerator_numthreads;
+}
+
 //
 // Calculates the face normal to the current face.
 //
@@ -452,3 +713,105 @@ SoNormalGenerator::calcFaceNormal(void)
   }
   return ret;
 }
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/misc/SoNormalGenerator.h>
+
+// A grid of (n+1) x (n+1) points with bumpy heights, as quads.
+static void
+make_grid(const int n, SbList <SbVec3f> & coords, SbList <int32_t> & indices)
+{
+  for (int z = 0; z <= n; z++) {
+    for (int x = 0; x <= n; x++) {
+      const float y = float(((x * 7) ^ (z * 13)) % 5) * 0.25f;
+      coords.append(SbVec3f(float(x), y, float(z)));
+    }
+  }
+  for (int z = 0; z < n; z++) {
+    for (int x = 0; x < n; x++) {
+      const int32_t idx = z * (n + 1) + x;
+      indices.append(idx + n + 1);
+      indices.append(idx + n + 2);
+      indices.append(idx + 1);
+      indices.append(idx);
+      indices.append(-1);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(indexedCube)
+{
+  static const SbVec3f coords[] = {
+    SbVec3f(0, 0, 0), SbVec3f(1, 0, 0), SbVec3f(1, 1, 0), SbVec3f(0, 1, 0),
+    SbVec3f(0, 0, 1), SbVec3f(1, 0, 1), SbVec3f(1, 1, 1), SbVec3f(0, 1, 1)
+  };
+  static const int32_t indices[] = {
+    0, 3, 2, 1, -1,  4, 5, 6, 7, -1,  0, 1, 5, 4, -1,
+    2, 3, 7, 6, -1,  0, 4, 7, 3, -1,  1, 2, 6, 5
+  };
+  const int numindices = sizeof(indices) / sizeof(indices[0]);
+
+  SoNormalGenerator generator(TRUE);
+  generator.setIndexedFaces(coords, 8, indices, numindices);
+  generator.generate(0.5f);
+  BOOST_REQUIRE(generator.getNumNormals() == 24);
+  // flat shaded, all vertices of the bottom face point down
+  for (int i = 0; i < 4; i++) {
+    BOOST_CHECK_MESSAGE(generator.getNormal(i).equals(SbVec3f(0, 0, -1), 1e-6f),
+                        "Wrong normal for a sharp edge");
+  }
+
+  generator.reset(TRUE);
+  generator.setIndexedFaces(coords, 8, indices, numindices);
+  generator.generate(float(M_PI));
+  BOOST_REQUIRE(generator.getNumNormals() == 24);
+  // smooth shaded, the first vertex is at the origin corner
+  SbVec3f corner(-1, -1, -1);
+  corner.normalize();
+  BOOST_CHECK_MESSAGE(generator.getNormal(0).equals(corner, 1e-6f),
+                      "Wrong normal for a smooth corner");
+}
+
+BOOST_AUTO_TEST_CASE(indexedSameAsWelded)
+{
+  SbList <SbVec3f> coords;
+  SbList <int32_t> indices;
+  // more than two threads' worth of faces, so face normals are
+  // calculated in parallel too
+  make_grid(200, coords, indices);
+
+  // vertices welded by position
+  SoNormalGenerator welded(TRUE);
+  for (int i = 0; i < indices.getLength(); i++) {
+    if (i == 0 || indices[i-1] < 0) welded.beginPolygon();
+    if (indices[i] < 0) welded.endPolygon();
+    else welded.polygonVertex(coords[indices[i]]);
+  }
+  welded.generate(0.8f);
+
+  SbList <SbVec3f> normals[2];
+  for (int t = 0; t < 2; t++) {
+    SoNormalGenerator::setNumThreads(t == 0 ? 1 : 4);
+    SoNormalGenerator indexed(TRUE);
+    indexed.setIndexedFaces(coords.getArrayPtr(), coords.getLength(),
+                            indices.getArrayPtr(), indices.getLength());
+    indexed.generate(0.8f);
+    for (int i = 0; i < indexed.getNumNormals(); i++) {
+      normals[t].append(indexed.getNormal(i));
+    }
+  }
+  SoNormalGenerator::setNumThreads(1);
+
+  BOOST_REQUIRE(normals[0].getLength() == welded.getNumNormals());
+  BOOST_REQUIRE(normals[1].getLength() == welded.getNumNormals());
+  int differ = 0, threaddiffer = 0;
+  for (int i = 0; i < normals[0].getLength(); i++) {
+    if (!normals[0][i].equals(welded.getNormal(i), 1e-5f)) differ++;
+    if (normals[0][i] != normals[1][i]) threaddiffer++;
+  }
+  BOOST_CHECK_MESSAGE(differ == 0, "Indexed normals differ from welded normals");
+  BOOST_CHECK_MESSAGE(threaddiffer == 0, "Normals depend on the number of threads");
+}
+
+#endif // COIN_TEST_SUITE
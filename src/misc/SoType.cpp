@@ -147,7 +147,7 @@
 #include <Inventor/C/glue/dl.h>
 
 #include "tidbitsp.h"
-#include "misc/SbHash.h"
+#include "misc/SbFlatHash.h"
 
 #include "coindefs.h"
 
@@ -193,15 +193,15 @@ template class SbList<SoTypeData *>;
 SbList<SoTypeData *> * SoType::typedatalist = NULL;
 
 // hash map from type name to SoType 'data' id.
-typedef SbHash<const char *, int16_t> Name2IdMap;
+typedef SbFlatHash<const char *, int16_t> Name2IdMap;
 static Name2IdMap * type_dict = NULL;
 
 // hash map from type name to handle for dynamically loaded library
-typedef SbHash<const char *, cc_libhandle> Name2HandleMap;
+typedef SbFlatHash<const char *, cc_libhandle> Name2HandleMap;
 static Name2HandleMap * module_dict = NULL;
 
 // hash map for flagging all the shared library names we have tried
-typedef SbHash<const char *, void *> NameMap;
+typedef SbFlatHash<const char *, void *> NameMap;
 static NameMap * dynload_tries = NULL;
 
 // *************************************************************************
@@ -47,6 +47,10 @@
   will then automatically trigger an invocation of a read operation
   which imports the filename you set in the field.
 
+  With SoFile::setDelayedRead(), the file is not read along with the
+  SoFile node, but when the node is first traversed. See the
+  documentation of that method for the details.
+
   <b>FILE FORMAT/DEFAULTS:</b>
   \code
     File {
@@ -67,13 +71,21 @@
 #include <Inventor/SoInput.h>
 #include <Inventor/actions/SoCallbackAction.h>
 #include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/actions/SoGLRenderAction.h>
+#include <Inventor/elements/SoCacheElement.h>
+#include <Inventor/elements/SoCullElement.h>
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/errors/SoReadError.h>
+#include <Inventor/lists/SbStringList.h>
 #include <Inventor/misc/SoChildList.h>
 #include <Inventor/nodes/SoGroup.h>
 #include <Inventor/sensors/SoFieldSensor.h>
 
+#include "io/SoFileCache.h"
+#include "misc/SbHash.h"
 #include "nodes/SoSubNodeP.h"
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
 
 // *************************************************************************
 
@@ -88,12 +100,166 @@
 
 class SoFileP {
 public:
+  SoFileP(SoFile * masterptr)
+    : master(masterptr), file(NULL), requested(FALSE) { }
+
+  SoFile * master;
+  // the file to read when the node is first traversed, while it
+  // hasn't been read
+  SoFileCache * file;
+  SbBool requested;
+
+  void delayRead(SoInput * in, SbString & fullname);
+  void setFile(SoFileCache * newfile);
+  void requestLoad(void);
+  void load(void);
+  void attach(SoGroup * root);
+  static void loadedCB(void * closure, SoFileCache * file);
+
   static const char UNDEFINED_FILE[];
   static SbBool searchok;
+  static SbBool delayread;
 };
 
 const char SoFileP::UNDEFINED_FILE[] = "<Undefined file>";
 SbBool SoFileP::searchok = FALSE;
+SbBool SoFileP::delayread = FALSE;
+
+// The private data is kept outside the node, so the layout of the
+// public class stays the same.
+typedef SbHash<const SoFile *, SoFileP *> SoFilePrivateDict;
+static SoFilePrivateDict * sofile_private = NULL;
+static void * sofile_private_mutex = NULL;
+
+extern "C" {
+static void
+sofile_cleanup(void)
+{
+  delete sofile_private;
+  sofile_private = NULL;
+  CC_MUTEX_DESTRUCT(sofile_private_mutex);
+}
+}
+
+static SoFileP *
+sofile_get_private(const SoFile * node)
+{
+  SoFileP * pimpl = NULL;
+  CC_MUTEX_LOCK(sofile_private_mutex);
+  const SbBool found = sofile_private->get(node, pimpl);
+  CC_MUTEX_UNLOCK(sofile_private_mutex);
+  assert(found && "no private data for the SoFile node");
+  (void)found;
+  return pimpl;
+}
+
+#define PRIVATE(obj) (sofile_get_private(obj))
+
+// Returns the private data of a node which still has a file to read,
+// or NULL. Such a node has no children, so traversals of nodes which
+// have been read don't need the lookup.
+static SoFileP *
+sofile_get_delayed(const SoFile * node)
+{
+  if (node->getChildren()->getLength() > 0) return NULL;
+  SoFileP * pimpl = PRIVATE(node);
+  return pimpl->file ? pimpl : NULL;
+}
+
+// Finds the file named in the SoFile::name field, and leaves it to be
+// read when the node is first traversed, and sets fullname to where
+// it was found. in is NULL when the field was set after the node was
+// read.
+void
+SoFileP::delayRead(SoInput * in, SbString & fullname)
+{
+  this->setFile(NULL);
+  this->master->getChildren()->truncate(0);
+
+  const SbString & name = this->master->name.getValue();
+  if (name.getLength() == 0 || name == SoFileP::UNDEFINED_FILE) {
+    SoDebugError::postWarning("SoFile::readInstance",
+                              "Undefined filename in SoFile.");
+    return;
+  }
+
+  // if we can't find the file, ignore it, as readNamedFile() does
+  SbStringList subdirs;
+  const SbString found =
+    SoInput::searchForFile(name, SoInput::getDirectories(), subdirs);
+  if (found.getLength() == 0) {
+    if (in) {
+      SoReadError::post(in, "Unable to find subfile: ``%s''", name.getString());
+    }
+    else {
+      SoDebugError::postWarning("SoFile::readInstance",
+                                "Unable to find subfile: ``%s''", name.getString());
+    }
+    return;
+  }
+  fullname = found;
+  this->file = SoFileCache::find(found, SoFileCache::NODES);
+}
+
+void
+SoFileP::setFile(SoFileCache * newfile)
+{
+  if (newfile) newfile->ref();
+  if (this->file) {
+    if (this->requested) this->file->cancelLoad(SoFileP::loadedCB, this);
+    this->file->unref();
+  }
+  this->file = newfile;
+  this->requested = FALSE;
+}
+
+void
+SoFileP::requestLoad(void)
+{
+  if (this->file->isLoaded()) {
+    this->load();
+  }
+  else if (!this->requested) {
+    this->requested = this->file->requestLoad(SoFileP::loadedCB, this);
+  }
+}
+
+// Reads the file right away, if it hasn't been read into the node.
+// The children are only changed on the main thread, as when the
+// file is read from the timer sensor, so on other threads the node
+// stays empty until the main thread has read it.
+void
+SoFileP::load(void)
+{
+  if (this->file && SoFileCache::isMainThread()) {
+    this->attach(this->file->load());
+  }
+}
+
+// Makes the top level nodes of the file the children of the node.
+void
+SoFileP::attach(SoGroup * root)
+{
+  if (root) root->ref();
+  this->setFile(NULL);
+  SoChildList * children = this->master->getChildren();
+  children->truncate(0);
+  if (root) {
+    for (int i = 0; i < root->getNumChildren(); i++) {
+      children->append(root->getChild(i));
+    }
+    root->unref();
+  }
+}
+
+void
+SoFileP::loadedCB(void * closure, SoFileCache * file)
+{
+  SoFileP * thisp = static_cast<SoFileP *>(closure);
+  assert(thisp->file == file);
+  thisp->requested = FALSE;
+  thisp->attach(file->getRoot());
+}
 
 // *************************************************************************
 
@@ -106,6 +272,10 @@ SO_NODE_SOURCE(SoFile);
 */
 SoFile::SoFile(void)
 {
+  CC_MUTEX_LOCK(sofile_private_mutex);
+  (void)sofile_private->put(this, new SoFileP(this));
+  CC_MUTEX_UNLOCK(sofile_private_mutex);
+
   SO_NODE_INTERNAL_CONSTRUCTOR(SoFile);
 
   SO_NODE_ADD_FIELD(name, (SoFileP::UNDEFINED_FILE));
@@ -122,6 +292,12 @@ SoFile::SoFile(void)
 */
 SoFile::~SoFile()
 {
+  SoFileP * pimpl = PRIVATE(this);
+  pimpl->setFile(NULL);
+  delete pimpl;
+  CC_MUTEX_LOCK(sofile_private_mutex);
+  (void)sofile_private->erase(this);
+  CC_MUTEX_UNLOCK(sofile_private_mutex);
   delete this->namesensor;
   delete this->children;
 }
@@ -133,6 +309,10 @@ void
 SoFile::initClass(void)
 {
   SO_NODE_INTERNAL_INIT_CLASS(SoFile, SO_FROM_INVENTOR_1);
+
+  sofile_private = new SoFilePrivateDict;
+  CC_MUTEX_CONSTRUCT(sofile_private_mutex);
+  coin_atexit(sofile_cleanup, CC_ATEXIT_NORMAL);
 }
 
 // *************************************************************************
@@ -142,6 +322,9 @@ SoFile::initClass(void)
   where the file was found.  Returns an empty string if no file has
   been read.
 
+  When reading is delayed, this is the name of the file which will be
+  read when the node is first traversed.
+
   This method is an extension versus the Open Inventor API.  
 */
 const SbString & 
@@ -158,6 +341,26 @@ SoFile::getBoundingBox(SoGetBoundingBoxAction * action)
   const int * indices;
   int lastchildindex;
 
+  SoFileP * pimpl = sofile_get_delayed(this);
+  if (pimpl) {
+    // use the bounding box stored with the file, if there is one,
+    // so the file isn't read until it's needed
+    SbBox3f box;
+    if (pimpl->file->getBoundingBox(box)) {
+      if (action->getPathCode(numindices, indices) != SoAction::OFF_PATH) {
+        action->extendBy(box);
+        action->setCenter(box.getCenter(), TRUE);
+      }
+      return;
+    }
+    pimpl->load();
+    if (pimpl->file) {
+      // not read on this thread, so don't cache the empty box
+      SoCacheElement::invalidate(action->getState());
+      return;
+    }
+  }
+
   if (action->getPathCode(numindices, indices) == SoAction::IN_PATH)
     lastchildindex = indices[numindices-1];
   else
@@ -188,6 +391,20 @@ SoFile::getBoundingBox(SoGetBoundingBoxAction * action)
 void
 SoFile::GLRender(SoGLRenderAction * action)
 {
+  SoFileP * pimpl = sofile_get_delayed(this);
+  if (pimpl) {
+    // Ask for the file to be read, unless the node is outside the
+    // view volume. Nothing is rendered until it has been read, so
+    // make sure no render cache is made from this.
+    SoState * state = action->getState();
+    SoCacheElement::invalidate(state);
+    SbBox3f box;
+    if (!pimpl->file->getBoundingBox(box) ||
+        !SoCullElement::cullTest(state, box, TRUE)) {
+      pimpl->requestLoad();
+    }
+    return;
+  }
   SoFile::doAction((SoAction *)action);
 }
 
@@ -208,6 +425,10 @@ SoFile::readInstance(SoInput * in, unsigned short flags)
   this->namesensor->detach();
   SbBool result = inherited::readInstance(in, flags);
   this->namesensor->attach(& this->name);
+  if (result && SoFileP::delayread) {
+    PRIVATE(this)->delayRead(in, this->fullname);
+    return TRUE;
+  }
   return result && this->readNamedFile(in);
 }
 
@@ -222,6 +443,8 @@ SoFile::readInstance(SoInput * in, unsigned short flags)
 SbBool
 SoFile::readNamedFile(SoInput * in)
 {
+  PRIVATE(this)->setFile(NULL);
+
   if (this->name.getValue().getLength() == 0 ||
       strcmp(this->name.getValue().getString(), SoFileP::UNDEFINED_FILE) == 0) {
     // We handle this different than Inventor, where the whole read
@@ -330,8 +553,12 @@ void
 SoFile::nameFieldModified(void * userdata, SoSensor * COIN_UNUSED_ARG(sensor))
 {
   SoFile * that = (SoFile *)userdata;
-  SoInput in;
   that->fullname.makeEmpty();
+  if (SoFileP::delayread) {
+    PRIVATE(that)->delayRead(NULL, that->fullname);
+    return;
+  }
+  SoInput in;
   (void)that->readNamedFile(&in);
 }
 
@@ -341,6 +568,8 @@ SoFile::nameFieldModified(void * userdata, SoSensor * COIN_UNUSED_ARG(sensor))
 SoGroup *
 SoFile::copyChildren(void) const
 {
+  PRIVATE(this)->load();
+
   SoGroup * tmproot = new SoGroup;
   tmproot->ref();
 
@@ -373,6 +602,9 @@ SoFile::getChildren(void) const
 void
 SoFile::doAction(SoAction * action)
 {
+  SoFileP * pimpl = sofile_get_delayed(this);
+  if (pimpl) pimpl->load();
+
   int numindices;
   const int * indices;
   if (action->getPathCode(numindices, indices) == SoAction::IN_PATH) {
@@ -401,6 +633,8 @@ SoFile::getMatrix(SoGetMatrixAction * action)
 void
 SoFile::handleEvent(SoHandleEventAction * action)
 {
+  // events don't cause the file to be read
+  if (sofile_get_delayed(this)) return;
   SoFile::doAction((SoAction *)action);
 }
 
@@ -451,6 +685,10 @@ SoFile::copyContents(const SoFieldContainer * from, SbBool copyconnections)
       SoFieldContainer::findCopy((*(filenode->children))[i], copyconnections);
     this->children->append(cp);
   }
+
+  // a file which hasn't been read yet is shared with the copy
+  this->fullname = filenode->fullname;
+  PRIVATE(this)->setFile(PRIVATE(filenode)->file);
 }
 
 /*!
@@ -470,3 +708,136 @@ SoFile::getSearchOK()
 {
   return SoFileP::searchok;
 }
+
+/*!
+  Sets whether SoFile nodes read their file when the node is read (or
+  the SoFile::name field is set), or when the node is first
+  traversed. The default is to read the file right away.
+
+  With delayed reading, the file is only looked up in the SoInput
+  search directories when the node is read. It is read when an action
+  needs the children of the node. Render traversals don't wait for
+  the file: they ask for it to be read in the background, and the
+  children are added from a timer sensor when it has been, which in
+  turn triggers a redraw. Nothing is rendered for the node until
+  then, and nodes outside the view volume don't ask for their file at
+  all. SoHandleEventAction doesn't cause the file to be read, and
+  neither does SoSearchAction, unless searching is enabled with
+  SoFile::setSearchOK().
+
+  All SoFile nodes which refer to the same file while it is being
+  read share one scene graph read from it.
+
+  SoGetBoundingBoxAction uses the bounding box stored in a file next to
+  the file, if there is one, instead of reading the file. Its name is
+  the name of the file with a ".bbox" suffix, and it holds the six
+  numbers "xmin ymin zmin xmax ymax zmax".
+
+  Note that the file is read with a separate SoInput, so names
+  defined in the file containing the SoFile node can not be
+  referenced from the file, and the state changes made by the
+  children of the SoFile node only affect the nodes after it once
+  the file has been read.
+
+  \since Coin 4.0
+*/
+void
+SoFile::setDelayedRead(SbBool delay)
+{
+  SoFileP::delayread = delay;
+}
+
+/*!
+  Returns whether reading the files of SoFile nodes is delayed until
+  the nodes are first traversed.
+
+  \sa setDelayedRead()
+  \since Coin 4.0
+*/
+SbBool
+SoFile::getDelayedRead(void)
+{
+  return SoFileP::delayread;
+}
+
+#undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <cstdio>
+#include <cstring>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/misc/SoChildList.h>
+#include <Inventor/nodes/SoSeparator.h>
+
+static void
+write_test_file(const char * filename, const char * contents)
+{
+  FILE * fp = fopen(filename, "wb");
+  BOOST_REQUIRE(fp);
+  (void)fputs(contents, fp);
+  (void)fclose(fp);
+}
+
+BOOST_AUTO_TEST_CASE(DelayedRead)
+{
+  SoDB::init();
+
+  const std::string subfile = TemporaryFileName(".iv");
+  const std::string sidecar = subfile + ".bbox";
+  write_test_file(subfile.c_str(),
+                  "#Inventor V2.1 ascii\n\n"
+                  "DEF SoFileDelayedCoords Coordinate3 { point [ 0 0 0, 1 2 3 ] }\n"
+                  "PointSet { }\n");
+  write_test_file(sidecar.c_str(), "-1 -1 -1 4 4 4\n");
+
+  const std::string scene =
+    "#Inventor V2.1 ascii\n\n"
+    "Separator {\n"
+    "  Separator { File { name \"" + subfile + "\" } }\n"
+    "  Separator { File { name \"" + subfile + "\" } }\n"
+    "}\n";
+
+  SoFile::setDelayedRead(TRUE);
+  SoInput in;
+  in.setBuffer(scene.c_str(), scene.size());
+  SoSeparator * root = SoDB::readAll(&in);
+  SoFile::setDelayedRead(FALSE);
+  BOOST_REQUIRE(root);
+  root->ref();
+
+  SoFile * file1 = static_cast<SoFile *>(static_cast<SoGroup *>(root->getChild(0))->getChild(0));
+  SoFile * file2 = static_cast<SoFile *>(static_cast<SoGroup *>(root->getChild(1))->getChild(0));
+  BOOST_REQUIRE(file1->isOfType(SoFile::getClassTypeId()));
+  BOOST_CHECK_MESSAGE(file1->getChildren()->getLength() == 0,
+                      "file was read with the node");
+
+  SoGetBoundingBoxAction bboxaction((SbViewportRegion()));
+  bboxaction.apply(root);
+  BOOST_CHECK_MESSAGE(bboxaction.getBoundingBox() == SbBox3f(-1, -1, -1, 4, 4, 4),
+                      "bounding box wasn't read from the sidecar file");
+  BOOST_CHECK_MESSAGE(SoNode::getByName("SoFileDelayedCoords") == NULL,
+                      "file was read for the bounding box");
+
+  SoCallbackAction cbaction;
+  cbaction.apply(root);
+  BOOST_CHECK_MESSAGE(file1->getChildren()->getLength() == 2 &&
+                      file2->getChildren()->getLength() == 2,
+                      "file wasn't read when traversed");
+  BOOST_CHECK_MESSAGE((*file1->getChildren())[0] == (*file2->getChildren())[0],
+                      "references to the same file don't share the scene");
+
+  bboxaction.apply(root);
+  BOOST_CHECK_MESSAGE(bboxaction.getBoundingBox() == SbBox3f(0, 0, 0, 1, 2, 3),
+                      "bounding box of the file's scene is wrong");
+
+  root->unref();
+  (void)remove(subfile.c_str());
+  (void)remove(sidecar.c_str());
+}
+
+#endif // COIN_TEST_SUITE
@@ -215,9 +215,10 @@ SbUniqueId is not really a class, just a \c typedef.
 #include <Inventor/lists/SoEngineOutputList.h>
 
 #include "tidbitsp.h"
-#include "misc/SbHash.h"
+#include "misc/SbFlatHash.h"
 #include "rendering/SoGL.h"
 #include "nodes/SoSubNodeP.h"
+#include "nodes/SoSceneCacheSeparator.h"
 #include "nodes/SoUnknownNode.h"
 #include "threads/threadsutilp.h"
 #include "glue/glp.h"
@@ -345,7 +346,7 @@ int SoNode::nextActionMethodIndex = 0;
 SoType SoNode::classTypeId STATIC_SOTYPE_INIT;
 static void * sonode_mutex = NULL;
 
-typedef SbHash<int16_t, uint32_t> Int16ToUInt32Map;
+typedef SbFlatHash<int16_t, uint32_t> Int16ToUInt32Map;
 static Int16ToUInt32Map * compatibility_dict = NULL;
 
 static void init_action_methods(void);
@@ -705,6 +706,7 @@ SoNode::initClasses(void)
   SoTextureCoordinateEnvironment::initClass();
   SoTextureCoordinatePlane::initClass();
   SoUnknownNode::initClass();
+  SoSceneCacheSeparator::initClass();
   SoVertexProperty::initClass();
   SoWWWInline::initClass();
   SoListener::initClass();
@@ -0,0 +1,295 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+// This is an internal class, which stands in for a separator in a
+// scene cache file (see io/SoSceneCache.cpp) until its children are
+// needed. The children are read from the file the first time the node
+// is traversed by an action which needs them. Until then, bounding
+// box actions use the bounding box stored in the file, and render
+// actions cull against it.
+// Anything which goes through getChildren() loads the children.
+//
+// Event handling doesn't load the children, as events are sent through
+// the whole scene. Nodes in a part of the scene which hasn't been
+// loaded yet won't see events, but such a part hasn't been rendered
+// or searched either.
+
+#include "nodes/SoSceneCacheSeparator.h"
+
+#include <Inventor/actions/SoGLRenderAction.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/elements/SoCullElement.h>
+#include <Inventor/misc/SoChildList.h>
+#include <Inventor/misc/SoState.h>
+
+#include "io/SoSceneCache.h"
+#include "nodes/SoSubNodeP.h"
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
+
+// *************************************************************************
+
+static void * soscenecacheseparator_mutex = NULL;
+
+static void
+soscenecacheseparator_cleanup(void)
+{
+  CC_MUTEX_DESTRUCT(soscenecacheseparator_mutex);
+}
+
+SO_NODE_SOURCE(SoSceneCacheSeparator);
+
+// *************************************************************************
+
+SoSceneCacheSeparator::SoSceneCacheSeparator(void)
+{
+  SO_NODE_INTERNAL_CONSTRUCTOR(SoSceneCacheSeparator);
+
+  SO_NODE_ADD_FIELD(chunk, (-1));
+
+  this->source = NULL;
+  this->loaded = FALSE;
+}
+
+SoSceneCacheSeparator::~SoSceneCacheSeparator()
+{
+  if (this->source) { this->source->unref(); }
+}
+
+void
+SoSceneCacheSeparator::initClass(void)
+{
+  SO_NODE_INTERNAL_INIT_CLASS(SoSceneCacheSeparator, SO_FROM_COIN_4_0);
+  CC_MUTEX_CONSTRUCT(soscenecacheseparator_mutex);
+  coin_atexit((coin_atexit_f *)soscenecacheseparator_cleanup, CC_ATEXIT_NORMAL);
+}
+
+// Sets the file to read the children from. The chunk field tells
+// which part of the file they are in.
+void
+SoSceneCacheSeparator::setSource(SoSceneCacheFile * file)
+{
+  assert(this->source == NULL);
+  this->source = file;
+  this->source->ref();
+}
+
+// Returns TRUE if the children haven't been read yet.
+SbBool
+SoSceneCacheSeparator::isPending(void) const
+{
+  return this->getPendingChunk() >= 0;
+}
+
+// Returns the chunk the children are to be read from, or -1 if they
+// have been read. The children may be read by another thread at any
+// time, so the chunk is only looked at under the lock.
+int
+SoSceneCacheSeparator::getPendingChunk(void) const
+{
+  if (this->source == NULL) return -1;
+  CC_MUTEX_LOCK(soscenecacheseparator_mutex);
+  const int idx = this->loaded ? -1 : this->chunk.getValue();
+  CC_MUTEX_UNLOCK(soscenecacheseparator_mutex);
+  return idx;
+}
+
+// Reads the children, if that hasn't been done already.
+void
+SoSceneCacheSeparator::load(void)
+{
+  if (!this->isPending()) return;
+
+  CC_MUTEX_LOCK(soscenecacheseparator_mutex);
+  if (!this->loaded) {
+    SoSeparator * sep = this->source->readChunk(this->chunk.getValue());
+    // the scene doesn't change by loading, so don't let it look like
+    // it did
+    const SbBool notify = this->enableNotify(FALSE);
+    if (sep) {
+      sep->ref();
+      // addChild() would come back here through getChildren()
+      SoChildList * children = inherited::getChildren();
+      for (int i = 0; i < sep->getNumChildren(); i++) {
+        children->append(sep->getChild(i));
+      }
+      sep->unref();
+    }
+    this->chunk.setValue(-1);
+    this->chunk.setDefault(TRUE);
+    (void)this->enableNotify(notify);
+    this->loaded = TRUE;
+  }
+  CC_MUTEX_UNLOCK(soscenecacheseparator_mutex);
+}
+
+void
+SoSceneCacheSeparator::doAction(SoAction * action)
+{
+  this->load();
+  inherited::doAction(action);
+}
+
+void
+SoSceneCacheSeparator::GLRenderBelowPath(SoGLRenderAction * action)
+{
+  const int idx = this->getPendingChunk();
+  if (idx >= 0) {
+    // cull against the stored bounding box, like SoSeparator does
+    // against its bounding box cache
+    SoState * state = action->getState();
+    if (this->renderCulling.getValue() != SoSeparator::OFF &&
+        !state->isCacheOpen() && !SoCullElement::completelyInside(state)) {
+      const SbBox3f box = this->source->getBoundingBox(idx);
+      if (!box.isEmpty() && SoCullElement::cullTest(state, box, TRUE)) return;
+    }
+  }
+  this->load();
+  inherited::GLRenderBelowPath(action);
+}
+
+void
+SoSceneCacheSeparator::GLRenderInPath(SoGLRenderAction * action)
+{
+  this->load();
+  inherited::GLRenderInPath(action);
+}
+
+void
+SoSceneCacheSeparator::callback(SoCallbackAction * action)
+{
+  this->load();
+  inherited::callback(action);
+}
+
+void
+SoSceneCacheSeparator::getBoundingBox(SoGetBoundingBoxAction * action)
+{
+  const SoAction::PathCode pathcode = action->getCurPathCode();
+  const int idx = this->getPendingChunk();
+  if (idx >= 0 &&
+      (pathcode == SoAction::NO_PATH || pathcode == SoAction::BELOW_PATH) &&
+      !action->isInCameraSpace() && !action->isResetPath()) {
+    const SbBox3f box = this->source->getBoundingBox(idx);
+    SbVec3f center;
+    if (!box.isEmpty()) {
+      action->extendBy(box);
+      if (this->source->getCenter(idx, center)) {
+        action->resetCenter();
+        action->setCenter(center, TRUE);
+      }
+    }
+    return;
+  }
+  this->load();
+  inherited::getBoundingBox(action);
+}
+
+void
+SoSceneCacheSeparator::handleEvent(SoHandleEventAction * action)
+{
+  if (this->isPending()) return;
+  inherited::handleEvent(action);
+}
+
+void
+SoSceneCacheSeparator::rayPick(SoRayPickAction * action)
+{
+  this->load();
+  inherited::rayPick(action);
+}
+
+void
+SoSceneCacheSeparator::search(SoSearchAction * action)
+{
+  this->load();
+  inherited::search(action);
+}
+
+void
+SoSceneCacheSeparator::getPrimitiveCount(SoGetPrimitiveCountAction * action)
+{
+  this->load();
+  inherited::getPrimitiveCount(action);
+}
+
+void
+SoSceneCacheSeparator::audioRender(SoAudioRenderAction * action)
+{
+  this->load();
+  inherited::audioRender(action);
+}
+
+void
+SoSceneCacheSeparator::write(SoWriteAction * action)
+{
+  this->load();
+  inherited::write(action);
+}
+
+SoChildList *
+SoSceneCacheSeparator::getChildren(void) const
+{
+  const_cast<SoSceneCacheSeparator *>(this)->load();
+  return inherited::getChildren();
+}
+
+// Once the children are loaded, the node is written as a plain
+// separator.
+const char *
+SoSceneCacheSeparator::getFileFormatName(void) const
+{
+  if (this->chunk.isDefault()) return "Separator";
+  return inherited::getFileFormatName();
+}
+
+void
+SoSceneCacheSeparator::copyContents(const SoFieldContainer * from,
+                                    SbBool copyconnections)
+{
+  if (from->isOfType(SoSceneCacheSeparator::getClassTypeId())) {
+    inherited::copyContents(from, copyconnections);
+    return;
+  }
+
+  // Standing in for a separator in the skeleton of a scene cache file
+  // being written. Its children go in a chunk of their own, so copy
+  // just the name and the separator's fields.
+  this->setName(from->getName());
+  const SoFieldData * fielddata = from->getFieldData();
+  for (int i = 0; i < fielddata->getNumFields(); i++) {
+    const SoField * src = fielddata->getField(from, i);
+    SoField * dst = this->getField(fielddata->getFieldName(i));
+    dst->copyFrom(*src);
+    dst->setDefault(src->isDefault());
+  }
+}
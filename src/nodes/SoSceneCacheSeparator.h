@@ -0,0 +1,87 @@
+#ifndef COIN_SOSCENECACHESEPARATOR_H
+#define COIN_SOSCENECACHESEPARATOR_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* !COIN_INTERNAL */
+
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/fields/SoSFInt32.h>
+
+class SoSceneCacheFile;
+
+class SoSceneCacheSeparator : public SoSeparator {
+  typedef SoSeparator inherited;
+
+  SO_NODE_HEADER(SoSceneCacheSeparator);
+
+public:
+  static void initClass(void);
+  SoSceneCacheSeparator(void);
+
+  SoSFInt32 chunk;
+
+  void setSource(SoSceneCacheFile * file);
+  SbBool isPending(void) const;
+  void load(void);
+
+  virtual void doAction(SoAction * action);
+  virtual void GLRenderBelowPath(SoGLRenderAction * action);
+  virtual void GLRenderInPath(SoGLRenderAction * action);
+  virtual void callback(SoCallbackAction * action);
+  virtual void getBoundingBox(SoGetBoundingBoxAction * action);
+  virtual void handleEvent(SoHandleEventAction * action);
+  virtual void rayPick(SoRayPickAction * action);
+  virtual void search(SoSearchAction * action);
+  virtual void getPrimitiveCount(SoGetPrimitiveCountAction * action);
+  virtual void audioRender(SoAudioRenderAction * action);
+  virtual void write(SoWriteAction * action);
+  virtual SoChildList * getChildren(void) const;
+
+protected:
+  virtual ~SoSceneCacheSeparator();
+
+  virtual const char * getFileFormatName(void) const;
+  virtual void copyContents(const SoFieldContainer * from,
+                            SbBool copyconnections);
+
+private:
+  int getPendingChunk(void) const;
+
+  SoSceneCacheFile * source;
+  SbBool loaded;
+};
+
+#endif // !COIN_SOSCENECACHESEPARATOR_H
@@ -92,6 +92,7 @@
 #include "SoRotationXYZ.cpp"
 #include "SoRotor.cpp"
 #include "SoScale.cpp"
+#include "SoSceneCacheSeparator.cpp"
 #include "SoSceneTexture2.cpp"
 #include "SoSceneTextureCubeMap.cpp"
 #include "SoSelection.cpp"
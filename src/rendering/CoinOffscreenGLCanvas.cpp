@@ -40,6 +40,7 @@
 #include <Inventor/elements/SoGLCacheContextElement.h>
 
 #include "tidbitsp.h"
+#include "threads/threadsutilp.h"
 
 #if defined(HAVE_CONFIG_H)
 #include "config.h"
@@ -52,6 +53,10 @@
 
 unsigned int CoinOffscreenGLCanvas::tilesizeroof = UINT_MAX;
 
+SbList<CoinOffscreenGLCanvas *> * CoinOffscreenGLCanvas::pool = NULL;
+int CoinOffscreenGLCanvas::poolsize = 0;
+void * CoinOffscreenGLCanvas::poolmutex = NULL;
+
 // *************************************************************************
 
 CoinOffscreenGLCanvas::CoinOffscreenGLCanvas(void)
@@ -60,13 +65,112 @@ CoinOffscreenGLCanvas::CoinOffscreenGLCanvas(void)
   this->context = NULL;
   this->current_hdc = NULL;
 #ifdef HAVE_OSMESA
-    SoOffscreenOSMesaData::init(&offscreenCbFunctions);
+    SoOffscreenOSMesaData::init();
 #endif
 }
 
 CoinOffscreenGLCanvas::~CoinOffscreenGLCanvas()
 {
   if (this->context) { this->destructContext(); }
+#ifdef HAVE_OSMESA
+    SoOffscreenOSMesaData::finish();
+#endif
+}
+
+// *************************************************************************
+
+// The pool keeps canvases released by their users, with their GL
+// contexts intact, for the next user to pick up. As the cache context
+// id stays with the GL context, display lists, textures and vertex
+// buffers made for one SoOffscreenRenderer are still valid when a
+// later instance gets the same canvas.
+
+// Returns a canvas from the pool, or a new one if the pool is empty.
+// The canvas last released is handed out first, as it is the one
+// most likely to be of the same size as asked for again.
+CoinOffscreenGLCanvas *
+CoinOffscreenGLCanvas::acquire(void)
+{
+  CoinOffscreenGLCanvas * canvas = NULL;
+  CC_MUTEX_CONSTRUCT(CoinOffscreenGLCanvas::poolmutex);
+  CC_MUTEX_LOCK(CoinOffscreenGLCanvas::poolmutex);
+  SbList<CoinOffscreenGLCanvas *> * pool = CoinOffscreenGLCanvas::pool;
+  if (pool && pool->getLength() > 0) { canvas = pool->pop(); }
+  CC_MUTEX_UNLOCK(CoinOffscreenGLCanvas::poolmutex);
+
+  if (canvas == NULL) { canvas = new CoinOffscreenGLCanvas; }
+  return canvas;
+}
+
+// Hands a canvas acquired with acquire() back. It is kept in the pool
+// if there is room, else it is deleted.
+void
+CoinOffscreenGLCanvas::release(CoinOffscreenGLCanvas * canvas)
+{
+  if (canvas == NULL) { return; }
+  SbBool kept = FALSE;
+  CC_MUTEX_CONSTRUCT(CoinOffscreenGLCanvas::poolmutex);
+  CC_MUTEX_LOCK(CoinOffscreenGLCanvas::poolmutex);
+  SbList<CoinOffscreenGLCanvas *> * pool = CoinOffscreenGLCanvas::pool;
+  // only canvases with a context are worth keeping
+  if (pool && canvas->context &&
+      pool->getLength() < CoinOffscreenGLCanvas::poolsize) {
+    pool->append(canvas);
+    kept = TRUE;
+  }
+  CC_MUTEX_UNLOCK(CoinOffscreenGLCanvas::poolmutex);
+
+  // destructing the context invokes the context destruction
+  // callbacks, so this is done without the lock
+  if (!kept) { delete canvas; }
+}
+
+// Sets the number of unused canvases to keep. 0, the default, makes
+// release() delete all canvases.
+void
+CoinOffscreenGLCanvas::setPoolSize(const int size)
+{
+  assert(size >= 0);
+  CC_MUTEX_CONSTRUCT(CoinOffscreenGLCanvas::poolmutex);
+  CC_MUTEX_LOCK(CoinOffscreenGLCanvas::poolmutex);
+  if (CoinOffscreenGLCanvas::pool == NULL && size > 0) {
+    CoinOffscreenGLCanvas::pool = new SbList<CoinOffscreenGLCanvas *>;
+    coin_atexit((coin_atexit_f*) CoinOffscreenGLCanvas::cleanupPool,
+                CC_ATEXIT_OFFSCREEN_CONTEXTS);
+  }
+  CoinOffscreenGLCanvas::poolsize = size;
+  CC_MUTEX_UNLOCK(CoinOffscreenGLCanvas::poolmutex);
+
+  CoinOffscreenGLCanvas::trimPool(size);
+}
+
+int
+CoinOffscreenGLCanvas::getPoolSize(void)
+{
+  return CoinOffscreenGLCanvas::poolsize;
+}
+
+// Deletes pooled canvases until at most size are left.
+void
+CoinOffscreenGLCanvas::trimPool(const int size)
+{
+  SbList<CoinOffscreenGLCanvas *> deletelist;
+  CC_MUTEX_LOCK(CoinOffscreenGLCanvas::poolmutex);
+  SbList<CoinOffscreenGLCanvas *> * pool = CoinOffscreenGLCanvas::pool;
+  while (pool && pool->getLength() > size) { deletelist.append(pool->pop()); }
+  CC_MUTEX_UNLOCK(CoinOffscreenGLCanvas::poolmutex);
+
+  for (int i = 0; i < deletelist.getLength(); i++) { delete deletelist[i]; }
+}
+
+void
+CoinOffscreenGLCanvas::cleanupPool(void)
+{
+  CoinOffscreenGLCanvas::poolsize = 0;
+  CoinOffscreenGLCanvas::trimPool(0);
+  delete CoinOffscreenGLCanvas::pool;
+  CoinOffscreenGLCanvas::pool = NULL;
+  CC_MUTEX_DESTRUCT(CoinOffscreenGLCanvas::poolmutex);
 }
 
 // *************************************************************************
@@ -313,11 +417,6 @@ CoinOffscreenGLCanvas::destructContext(void)
   this->context = NULL;
   this->renderid = 0;
   this->current_hdc = NULL;
-
-#ifdef HAVE_OSMESA
-    SoOffscreenOSMesaData::finish();
-#endif
-
 }
 
 // *************************************************************************
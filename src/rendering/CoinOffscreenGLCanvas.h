@@ -40,6 +40,7 @@
 // *************************************************************************
 
 #include <Inventor/SbVec2s.h>
+#include <Inventor/lists/SbList.h>
 #include "Inventor/C/glue/gl.h"
 
 // *************************************************************************
@@ -65,7 +66,19 @@ public:
 
   const void * const & getHDC(void) const; // ugliness to support SoOffscreenRenderer::getDC()
   void updateDCBitmap();	
+
+  static CoinOffscreenGLCanvas * acquire(void);
+  static void release(CoinOffscreenGLCanvas * canvas);
+  static void setPoolSize(const int size);
+  static int getPoolSize(void);
+
 private:
+  static void trimPool(const int size);
+  static void cleanupPool(void);
+  static SbList<CoinOffscreenGLCanvas *> * pool;
+  static int poolsize;
+  static void * poolmutex;
+
   static SbBool clampSize(SbVec2s & s);
   static void clampToPixelSizeRoof(SbVec2s & s);
   static SbVec2s getMaxTileSize(void);
@@ -78,7 +91,6 @@ private:
   void * context;
   uint32_t renderid;
   const void * current_hdc;
-    cc_glglue_offscreen_cb_functions offscreenCbFunctions;
 };
 
 // *************************************************************************
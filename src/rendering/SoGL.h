@@ -46,6 +46,7 @@
 class SoShape;
 class SoState;
 class SoAction;
+class SoGLRenderAction;
 class SoMaterialBundle;
 class SoGLCoordinateElement;
 class SoTextureCoordinateBundle;
@@ -68,6 +69,12 @@ class SbVec2f;
 // pointer.
 const cc_glglue * sogl_glue_instance(const SoState * state);
 
+#ifdef HAVE_THREADS
+// The worker pool of the render action for sorting the triangles of
+// transparent shapes, with at least numworkers workers.
+struct cc_wpool * sogl_sort_pool(SoGLRenderAction * action, const int numworkers);
+#endif // HAVE_THREADS
+
 
 // render
 void sogl_render_cone(const float bottomRadius,
@@ -36,11 +36,14 @@
 
 #ifdef HAVE_OSMESA
 
+#include <cassert>
+
 #include "SoOffscreenOSMesaData.h"
 #include "Inventor/C/glue/gl.h"
 #include "glue/gl_osmesa.h"
 
-SbBool SoOffscreenOSMesaData::initialized = FALSE;
+int SoOffscreenOSMesaData::numusers = 0;
+cc_glglue_offscreen_cb_functions SoOffscreenOSMesaData::functions;
 
 // Pixels-pr-mm.
 // TODO: add resolution
@@ -51,26 +54,28 @@ SoOffscreenOSMesaData::getResolution(void)
 }
 
 void
-SoOffscreenOSMesaData::init(cc_glglue_offscreen_cb_functions* func) {
-    if(initialized)
+SoOffscreenOSMesaData::init() {
+    if(numusers++ > 0)
         return;
-    func->create_offscreen = osmesaglue_context_create_offscreen;
-    func->make_current = osmesaglue_context_make_current;
-    func->current_context = osmesaglue_current_context;
-    func->reinstate_previous = osmesaglue_context_reinstate_previous;
-    func->destruct = osmesaglue_context_destruct;
-    cc_glglue_context_set_offscreen_cb_functions(func);
-    initialized = TRUE;
+    functions.create_offscreen = osmesaglue_context_create_offscreen;
+    functions.make_current = osmesaglue_context_make_current;
+    functions.current_context = osmesaglue_current_context;
+    functions.reinstate_previous = osmesaglue_context_reinstate_previous;
+    functions.destruct = osmesaglue_context_destruct;
+    cc_glglue_context_set_offscreen_cb_functions(&functions);
 }
 
 void
 SoOffscreenOSMesaData::finish() {
+    assert(numusers > 0);
+    if(--numusers > 0)
+        return;
     cc_glglue_context_set_offscreen_cb_functions(NULL);
 }
 
 SbBool
 SoOffscreenOSMesaData::isInitialized() {
-    return (initialized);
+    return (numusers > 0);
 }
 
 #endif // HAVE_OSMESA
@@ -48,12 +48,15 @@
 
 // *************************************************************************
 
+// The OSMesa functions are set up as offscreen callbacks for as long
+// as there is at least one user, i.e. one CoinOffscreenGLCanvas.
 class SoOffscreenOSMesaData {
-    static SbBool initialized;
+    static int numusers;
+    static cc_glglue_offscreen_cb_functions functions;
 public:
     static SbVec2f getResolution(void);
     static SbBool isInitialized();
-    static void init(cc_glglue_offscreen_cb_functions*);
+    static void init();
     static void finish();
 };
 
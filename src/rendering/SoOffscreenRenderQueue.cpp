@@ -0,0 +1,490 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+/*!
+  \class SoOffscreenRenderQueue SoOffscreenRenderQueue.h Inventor/SoOffscreenRenderQueue.h
+  \brief The SoOffscreenRenderQueue class renders batches of scenes to memory buffers.
+
+  \ingroup coin_general
+
+  This class is meant for generating a lot of images in one go, as
+  when making thumbnails of a collection of models. Each job consists
+  of a scene graph, an optional camera and the size of the image.
+  Jobs are added with addJob(), rendered with processJobs(), and the
+  images are then picked up with getJobBuffer():
+
+  \code
+  SoOffscreenRenderQueue queue;
+  SbList<int> jobs;
+  for (int i = 0; i < models.getLength(); i++) {
+    jobs.append(queue.addJob(models[i], cameras[i], SbVec2s(128, 128)));
+  }
+  queue.processJobs();
+  for (int i = 0; i < jobs.getLength(); i++) {
+    const unsigned char * image = queue.getJobBuffer(jobs[i]);
+    if (image) { saveThumbnail(i, image); }
+    queue.removeJob(jobs[i]);
+  }
+  \endcode
+
+  The queue keeps its SoOffscreenRenderer instances, and thereby
+  their OpenGL contexts, between jobs and between calls to
+  processJobs(). Render caches, textures and vertex buffer objects
+  made for one job are therefore reused by later jobs which share
+  parts of the scene graph with it. To keep contexts around also
+  after the queue is destructed, see
+  SoOffscreenRenderer::setContextPoolSize().
+
+  \sa SoOffscreenRenderer
+
+  \COIN_CLASS_EXTENSION
+
+  \since Coin 4.0
+*/
+
+// *************************************************************************
+
+#include <Inventor/SoOffscreenRenderQueue.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/nodes/SoCamera.h>
+#include <Inventor/nodes/SoGroup.h>
+
+#ifdef COIN_THREADSAFE
+#include <Inventor/C/threads/wpool.h>
+#include <Inventor/threads/SbMutex.h>
+#endif // COIN_THREADSAFE
+
+#include "misc/SbFlatHash.h"
+
+// *************************************************************************
+
+class SoOffscreenRenderJob {
+public:
+  int id;
+  SoNode * root;
+  SbVec2s size;
+  unsigned char * buffer;
+  SbBool done;
+};
+
+class SoOffscreenRenderQueueP;
+
+// One renderer, and the thread which uses it while processing jobs.
+class SoOffscreenRenderQueueWorker {
+public:
+  SoOffscreenRenderQueueP * owner;
+  SoOffscreenRenderer * renderer;
+};
+
+class SoOffscreenRenderQueueP {
+public:
+  SoOffscreenRenderQueueP(void)
+  {
+    this->components = SoOffscreenRenderer::RGB;
+    this->backgroundcolor.setValue(0.0f, 0.0f, 0.0f);
+    this->numthreads = 1;
+    this->lastid = 0;
+    this->nextjob = 0;
+#ifdef COIN_THREADSAFE
+    this->pool = NULL;
+#endif // COIN_THREADSAFE
+  }
+
+  void renderJob(SoOffscreenRenderer * renderer, SoOffscreenRenderJob * job);
+  void renderJobs(SoOffscreenRenderer * renderer);
+  SoOffscreenRenderQueueWorker * getWorker(const int idx);
+  void deleteWorkers(const int keep);
+  void deleteJob(SoOffscreenRenderJob * job);
+
+#ifdef COIN_THREADSAFE
+  static void jobWorker(void * closure);
+  cc_wpool * pool;
+  SbMutex jobmutex;
+#endif // COIN_THREADSAFE
+
+  SoOffscreenRenderer::Components components;
+  SbColor backgroundcolor;
+  int numthreads;
+  int lastid;
+
+  SbFlatHash<int, SoOffscreenRenderJob *> jobs;
+  SbList<SoOffscreenRenderJob *> pending;
+  int nextjob;
+  SbList<SoOffscreenRenderQueueWorker *> workers;
+};
+
+#define PRIVATE(p) (p->pimpl)
+
+// *************************************************************************
+
+// Renders one job and keeps a copy of the image.
+void
+SoOffscreenRenderQueueP::renderJob(SoOffscreenRenderer * renderer,
+                                   SoOffscreenRenderJob * job)
+{
+  renderer->setViewportRegion(SbViewportRegion(job->size));
+  renderer->setComponents(this->components);
+  renderer->setBackgroundColor(this->backgroundcolor);
+  if (renderer->render(job->root)) {
+    const size_t size = size_t(job->size[0]) * size_t(job->size[1]) *
+      size_t(this->components);
+    job->buffer = static_cast<unsigned char *>(malloc(size));
+    if (job->buffer) { (void)memcpy(job->buffer, renderer->getBuffer(), size); }
+  }
+  job->done = TRUE;
+}
+
+// Renders pending jobs until there are none left to claim.
+void
+SoOffscreenRenderQueueP::renderJobs(SoOffscreenRenderer * renderer)
+{
+  for (;;) {
+#ifdef COIN_THREADSAFE
+    this->jobmutex.lock();
+#endif // COIN_THREADSAFE
+    const int idx = this->nextjob;
+    if (idx < this->pending.getLength()) { this->nextjob++; }
+#ifdef COIN_THREADSAFE
+    this->jobmutex.unlock();
+#endif // COIN_THREADSAFE
+    if (idx >= this->pending.getLength()) { return; }
+    this->renderJob(renderer, this->pending[idx]);
+  }
+}
+
+SoOffscreenRenderQueueWorker *
+SoOffscreenRenderQueueP::getWorker(const int idx)
+{
+  while (idx >= this->workers.getLength()) {
+    SoOffscreenRenderQueueWorker * worker = new SoOffscreenRenderQueueWorker;
+    worker->owner = this;
+    worker->renderer = new SoOffscreenRenderer(SbViewportRegion(1, 1));
+    this->workers.append(worker);
+  }
+  return this->workers[idx];
+}
+
+void
+SoOffscreenRenderQueueP::deleteWorkers(const int keep)
+{
+  while (this->workers.getLength() > keep) {
+    SoOffscreenRenderQueueWorker * worker = this->workers.pop();
+    delete worker->renderer;
+    delete worker;
+  }
+}
+
+void
+SoOffscreenRenderQueueP::deleteJob(SoOffscreenRenderJob * job)
+{
+  job->root->unref();
+  free(job->buffer);
+  delete job;
+}
+
+#ifdef COIN_THREADSAFE
+
+void
+SoOffscreenRenderQueueP::jobWorker(void * closure)
+{
+  SoOffscreenRenderQueueWorker * worker = (SoOffscreenRenderQueueWorker *) closure;
+  worker->owner->renderJobs(worker->renderer);
+}
+
+#endif // COIN_THREADSAFE
+
+// *************************************************************************
+
+/*!
+  Constructor. The queue is empty, and renders RGB images on a black
+  background with one thread.
+*/
+SoOffscreenRenderQueue::SoOffscreenRenderQueue(void)
+{
+  PRIVATE(this) = new SoOffscreenRenderQueueP;
+}
+
+/*!
+  Destructor. All jobs are removed, and the offscreen contexts are
+  released.
+*/
+SoOffscreenRenderQueue::~SoOffscreenRenderQueue()
+{
+  SbList<int> ids;
+  PRIVATE(this)->jobs.makeKeyList(ids);
+  for (int i = 0; i < ids.getLength(); i++) { this->removeJob(ids[i]); }
+  PRIVATE(this)->deleteWorkers(0);
+#ifdef COIN_THREADSAFE
+  if (PRIVATE(this)->pool) { cc_wpool_destruct(PRIVATE(this)->pool); }
+#endif // COIN_THREADSAFE
+  delete PRIVATE(this);
+}
+
+/*!
+  Sets the components of the images rendered by the following calls
+  to processJobs().
+
+  \sa SoOffscreenRenderer::setComponents()
+*/
+void
+SoOffscreenRenderQueue::setComponents(const SoOffscreenRenderer::Components components)
+{
+  PRIVATE(this)->components = components;
+}
+
+/*!
+  Returns the components of the rendered images.
+*/
+SoOffscreenRenderer::Components
+SoOffscreenRenderQueue::getComponents(void) const
+{
+  return PRIVATE(this)->components;
+}
+
+/*!
+  Sets the background color of the images rendered by the following
+  calls to processJobs().
+
+  \sa SoOffscreenRenderer::setBackgroundColor()
+*/
+void
+SoOffscreenRenderQueue::setBackgroundColor(const SbColor & color)
+{
+  PRIVATE(this)->backgroundcolor = color;
+}
+
+/*!
+  Returns the background color of the rendered images.
+*/
+const SbColor &
+SoOffscreenRenderQueue::getBackgroundColor(void) const
+{
+  return PRIVATE(this)->backgroundcolor;
+}
+
+/*!
+  Sets the number of threads to render jobs with. Each thread has
+  its own SoOffscreenRenderer, with its own offscreen context, and
+  renders whole jobs.
+
+  As with SoOffscreenRenderer::setNumThreads(), this setting is
+  ignored unless Coin was built with thread safe traversals enabled
+  (COIN_THREADSAFE), and the OpenGL offscreen binding must allow
+  contexts to be used from several threads.
+
+  Default is 1.
+*/
+void
+SoOffscreenRenderQueue::setNumThreads(const int numthreads)
+{
+  assert(numthreads >= 1);
+  PRIVATE(this)->numthreads = numthreads;
+  PRIVATE(this)->deleteWorkers(numthreads);
+}
+
+/*!
+  Returns the number of threads used for rendering jobs.
+*/
+int
+SoOffscreenRenderQueue::getNumThreads(void) const
+{
+  return PRIVATE(this)->numthreads;
+}
+
+/*!
+  Adds a job for rendering \a scene with \a camera into an image of
+  \a size pixels, and returns its id.
+
+  If \a camera is \c NULL, the scene graph must contain a camera of
+  its own. If not, the camera is traversed before the scene graph,
+  which should then not contain any camera.
+
+  \a scene and \a camera are referenced until the job is removed, and
+  must not be changed before the job has been rendered.
+
+  \sa processJobs(), removeJob()
+*/
+int
+SoOffscreenRenderQueue::addJob(SoNode * scene, SoCamera * camera,
+                               const SbVec2s & size)
+{
+  assert(scene != NULL);
+  assert(size[0] > 0 && size[1] > 0);
+
+  SoOffscreenRenderJob * job = new SoOffscreenRenderJob;
+  job->id = ++PRIVATE(this)->lastid;
+  if (camera) {
+    SoGroup * root = new SoGroup;
+    root->addChild(camera);
+    root->addChild(scene);
+    job->root = root;
+  }
+  else {
+    job->root = scene;
+  }
+  job->root->ref();
+  job->size = size;
+  job->buffer = NULL;
+  job->done = FALSE;
+
+  PRIVATE(this)->jobs.put(job->id, job);
+  PRIVATE(this)->pending.append(job);
+  return job->id;
+}
+
+/*!
+  Returns the number of jobs waiting for processJobs().
+*/
+int
+SoOffscreenRenderQueue::getNumPendingJobs(void) const
+{
+  return PRIVATE(this)->pending.getLength();
+}
+
+/*!
+  Renders all pending jobs, and returns when they are done.
+
+  Jobs are rendered in the order they were added, except when several
+  threads are used, in which case each thread picks the next job not
+  taken by another.
+
+  \sa setNumThreads(), getJobBuffer()
+*/
+void
+SoOffscreenRenderQueue::processJobs(void)
+{
+  SoOffscreenRenderQueueP * thisp = PRIVATE(this);
+  if (thisp->pending.getLength() == 0) { return; }
+
+  // The first job is rendered before any other thread is started, so
+  // that the one-time setup of the offscreen binding is done by this
+  // thread alone.
+  SoOffscreenRenderer * renderer = thisp->getWorker(0)->renderer;
+  thisp->nextjob = 1;
+  thisp->renderJob(renderer, thisp->pending[0]);
+
+#ifdef COIN_THREADSAFE
+  const int numworkers = SbMin(thisp->numthreads - 1,
+                               thisp->pending.getLength() - 1);
+  if (numworkers > 0) {
+    int i;
+    for (i = 1; i <= numworkers; i++) { (void)thisp->getWorker(i); }
+    if (thisp->pool == NULL) {
+      thisp->pool = cc_wpool_construct(numworkers);
+    }
+    else if (cc_wpool_get_num_workers(thisp->pool) < numworkers) {
+      cc_wpool_set_num_workers(thisp->pool, numworkers);
+    }
+    cc_wpool_begin(thisp->pool, numworkers);
+    for (i = 1; i <= numworkers; i++) {
+      cc_wpool_start_worker(thisp->pool, SoOffscreenRenderQueueP::jobWorker,
+                            thisp->workers[i]);
+    }
+    cc_wpool_end(thisp->pool);
+  }
+#endif // COIN_THREADSAFE
+
+  thisp->renderJobs(renderer);
+
+#ifdef COIN_THREADSAFE
+  if (numworkers > 0) { cc_wpool_wait_all(thisp->pool); }
+#endif // COIN_THREADSAFE
+
+  thisp->pending.truncate(0);
+  thisp->nextjob = 0;
+}
+
+/*!
+  Returns \c TRUE if the job has been processed, whether rendering it
+  succeeded or not.
+*/
+SbBool
+SoOffscreenRenderQueue::isJobDone(const int job) const
+{
+  SoOffscreenRenderJob * data;
+  if (!PRIVATE(this)->jobs.get(job, data)) { return FALSE; }
+  return data->done;
+}
+
+/*!
+  Returns the image rendered for the job, in the same layout as
+  SoOffscreenRenderer::getBuffer(). \c NULL is returned if the job
+  has not been processed yet, or could not be rendered.
+
+  The buffer is owned by the queue, and freed by removeJob().
+*/
+const unsigned char *
+SoOffscreenRenderQueue::getJobBuffer(const int job) const
+{
+  SoOffscreenRenderJob * data;
+  if (!PRIVATE(this)->jobs.get(job, data)) { return NULL; }
+  return data->buffer;
+}
+
+/*!
+  Returns the image size given for the job, or (0, 0) if there is no
+  such job.
+*/
+SbVec2s
+SoOffscreenRenderQueue::getJobSize(const int job) const
+{
+  SoOffscreenRenderJob * data;
+  if (!PRIVATE(this)->jobs.get(job, data)) { return SbVec2s(0, 0); }
+  return data->size;
+}
+
+/*!
+  Removes the job, whether it has been processed or not, and frees
+  its image buffer. The scene graph and camera are unreferenced.
+*/
+void
+SoOffscreenRenderQueue::removeJob(const int job)
+{
+  SoOffscreenRenderJob * data;
+  if (!PRIVATE(this)->jobs.get(job, data)) { return; }
+  PRIVATE(this)->jobs.erase(job);
+  const int idx = PRIVATE(this)->pending.find(data);
+  if (idx != -1) { PRIVATE(this)->pending.remove(idx); }
+  PRIVATE(this)->deleteJob(data);
+}
+
+#undef PRIVATE
@@ -340,7 +340,13 @@
 #include <Inventor/system/gl.h>
 #include <Inventor/SbTime.h>
 
+#ifdef COIN_THREADSAFE
+#include <Inventor/C/threads/wpool.h>
+#include <Inventor/threads/SbMutex.h>
+#endif // COIN_THREADSAFE
+
 #include "glue/simage_wrapper.h"
+#include "threads/threadsutilp.h"
 #include "tidbitsp.h"
 #include "coindefs.h" // COIN_STUB()
 
@@ -378,6 +384,35 @@
 
 // *************************************************************************
 
+// The state used while rendering tiles into one offscreen GL
+// context. The SoOffscreenRenderer has one for its own canvas and
+// render action, and when rendering tiles in parallel, one for each
+// extra thread, with a canvas and render action of its own.
+class SoOffscreenTileContext {
+public:
+  SoOffscreenTileContext(SoOffscreenRendererP * ownerptr)
+  {
+    this->owner = ownerptr;
+    this->glcanvas = NULL;
+    this->renderaction = NULL;
+    this->lastnodewasacamera = FALSE;
+    this->visitedcamera = NULL;
+  }
+
+  SoOffscreenRendererP * owner;
+  CoinOffscreenGLCanvas * glcanvas;
+  SoGLRenderAction * renderaction;
+
+  // The subscreen size of the current tile. (Less than max if it is a
+  // right- or bottom-border tile.)
+  unsigned int subsize[2];
+  // Keeps track of the current tile to be rendered.
+  SbVec2s currenttile;
+
+  SbBool lastnodewasacamera;
+  SoCamera * visitedcamera;
+};
+
 class SoOffscreenRendererP {
 public:
   SoOffscreenRendererP(SoOffscreenRenderer * masterptr,
@@ -392,7 +427,16 @@ public:
     this->components = SoOffscreenRenderer::RGB;
     this->buffer = NULL;
     this->bufferbytesize = 0;
-    this->lastnodewasacamera = FALSE;
+    this->glcanvas = CoinOffscreenGLCanvas::acquire();
+    this->maintile = new SoOffscreenTileContext(this);
+    this->maintile->glcanvas = this->glcanvas;
+    this->numthreads = 1;
+    this->rowcb = NULL;
+    this->rowcbdata = NULL;
+    this->streaming = FALSE;
+#ifdef COIN_THREADSAFE
+    this->pool = NULL;
+#endif // COIN_THREADSAFE
 	
     if (glrenderaction) {
       this->renderaction = glrenderaction;
@@ -412,6 +456,12 @@ public:
   ~SoOffscreenRendererP()
   {
     if (this->didallocation) { delete this->renderaction; }
+    this->deleteExtraContexts(0);
+    delete this->maintile;
+    CoinOffscreenGLCanvas::release(this->glcanvas);
+#ifdef COIN_THREADSAFE
+    if (this->pool) cc_wpool_destruct(this->pool);
+#endif // COIN_THREADSAFE
   }
 
   static SbBool offscreenContextsNotSupported(void);
@@ -421,10 +471,23 @@ public:
   static SoGLRenderAction::AbortCode GLRenderAbortCallback(void *userData);
   SbBool renderFromBase(SoBase * base);
 
-  void setCameraViewvolForTile(SoCamera * cam);
-
+  void renderTileRange(void);
+  void renderTiles(SoOffscreenTileContext * tile);
+  void renderTile(SoOffscreenTileContext * tile, int x, int y);
+  void setCameraViewvolForTile(SoOffscreenTileContext * tile, SoCamera * cam);
+  void deleteExtraContexts(const int keep);
+#ifdef COIN_THREADSAFE
+  void prepareExtraContexts(void);
+  static void tileWorker(void * closure);
+#endif // COIN_THREADSAFE
+
+  static void writeRGBHeader(FILE * fp, unsigned int w, unsigned int h,
+                             unsigned int nrcomponents);
   static SbBool writeToRGB(FILE * fp, unsigned int w, unsigned int h,
                            unsigned int nrcomponents, const uint8_t * imgbuf);
+  static void writeRGBRows(void * userdata, SoOffscreenRenderer * renderer,
+                           const unsigned char * rows,
+                           int firstrow, int numrows);
 
   SbViewportRegion viewport;
   SbColor backgroundcolor;
@@ -438,18 +501,31 @@ public:
   unsigned char * buffer;
   size_t bufferbytesize;
 
-  CoinOffscreenGLCanvas glcanvas;
+  CoinOffscreenGLCanvas * glcanvas;
   int glcanvassize[2];
 
   int numsubscreens[2];
-  // The subscreen size of the current tile. (Less than max if it is a
-  // right- or bottom-border tile.)
-  unsigned int subsize[2];
-  // Keeps track of the current tile to be rendered.
-  SbVec2s currenttile;
-
-  SbBool lastnodewasacamera;
-  SoCamera * visitedcamera;
+  // The scene and image size for the tiled rendering in progress, and
+  // the next tile to hand out to a context.
+  SoBase * tilebase;
+  SbVec2s tilefullsize;
+  int nexttile;
+  int endtile;
+
+  // Set when each row of tiles is handed to the row callback instead
+  // of being kept in the buffer.
+  SoOffscreenRendererRowCB * rowcb;
+  void * rowcbdata;
+  SbBool streaming;
+
+  SoOffscreenTileContext * maintile;
+  SbList<SoOffscreenTileContext *> extracontexts;
+  int numthreads;
+#ifdef COIN_THREADSAFE
+  cc_wpool * pool;
+  SbMutex tilemutex;
+  SbList<SoOffscreenTileContext *> readycontexts;
+#endif // COIN_THREADSAFE
 
   // used for lazy readPixels()
   SbBool didreadbuffer;
@@ -653,6 +729,32 @@ pre_render_cb(void * COIN_UNUSED_ARG(userdata), SoGLRenderAction * action)
   action->setRenderingIsRemote(FALSE);
 }
 
+// The SoGLBigImage change limit is global, and renderers may render
+// in several threads at the same time, so the first render to start
+// raises the limit and the last one to finish restores it.
+static int sooffscreenrenderer_changelimit_users = 0;
+static int sooffscreenrenderer_changelimit_saved = 0;
+
+static void
+sooffscreenrenderer_raise_change_limit(void)
+{
+  CC_GLOBAL_LOCK;
+  if (sooffscreenrenderer_changelimit_users++ == 0) {
+    sooffscreenrenderer_changelimit_saved = SoGLBigImage::setChangeLimit(INT_MAX);
+  }
+  CC_GLOBAL_UNLOCK;
+}
+
+static void
+sooffscreenrenderer_restore_change_limit(void)
+{
+  CC_GLOBAL_LOCK;
+  if (--sooffscreenrenderer_changelimit_users == 0) {
+    (void)SoGLBigImage::setChangeLimit(sooffscreenrenderer_changelimit_saved);
+  }
+  CC_GLOBAL_UNLOCK;
+}
+
 // *************************************************************************
 
 // Callback when rendering scene graph to subscreens. Detects when a
@@ -670,19 +772,19 @@ pre_render_cb(void * COIN_UNUSED_ARG(userdata), SoGLRenderAction * action)
 SoGLRenderAction::AbortCode
 SoOffscreenRendererP::GLRenderAbortCallback(void *userData)
 {
-  SoOffscreenRendererP * thisp = (SoOffscreenRendererP *) userData;
-  const SoFullPath * path = (const SoFullPath*) thisp->renderaction->getCurPath();
+  SoOffscreenTileContext * tile = (SoOffscreenTileContext *) userData;
+  const SoFullPath * path = (const SoFullPath*) tile->renderaction->getCurPath();
   SoNode * node = path->getTail();
   assert(node);
 
-  if (thisp->lastnodewasacamera) {
-    thisp->setCameraViewvolForTile(thisp->visitedcamera);
-    thisp->lastnodewasacamera = FALSE;
+  if (tile->lastnodewasacamera) {
+    tile->owner->setCameraViewvolForTile(tile, tile->visitedcamera);
+    tile->lastnodewasacamera = FALSE;
   }
 
   if (node->isOfType(SoCamera::getClassTypeId())) {
-    thisp->visitedcamera = (SoCamera *) node;
-    thisp->lastnodewasacamera = TRUE;
+    tile->visitedcamera = (SoCamera *) node;
+    tile->lastnodewasacamera = TRUE;
 
     // FIXME: this is not really entirely sufficient. If a camera is
     // already within a cached list upon the first invocation of a
@@ -699,7 +801,7 @@ SoOffscreenRendererP::GLRenderAbortCallback(void *userData)
     // #121 in Coin/BUGS.txt. (The tile number should be in an
     // element, which the SoCamera would query (and thereby also make
     // the cache dependent on)).
-    SoCacheElement::invalidate(thisp->renderaction->getState());
+    SoCacheElement::invalidate(tile->renderaction->getState());
   }
 
   return SoGLRenderAction::CONTINUE;
@@ -721,19 +823,19 @@ SoOffscreenRendererP::renderFromBase(SoBase * base)
   }
 
   const SbVec2s fullsize = this->viewport.getViewportSizePixels();
-  this->glcanvas.setWantedSize(fullsize);
+  this->glcanvas->setWantedSize(fullsize);
 
   // check if no possible canvas size was found
-  if (this->glcanvas.getActualSize() == SbVec2s(0, 0)) { return FALSE; }
+  if (this->glcanvas->getActualSize() == SbVec2s(0, 0)) { return FALSE; }
 
-  const uint32_t newcontext = this->glcanvas.activateGLContext();
+  const uint32_t newcontext = this->glcanvas->activateGLContext();
   if (newcontext == 0) {
     SoDebugError::postWarning("SoOffscreenRenderer::renderFromBase",
                               "Could not set up an offscreen OpenGL context.");
     return FALSE;
   }
 
-  const SbVec2s glsize = this->glcanvas.getActualSize();
+  const SbVec2s glsize = this->glcanvas->getActualSize();
 
   // We need to know the actual GL viewport size for tiled rendering,
   // in calculations when narrowing the camera view volume -- so we
@@ -785,13 +887,18 @@ SoOffscreenRendererP::renderFromBase(SoBase * base)
   // value to indicate whether or not stuff should be rendered in
   // maximum quality. That would be generally useful for having better
   // control from the offscreenrenderer.
-  const int bigimagechangelimit = SoGLBigImage::setChangeLimit(INT_MAX);
+  sooffscreenrenderer_raise_change_limit();
+
+  // When the image is streamed to the row callback, only one row of
+  // tiles is kept in memory at a time.
+  this->streaming = (this->rowcb != NULL);
+  const int bufrows = this->streaming ? SbMin(glsize[1], fullsize[1]) : fullsize[1];
 
   // Deallocate old and allocate new target buffer, if necessary.
   //
   // If we need more space:
   const size_t bufsize =
-    size_t(fullsize[0]) * size_t(fullsize[1]) * size_t(PUBLIC(this)->getComponents());
+    size_t(fullsize[0]) * size_t(bufrows) * size_t(PUBLIC(this)->getComponents());
   SbBool alloc = (bufsize > this->bufferbytesize);
   // or if old buffer was much larger, free up the memory by fitting
   // to smaller size:
@@ -835,8 +942,8 @@ SoOffscreenRendererP::renderFromBase(SoBase * base)
   // SoExtSelection, rather than adding some kind of "semi-private"
   // API to let SoExtSelection find out whether or not tiled rendering
   // is used). 20041028 mortene.
-  const SbBool tiledrendering =
-    forcetiled || (fullsize[0] > glsize[0]) || (fullsize[1] > glsize[1]);
+  const SbBool tiledrendering = forcetiled || this->streaming ||
+    (fullsize[0] > glsize[0]) || (fullsize[1] > glsize[1]);
 
   // Shall we use subscreen rendering or regular one-screen renderer?
   if (tiledrendering) {
@@ -846,78 +953,47 @@ SoOffscreenRendererP::renderFromBase(SoBase * base)
     for (int i=0; i < 2; i++) {
       this->numsubscreens[i] = (fullsize[i] + (glsize[i] - 1)) / glsize[i];
     }
+    this->tilebase = base;
+    this->tilefullsize = fullsize;
 
     // We have to grab cameras using this callback during rendering
-    this->visitedcamera = NULL;
-    this->renderaction->setAbortCallback(SoOffscreenRendererP::GLRenderAbortCallback, this);
-
-    // Render entire scene graph for each subscreen.
-    for (int y=0; y < this->numsubscreens[1]; y++) {
-      for (int x=0; x < this->numsubscreens[0]; x++) {
-        this->currenttile = SbVec2s(x, y);
-
-        // Find current "active" tilesize.
-        this->subsize[0] = glsize[0];
-        this->subsize[1] = glsize[1];
-        if (x == (this->numsubscreens[0] - 1)) {
-          this->subsize[0] = fullsize[0] % glsize[0];
-          if (this->subsize[0] == 0) { this->subsize[0] = glsize[0]; }
-        }
-        if (y == (this->numsubscreens[1] - 1)) {
-          this->subsize[1] = fullsize[1] % glsize[1];
-          if (this->subsize[1] == 0) { this->subsize[1] = glsize[1]; }
-        }
-
-        SbViewportRegion subviewport = SbViewportRegion(SbVec2s(this->subsize[0], this->subsize[1]));
-        this->renderaction->setViewportRegion(subviewport);
-
-        if (base->isOfType(SoNode::getClassTypeId()))
-          this->renderaction->apply((SoNode *)base);
-        else if (base->isOfType(SoPath::getClassTypeId()))
-          this->renderaction->apply((SoPath *)base);
-        else {
-          assert(FALSE && "Cannot apply to anything else than an SoNode or an SoPath");
-        }
-
-        const unsigned int nrcomp = PUBLIC(this)->getComponents();
-
-        const int MAINBUF_OFFSET =
-          (glsize[1] * y * fullsize[0] + glsize[0] * x) * nrcomp;
-
-        const SbVec2s vpsize = subviewport.getViewportSizePixels();
-        this->glcanvas.readPixels(this->buffer + MAINBUF_OFFSET,
-                                  vpsize, fullsize[0], nrcomp);
-
-        // Debug option to dump the (full) buffer after each
-        // iteration.
-        if (SoOffscreenRendererP::debugTileOutputPrefix()) {
-          SbString s;
-          s.sprintf("%s_%03d_%03d.rgb",
-                    SoOffscreenRendererP::debugTileOutputPrefix(), x, y);
-
-          FILE * f = fopen(s.getString(), "wb");
-		  if (f) {
-            SbBool w = SoOffscreenRendererP::writeToRGB(f, fullsize[0], fullsize[1],
-                                                        nrcomp, this->buffer);
-            assert(w);
-            const int r = fclose(f);
-            assert(r == 0);
-		  }
-
-          // This is sometimes useful to enable during debugging to
-          // see the exact order and position of the tiles. Not
-          // enabled by default because it makes the final buffer
-          // completely blank.
-#if 0 // debug
-          (void)memset(this->buffer, 0x00, bufsize);
-#endif // debug
-        }
+    this->maintile->renderaction = this->renderaction;
+    this->maintile->lastnodewasacamera = FALSE;
+    this->maintile->visitedcamera = NULL;
+    this->renderaction->setAbortCallback(SoOffscreenRendererP::GLRenderAbortCallback, this->maintile);
+
+#ifdef COIN_THREADSAFE
+    this->prepareExtraContexts();
+#endif // COIN_THREADSAFE
+
+    const int numtiles = this->numsubscreens[0] * this->numsubscreens[1];
+    if (this->streaming) {
+      // Render one row of tiles at a time, and hand it over before
+      // the buffer is reused for the next row.
+      for (int y = 0; y < this->numsubscreens[1]; y++) {
+        this->nexttile = y * this->numsubscreens[0];
+        this->endtile = this->nexttile + this->numsubscreens[0];
+        this->renderTileRange();
+
+        const int firstrow = y * glsize[1];
+        const int numrows = SbMin(int(glsize[1]), fullsize[1] - firstrow);
+        this->rowcb(this->rowcbdata, PUBLIC(this), this->buffer,
+                    firstrow, numrows);
       }
     }
+    else {
+      this->nexttile = 0;
+      this->endtile = numtiles;
+      this->renderTileRange();
+    }
 
     this->renderaction->setAbortCallback(NULL, this);
 
-    if (!this->visitedcamera) {
+    SoCamera * visitedcamera = this->maintile->visitedcamera;
+    for (int j = 0; j < this->extracontexts.getLength() && !visitedcamera; j++) {
+      visitedcamera = this->extracontexts[j]->visitedcamera;
+    }
+    if (!visitedcamera) {
       SoDebugError::postWarning("SoOffscreenRenderer::renderFromBase",
                                 "No camera node found in scene graph while rendering offscreen image. "
                                 "The result will most likely be incorrect.");
@@ -962,9 +1038,9 @@ SoOffscreenRendererP::renderFromBase(SoBase * base)
   this->renderaction->removePreRenderCallback(pre_render_cb, NULL);
 
   // Restore old value.
-  (void)SoGLBigImage::setChangeLimit(bigimagechangelimit);
+  sooffscreenrenderer_restore_change_limit();
 
-  this->glcanvas.deactivateGLContext();
+  this->glcanvas->deactivateGLContext();
   this->renderaction->setCacheContext(oldcontext); // restore old
 
   if(this->useDC)
@@ -973,6 +1049,246 @@ SoOffscreenRendererP::renderFromBase(SoBase * base)
   return TRUE;
 }
 
+// Renders the tiles from nexttile up to endtile, in the main context
+// and in the extra contexts which are ready for use.
+void
+SoOffscreenRendererP::renderTileRange(void)
+{
+#ifdef COIN_THREADSAFE
+  const int numworkers = SbMin(this->readycontexts.getLength(),
+                               this->endtile - this->nexttile - 1);
+  if (numworkers > 0) {
+    cc_wpool_begin(this->pool, numworkers);
+    for (int i = 0; i < numworkers; i++) {
+      cc_wpool_start_worker(this->pool, SoOffscreenRendererP::tileWorker,
+                            this->readycontexts[i]);
+    }
+    cc_wpool_end(this->pool);
+  }
+#endif // COIN_THREADSAFE
+
+  // Render entire scene graph for each subscreen not taken by
+  // another thread.
+  this->renderTiles(this->maintile);
+
+#ifdef COIN_THREADSAFE
+  if (numworkers > 0) { cc_wpool_wait_all(this->pool); }
+#endif // COIN_THREADSAFE
+}
+
+// Renders tiles into the context of the given tile context until
+// there are no more tiles left. The tiles are handed out in the same
+// order as they were rendered in before multiple threads could be
+// used, row by row from the bottom of the image.
+void
+SoOffscreenRendererP::renderTiles(SoOffscreenTileContext * tile)
+{
+  for (;;) {
+#ifdef COIN_THREADSAFE
+    this->tilemutex.lock();
+#endif // COIN_THREADSAFE
+    const int idx = this->nexttile++;
+#ifdef COIN_THREADSAFE
+    this->tilemutex.unlock();
+#endif // COIN_THREADSAFE
+    if (idx >= this->endtile) { break; }
+
+    this->renderTile(tile, idx % this->numsubscreens[0], idx / this->numsubscreens[0]);
+  }
+}
+
+// Renders a single tile, and copies it into its place in the
+// buffer. The tiles never overlap, so this can be done from several
+// threads at once.
+void
+SoOffscreenRendererP::renderTile(SoOffscreenTileContext * tile, int x, int y)
+{
+  const SbVec2s fullsize = this->tilefullsize;
+  const SbVec2s glsize(this->glcanvassize[0], this->glcanvassize[1]);
+
+  tile->currenttile = SbVec2s(x, y);
+
+  // Find current "active" tilesize.
+  tile->subsize[0] = glsize[0];
+  tile->subsize[1] = glsize[1];
+  if (x == (this->numsubscreens[0] - 1)) {
+    tile->subsize[0] = fullsize[0] % glsize[0];
+    if (tile->subsize[0] == 0) { tile->subsize[0] = glsize[0]; }
+  }
+  if (y == (this->numsubscreens[1] - 1)) {
+    tile->subsize[1] = fullsize[1] % glsize[1];
+    if (tile->subsize[1] == 0) { tile->subsize[1] = glsize[1]; }
+  }
+
+  SbViewportRegion subviewport = SbViewportRegion(SbVec2s(tile->subsize[0], tile->subsize[1]));
+  tile->renderaction->setViewportRegion(subviewport);
+
+  SoBase * base = this->tilebase;
+  if (base->isOfType(SoNode::getClassTypeId()))
+    tile->renderaction->apply((SoNode *)base);
+  else if (base->isOfType(SoPath::getClassTypeId()))
+    tile->renderaction->apply((SoPath *)base);
+  else {
+    assert(FALSE && "Cannot apply to anything else than an SoNode or an SoPath");
+  }
+
+  const unsigned int nrcomp = PUBLIC(this)->getComponents();
+
+  // when streaming, the buffer only holds the current row of tiles
+  const size_t rowoffset =
+    this->streaming ? 0 : size_t(glsize[1]) * y * fullsize[0];
+  const size_t MAINBUF_OFFSET = (rowoffset + size_t(glsize[0]) * x) * nrcomp;
+
+  const SbVec2s vpsize = subviewport.getViewportSizePixels();
+  tile->glcanvas->readPixels(this->buffer + MAINBUF_OFFSET,
+                             vpsize, fullsize[0], nrcomp);
+
+  // Debug option to dump the (full) buffer after each
+  // iteration.
+  if (SoOffscreenRendererP::debugTileOutputPrefix() && !this->streaming) {
+    SbString s;
+    s.sprintf("%s_%03d_%03d.rgb",
+              SoOffscreenRendererP::debugTileOutputPrefix(), x, y);
+
+    FILE * f = fopen(s.getString(), "wb");
+    if (f) {
+      SbBool w = SoOffscreenRendererP::writeToRGB(f, fullsize[0], fullsize[1],
+                                                  nrcomp, this->buffer);
+      assert(w);
+      const int r = fclose(f);
+      assert(r == 0);
+    }
+
+    // This is sometimes useful to enable during debugging to
+    // see the exact order and position of the tiles. Not
+    // enabled by default because it makes the final buffer
+    // completely blank.
+#if 0 // debug
+    (void)memset(this->buffer, 0x00, size_t(fullsize[0]) * size_t(fullsize[1]) * nrcomp);
+#endif // debug
+  }
+}
+
+// Deletes the extra contexts used for rendering tiles in parallel,
+// except the first keep ones.
+void
+SoOffscreenRendererP::deleteExtraContexts(const int keep)
+{
+  while (this->extracontexts.getLength() > keep) {
+    SoOffscreenTileContext * tile = this->extracontexts.pop();
+    delete tile->renderaction;
+    CoinOffscreenGLCanvas::release(tile->glcanvas);
+    delete tile;
+  }
+}
+
+#ifdef COIN_THREADSAFE
+
+// Sets up one extra context for each thread beyond the first, for
+// the worker pool to render tiles into.
+//
+// The contexts are created and prepared here, in the calling thread,
+// and left for the workers to make current. Only contexts with the
+// same size as the main context are used, as the tile size decides
+// the camera view volume of each tile, and thereby the exact output.
+void
+SoOffscreenRendererP::prepareExtraContexts(void)
+{
+  int i;
+  for (i = 0; i < this->extracontexts.getLength(); i++) {
+    this->extracontexts[i]->visitedcamera = NULL;
+  }
+  SbList<SoOffscreenTileContext *> & ready = this->readycontexts;
+  ready.truncate(0);
+
+  // no more tiles than in one row are rendered at a time when streaming
+  const int numtiles = this->streaming ? this->numsubscreens[0] :
+    this->numsubscreens[0] * this->numsubscreens[1];
+  const int numextra = SbMin(this->numthreads, numtiles) - 1;
+  if (numextra < 1) { return; }
+
+  const SbVec2s glsize(this->glcanvassize[0], this->glcanvassize[1]);
+
+  for (i = 0; i < numextra; i++) {
+    if (i == this->extracontexts.getLength()) {
+      SoOffscreenTileContext * tile = new SoOffscreenTileContext(this);
+      tile->glcanvas = CoinOffscreenGLCanvas::acquire();
+      tile->renderaction = new SoGLRenderAction(this->viewport);
+      tile->renderaction->addPreRenderCallback(pre_render_cb, NULL);
+      tile->renderaction->setAbortCallback(SoOffscreenRendererP::GLRenderAbortCallback, tile);
+      this->extracontexts.append(tile);
+    }
+    SoOffscreenTileContext * tile = this->extracontexts[i];
+
+    tile->glcanvas->setWantedSize(this->tilefullsize);
+    if (tile->glcanvas->getActualSize() != glsize) {
+      // left with a different size from an earlier render, start over
+      delete tile->glcanvas;
+      tile->glcanvas = new CoinOffscreenGLCanvas;
+      tile->glcanvas->setWantedSize(this->tilefullsize);
+    }
+    if (tile->glcanvas->getActualSize() != glsize) { continue; }
+
+    const uint32_t context = tile->glcanvas->activateGLContext();
+    if (context == 0) { continue; }
+    if (tile->glcanvas->getActualSize() == glsize) {
+      glEnable(GL_DEPTH_TEST);
+      glClearColor(this->backgroundcolor[0],
+                   this->backgroundcolor[1],
+                   this->backgroundcolor[2],
+                   0.0f);
+
+      SoGLRenderAction * action = tile->renderaction;
+      action->setCacheContext(context);
+      action->setTransparencyType(this->renderaction->getTransparencyType());
+      action->setTransparentDelayedObjectRenderType(this->renderaction->getTransparentDelayedObjectRenderType());
+      action->setSmoothing(this->renderaction->isSmoothing());
+      action->setNumPasses(this->renderaction->getNumPasses());
+      action->setPassUpdate(this->renderaction->isPassUpdate());
+      action->setSortedLayersNumPasses(this->renderaction->getSortedLayersNumPasses());
+      action->setDelayedObjDepthWrite(this->renderaction->getDelayedObjDepthWrite());
+
+      tile->lastnodewasacamera = FALSE;
+      ready.append(tile);
+    }
+    tile->glcanvas->deactivateGLContext();
+  }
+
+  if (CoinOffscreenGLCanvas::debug()) {
+    SoDebugError::postInfo("SoOffscreenRendererP::prepareExtraContexts",
+                           "rendering tiles with %d extra contexts",
+                           ready.getLength());
+  }
+
+  const int numworkers = ready.getLength();
+  if (numworkers == 0) { return; }
+
+  if (this->pool == NULL) {
+    this->pool = cc_wpool_construct(numworkers);
+  }
+  else if (cc_wpool_get_num_workers(this->pool) < numworkers) {
+    cc_wpool_set_num_workers(this->pool, numworkers);
+  }
+}
+
+// Renders tiles into one of the extra contexts, from a worker thread.
+void
+SoOffscreenRendererP::tileWorker(void * closure)
+{
+  SoOffscreenTileContext * tile = (SoOffscreenTileContext *) closure;
+  SoOffscreenRendererP * thisp = tile->owner;
+
+  if (tile->glcanvas->activateGLContext() == 0) { return; }
+  // the tiles not taken here are rendered by the other contexts
+  if (tile->glcanvas->getActualSize() ==
+      SbVec2s(thisp->glcanvassize[0], thisp->glcanvassize[1])) {
+    thisp->renderTiles(tile);
+  }
+  tile->glcanvas->deactivateGLContext();
+}
+
+#endif // COIN_THREADSAFE
+
 /*!
   Render the scene graph rooted at \a scene into our internal pixel
   buffer.
@@ -1034,18 +1350,24 @@ SoOffscreenRenderer::render(SoPath * scene)
 
 /*!
   Returns the offscreen memory buffer.
+
+  After rendering with a row callback set, the image is not kept in
+  memory, and \c NULL is returned.
+
+  \sa setRowCallback()
 */
 unsigned char *
 SoOffscreenRenderer::getBuffer(void) const
 {
+  if (PRIVATE(this)->streaming) { return NULL; }
   if (!PRIVATE(this)->didreadbuffer) {
     const SbVec2s dims = this->getViewportRegion().getViewportSizePixels();
     //fprintf(stderr,"reading pixels: %d %d\n", dims[0], dims[1]);
 
-    PRIVATE(this)->glcanvas.activateGLContext();
-    PRIVATE(this)->glcanvas.readPixels(PRIVATE(this)->buffer, dims, dims[0],
+    PRIVATE(this)->glcanvas->activateGLContext();
+    PRIVATE(this)->glcanvas->readPixels(PRIVATE(this)->buffer, dims, dims[0],
                                        (unsigned int) this->getComponents());
-    PRIVATE(this)->glcanvas.deactivateGLContext();
+    PRIVATE(this)->glcanvas->deactivateGLContext();
     PRIVATE(this)->didreadbuffer = TRUE;
   }
   return PRIVATE(this)->buffer;
@@ -1088,12 +1410,12 @@ SoOffscreenRenderer::getDC(void) const
 	PRIVATE(this)->updateDCBitmap();
   }
   
-  return PRIVATE(this)->glcanvas.getHDC();
+  return PRIVATE(this)->glcanvas->getHDC();
 }
 
 void SoOffscreenRendererP::updateDCBitmap()
 {
-  this->glcanvas.updateDCBitmap();
+  this->glcanvas->updateDCBitmap();
 }
 // *************************************************************************
 
@@ -1109,10 +1431,9 @@ write_short(FILE * fp, unsigned short val)
   return fwrite(&tmp, 2, 1, fp);
 }
 
-SbBool
-SoOffscreenRendererP::writeToRGB(FILE * fp, unsigned int w, unsigned int h,
-                                 unsigned int nrcomponents,
-                                 const uint8_t * imgbuf)
+void
+SoOffscreenRendererP::writeRGBHeader(FILE * fp, unsigned int w, unsigned int h,
+                                     unsigned int nrcomponents)
 {
   // FIXME: add code to rle rows, pederb 2000-01-10
 
@@ -1135,6 +1456,14 @@ SoOffscreenRendererP::writeToRGB(FILE * fp, unsigned int w, unsigned int h,
   strcpy((char *)buf+8, "https://github.com/coin3d/");
   const size_t wrote = fwrite(buf, 1, BUFSIZE, fp);
   assert(wrote == BUFSIZE);
+}
+
+SbBool
+SoOffscreenRendererP::writeToRGB(FILE * fp, unsigned int w, unsigned int h,
+                                 unsigned int nrcomponents,
+                                 const uint8_t * imgbuf)
+{
+  SoOffscreenRendererP::writeRGBHeader(fp, w, h, nrcomponents);
 
   unsigned char * tmpbuf = new unsigned char[w];
 
@@ -1173,10 +1502,11 @@ SoOffscreenRenderer::writeToRGB(FILE * fp) const
   if (SoOffscreenRendererP::offscreenContextsNotSupported()) { return FALSE; }
 
   SbVec2s size = PRIVATE(this)->viewport.getViewportSizePixels();
+  const unsigned char * buffer = this->getBuffer();
+  if (buffer == NULL) { return FALSE; }
 
   return SoOffscreenRendererP::writeToRGB(fp, size[0], size[1],
-                                          this->getComponents(),
-                                          this->getBuffer());
+                                          this->getComponents(), buffer);
 }
 
 /*!
@@ -1260,6 +1590,7 @@ SoOffscreenRenderer::writeToPostScript(FILE * fp,
                           (short)(printsize[1]*defaultdpi));
 
   const unsigned char * src = this->getBuffer();
+  if (src == NULL) { return FALSE; }
   const int chan = nc <= 2 ? 1 : 3;
   const SbVec2s scaledsize((short) ceil(size[0]*defaultdpi/dpi),
                            (short) ceil(size[1]*defaultdpi/dpi));
@@ -1611,6 +1942,7 @@ SoOffscreenRenderer::writeToFile(const SbString & filename, const SbName & filet
   SbVec2s size = PRIVATE(this)->viewport.getViewportSizePixels();
   int comp = (int) this->getComponents();
   unsigned char * bytes = this->getBuffer();
+  if (bytes == NULL) { return FALSE; }
   int ret = simage_wrapper()->simage_save_image(filename.getString(),
                                                 bytes,
                                                 int(size[0]), int(size[1]), comp,
@@ -1668,14 +2000,268 @@ SoOffscreenRenderer::getPbufferEnable(void) const
   return TRUE;
 }
 
+/*!
+  Sets the number of threads used for rendering, when the image is
+  larger than what can be rendered into a single offscreen context
+  and must be rendered in tiles.
+
+  With more than one thread, an extra offscreen context with a render
+  action of its own is set up for each additional thread, and the
+  tiles are rendered into the contexts at the same time. The extra
+  render actions use separate cache contexts, and get their settings
+  (transparency type, smoothing, number of passes and so on) copied
+  from the render action of the SoOffscreenRenderer before each
+  render. Callbacks and the sorted object order strategy set on that
+  render action are not copied, so these should not be used with
+  multiple threads.
+
+  The resulting image is identical to the one rendered with a single
+  thread. An extra context is only used if it gets the same size as
+  the first one, otherwise its tiles are rendered by the others.
+
+  The scene graph is traversed from several threads at once, so this
+  setting is ignored unless Coin was built with thread safe
+  traversals enabled (COIN_THREADSAFE), and the OpenGL offscreen
+  binding must allow contexts to be used from several threads. With
+  GLX, this means that the application must have called
+  XInitThreads() before any other Xlib call.
+
+  Default is 1.
+
+  \sa getNumThreads(), getMaximumResolution()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoOffscreenRenderer::setNumThreads(const int numthreads)
+{
+  assert(numthreads >= 1);
+  PRIVATE(this)->numthreads = numthreads;
+  PRIVATE(this)->deleteExtraContexts(numthreads - 1);
+}
+
+/*!
+  Returns the number of threads used for tiled rendering.
+
+  \sa setNumThreads()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+int
+SoOffscreenRenderer::getNumThreads(void) const
+{
+  return PRIVATE(this)->numthreads;
+}
+
+/*!
+  Sets the number of offscreen OpenGL contexts to keep around when
+  SoOffscreenRenderer instances are destructed, for later instances
+  to reuse.
+
+  Setting up an offscreen context is costly, and all OpenGL resources
+  made for the scene graph -- render caches, textures and vertex
+  buffer objects -- are lost with it. A reused context keeps its
+  cache context id, so these resources stay valid, and rendering the
+  same (or a partly shared) scene graph again with a new
+  SoOffscreenRenderer instance will not have to recreate them. This
+  is useful when a lot of small images are rendered one after the
+  other, as when making thumbnails. See also SoOffscreenRenderQueue.
+
+  The extra contexts used for rendering tiles in parallel (see
+  setNumThreads()) are taken from and returned to the same pool.
+
+  Lowering the pool size destructs pooled contexts beyond the new
+  size right away. All pooled contexts are destructed by SoDB::finish().
+
+  Default is 0, which means contexts are destructed together with
+  the SoOffscreenRenderer instance using them.
+
+  \sa getContextPoolSize()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoOffscreenRenderer::setContextPoolSize(const int numcontexts)
+{
+  CoinOffscreenGLCanvas::setPoolSize(numcontexts);
+}
+
+/*!
+  Returns the number of offscreen contexts kept for reuse.
+
+  \sa setContextPoolSize()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+int
+SoOffscreenRenderer::getContextPoolSize(void)
+{
+  return CoinOffscreenGLCanvas::getPoolSize();
+}
+
+/*!
+  Sets a callback which gets the rendered image one row of tiles at a
+  time, instead of having the full image kept in the buffer. This
+  makes it possible to render images which are too large to keep in
+  memory, as only one row of tiles is in memory at once.
+
+  The callback is invoked from render() for each row of tiles, from
+  the bottom of the image and up. \a rows points to \a numrows rows
+  of pixels, starting with row number \a firstrow from the bottom of
+  the image. Each row has the full width of the image, in the format
+  given by getComponents(), with no padding between rows. The pixels
+  are only valid until the callback returns.
+
+  With a callback set, the image is always rendered in tiles, and
+  getBuffer() returns \c NULL after rendering. Pass \c NULL to go
+  back to keeping the image in the buffer.
+
+  \sa renderToRGB(), getMaximumResolution()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoOffscreenRenderer::setRowCallback(SoOffscreenRendererRowCB * func,
+                                    void * userdata)
+{
+  PRIVATE(this)->rowcb = func;
+  PRIVATE(this)->rowcbdata = userdata;
+}
+
+// Data for writing an SGI RGB file while rendering.
+struct SoOffscreenRGBWriter {
+  FILE * fp;
+  int64_t start;
+  unsigned int width, height, nrcomponents;
+  unsigned char * tmpbuf;
+  SbBool ok;
+};
+
+// Row callback for renderToRGB(). The RGB format stores each
+// component in a separate plane, so the rows of each plane are put in
+// place with a seek.
+void
+SoOffscreenRendererP::writeRGBRows(void * userdata,
+                                   SoOffscreenRenderer * COIN_UNUSED_ARG(renderer),
+                                   const unsigned char * rows,
+                                   int firstrow, int numrows)
+{
+  SoOffscreenRGBWriter * writer = (SoOffscreenRGBWriter *) userdata;
+  const unsigned int w = writer->width;
+  const unsigned int nrcomponents = writer->nrcomponents;
+
+  for (unsigned int c = 0; c < nrcomponents && writer->ok; c++) {
+    const int64_t offset = writer->start + 512 +
+      (int64_t(c) * writer->height + firstrow) * int64_t(w);
+    writer->ok = (coin_fseek64(writer->fp, offset, SEEK_SET) == 0);
+    for (int y = 0; y < numrows && writer->ok; y++) {
+      const unsigned char * src = rows + size_t(y) * w * nrcomponents + c;
+      for (unsigned int x = 0; x < w; x++) {
+        writer->tmpbuf[x] = src[x * nrcomponents];
+      }
+      writer->ok = (fwrite(writer->tmpbuf, 1, w, writer->fp) == w);
+    }
+  }
+}
+
+/*!
+  Renders the \a scene, and writes the image in SGI RGB format to the
+  already open file, a row of tiles at a time as they are rendered.
+  The full image is never kept in memory, see setRowCallback().
+
+  The file must be seekable, as the RGB format stores the image
+  components one after another. Returns \c FALSE if rendering or
+  writing fails.
+
+  The same note about Microsoft Windows DLLs as for writeToRGB()
+  applies to this method.
+
+  \sa setRowCallback(), writeToRGB()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+SbBool
+SoOffscreenRenderer::renderToRGB(SoNode * scene, FILE * fp)
+{
+  if (SoOffscreenRendererP::offscreenContextsNotSupported()) { return FALSE; }
+
+  const SbVec2s size = PRIVATE(this)->viewport.getViewportSizePixels();
+  SoOffscreenRGBWriter writer;
+  writer.fp = fp;
+  writer.start = coin_ftell64(fp);
+  writer.width = size[0];
+  writer.height = size[1];
+  writer.nrcomponents = this->getComponents();
+  writer.tmpbuf = new unsigned char[size[0]];
+  writer.ok = (writer.start >= 0);
+
+  if (writer.ok) {
+    SoOffscreenRendererP::writeRGBHeader(fp, writer.width, writer.height,
+                                         writer.nrcomponents);
+  }
+
+  SoOffscreenRendererRowCB * prevcb = PRIVATE(this)->rowcb;
+  void * prevdata = PRIVATE(this)->rowcbdata;
+  this->setRowCallback(SoOffscreenRendererP::writeRGBRows, &writer);
+  const SbBool rendered = writer.ok && this->render(scene);
+  this->setRowCallback(prevcb, prevdata);
+  delete[] writer.tmpbuf;
+
+  if (rendered && !writer.ok) {
+    SoDebugError::postWarning("SoOffscreenRenderer::renderToRGB",
+                              "error when writing RGB file");
+  }
+  return rendered && writer.ok;
+}
+
+/*!
+  Opens a file with the given name, and renders the \a scene into it
+  in SGI RGB format, a row of tiles at a time. If the file already
+  exists, it will be overwritten (if permitted by the filesystem).
+
+  Returns \c TRUE if all went ok, otherwise \c FALSE.
+
+  \sa setRowCallback(), writeToRGB()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+SbBool
+SoOffscreenRenderer::renderToRGB(SoNode * scene, const char * filename)
+{
+  FILE * rgbfp = fopen(filename, "wb");
+  if (!rgbfp) {
+    SoDebugError::postWarning("SoOffscreenRenderer::renderToRGB",
+                              "couldn't open file '%s'", filename);
+    return FALSE;
+  }
+  SbBool result = this->renderToRGB(scene, rgbfp);
+  (void)fclose(rgbfp);
+  return result;
+}
+
 // *************************************************************************
 
 // FIXME: this should really be done by SoCamera, on the basis of data
 // from an "SoTileRenderingElement". See BUGS.txt, item #121. 20050712 mortene.
 void
-SoOffscreenRendererP::setCameraViewvolForTile(SoCamera * cam)
+SoOffscreenRendererP::setCameraViewvolForTile(SoOffscreenTileContext * tile, SoCamera * cam)
 {
-  SoState * state = (PUBLIC(this)->getGLRenderAction())->getState();
+  SoGLRenderAction * renderaction = tile->renderaction;
+  SoState * state = renderaction->getState();
 
   // A small trick to change the aspect ratio without changing the
   // scene graph camera.
@@ -1716,10 +2302,10 @@ SoOffscreenRendererP::setCameraViewvolForTile(SoCamera * cam)
     break;
   }
 
-  const int LEFTINTPOS = (this->currenttile[0] * this->glcanvassize[0]) - vporigin[0];
-  const int RIGHTINTPOS = LEFTINTPOS + this->subsize[0];
-  const int TOPINTPOS = (this->currenttile[1] * this->glcanvassize[1]) - vporigin[1];
-  const int BOTTOMINTPOS = TOPINTPOS + this->subsize[1];
+  const int LEFTINTPOS = (tile->currenttile[0] * this->glcanvassize[0]) - vporigin[0];
+  const int RIGHTINTPOS = LEFTINTPOS + tile->subsize[0];
+  const int TOPINTPOS = (tile->currenttile[1] * this->glcanvassize[1]) - vporigin[1];
+  const int BOTTOMINTPOS = TOPINTPOS + tile->subsize[1];
 
   const SbVec2s fullsize = this->viewport.getViewportSizePixels();
   const float left = float(LEFTINTPOS) / float(fullsize[0]);
@@ -1732,7 +2318,7 @@ SoOffscreenRendererP::setCameraViewvolForTile(SoCamera * cam)
   if (CoinOffscreenGLCanvas::debug()) {
     SoDebugError::postInfo("SoOffscreenRendererP::setCameraViewvolForTile",
                            "narrowing for tile <%d, %d>: <%f, %f> - <%f, %f>",
-                           this->currenttile[0], this->currenttile[1],
+                           tile->currenttile[0], tile->currenttile[1],
                            left, bottom, right, top);
   }
 
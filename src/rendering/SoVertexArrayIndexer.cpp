@@ -430,12 +430,26 @@ SoVertexArrayIndexer::sort_triangles(void)
   // GPU vertex cache. Not the optimal solution, but should work
   // pretty well. Example: bunny.iv (~70000 triangles) went from 238
   // fps with no sorting to 380 fps with sorting.
-  if (this->indexarray.getLength()) {
-    qsort((void*) this->indexarray.getArrayPtr(),
-          this->indexarray.getLength() / 3,
-          sizeof(int32_t) * 3,
-          compare_triangle);
+  const int numindices = this->indexarray.getLength();
+  if (numindices == 0) return;
+
+  // keep the order if the vertices are numbered in the order the
+  // triangles first use them, as for shapes made by
+  // SoReorganizeAction. The vertex data was then laid out for this
+  // triangle order, which is already ordered for the cache.
+  int32_t * indices = const_cast<int32_t *>(this->indexarray.getArrayPtr());
+  int32_t numused = 0;
+  int i;
+  for (i = 0; i < numindices; i++) {
+    if (indices[i] > numused) break;
+    if (indices[i] == numused) numused++;
   }
+  if (i == numindices) return;
+
+  qsort((void*) indices,
+        numindices / 3,
+        sizeof(int32_t) * 3,
+        compare_triangle);
 }
 
 //
@@ -39,6 +39,7 @@
 #include "SoGLNurbs.cpp"
 #include "SoOffscreenCGData.cpp"
 #include "SoOffscreenGLXData.cpp"
+#include "SoOffscreenRenderQueue.cpp"
 #include "SoOffscreenRenderer.cpp"
 #include "SoOffscreenWGLData.cpp"
 #include "SoRenderManager.cpp"
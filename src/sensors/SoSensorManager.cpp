@@ -107,7 +107,7 @@
 #include <Inventor/threads/SbMutex.h>
 #endif // COIN_THREADSAFE
 
-#include "misc/SbHash.h"
+#include "misc/SbFlatHash.h"
 #include "coindefs.h" // COIN_STUB()
 
 // *************************************************************************
@@ -134,6 +134,109 @@
 
 // *************************************************************************
 
+// A binary min-heap of sensors, ordered on a sort key (trigger time
+// or priority) and then on insertion order, so that sensors with the
+// same key are still processed first in, first out. The position of
+// each sensor in the heap is kept in a hash table, which makes
+// removing an arbitrary sensor O(log n) instead of a linear search.
+template <class Sensor, class Key>
+class SoSensorHeap {
+public:
+  SoSensorHeap(void) : counter(0) { }
+
+  int getLength(void) const { return this->entries.getLength(); }
+  Sensor * top(void) const { return this->entries[0].sensor; }
+
+  void insert(Sensor * sensor, const Key key) {
+    Entry entry;
+    entry.key = key;
+    entry.seq = this->counter++;
+    entry.sensor = sensor;
+    this->entries.append(entry);
+    this->siftUp(this->entries.getLength() - 1);
+  }
+
+  Sensor * pop(void) {
+    Sensor * sensor = this->entries[0].sensor;
+    this->removeAt(0);
+    return sensor;
+  }
+
+  SbBool remove(Sensor * sensor) {
+    int idx;
+    if (!this->positions.get(sensor, idx)) return FALSE;
+    this->removeAt(idx);
+    return TRUE;
+  }
+
+private:
+  class Entry {
+  public:
+    Key key;
+    uint32_t seq;
+    Sensor * sensor;
+  };
+
+  // The sequence numbers are compared as a signed difference, so the
+  // counter can wrap around as long as fewer than 2^31 sensors are
+  // inserted while one of them is waiting.
+  static SbBool isBefore(const Entry & a, const Entry & b) {
+    if (a.key != b.key) return a.key < b.key;
+    return static_cast<int32_t>(a.seq - b.seq) < 0;
+  }
+
+  void place(const Entry & entry, const int idx) {
+    this->entries[idx] = entry;
+    this->positions.put(entry.sensor, idx);
+  }
+
+  void siftUp(int idx) {
+    const Entry entry = this->entries[idx];
+    while (idx > 0) {
+      const int parent = (idx - 1) / 2;
+      if (!isBefore(entry, this->entries[parent])) break;
+      this->place(this->entries[parent], idx);
+      idx = parent;
+    }
+    this->place(entry, idx);
+  }
+
+  void siftDown(int idx) {
+    const int n = this->entries.getLength();
+    const Entry entry = this->entries[idx];
+    for (;;) {
+      int child = 2 * idx + 1;
+      if (child >= n) break;
+      if (child + 1 < n && isBefore(this->entries[child + 1], this->entries[child])) {
+        child++;
+      }
+      if (!isBefore(this->entries[child], entry)) break;
+      this->place(this->entries[child], idx);
+      idx = child;
+    }
+    this->place(entry, idx);
+  }
+
+  void removeAt(const int idx) {
+    (void)this->positions.erase(this->entries[idx].sensor);
+    const Entry last = this->entries.pop();
+    if (idx == this->entries.getLength()) return;
+    this->entries[idx] = last;
+    if (idx > 0 && isBefore(last, this->entries[(idx - 1) / 2])) {
+      this->siftUp(idx);
+    }
+    else {
+      this->siftDown(idx);
+    }
+  }
+
+  SbList<Entry> entries;
+  SbFlatHash<Sensor *, int> positions;
+  uint32_t counter;
+};
+
+// *************************************************************************
+
 class SoSensorManagerP {
 public:
   SoSensorManagerP(void) : alive(ALIVE_PATTERN) { }
@@ -143,12 +246,12 @@ public:
   SbBool processingimmediatequeue;
 
   // immediatequeue - stores SoDelayQueueSensors with priority 0. FIFO.
-  // delayqueue   - stores SoDelayQueueSensor's in sorted order.
-  // timerqueue - stores SoTimerSensors in sorted order.
+  // delayqueue   - stores SoDelayQueueSensor's ordered on priority.
+  // timerqueue - stores SoTimerSensors ordered on trigger time.
 
   SbList <SoDelayQueueSensor *> immediatequeue;
-  SbList <SoDelayQueueSensor *> delayqueue;
-  SbList <SoTimerQueueSensor *> timerqueue;
+  SoSensorHeap <SoDelayQueueSensor, uint32_t> delayqueue;
+  SoSensorHeap <SoTimerQueueSensor, double> timerqueue;
   SbList <SoTimerSensor*> reschedulelist;
 
   // FIXME: from what I can see, the two dicts below are simply used
@@ -156,9 +259,9 @@ public:
   // instead. 20050520 mortene.
 
   // stores sensors that has been triggered in processDelayQueue().
-  SbHash<SoDelayQueueSensor *, SoDelayQueueSensor *> triggerdict;
+  SbFlatHash<SoDelayQueueSensor *, SoDelayQueueSensor *> triggerdict;
   // temporary storage for idle sensors during processing
-  SbHash<SoDelayQueueSensor *, SoDelayQueueSensor *> reinsertdict;
+  SbFlatHash<SoDelayQueueSensor *, SoDelayQueueSensor *> reinsertdict;
 
   void (*queueChangedCB)(void *);
   void * queueChangedCBData;
@@ -308,17 +411,8 @@ SoSensorManager::insertDelaySensor(SoDelayQueueSensor * newentry)
     }
 
     LOCK_DELAY_QUEUE(this);
-    SbList <SoDelayQueueSensor *> & delayqueue = PRIVATE(this)->delayqueue;
-
-    // <= in test since the sensors should be processed FIFO for
-    // sensors with equal priority
-    uint32_t newsensorpriority = newentry->getPriority();
-    int pos = 0;
-    while((pos < delayqueue.getLength()) &&
-          (delayqueue[pos]->getPriority() <= newsensorpriority)) {
-      pos++;
-    }
-    delayqueue.insert(newentry, pos);
+    // sensors with equal priority are processed FIFO
+    PRIVATE(this)->delayqueue.insert(newentry, newentry->getPriority());
     UNLOCK_DELAY_QUEUE(this);
     this->notifyChanged();
   }
@@ -346,20 +440,9 @@ SoSensorManager::insertTimerSensor(SoTimerQueueSensor * newentry)
   SoSensorManagerP::assertAlive(PRIVATE(this));
   assert(newentry);
 
-  SbList <SoTimerQueueSensor *> & timerqueue = PRIVATE(this)->timerqueue;
-
   LOCK_TIMER_QUEUE(this);
-  int i = 0;
-
-  // <= in test since the sensors should be processed FIFO for sensors
-  // with the same trigger time
-  double newtime = newentry->getTriggerTime().getValue();
-  while ((i < timerqueue.getLength()) &&
-         (timerqueue[i]->getTriggerTime().getValue() <= newtime)) {
-    i++;
-  }
-  timerqueue.insert(newentry, i);
-
+  // sensors with the same trigger time are processed FIFO
+  PRIVATE(this)->timerqueue.insert(newentry, newentry->getTriggerTime().getValue());
   UNLOCK_TIMER_QUEUE(this);
 
 #if DEBUG_TIMER_SENSORHANDLING || 0 // debug
@@ -390,8 +473,7 @@ SoSensorManager::removeDelaySensor(SoDelayQueueSensor * entry)
 
   LOCK_DELAY_QUEUE(this);
   // Check "real" queue first..
-  int idx = PRIVATE(this)->delayqueue.find(entry);
-  if (idx != -1) PRIVATE(this)->delayqueue.remove(idx);
+  int idx = PRIVATE(this)->delayqueue.remove(entry) ? 0 : -1;
   UNLOCK_DELAY_QUEUE(this);
 
   // ..then the immediate queue.
@@ -427,9 +509,7 @@ SoSensorManager::removeTimerSensor(SoTimerQueueSensor * entry)
   SoSensorManagerP::assertAlive(PRIVATE(this));
 
   LOCK_TIMER_QUEUE(this);
-  int idx = PRIVATE(this)->timerqueue.find(entry);
-  if (idx != -1) {
-    PRIVATE(this)->timerqueue.remove(idx);
+  if (PRIVATE(this)->timerqueue.remove(entry)) {
     UNLOCK_TIMER_QUEUE(this);
     this->notifyChanged();
   }
@@ -482,14 +562,13 @@ SoSensorManager::processTimerQueue(void)
 
   SbTime currenttime = SbTime::getTimeOfDay();
   while (PRIVATE(this)->timerqueue.getLength() > 0 &&
-         PRIVATE(this)->timerqueue[0]->getTriggerTime() <= currenttime) {
+         PRIVATE(this)->timerqueue.top()->getTriggerTime() <= currenttime) {
 #if DEBUG_TIMER_SENSORHANDLING // debug
     SoDebugError::postInfo("SoSensorManager::processTimerQueue",
                            "process element with triggertime %s",
-                           PRIVATE(this)->timerqueue[0]->getTriggerTime().format().getString());
+                           PRIVATE(this)->timerqueue.top()->getTriggerTime().format().getString());
 #endif // debug
-    SoSensor * sensor = PRIVATE(this)->timerqueue[0];
-    PRIVATE(this)->timerqueue.remove(0);
+    SoSensor * sensor = PRIVATE(this)->timerqueue.pop();
     UNLOCK_TIMER_QUEUE(this);
     sensor->trigger();
     LOCK_TIMER_QUEUE(this);
@@ -591,11 +670,10 @@ SoSensorManager::processDelayQueue(SbBool isidle)
 #if DEBUG_DELAY_SENSORHANDLING // debug
     SoDebugError::postInfo("SoSensorManager::processDelayQueue",
                            "treat element with pri %d",
-                           PRIVATE(this)->delayqueue[0]->getPriority());
+                           PRIVATE(this)->delayqueue.top()->getPriority());
 #endif // debug
 
-    SoDelayQueueSensor * sensor = PRIVATE(this)->delayqueue[0];
-    PRIVATE(this)->delayqueue.remove(0);
+    SoDelayQueueSensor * sensor = PRIVATE(this)->delayqueue.pop();
     UNLOCK_DELAY_QUEUE(this);
 
     if (!isidle && sensor->isIdleOnly()) {
@@ -624,7 +702,7 @@ SoSensorManager::processDelayQueue(SbBool isidle)
   // was an idle sensor, or because the sensor had already been
   // triggered
   for(
-      SbHash<SoDelayQueueSensor *, SoDelayQueueSensor *>::const_iterator iter =
+      SbFlatHash<SoDelayQueueSensor *, SoDelayQueueSensor *>::const_iterator iter =
        PRIVATE(this)->reinsertdict.const_begin();
       iter!=PRIVATE(this)->reinsertdict.const_end();
       ++iter
@@ -776,7 +854,7 @@ SoSensorManager::isTimerSensorPending(SbTime & tm)
 
   LOCK_TIMER_QUEUE(this);
   if (PRIVATE(this)->timerqueue.getLength() > 0) {
-    tm = PRIVATE(this)->timerqueue[0]->getTriggerTime();
+    tm = PRIVATE(this)->timerqueue.top()->getTriggerTime();
     UNLOCK_TIMER_QUEUE(this);
     return TRUE;
   }
@@ -915,3 +993,102 @@ SoSensorManager::mergeDelayQueues(void)
 #undef LOCK_RESCHEDULE_LIST
 #undef UNLOCK_RESCHEDULE_LIST
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/sensors/SoAlarmSensor.h>
+#include <Inventor/sensors/SoOneShotSensor.h>
+#include <Inventor/sensors/SoSensorManager.h>
+
+static void
+sosensormanager_record_cb(void * data, SoSensor * sensor)
+{
+  static_cast<SbList<SoSensor *> *>(data)->append(sensor);
+}
+
+BOOST_AUTO_TEST_CASE(delayqueueorder)
+{
+  // a few priorities, each with many sensors which must come out in
+  // the order they were scheduled
+  const int num = 2000;
+  SbList<SoSensor *> triggered;
+  SoOneShotSensor ** sensors = new SoOneShotSensor *[num];
+  int i;
+  for (i = 0; i < num; i++) {
+    sensors[i] = new SoOneShotSensor(sosensormanager_record_cb, &triggered);
+    sensors[i]->setPriority(1000 + (i * 7) % 5);
+    sensors[i]->schedule();
+  }
+  for (i = 0; i < num; i += 3) sensors[i]->unschedule();
+
+  SoDB::getSensorManager()->processDelayQueue(TRUE);
+
+  SbBool ordered = TRUE;
+  int prev = -1;
+  for (i = 0; i < triggered.getLength(); i++) {
+    int idx = 0;
+    while (idx < num && sensors[idx] != triggered[i]) idx++;
+    if (idx == num) continue; // not one of ours
+    if (idx % 3 == 0) ordered = FALSE;
+    if (prev >= 0) {
+      const uint32_t pp = sensors[prev]->getPriority();
+      const uint32_t p = sensors[idx]->getPriority();
+      if (p < pp || (p == pp && idx < prev)) ordered = FALSE;
+    }
+    prev = idx;
+  }
+  BOOST_CHECK_MESSAGE(ordered, "Delay sensors triggered out of order");
+  BOOST_CHECK_EQUAL(triggered.getLength(), num - (num + 2) / 3);
+
+  for (i = 0; i < num; i++) delete sensors[i];
+  delete[] sensors;
+}
+
+BOOST_AUTO_TEST_CASE(timerqueueorder)
+{
+  const int num = 2000;
+  SbList<SoSensor *> triggered;
+  SoAlarmSensor ** sensors = new SoAlarmSensor *[num];
+  const SbTime now = SbTime::getTimeOfDay();
+  int i;
+  for (i = 0; i < num; i++) {
+    sensors[i] = new SoAlarmSensor(sosensormanager_record_cb, &triggered);
+    // all in the past, with many sharing the same time
+    sensors[i]->setTime(now - SbTime(double(1 + (i * 13) % 7)));
+    sensors[i]->schedule();
+  }
+  for (i = 1; i < num; i += 4) sensors[i]->unschedule();
+  // move the first sensor to the front
+  sensors[0]->unschedule();
+  sensors[0]->setTime(now - SbTime(100.0));
+  sensors[0]->schedule();
+
+  SoDB::getSensorManager()->processTimerQueue();
+
+  SbBool ordered = TRUE;
+  int prev = -1;
+  for (i = 0; i < triggered.getLength(); i++) {
+    int idx = 0;
+    while (idx < num && sensors[idx] != triggered[i]) idx++;
+    if (idx == num) continue;
+    if (idx % 4 == 1) ordered = FALSE;
+    if (prev >= 0) {
+      const SbTime pt = sensors[prev]->getTime();
+      const SbTime t = sensors[idx]->getTime();
+      if (t < pt || (t == pt && idx < prev)) ordered = FALSE;
+    }
+    prev = idx;
+  }
+  BOOST_CHECK_MESSAGE(ordered, "Timer sensors triggered out of order");
+  BOOST_CHECK_EQUAL(triggered.getLength(), num - num / 4);
+  BOOST_CHECK_MESSAGE(triggered.getLength() > 0 && triggered[0] == sensors[0],
+                      "Rescheduled timer sensor not triggered first");
+
+  for (i = 0; i < num; i++) delete sensors[i];
+  delete[] sensors;
+}
+
+#endif // COIN_TEST_SUITE
@@ -71,6 +71,7 @@
 #include <Inventor/caches/SoPrimitiveVertexCache.h>
 #include <Inventor/details/SoFaceDetail.h>
 #include <Inventor/details/SoLineDetail.h>
+#include <Inventor/details/SoPointDetail.h>
 #include <Inventor/elements/SoBumpMapElement.h>
 #include <Inventor/elements/SoCacheElement.h>
 #include <Inventor/elements/SoComplexityElement.h>
@@ -101,7 +102,18 @@
 #include <Inventor/misc/SoGLBigImage.h>
 #include <Inventor/misc/SoGLDriverDatabase.h>
 #include <Inventor/misc/SoState.h>
+#include <Inventor/nodes/SoFaceSet.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoIndexedLineSet.h>
+#include <Inventor/nodes/SoIndexedMarkerSet.h>
+#include <Inventor/nodes/SoIndexedPointSet.h>
+#include <Inventor/nodes/SoIndexedTriangleStripSet.h>
 #include <Inventor/nodes/SoLight.h>
+#include <Inventor/nodes/SoLineSet.h>
+#include <Inventor/nodes/SoMarkerSet.h>
+#include <Inventor/nodes/SoPointSet.h>
+#include <Inventor/nodes/SoQuadMesh.h>
+#include <Inventor/nodes/SoTriangleStripSet.h>
 #include <Inventor/nodes/SoVertexProperty.h>
 #include <Inventor/nodes/SoVertexShape.h>
 #include <Inventor/system/gl.h>
@@ -110,6 +122,8 @@
 
 #ifdef HAVE_VRML97
 #include <Inventor/VRMLnodes/SoVRMLIndexedFaceSet.h>
+#include <Inventor/VRMLnodes/SoVRMLIndexedLineSet.h>
+#include <Inventor/VRMLnodes/SoVRMLPointSet.h>
 #include <Inventor/VRMLnodes/SoVRMLExtrusion.h>
 #include <Inventor/VRMLnodes/SoVRMLElevationGrid.h>
 #endif // HAVE_VRML97
@@ -120,6 +134,7 @@
 #include "threads/threadsutilp.h"
 #include "tidbitsp.h"
 #include "rendering/SoVBO.h"
+#include "caches/SoRayPickCache.h"
 #include "coindefs.h" // COIN_OBSOLETED()
 
 // SoShape.cpp grew too big, so I had to move some code into new
@@ -175,6 +190,7 @@ public:
   SoShapeP() {
     this->bboxcache = NULL;
     this->pvcache = NULL;
+    this->pickcache = NULL;
     this->bumprender = NULL;
     this->rendercnt = 0;
     this->flags = 0;
@@ -182,6 +198,7 @@ public:
   ~SoShapeP() {
     if (this->bboxcache) { this->bboxcache->unref(); }
     if (this->pvcache) { this->pvcache->unref(); }
+    if (this->pickcache) { this->pickcache->unref(); }
     delete this->bumprender;
   }
   enum {
@@ -198,6 +215,7 @@ public:
   static double bboxcachetimelimit;
   SoBoundingBoxCache * bboxcache;
   SoPrimitiveVertexCache * pvcache;
+  SoRayPickCache * pickcache;
   soshape_bumprender * bumprender;
   uint32_t flags : FLAG_BITS;
   // stores the number of frames rendered with no node changes
@@ -276,6 +294,8 @@ typedef struct {
   soshape_bigtexture * currentbigtexture;
   // used in generatePrimitives() callbacks to set correct material
   SoMaterialBundle * currentbundle;
+  // set while primitives are generated into a ray pick cache
+  SoRayPickCache * pickcache;
 
   int rendermode;
 } soshape_staticdata;
@@ -303,6 +323,7 @@ soshape_construct_staticdata(void * closure)
   data->bigtexturecontext = new SbList <uint32_t>;
   data->primdata = new soshape_primdata();
   data->trianglesort = new soshape_trianglesort();
+  data->pickcache = NULL;
   data->rendermode = NORMAL;
 }
 
@@ -445,9 +466,244 @@ soshape_ray_intersect(SoRayPickAction * action, const SbBox3f & box)
   return action->intersect(box, TRUE);
 }
 
+// Intersects the pick ray with a triangle, and adds a picked point
+// if there is an intersection.
+static SoPickedPoint *
+soshape_pick_triangle(SoRayPickAction * ra,
+                      const SoPrimitiveVertex * v1,
+                      const SoPrimitiveVertex * v2,
+                      const SoPrimitiveVertex * v3,
+                      SbVec3f & barycentric)
+{
+  SbVec3f intersection;
+  SbBool front;
+
+  if (ra->intersect(v1->getPoint(), v2->getPoint(), v3->getPoint(),
+                    intersection, barycentric, front)) {
+    if (ra->isBetweenPlanes(intersection)) {
+      if (SoShapeHintsElement::getVertexOrdering(ra->getState()) ==
+          SoShapeHintsElement::CLOCKWISE) {
+        front = !front;
+      }
+      return ra->addIntersection(intersection, front);
+    }
+  }
+  return NULL;
+}
+
+// Sets the normal, texture coordinates and material index for a
+// picked point on a triangle.
+static void
+soshape_set_triangle_pick_data(SoPickedPoint * pp,
+                               const SbVec3f & barycentric,
+                               const SoPrimitiveVertex * v1,
+                               const SoPrimitiveVertex * v2,
+                               const SoPrimitiveVertex * v3)
+{
+  // calculate normal at picked point
+  SbVec3f n =
+    v1->getNormal() * barycentric[0] +
+    v2->getNormal() * barycentric[1] +
+    v3->getNormal() * barycentric[2];
+  n.normalize();
+  pp->setObjectNormal(n);
+
+  // calculate texture coordinate at picked point
+  SbVec4f tc =
+    v1->getTextureCoords() * barycentric[0] +
+    v2->getTextureCoords() * barycentric[1] +
+    v3->getTextureCoords() * barycentric[2];
+
+  pp->setObjectTextureCoords(tc);
+
+  // material index need to be approximated, since there is no
+  // way to average material indices :( This makes it
+  // impossible to fully support color per vertex. An
+  // extension to the OIV API would perhaps be a good idea
+  // here? Maybe calculate the rgba value for diffuse and
+  // transparency and set it in SoPickedPoint?
+  float maxval = barycentric[0];
+  const SoPrimitiveVertex * maxv = v1;
+  if (barycentric[1] > maxval) {
+    maxv = v2;
+    maxval = barycentric[1];
+  }
+  if (barycentric[2] > maxval) {
+    maxv = v3;
+  }
+  pp->setMaterialIndex(maxv->getMaterialIndex());
+}
+
+// Intersects the pick ray with a line segment, and adds a picked
+// point if there is an intersection.
+static SoPickedPoint *
+soshape_pick_line(SoRayPickAction * ra,
+                  const SoPrimitiveVertex * v1,
+                  const SoPrimitiveVertex * v2,
+                  SbVec3f & intersection)
+{
+  if (ra->intersect(v1->getPoint(), v2->getPoint(), intersection)) {
+    if (ra->isBetweenPlanes(intersection)) {
+      return ra->addIntersection(intersection);
+    }
+  }
+  return NULL;
+}
+
+// Sets the normal, texture coordinates and material index for a
+// picked point on a line segment.
+static void
+soshape_set_line_pick_data(SoPickedPoint * pp,
+                           const SbVec3f & intersection,
+                           const SoPrimitiveVertex * v1,
+                           const SoPrimitiveVertex * v2)
+{
+  float total = (v2->getPoint()-v1->getPoint()).length();
+  float len1 = 1.0f;
+  float len2 = 0.0f;
+  if (total > 0.0f) {
+    len1 = (intersection-v1->getPoint()).length();
+    len2 = (intersection-v2->getPoint()).length();
+    len1 /= total;
+    len2 /= total;
+  }
+  SbVec3f n =
+    v1->getNormal() * len1 +
+    v2->getNormal() * len2;
+  n.normalize();
+  pp->setObjectNormal(n);
+
+  SbVec4f tc =
+    v1->getTextureCoords() * len1 +
+    v2->getTextureCoords() * len2;
+  pp->setObjectTextureCoords(tc);
+  pp->setMaterialIndex(len1 >= len2 ?
+                       v1->getMaterialIndex() :
+                       v2->getMaterialIndex());
+}
+
+// Intersects the pick ray with a point, and adds a picked point if
+// there is an intersection.
+static SoPickedPoint *
+soshape_pick_point(SoRayPickAction * ra, const SoPrimitiveVertex * v)
+{
+  SbVec3f intersection = v->getPoint();
+  if (ra->intersect(intersection)) {
+    if (ra->isBetweenPlanes(intersection)) {
+      SoPickedPoint * pp = ra->addIntersection(intersection);
+      if (pp) {
+        pp->setObjectNormal(v->getNormal());
+        pp->setObjectTextureCoords(v->getTextureCoords());
+        pp->setMaterialIndex(v->getMaterialIndex());
+      }
+      return pp;
+    }
+  }
+  return NULL;
+}
+
+typedef struct {
+  SoRayPickAction * action;
+  const SoRayPickCache * cache;
+  SoShape * shape;
+} soshape_pickcache_data;
+
+static SbBool
+soshape_pickcache_box_cb(void * closure, const SbBox3f & box)
+{
+  soshape_pickcache_data * data = (soshape_pickcache_data *) closure;
+  // only the pick ray itself is used for triangle intersection
+  // testing, so we don't need to test against the full pick volume
+  return data->action->intersect(box, FALSE);
+}
+
+static SbBool
+soshape_pickcache_triangle_cb(void * closure, const int idx)
+{
+  soshape_pickcache_data * data = (soshape_pickcache_data *) closure;
+  const SoPrimitiveVertex * v = data->cache->getTriangle(idx);
+  SbVec3f barycentric;
+  SoPickedPoint * pp = soshape_pick_triangle(data->action, &v[0], &v[1], &v[2], barycentric);
+  if (pp) {
+    pp->setDetail(data->cache->createTriangleDetail(idx), data->shape);
+    soshape_set_triangle_pick_data(pp, barycentric, &v[0], &v[1], &v[2]);
+  }
+  return TRUE;
+}
+
+// Picks on the primitives stored in a ray pick cache instead of
+// generating the primitives again.
+static void
+soshape_pick_cache(SoShape * shape, SoRayPickAction * action,
+                   const SoRayPickCache * cache)
+{
+  soshape_pickcache_data data;
+  data.action = action;
+  data.cache = cache;
+  data.shape = shape;
+  cache->getTriangleBVH().traverse(soshape_pickcache_box_cb,
+                                   soshape_pickcache_triangle_cb,
+                                   &data);
+  int i;
+  const int numlines = cache->getNumLines();
+  for (i = 0; i < numlines; i++) {
+    const SoPrimitiveVertex * v = cache->getLine(i);
+    SbVec3f intersection;
+    SoPickedPoint * pp = soshape_pick_line(action, &v[0], &v[1], intersection);
+    if (pp) {
+      pp->setDetail(cache->createLineDetail(i), shape);
+      soshape_set_line_pick_data(pp, intersection, &v[0], &v[1]);
+    }
+  }
+  const int numpoints = cache->getNumPoints();
+  for (i = 0; i < numpoints; i++) {
+    SoPickedPoint * pp = soshape_pick_point(action, cache->getPoint(i));
+    if (pp) {
+      pp->setDetail(cache->createPointDetail(i), shape);
+    }
+  }
+}
+
+// Checks whether the shape is one of the built-in shapes which use
+// the default create*Detail() methods. The details of the primitives
+// in a ray pick cache are made from the primitive data, so shapes
+// which may override these methods, including all subclasses of the
+// built-in shapes, are picked without a cache.
+static SbBool
+soshape_has_default_details(const SoShape * shape)
+{
+  const SoType type = shape->getTypeId();
+  return
+    type == SoFaceSet::getClassTypeId() ||
+    type == SoIndexedFaceSet::getClassTypeId() ||
+    type == SoTriangleStripSet::getClassTypeId() ||
+    type == SoIndexedTriangleStripSet::getClassTypeId() ||
+    type == SoQuadMesh::getClassTypeId() ||
+    type == SoLineSet::getClassTypeId() ||
+    type == SoIndexedLineSet::getClassTypeId() ||
+    type == SoPointSet::getClassTypeId() ||
+    type == SoIndexedPointSet::getClassTypeId() ||
+    type == SoMarkerSet::getClassTypeId() ||
+    type == SoIndexedMarkerSet::getClassTypeId()
+#ifdef HAVE_VRML97
+    || type == SoVRMLIndexedFaceSet::getClassTypeId() ||
+    type == SoVRMLIndexedLineSet::getClassTypeId() ||
+    type == SoVRMLPointSet::getClassTypeId() ||
+    type == SoVRMLElevationGrid::getClassTypeId()
+#endif // HAVE_VRML97
+    ;
+}
 
 /*!
   Calculates picked point based on primitives generated by subclasses.
+
+  If SoRayPickAction::isBVHCaching() is enabled, the primitives of
+  the built-in shapes are stored in a cache the first time the shape
+  is picked, and later picks are done on the cached primitives until
+  the cache is invalidated. Other shapes, which may override
+  createTriangleDetail(), createLineSegmentDetail() or
+  createPointDetail(), are always picked by generating their
+  primitives.
 */
 void
 SoShape::rayPick(SoRayPickAction * action)
@@ -458,7 +714,39 @@ SoShape::rayPick(SoRayPickAction * action)
     if (!PRIVATE(this)->bboxcache ||
         !PRIVATE(this)->bboxcache->isValid(action->getState()) ||
         soshape_ray_intersect(action, PRIVATE(this)->bboxcache->getProjectedBox())) {
-      this->generatePrimitives(action);
+      if (!action->isBVHCaching() || !soshape_has_default_details(this)) {
+        this->generatePrimitives(action);
+        return;
+      }
+
+      SoState * state = action->getState();
+      // lock since pickcache is shared among all threads
+      PRIVATE(this)->lock();
+      if (PRIVATE(this)->pickcache == NULL ||
+          !PRIVATE(this)->pickcache->isValid(state)) {
+        if (PRIVATE(this)->pickcache) {
+          PRIVATE(this)->pickcache->unref();
+        }
+        soshape_staticdata * shapedata = soshape_get_staticdata();
+        SbBool storedinvalid = SoCacheElement::setInvalid(FALSE);
+        // must push state to make cache dependencies work
+        state->push();
+        PRIVATE(this)->pickcache = new SoRayPickCache(state);
+        PRIVATE(this)->pickcache->ref();
+        SoCacheElement::set(state, PRIVATE(this)->pickcache);
+        shapedata->pickcache = PRIVATE(this)->pickcache;
+        this->generatePrimitives(action);
+        shapedata->pickcache = NULL;
+        state->pop();
+        SoCacheElement::setInvalid(storedinvalid);
+        PRIVATE(this)->pickcache->close();
+      }
+      SoRayPickCache * pickcache = PRIVATE(this)->pickcache;
+      pickcache->ref();
+      PRIVATE(this)->unlock();
+
+      soshape_pick_cache(this, action, pickcache);
+      pickcache->unref();
     }
   }
 }
@@ -989,54 +1277,28 @@ SoShape::invokeTriangleCallbacks(SoAction * const action,
   if (action->getTypeId().isDerivedFrom(SoRayPickAction::getClassTypeId())) {
     SoRayPickAction * ra = (SoRayPickAction *) action;
 
-    SbVec3f intersection;
-    SbVec3f barycentric;
-    SbBool front;
-
-    if (ra->intersect(v1->getPoint(), v2->getPoint(), v3->getPoint(),
-                      intersection, barycentric, front)) {
-
-      if (ra->isBetweenPlanes(intersection)) {
-        if (SoShapeHintsElement::getVertexOrdering(ra->getState()) ==
-            SoShapeHintsElement::CLOCKWISE) {
-          front = !front;
-        }
-        SoPickedPoint * pp = ra->addIntersection(intersection, front);
-        if (pp) {
-          pp->setDetail(this->createTriangleDetail(ra, v1, v2, v3, pp), this);
-          // calculate normal at picked point
-          SbVec3f n =
-            v1->getNormal() * barycentric[0] +
-            v2->getNormal() * barycentric[1] +
-            v3->getNormal() * barycentric[2];
-          n.normalize();
-          pp->setObjectNormal(n);
-
-          // calculate texture coordinate at picked point
-          SbVec4f tc =
-            v1->getTextureCoords() * barycentric[0] +
-            v2->getTextureCoords() * barycentric[1] +
-            v3->getTextureCoords() * barycentric[2];
-
-          pp->setObjectTextureCoords(tc);
-
-          // material index need to be approximated, since there is no
-          // way to average material indices :( This makes it
-          // impossible to fully support color per vertex. An
-          // extension to the OIV API would perhaps be a good idea
-          // here? Maybe calculate the rgba value for diffuse and
-          // transparency and set it in SoPickedPoint?
-          float maxval = barycentric[0];
-          const SoPrimitiveVertex * maxv = v1;
-          if (barycentric[1] > maxval) {
-            maxv = v2;
-            maxval = barycentric[1];
-          }
-          if (barycentric[2] > maxval) {
-            maxv = v3;
-          }
-          pp->setMaterialIndex(maxv->getMaterialIndex());
-        }
+    soshape_staticdata * shapedata =
+      ra->isBVHCaching() ? soshape_get_staticdata() : NULL;
+    if (shapedata && shapedata->pickcache) {
+      // store the triangle in the cache instead of testing it, with
+      // the detail createTriangleDetail() would have made
+      soshape_primdata * primdata = shapedata->primdata;
+      if (primdata->faceDetail) {
+        shapedata->pickcache->addTriangle(v1, v2, v3,
+                                          primdata->faceDetail,
+                                          primdata->pointDetails,
+                                          primdata->getNumPickDetailPoints());
+      }
+      else {
+        shapedata->pickcache->addTriangle(v1, v2, v3, NULL);
+      }
+    }
+    else {
+      SbVec3f barycentric;
+      SoPickedPoint * pp = soshape_pick_triangle(ra, v1, v2, v3, barycentric);
+      if (pp) {
+        pp->setDetail(this->createTriangleDetail(ra, v1, v2, v3, pp), this);
+        soshape_set_triangle_pick_data(pp, barycentric, v1, v2, v3);
       }
     }
   }
@@ -1100,36 +1362,25 @@ SoShape::invokeLineSegmentCallbacks(SoAction * const action,
   if (action->getTypeId().isDerivedFrom(SoRayPickAction::getClassTypeId())) {
     SoRayPickAction * ra = (SoRayPickAction *) action;
 
-    SbVec3f intersection;
-    if (ra->intersect(v1->getPoint(), v2->getPoint(), intersection)) {
-      if (ra->isBetweenPlanes(intersection)) {
-        SoPickedPoint * pp = ra->addIntersection(intersection);
-        if (pp) {
-          pp->setDetail(this->createLineSegmentDetail(ra, v1, v2, pp), this);
-          float total = (v2->getPoint()-v1->getPoint()).length();
-          float len1 = 1.0f;
-          float len2 = 0.0f;
-          if (total > 0.0f) {
-            len1 = (intersection-v1->getPoint()).length();
-            len2 = (intersection-v2->getPoint()).length();
-            len1 /= total;
-            len2 /= total;
-          }
-          SbVec3f n =
-            v1->getNormal() * len1 +
-            v2->getNormal() * len2;
-          n.normalize();
-          pp->setObjectNormal(n);
-
-          SbVec4f tc =
-            v1->getTextureCoords() * len1 +
-            v2->getTextureCoords() * len2;
-          pp->setObjectTextureCoords(tc);
-          pp->setMaterialIndex(len1 >= len2 ?
-                               v1->getMaterialIndex() :
-                               v2->getMaterialIndex());
-
-        }
+    soshape_staticdata * shapedata =
+      ra->isBVHCaching() ? soshape_get_staticdata() : NULL;
+    if (shapedata && shapedata->pickcache) {
+      soshape_primdata * primdata = shapedata->primdata;
+      if (primdata->lineDetail) {
+        shapedata->pickcache->addLine(v1, v2,
+                                      primdata->lineDetail,
+                                      primdata->pointDetails);
+      }
+      else {
+        shapedata->pickcache->addLine(v1, v2, NULL);
+      }
+    }
+    else {
+      SbVec3f intersection;
+      SoPickedPoint * pp = soshape_pick_line(ra, v1, v2, intersection);
+      if (pp) {
+        pp->setDetail(this->createLineSegmentDetail(ra, v1, v2, pp), this);
+        soshape_set_line_pick_data(pp, intersection, v1, v2);
       }
     }
   }
@@ -1174,16 +1425,21 @@ SoShape::invokePointCallbacks(SoAction * const action,
   if (action->getTypeId().isDerivedFrom(SoRayPickAction::getClassTypeId())) {
     SoRayPickAction * ra = (SoRayPickAction *) action;
 
-    SbVec3f intersection = v->getPoint();
-    if (ra->intersect(intersection)) {
-      if (ra->isBetweenPlanes(intersection)) {
-        SoPickedPoint * pp = ra->addIntersection(intersection);
-        if (pp) {
-          pp->setDetail(this->createPointDetail(ra, v, pp), this);
-          pp->setObjectNormal(v->getNormal());
-          pp->setObjectTextureCoords(v->getTextureCoords());
-          pp->setMaterialIndex(v->getMaterialIndex());
-        }
+    soshape_staticdata * shapedata =
+      ra->isBVHCaching() ? soshape_get_staticdata() : NULL;
+    if (shapedata && shapedata->pickcache) {
+      const SoDetail * detail = v->getDetail();
+      if (detail && detail->getTypeId() == SoPointDetail::getClassTypeId()) {
+        shapedata->pickcache->addPoint(v, static_cast<const SoPointDetail *>(detail));
+      }
+      else {
+        shapedata->pickcache->addPoint(v, detail ? detail->copy() : NULL);
+      }
+    }
+    else {
+      SoPickedPoint * pp = soshape_pick_point(ra, v);
+      if (pp) {
+        pp->setDetail(this->createPointDetail(ra, v, pp), this);
       }
     }
   }
@@ -1428,6 +1684,9 @@ SoShape::notify(SoNotList * nl)
   if (PRIVATE(this)->pvcache) {
     PRIVATE(this)->pvcache->invalidate();
   }
+  if (PRIVATE(this)->pickcache) {
+    PRIVATE(this)->pickcache->invalidate();
+  }
   PRIVATE(this)->flags &= ~SoShapeP::SHOULD_BBOX_CACHE;
   PRIVATE(this)->rendercnt = 0;
   PRIVATE(this)->unlock();
@@ -354,36 +354,20 @@ soshape_primdata::getPointDetailIndex(const SoPrimitiveVertex * v) const
 SoDetail *
 soshape_primdata::createPickDetail(void)
 {
+  const int numpoints = this->getNumPickDetailPoints();
   switch (this->shapetype) {
   case SoShape::TRIANGLE_STRIP:
   case SoShape::TRIANGLE_FAN:
   case SoShape::TRIANGLES:
-    {
-      SoFaceDetail * detail = (SoFaceDetail *)this->faceDetail->copy();
-      detail->setNumPoints(3);
-      detail->setPoint(0, &this->pointDetails[0]);
-      detail->setPoint(1, &this->pointDetails[1]);
-      detail->setPoint(2, &this->pointDetails[2]);
-      return detail;
-    }
   case SoShape::POLYGON:
-    {
-      SoFaceDetail * detail = (SoFaceDetail *)this->faceDetail->copy();
-      detail->setNumPoints(this->counter);
-      for (int i = 0; i < this->counter; i++) {
-        detail->setPoint(i, &this->pointDetails[i]);
-      }
-      return detail;
-    }
   case SoShape::QUADS:
   case SoShape::QUAD_STRIP:
     {
       SoFaceDetail * detail = (SoFaceDetail *)this->faceDetail->copy();
-      detail->setNumPoints(4);
-      detail->setPoint(0, &this->pointDetails[0]);
-      detail->setPoint(1, &this->pointDetails[1]);
-      detail->setPoint(2, &this->pointDetails[2]);
-      detail->setPoint(3, &this->pointDetails[3]);
+      detail->setNumPoints(numpoints);
+      for (int i = 0; i < numpoints; i++) {
+        detail->setPoint(i, &this->pointDetails[i]);
+      }
       return detail;
     }
   case SoShape::POINTS:
@@ -405,6 +389,32 @@ soshape_primdata::createPickDetail(void)
   }
 }
 
+// Returns the number of point details, from the start of
+// pointDetails, that belong in the detail of the current primitive.
+int
+soshape_primdata::getNumPickDetailPoints(void) const
+{
+  switch (this->shapetype) {
+  case SoShape::TRIANGLE_STRIP:
+  case SoShape::TRIANGLE_FAN:
+  case SoShape::TRIANGLES:
+    return 3;
+  case SoShape::POLYGON:
+    return this->counter;
+  case SoShape::QUADS:
+  case SoShape::QUAD_STRIP:
+    return 4;
+  case SoShape::LINES:
+  case SoShape::LINE_STRIP:
+    return 2;
+  case SoShape::POINTS:
+    return 1;
+  default:
+    assert(0 && "unknown shape type");
+    return 0;
+  }
+}
+
 void
 soshape_primdata::tess_callback(void * v0, void * v1, void * v2, void * data)
 {
@@ -70,6 +70,7 @@ private:
   void handleFaceDetail(const int numv);
   void handleLineDetail(void);
   SoDetail * createPickDetail(void);
+  int getNumPickDetailPoints(void) const;
   static void tess_callback(void * v0, void * v1, void * v2, void * data);
 
   void copyMaterialIndex(const int lastvertex);
@@ -1381,6 +1381,26 @@ coin_get_stderr(void)
   return coin_stderr;
 }
 
+int
+coin_fseek64(FILE * fp, int64_t offset, int whence)
+{
+#ifdef _WIN32
+  return _fseeki64(fp, offset, whence);
+#else /* !_WIN32 */
+  return fseeko(fp, (off_t)offset, whence);
+#endif /* !_WIN32 */
+}
+
+int64_t
+coin_ftell64(FILE * fp)
+{
+#ifdef _WIN32
+  return _ftelli64(fp);
+#else /* !_WIN32 */
+  return (int64_t)ftello(fp);
+#endif /* !_WIN32 */
+}
+
 /**************************************************************************/
 
 SbBool
@@ -60,6 +60,11 @@ FILE * coin_get_stdin(void);
 FILE * coin_get_stdout(void);
 FILE * coin_get_stderr(void);
 
+/* fseek() and ftell() with 64-bit offsets, for files larger than
+   2 GB where long is 32 bits wide */
+int coin_fseek64(FILE * fp, int64_t offset, int whence);
+int64_t coin_ftell64(FILE * fp);
+
 /* ********************************************************************** */
 
 #define coin_atexit(func, priority) \
@@ -95,6 +100,12 @@ enum coin_atexit_priorities {
   */
   CC_ATEXIT_REALTIME_FIELD = CC_ATEXIT_NORMAL + 10,
 
+  /*
+    Pooled offscreen GL contexts must be destructed while the GL cache
+    handling they notify on context destruction is still around
+  */
+  CC_ATEXIT_OFFSCREEN_CONTEXTS = CC_ATEXIT_NORMAL + 5,
+
   /*
     We need to clean up default parts for draggers before tracking SoBase instances
    */
@@ -912,8 +912,6 @@ SoVRMLElevationGrid::updateNormalCache(Binding & nbind)
   if (PRIVATE(this)->dirty) {
     PRIVATE(this)->readUnlockNormalCache();
     PRIVATE(this)->writeLockNormalCache();
-    // FIXME: optimize by using a specialized algorithm for
-    // calculating the normals.
     PRIVATE(this)->ngen.reset(this->ccw.getValue());
 
     const int xdim = this->xDimension.getValue();
@@ -922,29 +920,35 @@ SoVRMLElevationGrid::updateNormalCache(Binding & nbind)
 
     const float * h = this->height.getValues(0);
 
-    const float * nexth = h + xdim;
-
-    float currz = 0.0f;
-
     const float zspace = this->zSpacing.getValue();
     const float xspace = this->xSpacing.getValue();
 
-    for (int z = 0; z < zdim-1; z++) {
+    // The grid points, and a quad for each grid cell, so that
+    // neighbouring quads share vertices by index.
+    SbList <SbVec3f> coords(xdim * zdim);
+    float currz = 0.0f;
+    for (int z = 0; z < zdim; z++) {
       float currx = 0.0f;
-      for (int x = 0; x < xdim-1; x++) {
-
-        SbVec3f v0(currx, nexth[x], currz+zspace);
-        SbVec3f v1(currx+xspace, nexth[x+1], currz+zspace);
-        SbVec3f v2(currx+xspace, h[x+1], currz);
-        SbVec3f v3(currx, h[x], currz);
-
-        PRIVATE(this)->ngen.quad(v0, v1, v2, v3);
+      for (int x = 0; x < xdim; x++) {
+        coords.append(SbVec3f(currx, h[x], currz));
         currx += xspace;
       }
       h += xdim;
-      nexth += xdim;
       currz += zspace;
     }
+    SbList <int32_t> quads((xdim - 1) * (zdim - 1) * 5);
+    for (int z = 0; z < zdim-1; z++) {
+      for (int x = 0; x < xdim-1; x++) {
+        const int32_t idx = z * xdim + x;
+        quads.append(idx + xdim);
+        quads.append(idx + xdim + 1);
+        quads.append(idx + 1);
+        quads.append(idx);
+        quads.append(-1);
+      }
+    }
+    PRIVATE(this)->ngen.setIndexedFaces(coords.getArrayPtr(), coords.getLength(),
+                                        quads.getArrayPtr(), quads.getLength());
 
     if (this->creaseAngle.getValue() <= FLT_EPSILON) {
       PRIVATE(this)->nbind = PER_QUAD;
@@ -31,7 +31,7 @@
 \**************************************************************************/
 
 #ifdef HAVE_CONFIG_H
-#include <config.h>
+#include "config.h"
 #endif // HAVE_CONFIG_H
 
 #ifdef HAVE_VRML97
@@ -135,26 +135,43 @@
 #include <Inventor/SoInput.h>
 #include <Inventor/SoDB.h>
 #include <Inventor/SbBox3f.h>
+#include <Inventor/errors/SoDebugError.h>
 #include <Inventor/errors/SoReadError.h>
 #include <Inventor/actions/SoActions.h>
 #include <Inventor/actions/SoSearchAction.h>
 #include <Inventor/actions/SoGLRenderAction.h>
 #include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/lists/SbStringList.h>
 #include <Inventor/misc/SoChildList.h>
 #include <Inventor/sensors/SoFieldSensor.h>
+#include <Inventor/elements/SoCacheElement.h>
+#include <Inventor/elements/SoCullElement.h>
 #include <Inventor/elements/SoGLLazyElement.h>
 #include <Inventor/elements/SoGLMultiTextureEnabledElement.h>
 #include <Inventor/system/gl.h>
 
+#include "io/SoFileCache.h"
 #include "nodes/SoSubNodeP.h"
 #include "tidbitsp.h"
 
 class SoVRMLInlineP {
 public:
+  SoVRMLInline * master;
   SbString fullurlname;
   SbBool isrequested;
   SoChildList * children;
   SoFieldSensor * urlsensor;
+  // the file to read when the node is first traversed, while it
+  // hasn't been read
+  SoFileCache * file;
+
+  void delayRead(SoInput * in);
+  void setFile(SoFileCache * newfile);
+  SbBool getBoundingBox(SbBox3f & box);
+  void requestLoad(void);
+  void load(void);
+  void attach(SoGroup * root);
+  static void loadedCB(void * closure, SoFileCache * file);
 };
 
 static SoVRMLInline::BboxVisibility
@@ -164,6 +181,7 @@ static void * sovrmlinline_fetchurlcbclosure;
 
 static SbColor * sovrmlinline_bboxcolor = NULL;
 static SbBool sovrmlinline_readassofile = TRUE;
+static SbBool sovrmlinline_delayfetchurl = FALSE;
 
 static void
 sovrmlinline_cleanup(void)
@@ -173,6 +191,104 @@ sovrmlinline_cleanup(void)
   sovrmlinline_bboxvisibility = SoVRMLInline::UNTIL_LOADED;
   sovrmlinline_fetchurlcb = NULL;  
   sovrmlinline_readassofile = TRUE;
+  sovrmlinline_delayfetchurl = FALSE;
+}
+
+// Finds the first file in the SoVRMLInline::url field, and leaves it
+// to be read when the node is first traversed. in is NULL when the
+// field was set after the node was read.
+void
+SoVRMLInlineP::delayRead(SoInput * in)
+{
+  this->setFile(NULL);
+  this->children->truncate(0);
+  if (this->master->url.getNum() == 0) return;
+
+  // if we can't find the file, ignore it, as readLocalFile() does
+  const SbString & filename = this->master->url[0];
+  SbStringList subdirs;
+  const SbString found =
+    SoInput::searchForFile(filename, SoInput::getDirectories(), subdirs);
+  if (found.getLength() == 0) {
+    if (in) {
+      SoReadError::post(in, "Unable to find Inline file: ``%s''",
+                        filename.getString());
+    }
+    else {
+      SoDebugError::postWarning("SoVRMLInline::readInstance",
+                                "Unable to find Inline file: ``%s''",
+                                filename.getString());
+    }
+    return;
+  }
+  this->fullurlname = found;
+  this->file = SoFileCache::find(found, SoFileCache::SEPARATOR);
+}
+
+void
+SoVRMLInlineP::setFile(SoFileCache * newfile)
+{
+  if (newfile) newfile->ref();
+  if (this->file) {
+    if (this->isrequested) this->file->cancelLoad(SoVRMLInlineP::loadedCB, this);
+    this->file->unref();
+  }
+  this->file = newfile;
+  this->isrequested = FALSE;
+}
+
+// The bounding box from the bboxCenter and bboxSize fields, or else
+// the one stored next to the file.
+SbBool
+SoVRMLInlineP::getBoundingBox(SbBox3f & box)
+{
+  SbVec3f size = this->master->bboxSize.getValue();
+  if (size[0] >= 0.0f && size[1] >= 0.0f && size[2] >= 0.0f) {
+    const SbVec3f center = this->master->bboxCenter.getValue();
+    size *= 0.5f;
+    box.setBounds(center - size, center + size);
+    return TRUE;
+  }
+  return this->file && this->file->getBoundingBox(box);
+}
+
+void
+SoVRMLInlineP::requestLoad(void)
+{
+  if (this->file->isLoaded()) {
+    this->load();
+  }
+  else if (!this->isrequested) {
+    this->isrequested = this->file->requestLoad(SoVRMLInlineP::loadedCB, this);
+  }
+}
+
+// Reads the file right away, if it hasn't been read into the node.
+// Only done on the main thread, as SoFileP::load() explains.
+void
+SoVRMLInlineP::load(void)
+{
+  if (this->file && SoFileCache::isMainThread()) {
+    this->attach(this->file->load());
+  }
+}
+
+void
+SoVRMLInlineP::attach(SoGroup * root)
+{
+  if (root) root->ref();
+  this->setFile(NULL);
+  this->master->setChildData(root);
+  if (root) root->unref();
+}
+
+void
+SoVRMLInlineP::loadedCB(void * closure, SoFileCache * file)
+{
+  SoVRMLInlineP * thisp = static_cast<SoVRMLInlineP *>(closure);
+  assert(thisp->file == file);
+  thisp->isrequested = FALSE;
+  thisp->attach(file->getRoot());
 }
 
 SO_NODE_SOURCE(SoVRMLInline);
@@ -198,8 +314,10 @@ SoVRMLInline::initClass(void)
 SoVRMLInline::SoVRMLInline(void)
 {
   PRIVATE(this) = new SoVRMLInlineP;
+  PRIVATE(this)->master = this;
   PRIVATE(this)->isrequested = FALSE;
   PRIVATE(this)->children = new SoChildList(this);
+  PRIVATE(this)->file = NULL;
 
   SO_VRMLNODE_INTERNAL_CONSTRUCTOR(SoVRMLInline);
 
@@ -217,6 +335,7 @@ SoVRMLInline::SoVRMLInline(void)
 */
 SoVRMLInline::~SoVRMLInline()
 {
+  PRIVATE(this)->setFile(NULL);
   delete PRIVATE(this)->urlsensor;
   delete PRIVATE(this)->children;
   delete PRIVATE(this);
@@ -246,6 +365,7 @@ SoVRMLInline::getFullURLName(void)
 SoGroup *
 SoVRMLInline::copyChildren(void) const
 {
+  PRIVATE(this)->load();
   if (PRIVATE(this)->children->getLength() == 0) return NULL;
   assert(PRIVATE(this)->children->getLength() == 1);
   SoNode * rootcopy = (*(PRIVATE(this)->children))[0]->copy();
@@ -262,10 +382,18 @@ SoVRMLInline::getChildren(void) const
 
 /*!
   Request URL data.
+
+  When reading the file is delayed (see setDelayFetchURL()), this asks
+  for the file to be read in the background, as if the node had been
+  rendered.
 */
 void
 SoVRMLInline::requestURLData(void)
 {
+  if (PRIVATE(this)->file) {
+    PRIVATE(this)->requestLoad();
+    return;
+  }
   PRIVATE(this)->isrequested = TRUE;
   if (sovrmlinline_fetchurlcb) {
     sovrmlinline_fetchurlcb(PRIVATE(this)->fullurlname,
@@ -298,6 +426,9 @@ SoVRMLInline::isURLDataHere(void) const
 void
 SoVRMLInline::cancelURLDataRequest(void)
 {
+  if (PRIVATE(this)->file && PRIVATE(this)->isrequested) {
+    PRIVATE(this)->file->cancelLoad(SoVRMLInlineP::loadedCB, PRIVATE(this));
+  }
   PRIVATE(this)->isrequested = FALSE;
 }
 
@@ -307,6 +438,7 @@ SoVRMLInline::cancelURLDataRequest(void)
 void
 SoVRMLInline::setChildData(SoNode * urldata)
 {
+  PRIVATE(this)->setFile(NULL);
   PRIVATE(this)->isrequested = FALSE;
   PRIVATE(this)->children->truncate(0);
   if (urldata) {
@@ -391,10 +523,57 @@ SoVRMLInline::getReadAsSoFile(void)
   return sovrmlinline_readassofile;
 }
 
+/*!
+  Sets whether Inline nodes read as SoFile nodes (see
+  setReadAsSoFile()) read their file when the node is read (or the
+  url field is set), or when the node is first traversed. The default
+  is to read the file right away.
+
+  With delayed reading, the file is only looked up in the SoInput
+  search directories when the node is read. It is read when an action
+  needs the children of the node. Render traversals don't wait for
+  the file: they ask for it to be read in the background, and the
+  children are added from a timer sensor when it has been, which in
+  turn triggers a redraw. Until then, the bounding box is drawn as
+  set with setBoundingBoxVisibility(), and nodes outside the view
+  volume don't ask for their file at all. SoHandleEventAction and
+  SoSearchAction don't cause the file to be read.
+
+  All Inline nodes which refer to the same file while it is being read
+  share one scene graph read from it.
+
+  SoGetBoundingBoxAction uses the bboxCenter and bboxSize fields when
+  they are set. Otherwise, it uses the bounding box stored in a file
+  next to the file, if there is one, as described for
+  SoFile::setDelayedRead().
+
+  \since Coin 4.0
+*/
+void
+SoVRMLInline::setDelayFetchURL(const SbBool onoff)
+{
+  sovrmlinline_delayfetchurl = onoff;
+}
+
+/*!
+  Returns whether reading the files of Inline nodes is delayed until
+  the nodes are first traversed.
+
+  \sa setDelayFetchURL()
+  \since Coin 4.0
+*/
+SbBool
+SoVRMLInline::getDelayFetchURL(void)
+{
+  return sovrmlinline_delayfetchurl;
+}
+
 // Doc in parent
 void
 SoVRMLInline::doAction(SoAction * action)
 {
+  PRIVATE(this)->load();
+
   int numindices;
   const int * indices;
   if (action->getPathCode(numindices, indices) == SoAction::IN_PATH) {
@@ -473,6 +652,20 @@ SoVRMLInline::GLRender(SoGLRenderAction * action)
     glEnd();
     state->pop();
   }
+
+  if (PRIVATE(this)->file) {
+    // Ask for the file to be read, unless the node is outside the
+    // view volume. The children are not rendered until it has been
+    // read, so make sure no render cache is made from this.
+    SoState * state = action->getState();
+    SoCacheElement::invalidate(state);
+    SbBox3f box;
+    if (!PRIVATE(this)->getBoundingBox(box) ||
+        !SoCullElement::cullTest(state, box, TRUE)) {
+      PRIVATE(this)->requestLoad();
+    }
+    return;
+  }
   SoVRMLInline::doAction(action);
 }
 
@@ -502,6 +695,25 @@ SoVRMLInline::getBoundingBox(SoGetBoundingBoxAction * action)
     int numindices;
     const int * indices;
     int lastchildindex;
+
+    if (PRIVATE(this)->file) {
+      // use the bounding box stored with the file, if there is one,
+      // so the file isn't read until it's needed
+      SbBox3f box;
+      if (PRIVATE(this)->file->getBoundingBox(box)) {
+        if (action->getPathCode(numindices, indices) != SoAction::OFF_PATH) {
+          action->extendBy(box);
+          action->setCenter(box.getCenter(), TRUE);
+        }
+        return;
+      }
+      PRIVATE(this)->load();
+      if (PRIVATE(this)->file) {
+        // not read on this thread, so don't cache the empty box
+        SoCacheElement::invalidate(action->getState());
+        return;
+      }
+    }
     
     if (action->getPathCode(numindices, indices) == SoAction::IN_PATH)
       lastchildindex = indices[numindices-1];
@@ -541,6 +753,8 @@ SoVRMLInline::getMatrix(SoGetMatrixAction * action)
 void
 SoVRMLInline::handleEvent(SoHandleEventAction * action)
 {
+  // events don't cause the file to be read
+  if (PRIVATE(this)->file) return;
   SoVRMLInline::doAction((SoAction*)action);
 }
 
@@ -551,6 +765,8 @@ SoVRMLInline::search(SoSearchAction * action)
   SoNode::search(action);
   if (action->isFound()) return;
 
+  // searching doesn't cause the file to be read
+  if (PRIVATE(this)->file) return;
   SoVRMLInline::doAction(action);
 }
 
@@ -586,7 +802,12 @@ SoVRMLInline::readInstance(SoInput * in,
   if (sovrmlinline_readassofile) {
     PRIVATE(this)->fullurlname.makeEmpty();
     ret = inherited::readInstance(in, flags);
-    ret = ret && this->readLocalFile(in);
+    if (ret && sovrmlinline_delayfetchurl) {
+      PRIVATE(this)->delayRead(in);
+    }
+    else {
+      ret = ret && this->readLocalFile(in);
+    }
   }
   else {
     ret = inherited::readInstance(in, flags);
@@ -602,6 +823,7 @@ void
 SoVRMLInline::copyContents(const SoFieldContainer * from,
                            SbBool copyconnections)
 {
+  PRIVATE(this)->setFile(NULL);
   PRIVATE(this)->children->truncate(0);
   inherited::copyContents(from, copyconnections);
 
@@ -609,6 +831,8 @@ SoVRMLInline::copyContents(const SoFieldContainer * from,
   PRIVATE(this)->fullurlname = inlinenode->pimpl->fullurlname;
   // the request will go to the original node, not this one.
   PRIVATE(this)->isrequested = FALSE;
+  // a file which hasn't been read yet is shared with the copy
+  PRIVATE(this)->setFile(inlinenode->pimpl->file);
 
   if (inlinenode->pimpl->children->getLength() == 0) return;
 
@@ -626,6 +850,8 @@ SoVRMLInline::copyContents(const SoFieldContainer * from,
 SbBool
 SoVRMLInline::readLocalFile(SoInput * in)
 {
+  PRIVATE(this)->setFile(NULL);
+
   if (this->url.getNum() == 0) {
     return TRUE;
   }
@@ -677,7 +903,10 @@ SoVRMLInline::urlFieldModified(void * userdata, SoSensor * COIN_UNUSED_ARG(senso
   SoVRMLInline * thisp = (SoVRMLInline *)userdata;
   SoInput in;
   thisp->pimpl->fullurlname.makeEmpty();
-  if (sovrmlinline_readassofile) {
+  if (sovrmlinline_readassofile && sovrmlinline_delayfetchurl) {
+    thisp->pimpl->delayRead(NULL);
+  }
+  else if (sovrmlinline_readassofile) {
     (void)thisp->readLocalFile(&in);
   }
   else {
@@ -687,4 +916,74 @@ SoVRMLInline::urlFieldModified(void * userdata, SoSensor * COIN_UNUSED_ARG(senso
 
 #undef PRIVATE
 
+#ifdef COIN_TEST_SUITE
+
+#include <cstdio>
+#include <cstring>
+#include <Inventor/C/threads/thread.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/VRMLnodes/SoVRMLInline.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/sensors/SoSensorManager.h>
+
+BOOST_AUTO_TEST_CASE(DelayFetchURL)
+{
+  SoDB::init();
+
+  const std::string subfile = TemporaryFileName(".wrl");
+  FILE * fp = fopen(subfile.c_str(), "wb");
+  BOOST_REQUIRE(fp);
+  (void)fputs("#VRML V2.0 utf8\n\nTransform { translation 1 2 3 }\n", fp);
+  (void)fclose(fp);
+
+  const std::string scene =
+    "#VRML V2.0 utf8\n\n"
+    "Inline { url \"" + subfile + "\" bboxSize 2 2 2 }\n"
+    "Inline { url \"" + subfile + "\" bboxSize 2 2 2 }\n";
+
+  SoVRMLInline::setDelayFetchURL(TRUE);
+  SoInput in;
+  in.setBuffer(scene.c_str(), scene.size());
+  SoSeparator * root = SoDB::readAll(&in);
+  SoVRMLInline::setDelayFetchURL(FALSE);
+  BOOST_REQUIRE(root);
+  root->ref();
+
+  SoVRMLInline * inline1 = static_cast<SoVRMLInline *>(root->getChild(0));
+  SoVRMLInline * inline2 = static_cast<SoVRMLInline *>(root->getChild(1));
+  BOOST_CHECK_MESSAGE(!inline1->isURLDataHere(), "file was read with the node");
+
+  SoGetBoundingBoxAction bboxaction((SbViewportRegion()));
+  bboxaction.apply(root);
+  BOOST_CHECK_MESSAGE(bboxaction.getBoundingBox() == SbBox3f(-1, -1, -1, 1, 1, 1),
+                      "wrong bounding box before reading the file");
+
+  inline1->requestURLData();
+  inline2->requestURLData();
+  BOOST_CHECK(inline1->isURLDataRequested());
+
+  // the file is read in the background, and handed to the nodes from
+  // a timer sensor
+  const SbTime timeout = SbTime::getTimeOfDay() + SbTime(10.0);
+  while (!(inline1->isURLDataHere() && inline2->isURLDataHere()) &&
+         SbTime::getTimeOfDay() < timeout) {
+    cc_sleep(0.01f);
+    SoDB::getSensorManager()->processTimerQueue();
+  }
+  BOOST_CHECK_MESSAGE(inline1->isURLDataHere() && inline2->isURLDataHere(),
+                      "file wasn't read in the background");
+  BOOST_CHECK_MESSAGE(inline1->getChildData() == inline2->getChildData(),
+                      "references to the same file don't share the scene");
+  BOOST_CHECK(!inline1->isURLDataRequested());
+
+  root->unref();
+  (void)remove(subfile.c_str());
+}
+
+#endif // COIN_TEST_SUITE
+
 #endif // HAVE_VRML97
@@ -0,0 +1,116 @@
+/************************************************************************
+ *
+ * Compare the chained SbHash with the open addressing SbFlatHash, for
+ * the two kinds of keys used by the core: object pointers (as in the
+ * SoBase auditor and name dictionaries) and SbName strings (as in the
+ * SoType and SoBase name lookups).
+ *
+ * For each kind of key and each table, a number of keys are inserted,
+ * looked up again (all hits, then all misses), iterated over, and
+ * finally erased. The time per key is written to stdout.
+ *
+ * These are internal classes, so build against the source tree:
+ *
+ *   g++ -O2 -DCOIN_INTERNAL -I<src> -I<include> -I<build>/include
+ *       benchmark.cpp -L<build>/lib -lCoin
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbName.h>
+#include <Inventor/SbString.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/nodes/SoInfo.h>
+
+#include "misc/SbHash.h"
+#include "misc/SbFlatHash.h"
+
+#include "../benchmark.h"
+
+static void
+report(const char * table, const char * what, const SbTime & elapsed, int num)
+{
+  SbString name;
+  name.sprintf("%s %s", table, what);
+  benchmark_report(name.getString(), elapsed, num, "key");
+}
+
+template <class Hash, class Key>
+static void
+measure(const char * table, const Key * keys, const Key * missing, int num)
+{
+  Hash hash;
+  int i;
+  SbTime start = SbTime::getTimeOfDay();
+  for (i = 0; i < num; i++) hash.put(keys[i], i);
+  report(table, "insert", SbTime::getTimeOfDay() - start, num);
+
+  int sum = 0, value;
+  start = SbTime::getTimeOfDay();
+  for (i = 0; i < num; i++) {
+    if (hash.get(keys[i], value)) sum += value;
+  }
+  report(table, "hit", SbTime::getTimeOfDay() - start, num);
+
+  start = SbTime::getTimeOfDay();
+  for (i = 0; i < num; i++) {
+    if (hash.get(missing[i], value)) sum += value;
+  }
+  report(table, "miss", SbTime::getTimeOfDay() - start, num);
+
+  start = SbTime::getTimeOfDay();
+  for (typename Hash::const_iterator it = hash.const_begin();
+       it != hash.const_end(); ++it) {
+    sum += it->obj;
+  }
+  report(table, "iterate", SbTime::getTimeOfDay() - start, num);
+
+  start = SbTime::getTimeOfDay();
+  for (i = 0; i < num; i++) hash.erase(keys[i]);
+  report(table, "erase", SbTime::getTimeOfDay() - start, num);
+
+  // keep the loops from being optimized away
+  if (sum == 42) (void)fprintf(stdout, "\n");
+}
+
+int
+main(int argc, char ** argv)
+{
+  benchmark_check_args(argc, argv, 0, 1, "[KEYS]",
+                       "\tKEYS = number of keys per test (default 1000000).\n");
+  const int num = benchmark_int_arg(argc, argv, 1, 1000000);
+
+  SoDB::init();
+
+  // pointer keys, from nodes allocated the way a scene graph would be
+  const SoBase ** nodes = new const SoBase *[2 * num];
+  int i;
+  for (i = 0; i < 2 * num; i++) {
+    SoInfo * info = new SoInfo;
+    info->ref();
+    nodes[i] = info;
+  }
+  (void)fprintf(stdout, "%d pointer keys\n", num);
+  measure<SbHash<const SoBase *, int> >("SbHash", nodes, nodes + num, num);
+  measure<SbFlatHash<const SoBase *, int> >("SbFlatHash", nodes, nodes + num, num);
+
+  // SbName keys
+  const char ** names = new const char *[2 * num];
+  char buf[64];
+  for (i = 0; i < 2 * num; i++) {
+    (void)sprintf(buf, "benchmark_name_%d", i);
+    names[i] = SbName(buf).getString();
+  }
+  (void)fprintf(stdout, "%d SbName keys\n", num);
+  measure<SbHash<const char *, int> >("SbHash", names, names + num, num);
+  measure<SbFlatHash<const char *, int> >("SbFlatHash", names, names + num, num);
+
+  for (i = 0; i < 2 * num; i++) {
+    const_cast<SoBase *>(nodes[i])->unref();
+  }
+  delete[] nodes;
+  delete[] names;
+  return 0;
+}
@@ -0,0 +1,116 @@
+/************************************************************************
+ *
+ * Measure the cost of constructing SbName instances, which looks up
+ * and inserts strings in the global name table.
+ *
+ * A number of unique names are first constructed from one thread,
+ * then looked up again, and then the same is done from several
+ * threads at once. Finally a generated scene with a DEF name on
+ * every node is read with SoDB::readAll(). The timings are written
+ * to stdout.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SbName.h>
+#include <Inventor/SbString.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/C/threads/thread.h>
+#include <Inventor/nodes/SoSeparator.h>
+
+#include "../benchmark.h"
+
+static int numnames = 0;
+
+struct thread_data {
+  int first;
+  int num;
+};
+
+// Constructs names from a range of which the threads share half, so
+// that both new and existing strings are looked up.
+static void *
+construct_names(void * closure)
+{
+  thread_data * data = static_cast<thread_data *>(closure);
+  char buf[64];
+  for (int i = 0; i < data->num; i++) {
+    const int idx = (i % 2) ? i : data->first + i;
+    (void)sprintf(buf, "thread_name_%d", idx);
+    SbName name(buf);
+  }
+  return NULL;
+}
+
+int
+main(int argc, char ** argv)
+{
+  benchmark_check_args(argc, argv, 0, 2, "[NAMES [THREADS]]",
+                       "\tNAMES = number of names per test (default 1000000).\n"
+                       "\tTHREADS = number of threads (default 4).\n");
+  numnames = benchmark_int_arg(argc, argv, 1, 1000000);
+  const int numthreads = benchmark_int_arg(argc, argv, 2, 4);
+
+  SoDB::init();
+
+  char buf[64];
+  int i;
+  SbTime start = SbTime::getTimeOfDay();
+  for (i = 0; i < numnames; i++) {
+    (void)sprintf(buf, "name_%d", i);
+    SbName name(buf);
+  }
+  benchmark_report("insert", SbTime::getTimeOfDay() - start, numnames, "name");
+
+  start = SbTime::getTimeOfDay();
+  for (i = 0; i < numnames; i++) {
+    (void)sprintf(buf, "name_%d", i);
+    SbName name(buf);
+  }
+  benchmark_report("lookup", SbTime::getTimeOfDay() - start, numnames, "name");
+
+  cc_thread ** threads = new cc_thread *[numthreads];
+  thread_data * data = new thread_data[numthreads];
+  start = SbTime::getTimeOfDay();
+  for (i = 0; i < numthreads; i++) {
+    data[i].first = numnames * (i + 1);
+    data[i].num = numnames / numthreads;
+    threads[i] = cc_thread_construct(construct_names, &data[i]);
+  }
+  for (i = 0; i < numthreads; i++) {
+    cc_thread_join(threads[i], NULL);
+    cc_thread_destruct(threads[i]);
+  }
+  SbString what;
+  what.sprintf("%d threads", numthreads);
+  benchmark_report(what.getString(), SbTime::getTimeOfDay() - start,
+                   numnames, "name");
+  delete[] threads;
+  delete[] data;
+
+  // a flat scene, with a unique DEF name on every node
+  const int numnodes = numnames / 10;
+  const size_t size = 64 + size_t(numnodes) * 48;
+  char * scene = static_cast<char *>(malloc(size));
+  char * ptr = scene;
+  ptr += sprintf(ptr, "#Inventor V2.1 ascii\n\nSeparator {\n");
+  for (i = 0; i < numnodes; i++) {
+    ptr += sprintf(ptr, "  DEF file_node_%d Info { }\n", i);
+  }
+  ptr += sprintf(ptr, "}\n");
+
+  SoInput in;
+  in.setBuffer(scene, ptr - scene);
+  start = SbTime::getTimeOfDay();
+  SoSeparator * root = SoDB::readAll(&in);
+  benchmark_report("SoDB::readAll", SbTime::getTimeOfDay() - start,
+                   numnodes, "name");
+  if (root) root->ref();
+  if (root) root->unref();
+  free(scene);
+
+  return 0;
+}
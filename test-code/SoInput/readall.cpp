@@ -0,0 +1,108 @@
+/************************************************************************
+ *
+ * Measure the cost of reading a file with many children below a
+ * single root SoSeparator with SoDB::readAll(), using one and several
+ * parse threads.
+ *
+ * A scene with a number of small Separator subgraphs is written to a
+ * memory buffer, and read back with a growing number of threads set
+ * with SoInput::setNumParseThreads(). The time taken and whether the
+ * scene read back the same as with one thread are written to stdout.
+ *
+ * The pieces are only read in parallel by thread safe builds of Coin.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/actions/SoWriteAction.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoMaterial.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+#include "../benchmark.h"
+
+static void
+write_scene(SoNode * root, void *& buf, size_t & size)
+{
+  SoOutput out;
+  out.setBuffer(malloc(1024), 1024, realloc);
+  SoWriteAction wa(&out);
+  wa.apply(root);
+  out.getBuffer(buf, size);
+}
+
+int
+main(int argc, char ** argv)
+{
+  benchmark_check_args(argc, argv, 0, 2, "[CHILDREN] [MAXTHREADS]",
+                       "\tCHILDREN = number of children of the root (default 100000).\n"
+                       BENCHMARK_MAXTHREADS_USAGE(8));
+  const int numchildren = benchmark_int_arg(argc, argv, 1, 100000);
+  const int maxthreads = benchmark_int_arg(argc, argv, 2, 8);
+
+  SoDB::init();
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  srand(1);
+  for (int i = 0; i < numchildren; i++) {
+    SoSeparator * sep = new SoSeparator;
+    SoTranslation * translation = new SoTranslation;
+    translation->translation.setValue(float(rand()) / float(RAND_MAX),
+                                      float(rand()) / float(RAND_MAX),
+                                      float(rand()) / float(RAND_MAX));
+    SoMaterial * material = new SoMaterial;
+    material->diffuseColor.setValue(float(rand()) / float(RAND_MAX), 0.5f, 0.5f);
+    sep->addChild(translation);
+    sep->addChild(material);
+    sep->addChild(new SoCube);
+    root->addChild(sep);
+  }
+
+  void * scene;
+  size_t scenesize;
+  write_scene(root, scene, scenesize);
+  root->unref();
+  (void)fprintf(stdout, "%d children, %lu bytes\n",
+                numchildren, (unsigned long)scenesize);
+
+  void * reference = NULL;
+  size_t referencesize = 0;
+  for (int numthreads = 1; numthreads <= maxthreads; numthreads *= 2) {
+    SoInput in;
+    in.setBuffer(scene, scenesize);
+    in.setNumParseThreads(numthreads);
+    const SbTime start = SbTime::getTimeOfDay();
+    SoSeparator * result = SoDB::readAll(&in);
+    const SbTime elapsed = SbTime::getTimeOfDay() - start;
+    if (result == NULL) exit(1);
+    result->ref();
+
+    void * written;
+    size_t writtensize;
+    write_scene(result, written, writtensize);
+    result->unref();
+    SbBool same = TRUE;
+    if (reference == NULL) {
+      reference = written;
+      referencesize = writtensize;
+    }
+    else {
+      same = (writtensize == referencesize) &&
+        (memcmp(written, reference, writtensize) == 0);
+      free(written);
+    }
+    benchmark_report_threads("readAll", numthreads, elapsed,
+                             same ? "ok" : "DIFFERS");
+  }
+  free(reference);
+  free(scene);
+  return 0;
+}
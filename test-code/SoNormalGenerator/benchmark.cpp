@@ -0,0 +1,92 @@
+/************************************************************************
+ *
+ * Measure the cost of generating crease angle vertex normals for a
+ * large indexed face set.
+ *
+ * A bumpy grid of triangles is set up as coordinates and coordinate
+ * indices. Normals are generated once with SoNormalGenerator by
+ * welding the vertices by position, as for non-indexed shapes, and
+ * then with SoNormalCache::generatePerVertex(), as for
+ * SoIndexedFaceSet, with a growing number of threads set with
+ * SoNormalGenerator::setNumThreads(). The time taken and whether the
+ * normals are the same as with one thread are written to stdout.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/caches/SoNormalCache.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/misc/SoNormalGenerator.h>
+
+#include "../benchmark.h"
+
+int
+main(int argc, char ** argv)
+{
+  benchmark_check_args(argc, argv, 0, 2, "[SIZE] [MAXTHREADS]",
+                       "\tSIZE = number of grid cells along each side, two\n"
+                       "\t       triangles per cell (default 1000).\n"
+                       BENCHMARK_MAXTHREADS_USAGE(8));
+  const int size = benchmark_int_arg(argc, argv, 1, 1000);
+  const int maxthreads = benchmark_int_arg(argc, argv, 2, 8);
+  const float creaseangle = 0.8f;
+
+  SoDB::init();
+
+  SbList <SbVec3f> coords;
+  SbList <int32_t> indices;
+  srand(1);
+  for (int z = 0; z <= size; z++) {
+    for (int x = 0; x <= size; x++) {
+      coords.append(SbVec3f(float(x), float(rand()) / float(RAND_MAX), float(z)));
+    }
+  }
+  for (int z = 0; z < size; z++) {
+    for (int x = 0; x < size; x++) {
+      const int32_t idx = z * (size + 1) + x;
+      indices.append(idx); indices.append(idx + size + 1);
+      indices.append(idx + 1); indices.append(-1);
+      indices.append(idx + 1); indices.append(idx + size + 1);
+      indices.append(idx + size + 2); indices.append(-1);
+    }
+  }
+  (void)fprintf(stdout, "%d triangles\n", size * size * 2);
+
+  SbTime start = SbTime::getTimeOfDay();
+  SoNormalGenerator welded(TRUE);
+  for (int i = 0; i < indices.getLength(); i += 4) {
+    welded.triangle(coords[indices[i]], coords[indices[i+1]], coords[indices[i+2]]);
+  }
+  welded.generate(creaseangle);
+  benchmark_report("welded", SbTime::getTimeOfDay() - start,
+                   size * size * 2, "triangle");
+
+  SbList <SbVec3f> reference;
+  for (int numthreads = 1; numthreads <= maxthreads; numthreads *= 2) {
+    SoNormalGenerator::setNumThreads(numthreads);
+    SoNormalCache cache(NULL);
+    start = SbTime::getTimeOfDay();
+    cache.generatePerVertex(coords.getArrayPtr(), coords.getLength(),
+                            indices.getArrayPtr(), indices.getLength(),
+                            creaseangle);
+    const SbTime elapsed = SbTime::getTimeOfDay() - start;
+
+    SbBool same = TRUE;
+    const SbVec3f * normals = cache.getNormals();
+    const int32_t * normalindices = cache.getIndices();
+    int vertex = 0;
+    for (int i = 0; i < cache.getNumIndices(); i++) {
+      if (normalindices[i] < 0) continue;
+      const SbVec3f & n = normals[normalindices[i]];
+      if (numthreads == 1) reference.append(n);
+      else if (n != reference[vertex]) same = FALSE;
+      vertex++;
+    }
+    benchmark_report_threads("indexed", numthreads, elapsed,
+                             same ? "ok" : "DIFFERS");
+  }
+  return 0;
+}
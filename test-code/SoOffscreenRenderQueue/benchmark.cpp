@@ -0,0 +1,137 @@
+/************************************************************************
+ *
+ * Measure the generation of a batch of thumbnails of the same scene
+ * from different viewpoints, the way a thumbnail service would do it.
+ *
+ * The thumbnails are first rendered with a new SoOffscreenRenderer
+ * for each of them, then the same with a pool of offscreen contexts
+ * (SoOffscreenRenderer::setContextPoolSize()), and finally through an
+ * SoOffscreenRenderQueue with an increasing number of threads. The
+ * total time for each is written to stdout.
+ *
+ * Multiple threads are only used if Coin was built with
+ * COIN_THREADSAFE.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoOffscreenRenderQueue.h>
+#include <Inventor/SoOffscreenRenderer.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/nodes/SoDirectionalLight.h>
+#include <Inventor/nodes/SoGroup.h>
+#include <Inventor/nodes/SoPerspectiveCamera.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/nodes/SoTexture2.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+#include "../benchmark.h"
+
+static SoSeparator *
+make_scene(int gridsize)
+{
+  SoSeparator * root = new SoSeparator;
+  root->addChild(new SoDirectionalLight);
+
+  // a checkerboard texture, to be uploaded for each new context
+  const int texsize = 512;
+  SoTexture2 * texture = new SoTexture2;
+  texture->image.setValue(SbVec2s(texsize, texsize), 3, NULL);
+  SbVec2s imagesize;
+  int nc;
+  unsigned char * pixels = texture->image.startEditing(imagesize, nc);
+  for (int i = 0; i < texsize * texsize; i++) {
+    const unsigned char c = ((i / 32 + i / (32 * texsize)) % 2) ? 255 : 64;
+    pixels[i * 3] = c; pixels[i * 3 + 1] = c; pixels[i * 3 + 2] = 128;
+  }
+  texture->image.finishEditing();
+  root->addChild(texture);
+
+  for (int y = 0; y < gridsize; y++) {
+    for (int x = 0; x < gridsize; x++) {
+      SoSeparator * sep = new SoSeparator;
+      SoTranslation * translation = new SoTranslation;
+      translation->translation.setValue(float(x) * 3.0f, float(y) * 3.0f, 0.0f);
+      sep->addChild(translation);
+      sep->addChild(new SoSphere);
+      root->addChild(sep);
+    }
+  }
+  return root;
+}
+
+static SbTime
+render_separately(SoSeparator * scene, SoPerspectiveCamera ** cameras,
+                  int num, const SbVec2s & size)
+{
+  const SbViewportRegion viewport(size);
+  const SbTime start = SbTime::getTimeOfDay();
+  for (int i = 0; i < num; i++) {
+    SoGroup * root = new SoGroup;
+    root->ref();
+    root->addChild(cameras[i]);
+    root->addChild(scene);
+    SoOffscreenRenderer renderer(viewport);
+    if (!renderer.render(root)) {
+      (void)fprintf(stderr, "Rendering failed.\n");
+      exit(1);
+    }
+    root->unref();
+  }
+  return SbTime::getTimeOfDay() - start;
+}
+
+int
+main(int argc, char ** argv)
+{
+  benchmark_check_args(argc, argv, 0, 3, "[THUMBNAILS [SIZE [MAXTHREADS]]]",
+                       "\tTHUMBNAILS = number of thumbnails (default 200).\n"
+                       "\tSIZE = width and height of each (default 128).\n"
+                       BENCHMARK_MAXTHREADS_USAGE(4));
+  const int num = benchmark_int_arg(argc, argv, 1, 200);
+  const short side = (short)benchmark_int_arg(argc, argv, 2, 128);
+  const int maxthreads = benchmark_int_arg(argc, argv, 3, 4);
+  const SbVec2s size(side, side);
+
+  SoDB::init();
+
+  SoSeparator * scene = make_scene(10);
+  scene->ref();
+
+  SoPerspectiveCamera ** cameras = new SoPerspectiveCamera *[num];
+  int i;
+  for (i = 0; i < num; i++) {
+    cameras[i] = new SoPerspectiveCamera;
+    cameras[i]->ref();
+    cameras[i]->orientation.setValue(SbRotation(SbVec3f(0.0f, 1.0f, 0.0f),
+                                                float(i) * 0.01f));
+    cameras[i]->viewAll(scene, SbViewportRegion(size));
+  }
+
+  benchmark_report("new renderer each",
+                   render_separately(scene, cameras, num, size), num, "thumbnail");
+
+  SoOffscreenRenderer::setContextPoolSize(1);
+  benchmark_report("new renderer, pooled",
+                   render_separately(scene, cameras, num, size), num, "thumbnail");
+  SoOffscreenRenderer::setContextPoolSize(0);
+
+  for (int numthreads = 1; numthreads <= maxthreads; numthreads *= 2) {
+    SoOffscreenRenderQueue queue;
+    queue.setNumThreads(numthreads);
+    const SbTime start = SbTime::getTimeOfDay();
+    for (i = 0; i < num; i++) { (void)queue.addJob(scene, cameras[i], size); }
+    queue.processJobs();
+    benchmark_report_threads("queue", numthreads,
+                             SbTime::getTimeOfDay() - start, NULL);
+  }
+
+  for (i = 0; i < num; i++) { cameras[i]->unref(); }
+  delete[] cameras;
+  scene->unref();
+  return 0;
+}
@@ -0,0 +1,106 @@
+/************************************************************************
+ *
+ * Measure tiled offscreen rendering with SoOffscreenRenderer, using
+ * one thread and then an increasing number of threads, each rendering
+ * tiles into an offscreen context of its own.
+ *
+ * The scene is a grid of spheres, rendered at a size which is larger
+ * than the maximum tile size, so tiles must be used. The time for
+ * each render is written to stdout, and the image from each thread
+ * count is compared with the one rendered with a single thread.
+ *
+ * Multiple threads are only used if Coin was built with
+ * COIN_THREADSAFE. To get tiles without rendering huge images, limit
+ * the tile size, e.g.
+ *
+ *   $ export COIN_OFFSCREENRENDERER_MAX_TILESIZE=256
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoOffscreenRenderer.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/nodes/SoDirectionalLight.h>
+#include <Inventor/nodes/SoMaterial.h>
+#include <Inventor/nodes/SoPerspectiveCamera.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+#include "../benchmark.h"
+
+static SoSeparator *
+make_scene(int gridsize)
+{
+  SoSeparator * root = new SoSeparator;
+  SoPerspectiveCamera * camera = new SoPerspectiveCamera;
+  root->addChild(camera);
+  root->addChild(new SoDirectionalLight);
+  for (int y = 0; y < gridsize; y++) {
+    for (int x = 0; x < gridsize; x++) {
+      SoSeparator * sep = new SoSeparator;
+      SoTranslation * translation = new SoTranslation;
+      translation->translation.setValue(float(x) * 3.0f, float(y) * 3.0f, 0.0f);
+      SoMaterial * material = new SoMaterial;
+      material->diffuseColor.setValue(float(x) / gridsize, float(y) / gridsize, 0.5f);
+      sep->addChild(translation);
+      sep->addChild(material);
+      sep->addChild(new SoSphere);
+      root->addChild(sep);
+    }
+  }
+  camera->viewAll(root, SbViewportRegion(100, 100));
+  return root;
+}
+
+int
+main(int argc, char ** argv)
+{
+  benchmark_check_args(argc, argv, 0, 3, "[WIDTH [HEIGHT [MAXTHREADS]]]",
+                       "\tWIDTH = image width (default 4096).\n"
+                       "\tHEIGHT = image height (default WIDTH).\n"
+                       BENCHMARK_MAXTHREADS_USAGE(4));
+  const int width = benchmark_int_arg(argc, argv, 1, 4096);
+  const int height = benchmark_int_arg(argc, argv, 2, width);
+  const int maxthreads = benchmark_int_arg(argc, argv, 3, 4);
+
+  SoDB::init();
+
+  SoSeparator * root = make_scene(20);
+  root->ref();
+
+  SoOffscreenRenderer renderer(SbViewportRegion(width, height));
+  const size_t size = size_t(width) * size_t(height) * 3;
+  unsigned char * reference = NULL;
+
+  for (int numthreads = 1; numthreads <= maxthreads; numthreads *= 2) {
+    renderer.setNumThreads(numthreads);
+    // the first render also sets up contexts and caches
+    for (int pass = 0; pass < 2; pass++) {
+      const SbTime start = SbTime::getTimeOfDay();
+      if (!renderer.render(root)) {
+        (void)fprintf(stderr, "Rendering failed.\n");
+        exit(1);
+      }
+      const SbTime elapsed = SbTime::getTimeOfDay() - start;
+      const char * result = NULL;
+      if (pass == 1) {
+        if (reference == NULL) {
+          reference = new unsigned char[size];
+          (void)memcpy(reference, renderer.getBuffer(), size);
+        }
+        result = memcmp(reference, renderer.getBuffer(), size) ? "DIFFERS" : "ok";
+      }
+      benchmark_report_threads(pass ? "second" : "first", numthreads,
+                               elapsed, result);
+    }
+  }
+
+  delete[] reference;
+  root->unref();
+  return 0;
+}
@@ -0,0 +1,102 @@
+/************************************************************************
+ *
+ * Measure the cost of writing floating point numbers to ASCII files
+ * and reading them back again.
+ *
+ * A coordinate list of random points is written with SoWriteAction,
+ * once with the default precision and once with
+ * SoOutput::setRoundTripFloats(), and each file is read back with
+ * SoDB::readAll(). The time per number and the file sizes are written
+ * to stdout, along with the number of values which didn't read back
+ * exactly.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/actions/SoWriteAction.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoSeparator.h>
+
+#include "../benchmark.h"
+
+static void
+measure(SoSeparator * root, SbBool roundtrip, int numpoints)
+{
+  const char * name = roundtrip ? "round trip" : "default precision";
+  SbString what;
+
+  SoOutput out;
+  out.setBuffer(malloc(1024), 1024, realloc);
+  out.setRoundTripFloats(roundtrip);
+  SoWriteAction wa(&out);
+  SbTime start = SbTime::getTimeOfDay();
+  wa.apply(root);
+  what.sprintf("write, %s", name);
+  benchmark_report(what.getString(), SbTime::getTimeOfDay() - start,
+                   numpoints * 3, "number");
+
+  void * buf;
+  size_t size;
+  out.getBuffer(buf, size);
+  (void)fprintf(stdout, "%-24s %8.1f bytes/number\n", "",
+                double(size) / double(numpoints * 3));
+
+  SoInput in;
+  in.setBuffer(buf, size);
+  start = SbTime::getTimeOfDay();
+  SoSeparator * result = SoDB::readAll(&in);
+  what.sprintf("read, %s", name);
+  benchmark_report(what.getString(), SbTime::getTimeOfDay() - start,
+                   numpoints * 3, "number");
+
+  if (result) {
+    result->ref();
+    const SoMFVec3f & written =
+      static_cast<SoCoordinate3 *>(root->getChild(0))->point;
+    const SoMFVec3f & read =
+      static_cast<SoCoordinate3 *>(result->getChild(0))->point;
+    int differ = 0;
+    for (int i = 0; i < numpoints; i++) {
+      if (memcmp(written[i].getValue(), read[i].getValue(), sizeof(SbVec3f))) differ++;
+    }
+    (void)fprintf(stdout, "%-24s %8d points differ\n", "", differ);
+    result->unref();
+  }
+  free(buf);
+}
+
+int
+main(int argc, char ** argv)
+{
+  benchmark_check_args(argc, argv, 0, 1, "[POINTS]",
+                       "\tPOINTS = number of points to write (default 1000000).\n");
+  const int numpoints = benchmark_int_arg(argc, argv, 1, 1000000);
+
+  SoDB::init();
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  root->addChild(coords);
+  coords->point.setNum(numpoints);
+  SbVec3f * pts = coords->point.startEditing();
+  srand(1);
+  for (int i = 0; i < numpoints; i++) {
+    pts[i].setValue(float(rand()) / float(RAND_MAX) * 200.0f - 100.0f,
+                    float(rand()) / float(RAND_MAX),
+                    float(rand()) / float(RAND_MAX) * 1.0e-3f);
+  }
+  coords->point.finishEditing();
+
+  measure(root, FALSE, numpoints);
+  measure(root, TRUE, numpoints);
+
+  root->unref();
+  return 0;
+}
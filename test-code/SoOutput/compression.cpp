@@ -0,0 +1,102 @@
+/************************************************************************
+ *
+ * Measure the cost of writing compressed files with SoOutput, using
+ * one and several compression threads.
+ *
+ * A coordinate list of random points is written with SoWriteAction
+ * to a file, with each available compression method and a growing
+ * number of threads set with SoOutput::setNumCompressionThreads().
+ * The time taken, the file size and whether the file read back the
+ * same are written to stdout.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/SbString.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/actions/SoWriteAction.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoSeparator.h>
+
+#include "../benchmark.h"
+
+static void
+measure(SoSeparator * root, const SbName & method, int numthreads,
+        const char * filename)
+{
+  SoOutput out;
+  (void)out.setCompression(method, 0.5f);
+  out.setNumCompressionThreads(numthreads);
+  out.setRoundTripFloats(TRUE);
+  if (!out.openFile(filename)) exit(1);
+  SoWriteAction wa(&out);
+  SbTime start = SbTime::getTimeOfDay();
+  wa.apply(root);
+  out.closeFile();
+  const SbTime elapsed = SbTime::getTimeOfDay() - start;
+
+  FILE * fp = fopen(filename, "rb");
+  (void)fseek(fp, 0, SEEK_END);
+  const long size = ftell(fp);
+  (void)fclose(fp);
+
+  SoInput in;
+  (void)in.openFile(filename);
+  SoSeparator * result = SoDB::readAll(&in);
+  SbBool same = FALSE;
+  if (result) {
+    result->ref();
+    same =
+      static_cast<SoCoordinate3 *>(root->getChild(0))->point ==
+      static_cast<SoCoordinate3 *>(result->getChild(0))->point;
+    result->unref();
+  }
+  SbString status;
+  status.sprintf("%10ld bytes %s", size, same ? "ok" : "DIFFERS");
+  benchmark_report_threads(method.getString(), numthreads, elapsed,
+                           status.getString());
+}
+
+int
+main(int argc, char ** argv)
+{
+  benchmark_check_args(argc, argv, 1, 3, "FILE [POINTS] [MAXTHREADS]",
+                       "\tFILE = temporary file to write to.\n"
+                       "\tPOINTS = number of points to write (default 1000000).\n"
+                       BENCHMARK_MAXTHREADS_USAGE(8));
+  const char * filename = argv[1];
+  const int numpoints = benchmark_int_arg(argc, argv, 2, 1000000);
+  const int maxthreads = benchmark_int_arg(argc, argv, 3, 8);
+
+  SoDB::init();
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  root->addChild(coords);
+  coords->point.setNum(numpoints);
+  SbVec3f * pts = coords->point.startEditing();
+  srand(1);
+  for (int i = 0; i < numpoints; i++) {
+    pts[i].setValue(float(rand()) / float(RAND_MAX) * 200.0f - 100.0f,
+                    float(rand()) / float(RAND_MAX),
+                    float(rand()) / float(RAND_MAX) * 1.0e-3f);
+  }
+  coords->point.finishEditing();
+
+  unsigned int nummethods;
+  const SbName * methods = SoOutput::getAvailableCompressionMethods(nummethods);
+  for (unsigned int m = 0; m < nummethods; m++) {
+    for (int numthreads = 1; numthreads <= maxthreads; numthreads *= 2) {
+      measure(root, methods[m], numthreads, filename);
+    }
+  }
+  (void)remove(filename);
+
+  root->unref();
+  return 0;
+}
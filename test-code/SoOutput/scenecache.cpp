@@ -0,0 +1,117 @@
+/************************************************************************
+ *
+ * Measure the cost of opening a large scene written in the scene cache
+ * format, compared to the same scene written as a plain binary file.
+ *
+ * A scene of many separators, each with a coordinate list of random
+ * points, is written with SoWriteAction both ways. The time taken to
+ * write each file, to read it with SoDB::readAll(), to get the bounding
+ * box of the scene read, and then to write the scene out again (which
+ * reads the rest of a scene cache file), is written to stdout.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/actions/SoWriteAction.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoPointSet.h>
+#include <Inventor/nodes/SoSeparator.h>
+
+#include "../benchmark.h"
+
+static void
+report(const char * format, const char * what, const SbTime & elapsed)
+{
+  (void)fprintf(stdout, "%-12s %-12s %8.3f s\n",
+                format, what, elapsed.getValue());
+}
+
+static void
+measure(SoSeparator * root, SbBool scenecache, const char * filename)
+{
+  const char * format = scenecache ? "scene cache" : "binary";
+
+  SoOutput out;
+  out.setBinary(TRUE);
+  out.setSceneCacheFormat(scenecache);
+  if (!out.openFile(filename)) exit(1);
+  SoWriteAction wa(&out);
+  SbTime start = SbTime::getTimeOfDay();
+  wa.apply(root);
+  out.closeFile();
+  report(format, "write", SbTime::getTimeOfDay() - start);
+
+  SoInput in;
+  if (!in.openFile(filename)) exit(1);
+  start = SbTime::getTimeOfDay();
+  SoSeparator * result = SoDB::readAll(&in);
+  report(format, "open", SbTime::getTimeOfDay() - start);
+  if (!result) exit(1);
+  result->ref();
+
+  SoGetBoundingBoxAction bboxaction((SbViewportRegion()));
+  start = SbTime::getTimeOfDay();
+  bboxaction.apply(result);
+  report(format, "bounding box", SbTime::getTimeOfDay() - start);
+
+  SoOutput nullout;
+  nullout.setBuffer(malloc(1024), 1024, realloc);
+  nullout.setBinary(TRUE);
+  SoWriteAction nullwa(&nullout);
+  start = SbTime::getTimeOfDay();
+  nullwa.apply(result);
+  report(format, "write again", SbTime::getTimeOfDay() - start);
+  void * buf;
+  size_t size;
+  (void)nullout.getBuffer(buf, size);
+  free(buf);
+
+  result->unref();
+}
+
+int
+main(int argc, char ** argv)
+{
+  benchmark_check_args(argc, argv, 1, 3, "FILE [SEPARATORS] [POINTS]",
+                       "\tFILE = temporary file to write to.\n"
+                       "\tSEPARATORS = number of separators (default 100).\n"
+                       "\tPOINTS = number of points per separator (default 100000).\n");
+  const char * filename = argv[1];
+  const int numseparators = benchmark_int_arg(argc, argv, 2, 100);
+  const int numpoints = benchmark_int_arg(argc, argv, 3, 100000);
+
+  SoDB::init();
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  srand(1);
+  for (int s = 0; s < numseparators; s++) {
+    SoSeparator * sep = new SoSeparator;
+    root->addChild(sep);
+    SoCoordinate3 * coords = new SoCoordinate3;
+    sep->addChild(coords);
+    sep->addChild(new SoPointSet);
+    coords->point.setNum(numpoints);
+    SbVec3f * pts = coords->point.startEditing();
+    for (int i = 0; i < numpoints; i++) {
+      pts[i].setValue(float(rand()) / float(RAND_MAX) + float(s),
+                      float(rand()) / float(RAND_MAX),
+                      float(rand()) / float(RAND_MAX));
+    }
+    coords->point.finishEditing();
+  }
+
+  measure(root, FALSE, filename);
+  measure(root, TRUE, filename);
+  (void)remove(filename);
+
+  root->unref();
+  return 0;
+}
@@ -0,0 +1,149 @@
+/************************************************************************
+ *
+ * Measure the effect of the vertex cache ordering of SoReorganizeAction
+ * on rendering.
+ *
+ * A sphere made of an SoIndexedFaceSet with shuffled faces is
+ * reorganized without reordering, with reordering for the vertex
+ * cache, and with reordering for both the vertex cache and overdraw.
+ * The cache statistics from SoReorganizeAction::finishReport() and
+ * the time per frame with SoOffscreenRenderer are written to stdout.
+ *
+ ************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoOffscreenRenderer.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoReorganizeAction.h>
+#include <Inventor/errors/SoDebugError.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoDirectionalLight.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoPerspectiveCamera.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoShapeHints.h>
+
+#include "../benchmark.h"
+
+static void
+print_info(const SoError * error, void *)
+{
+  (void)fprintf(stdout, "%s\n", error->getDebugString().getString());
+}
+
+static SoSeparator *
+make_sphere(int size)
+{
+  SoSeparator * root = new SoSeparator;
+  SoShapeHints * hints = new SoShapeHints;
+  hints->creaseAngle = 1.0f;
+  root->addChild(hints);
+
+  SoCoordinate3 * coords = new SoCoordinate3;
+  coords->point.setNum((size + 1) * (size + 1));
+  SbVec3f * pts = coords->point.startEditing();
+  for (int y = 0; y <= size; y++) {
+    for (int x = 0; x <= size; x++) {
+      const float theta = float(M_PI) * float(y) / float(size);
+      const float phi = 2.0f * float(M_PI) * float(x) / float(size);
+      pts[y * (size + 1) + x].setValue(float(sin(theta) * cos(phi)),
+                                       float(sin(theta) * sin(phi)),
+                                       float(cos(theta)));
+    }
+  }
+  coords->point.finishEditing();
+  root->addChild(coords);
+
+  int * order = new int[size * size];
+  for (int i = 0; i < size * size; i++) order[i] = i;
+  srand(1);
+  for (int i = size * size - 1; i > 0; i--) {
+    const int j = rand() % (i + 1);
+    const int tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+  }
+  SoIndexedFaceSet * ifs = new SoIndexedFaceSet;
+  ifs->coordIndex.setNum(size * size * 5);
+  int32_t * idx = ifs->coordIndex.startEditing();
+  for (int i = 0; i < size * size; i++) {
+    const int corner = (order[i] / size) * (size + 1) + order[i] % size;
+    *idx++ = corner;
+    *idx++ = corner + size + 1;
+    *idx++ = corner + size + 2;
+    *idx++ = corner + 1;
+    *idx++ = -1;
+  }
+  ifs->coordIndex.finishEditing();
+  delete[] order;
+  root->addChild(ifs);
+  return root;
+}
+
+static void
+measure(const char * what, SbBool vertexcache, SbBool overdraw,
+        int size, int numframes, SoOffscreenRenderer * renderer)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoPerspectiveCamera * camera = new SoPerspectiveCamera;
+  root->addChild(camera);
+  root->addChild(new SoDirectionalLight);
+  SoSeparator * sphere = make_sphere(size);
+  root->addChild(sphere);
+
+  SoReorganizeAction ra;
+  ra.optimizeVertexCache(vertexcache);
+  ra.optimizeOverdraw(overdraw);
+  SoReorganizeAction::startReport(what);
+  const SbTime start = SbTime::getTimeOfDay();
+  ra.apply(sphere);
+  const SbTime elapsed = SbTime::getTimeOfDay() - start;
+  SoReorganizeAction::finishReport();
+  benchmark_report(what, elapsed, size * size, "quad");
+
+  if (renderer) {
+    camera->viewAll(root, renderer->getViewportRegion());
+    // the first render sets up the vertex array caches
+    (void)renderer->render(root);
+    const SbTime renderstart = SbTime::getTimeOfDay();
+    for (int i = 0; i < numframes; i++) {
+      if (!renderer->render(root)) {
+        (void)fprintf(stderr, "Rendering failed.\n");
+        exit(1);
+      }
+    }
+    benchmark_report(what, SbTime::getTimeOfDay() - renderstart,
+                     numframes, "frame");
+  }
+  root->unref();
+}
+
+int
+main(int argc, char ** argv)
+{
+  benchmark_check_args(argc, argv, 0, 2, "[SIZE] [FRAMES]",
+                       "\tSIZE = number of quads along each side of the sphere\n"
+                       "\t       (default 500).\n"
+                       "\tFRAMES = number of frames to render, 0 to only\n"
+                       "\t         report the cache statistics (default 20).\n");
+  const int size = benchmark_int_arg(argc, argv, 1, 500);
+  const int numframes = benchmark_int_arg(argc, argv, 2, 20);
+
+  SoDB::init();
+  SoDebugError::setHandlerCallback(print_info, NULL);
+
+  SoOffscreenRenderer * renderer = NULL;
+  if (numframes > 0) {
+    renderer = new SoOffscreenRenderer(SbViewportRegion(512, 512));
+  }
+
+  measure("no reordering", FALSE, FALSE, size, numframes, renderer);
+  measure("vertex cache", TRUE, FALSE, size, numframes, renderer);
+  measure("vertex cache+overdraw", TRUE, TRUE, size, numframes, renderer);
+
+  delete renderer;
+  return 0;
+}
@@ -0,0 +1,127 @@
+/************************************************************************
+ *
+ * Measure the cost of scheduling, unscheduling and processing sensors
+ * in the timer queue and the delay queue of SoSensorManager, with a
+ * large number of sensors waiting at the same time.
+ *
+ * For each queue size, the sensors are scheduled with a few distinct
+ * trigger times (or priorities), every other sensor is unscheduled
+ * again in a scattered order, and the rest are then triggered by
+ * processing the queue. The time per sensor is written to stdout.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbString.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/sensors/SoAlarmSensor.h>
+#include <Inventor/sensors/SoOneShotSensor.h>
+#include <Inventor/sensors/SoSensorManager.h>
+
+#include "../benchmark.h"
+
+static int numtriggered = 0;
+
+static void
+count_cb(void *, SoSensor *)
+{
+  numtriggered++;
+}
+
+static void
+report(const char * queue, const char * what, const SbTime & elapsed, int num)
+{
+  SbString name;
+  name.sprintf("%s %s", queue, what);
+  benchmark_report(name.getString(), elapsed, num, "sensor");
+}
+
+// a scattered order, so unscheduling hits all parts of the queue
+static int
+scatter(int i, int num)
+{
+  return int((unsigned long)i * 7919UL % (unsigned long)num);
+}
+
+static void
+measure_timers(int num)
+{
+  SoSensorManager * sm = SoDB::getSensorManager();
+  SoAlarmSensor ** sensors = new SoAlarmSensor *[num];
+  const SbTime now = SbTime::getTimeOfDay();
+  int i;
+  for (i = 0; i < num; i++) {
+    sensors[i] = new SoAlarmSensor(count_cb, NULL);
+    sensors[i]->setTime(now - SbTime(double(i % 16)));
+  }
+
+  SbTime start = SbTime::getTimeOfDay();
+  for (i = 0; i < num; i++) sensors[i]->schedule();
+  report("timer", "schedule", SbTime::getTimeOfDay() - start, num);
+
+  start = SbTime::getTimeOfDay();
+  for (i = 0; i < num; i++) {
+    const int idx = scatter(i, num);
+    if (idx % 2) sensors[idx]->unschedule();
+  }
+  report("timer", "unschedule", SbTime::getTimeOfDay() - start, num / 2);
+
+  numtriggered = 0;
+  start = SbTime::getTimeOfDay();
+  sm->processTimerQueue();
+  report("timer", "process", SbTime::getTimeOfDay() - start, numtriggered);
+
+  for (i = 0; i < num; i++) delete sensors[i];
+  delete[] sensors;
+}
+
+static void
+measure_delays(int num)
+{
+  SoSensorManager * sm = SoDB::getSensorManager();
+  SoOneShotSensor ** sensors = new SoOneShotSensor *[num];
+  int i;
+  for (i = 0; i < num; i++) {
+    sensors[i] = new SoOneShotSensor(count_cb, NULL);
+    sensors[i]->setPriority(1 + i % 16);
+  }
+
+  SbTime start = SbTime::getTimeOfDay();
+  for (i = 0; i < num; i++) sensors[i]->schedule();
+  report("delay", "schedule", SbTime::getTimeOfDay() - start, num);
+
+  start = SbTime::getTimeOfDay();
+  for (i = 0; i < num; i++) {
+    const int idx = scatter(i, num);
+    if (idx % 2) sensors[idx]->unschedule();
+  }
+  report("delay", "unschedule", SbTime::getTimeOfDay() - start, num / 2);
+
+  numtriggered = 0;
+  start = SbTime::getTimeOfDay();
+  sm->processDelayQueue(TRUE);
+  report("delay", "process", SbTime::getTimeOfDay() - start, numtriggered);
+
+  for (i = 0; i < num; i++) delete sensors[i];
+  delete[] sensors;
+}
+
+int
+main(int argc, char ** argv)
+{
+  benchmark_check_args(argc, argv, 0, 1, "[MAXSENSORS]",
+                       "\tMAXSENSORS = largest queue size, starting at 10000\n"
+                       "\t             and growing by 10x (default 1000000).\n");
+  const int maxsensors = benchmark_int_arg(argc, argv, 1, 1000000);
+
+  SoDB::init();
+
+  for (int num = 10000; num <= maxsensors; num *= 10) {
+    (void)fprintf(stdout, "%d sensors\n", num);
+    measure_timers(num);
+    measure_delays(num);
+  }
+  return 0;
+}
@@ -0,0 +1,141 @@
+/************************************************************************
+ *
+ * Measure the per-separator traversal overhead of SoCallbackAction
+ * and SoGLRenderAction. A scene graph with a large number of nested
+ * and sibling SoSeparator nodes is traversed a number of times, and
+ * the average time per separator is written to stdout.
+ *
+ * The cost of SoState::push(), setting two elements and
+ * SoState::pop() is also measured on its own, without any node
+ * traversal, as it is easily hidden by the noise of the full
+ * traversals.
+ *
+ * SoGLRenderAction is only measured when asked for, as it needs an
+ * offscreen context.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/SoOffscreenRenderer.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/elements/SoDrawStyleElement.h>
+#include <Inventor/elements/SoModelMatrixElement.h>
+#include <Inventor/misc/SoState.h>
+#include <Inventor/nodes/SoBaseColor.h>
+#include <Inventor/nodes/SoDrawStyle.h>
+#include <Inventor/nodes/SoInfo.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+#include "../benchmark.h"
+
+static int numseparators = 0;
+
+// Builds a tree of separators, each changing a few elements so that
+// they must be pushed for real.
+static SoSeparator *
+build(int depth, int width)
+{
+  SoSeparator * sep = new SoSeparator;
+  // we want to measure state handling, not the caches
+  sep->renderCaching = SoSeparator::OFF;
+  sep->boundingBoxCaching = SoSeparator::OFF;
+  numseparators++;
+
+  SoTranslation * t = new SoTranslation;
+  t->translation.setValue(0.01f, 0.0f, 0.0f);
+  sep->addChild(t);
+  SoBaseColor * c = new SoBaseColor;
+  c->rgb.setValue(float(depth) / 10.0f, 0.5f, 0.5f);
+  sep->addChild(c);
+  if (depth % 2) sep->addChild(new SoDrawStyle);
+  sep->addChild(new SoInfo);
+
+  if (depth > 0) {
+    for (int i = 0; i < width; i++) {
+      sep->addChild(build(depth - 1, width));
+    }
+  }
+  return sep;
+}
+
+static void
+report(const char * name, const SbTime & elapsed, int numruns)
+{
+  const double nsec = elapsed.getValue() * 1.0e9 / (double(numruns) * numseparators);
+  (void)fprintf(stdout, "%-16s %8.1f ns/separator (%d runs, %.3f s)\n",
+                name, nsec, numruns, elapsed.getValue());
+}
+
+int
+main(int argc, char ** argv)
+{
+  // an unknown last argument gets the usage message too
+  benchmark_check_args(argc, argv, 0,
+                       (argc == 4 && strcmp(argv[3], "gl") != 0) ? 2 : 3,
+                       "[DEPTH [RUNS [gl]]]",
+                       "\tDEPTH = depth of the separator tree (default 7).\n"
+                       "\tRUNS = number of traversals (default 20).\n"
+                       "\tgl = also measure SoGLRenderAction.\n");
+  const int depth = benchmark_int_arg(argc, argv, 1, 7);
+  const int numruns = benchmark_int_arg(argc, argv, 2, 20);
+  const int measuregl = argc > 3;
+
+  SoDB::init();
+
+  SoSeparator * root = build(depth, 4);
+  root->ref();
+  (void)fprintf(stdout, "%d separators, depth %d\n", numseparators, depth);
+
+  SbViewportRegion vp(256, 256);
+  int i;
+
+  SoCallbackAction cba(vp);
+  cba.apply(root); // warm up
+  SbTime start = SbTime::getTimeOfDay();
+  for (i = 0; i < numruns; i++) cba.apply(root);
+  report("SoCallbackAction", SbTime::getTimeOfDay() - start, numruns);
+
+  // simulate the separator traversal on the state of the callback
+  // action, in the same order as the tree above
+  SoState * state = cba.getState();
+  const SbVec3f offset(0.01f, 0.0f, 0.0f);
+  start = SbTime::getTimeOfDay();
+  for (i = 0; i < numruns; i++) {
+    for (int j = 0; j < numseparators; j++) {
+      state->push();
+      SoModelMatrixElement::translateBy(state, NULL, offset);
+      SoDrawStyleElement::set(state, SoDrawStyleElement::FILLED);
+      if (j % 4 == 3) {
+        // unwind a few levels, as at the end of a child list
+        state->pop();
+        state->pop();
+      }
+      else if (j % 4 != 0) {
+        state->pop();
+      }
+    }
+    while (state->getDepth() > 0) state->pop();
+  }
+  report("SoState", SbTime::getTimeOfDay() - start, numruns);
+
+  if (measuregl) {
+    SoOffscreenRenderer renderer(vp);
+    if (renderer.render(root)) {
+      start = SbTime::getTimeOfDay();
+      for (i = 0; i < numruns; i++) renderer.render(root);
+      report("SoGLRenderAction", SbTime::getTimeOfDay() - start, numruns);
+    }
+    else {
+      (void)fprintf(stderr, "Couldn't render offscreen.\n");
+    }
+  }
+
+  root->unref();
+  return 0;
+}
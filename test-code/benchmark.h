@@ -0,0 +1,70 @@
+#ifndef COIN_TESTCODE_BENCHMARK_H
+#define COIN_TESTCODE_BENCHMARK_H
+
+/************************************************************************
+ *
+ * Helpers shared by the benchmarks in the subdirectories: checking
+ * the command line, reading optional numeric arguments, and writing
+ * the timings to stdout in the same format everywhere.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SbBasic.h>
+#include <Inventor/SbTime.h>
+
+// The description of the MAXTHREADS argument taken by the
+// benchmarks which are run with 1, 2, 4, ... threads.
+#define BENCHMARK_MAXTHREADS_USAGE(def) \
+  "\tMAXTHREADS = largest number of threads, starting at 1\n" \
+  "\t             and doubling (default " #def ").\n"
+
+// Exits with the usage message unless the number of arguments is
+// between minargs and maxargs.
+inline void
+benchmark_check_args(int argc, char ** argv, int minargs, int maxargs,
+                     const char * synopsis, const char * description)
+{
+  if (argc - 1 < minargs || argc - 1 > maxargs) {
+    (void)fprintf(stderr, "\n\n\tUsage: %s %s\n\n%s\n",
+                  argv[0], synopsis, description);
+    exit(1);
+  }
+}
+
+// Returns argument idx as an integer, or defaultvalue if it wasn't
+// given.
+inline int
+benchmark_int_arg(int argc, char ** argv, int idx, int defaultvalue)
+{
+  return argc > idx ? atoi(argv[idx]) : defaultvalue;
+}
+
+// Writes the time per item, in whichever of ns, us and ms is
+// readable, along with the total time.
+inline void
+benchmark_report(const char * what, const SbTime & elapsed, int num,
+                 const char * item)
+{
+  double per = num > 0 ? elapsed.getValue() / double(num) : 0.0;
+  const char * unit = "ns";
+  if (per < 1.0e-6) { per *= 1.0e9; }
+  else if (per < 1.0e-3) { per *= 1.0e6; unit = "us"; }
+  else { per *= 1.0e3; unit = "ms"; }
+  (void)fprintf(stdout, "%-24s %8.1f %s/%s (%.3f s)\n",
+                what, per, unit, item, elapsed.getValue());
+}
+
+// Writes the time taken with numthreads threads, followed by result
+// (e.g. whether the output matched the one from a single thread) if
+// it isn't NULL.
+inline void
+benchmark_report_threads(const char * what, int numthreads,
+                         const SbTime & elapsed, const char * result)
+{
+  (void)fprintf(stdout, "%-12s %2d threads %8.3f s %s\n",
+                what, numthreads, elapsed.getValue(), result ? result : "");
+}
+
+#endif // !COIN_TESTCODE_BENCHMARK_H
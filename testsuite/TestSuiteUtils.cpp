@@ -32,6 +32,7 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 #if defined (_POSIX_C_SOURCE) || defined (_POSIX_SOURCE) || defined(__APPLE__) || defined(__FreeBSD__)
@@ -387,6 +388,27 @@ namespace {
 }
 }
 
+std::string
+TestSuite::TemporaryFileName(const char * suffix)
+{
+  static int counter = 0;
+  char name[64];
+#ifdef USE_POSIX
+  const char * dir = getenv("TMPDIR");
+  if (dir == NULL || dir[0] == '\0') dir = "/tmp";
+  sprintf(name, "coin_test_%ld_%d", (long)getpid(), counter++);
+  return std::string(dir) + DIRECTORY_SEPARATOR + name + suffix;
+#endif //USE_POSIX
+#ifdef USE_WIN32
+  char dir[MAX_PATH + 1];
+  if (GetTempPath(sizeof(dir), dir) == 0) strcpy(dir, "./");
+  // forward slashes, so the path can be put in a scene file as it is
+  for (char * p = dir; *p; p++) { if (*p == '\\') *p = '/'; }
+  sprintf(name, "coin_test_%lu_%d", (unsigned long)GetCurrentProcessId(), counter++);
+  return std::string(dir) + name + suffix;
+#endif //USE_WIN32
+}
+
 void
 TestSuite::test_file(const std::string & filename,
                           test_files_CB * testFunction)
@@ -65,6 +65,10 @@ int GetMemoryErrorCount(void);
 SoNode * ReadInventorFile(const char * filename);
 int WriteInventorFile(const char * filename, SoNode * root);
 
+// a path in the temporary directory not used by any other test or
+// test run, for tests which need a real file
+std::string TemporaryFileName(const char * suffix);
+
 void test_file(const std::string & filename,
                     test_files_CB * testFunction);
 void test_all_files(const std::string & search_directory,